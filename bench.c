@@ -0,0 +1,1602 @@
+/* Benchmarks for the scorecard core.
+   Build: gcc -O2 -pthread bench.c bsc.c -o bench
+   Run:   ./bench [kpis] [reps]      (defaults: 1000000 KPIs, 20 repetitions)
+          ./bench --suite [options]  (generated workload, machine-readable; see suiteUsage)
+          ./bench --load [options]   (query server under concurrent clients; see loadUsage)
+          ./bench --memory [options] (resident memory per KPI; see memoryUsage)
+          ./bench --ingest [options] (multi-producer ingest throughput; see ingestUsage)
+          ./bench --tree [--names N] (AVL height check on sorted inserts; exits 1 on failure) */
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "bsc.h"
+
+static double nowSec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* one pass over every perspective; returns total performance sum */
+static double statsPass(Graph *g, KPIBatchStats *total) {
+    double sum = 0.0;
+    total->sumPerf = 0.0;
+    total->count = 0;
+    for (int b = 0; b < BAND_COUNT; ++b) total->bands[b] = 0;
+    for (int id = 0; id < g->numNodes; ++id) {
+        KPIBatchStats st;
+        perspectiveKPIStats(g, id, &st);
+        sum += st.sumPerf;
+        total->count += st.count;
+        for (int b = 0; b < BAND_COUNT; ++b) total->bands[b] += st.bands[b];
+    }
+    total->sumPerf = sum;
+    return sum;
+}
+
+/* fill g with kpis random KPIs spread over the four default perspectives */
+static void buildScorecard(Graph *g, long kpis) {
+    static const char *pers[] = { "Financial", "Customer", "Internal", "Learning" };
+    srand(42);
+    char name[MAX_NAME_LEN];
+    for (long i = 0; i < kpis; ++i) {
+        snprintf(name, sizeof(name), "KPI %ld", i);
+        float target = (float)(1 + rand() % 100);
+        float achieved = (float)(rand() % 130);
+        addKPIRecord(g, pers[i % 4], name, target, achieved);
+    }
+}
+
+/* insert + teardown cost and allocator call counts */
+static void benchAlloc(long kpis) {
+    Graph g;
+    initGraph(&g);
+    double t0 = nowSec();
+    buildScorecard(&g, kpis);
+    double buildSec = nowSec() - t0;
+
+    AllocStats st;
+    getAllocStats(&g, &st);
+    t0 = nowSec();
+    freeAll(&g);
+    double freeSec = nowSec() - t0;
+
+    printf("Allocation (%ld KPIs, %d perspectives)\n", kpis, 4);
+    printf("  insert    : %8.3f ms  %7.2f ns/KPI\n", buildSec * 1e3, buildSec * 1e9 / (double)kpis);
+    printf("  freeAll   : %8.3f ms\n", freeSec * 1e3);
+    printf("  malloc    : %ld chunk allocations for %ld objects (%.1f MiB reserved)\n",
+           st.mallocCalls, st.objects, (double)st.bytes / (1024.0 * 1024.0));
+}
+
+/* snapshot save + startup (load) time */
+static void benchSnapshot(long kpis) {
+    const char *path = "bench_snapshot.bin";
+    Graph g;
+    initGraph(&g);
+    buildScorecard(&g, kpis);
+    double t0 = nowSec();
+    int rc = saveSnapshot(&g, path);
+    double saveSec = nowSec() - t0;
+    freeAll(&g);
+    t0 = nowSec();
+    if (rc == 0) rc = loadSnapshot(&g, path);
+    double loadSec = nowSec() - t0;
+    remove(path);
+    if (rc != 0) { printf("Snapshot benchmark failed\n"); freeAll(&g); return; }
+    printf("Snapshot (%ld KPIs)\n", kpis);
+    printf("  save      : %8.3f ms\n", saveSec * 1e3);
+    printf("  load      : %8.3f ms\n", loadSec * 1e3);
+    freeAll(&g);
+}
+
+/* logged ingest (group commit) and log replay throughput */
+static void benchWal(long kpis) {
+    const char *path = "bench_wal.log";
+    remove(path);
+    Graph g;
+    initGraph(&g);
+    if (walOpen(&g, path) < 0) { printf("WAL benchmark failed\n"); return; }
+    double t0 = nowSec();
+    buildScorecard(&g, kpis);
+    walCommit(&g);
+    double ingestSec = nowSec() - t0;
+    long records = g.wal->records, commits = g.wal->commits;
+    walClose(&g);
+    freeAll(&g);
+
+    t0 = nowSec();
+    long replayed = walOpen(&g, path);
+    double replaySec = nowSec() - t0;
+    walClose(&g);
+    freeAll(&g);
+    remove(path);
+
+    printf("Write-ahead log (%ld KPIs)\n", kpis);
+    printf("  ingest    : %8.3f ms  %ld records in %ld group commits\n", ingestSec * 1e3, records, commits);
+    printf("  replay    : %8.3f ms  %.0f records/sec\n", replaySec * 1e3,
+           replaySec > 0.0 ? (double)replayed / replaySec : 0.0);
+}
+
+/* recording observations and rolling-window queries over long histories;
+   query cost should follow the window, not the history length */
+static void benchHistory(long kpis, int reps) {
+    static const char *pers[] = { "Financial", "Customer", "Internal", "Learning" };
+    const long n = 64;                        /* few KPIs, long histories */
+    int periods = (int)(kpis / n > 0 ? kpis / n : 1);
+    Graph g;
+    initGraph(&g);
+    char name[MAX_NAME_LEN];
+    srand(42);
+    double t0 = nowSec();
+    for (int p = 0; p < periods; ++p) {
+        for (long i = 0; i < n; ++i) {
+            snprintf(name, sizeof(name), "KPI %ld", i);
+            recordKPIObservation(&g, pers[i % 4], name, 200000 + p,
+                                 (float)(1 + rand() % 100), (float)(rand() % 130));
+        }
+    }
+    double recSec = nowSec() - t0;
+    long obs = n * periods;
+
+    printf("History (%ld KPIs x %d periods = %ld observations)\n", n, periods, obs);
+    printf("  record    : %8.3f ms  %7.2f ns/observation\n", recSec * 1e3, recSec * 1e9 / (double)obs);
+    static const int windows[] = { 4, 13, 52 };
+    for (int w = 0; w < 3; ++w) {
+        KPITrend t;
+        volatile float sink = 0.0f;
+        long queries = 0;
+        t0 = nowSec();
+        for (int r = 0; r < reps; ++r) {
+            for (long i = 0; i < n; ++i, ++queries) {
+                snprintf(name, sizeof(name), "KPI %ld", i);
+                if (kpiTrend(&g, pers[i % 4], name, 200000 + periods / 2, windows[w], &t) == 0) sink += t.slope;
+            }
+        }
+        (void)sink;
+        double sec = nowSec() - t0;
+        printf("  trend w=%-2d: %8.3f ms  %7.2f ns/query (incl. KPI lookup)\n",
+               windows[w], sec * 1e3, sec * 1e9 / (double)queries);
+    }
+    freeAll(&g);
+}
+
+/* parallel score pass on a skewed scorecard at 1..16 threads */
+static void benchParallel(long kpis, int reps) {
+    static const char *pers[] = { "Financial", "Customer", "Internal", "Learning" };
+    Graph g;
+    initGraph(&g);
+    srand(42);
+    char name[MAX_NAME_LEN];
+    for (long i = 0; i < kpis; ++i) {
+        /* 85% / 10% / 4% / 1% of the KPIs */
+        int r = (int)(i % 100);
+        int p = r < 85 ? 0 : r < 95 ? 1 : r < 99 ? 2 : 3;
+        snprintf(name, sizeof(name), "KPI %ld", i);
+        addKPIRecord(&g, pers[p], name, (float)(1 + rand() % 100), (float)(rand() % 130));
+    }
+    KPIBatchStats first[4], st[4];
+    evaluateKPIStats(&g, PERIOD_LATEST, first);   /* builds the columns */
+
+    printf("Parallel evaluation (%ld KPIs, skewed 85/10/4/1)\n", kpis);
+    static const int counts[] = { 1, 2, 4, 8, 16 };
+    double base[2] = { 0.0, 0.0 };
+    for (int c = 0; c < 5; ++c) {
+        setEvalThreads(&g, counts[c]);
+        double sec[2];
+        int same = 1;
+        for (int mode = 0; mode < 2; ++mode) {
+            int32_t period = mode == 0 ? PERIOD_LATEST : 0;
+            evaluateKPIStats(&g, period, st);           /* warm-up */
+            double t0 = nowSec();
+            for (int r = 0; r < reps; ++r) evaluateKPIStats(&g, period, st);
+            sec[mode] = (nowSec() - t0) / reps;
+            if (c == 0) base[mode] = sec[mode];
+            for (int p = 0; p < 4; ++p)
+                same &= st[p].sumPerf == first[p].sumPerf && st[p].count == first[p].count;
+        }
+        printf("  threads %2d: current %7.3f ms (%.2fx)  as-of %7.3f ms (%.2fx)  results %s\n",
+               counts[c], sec[0] * 1e3, base[0] / sec[0], sec[1] * 1e3, base[1] / sec[1],
+               same ? "identical" : "DIFFER");
+    }
+    setEvalThreads(&g, 1);
+    freeAll(&g);
+}
+
+/* ---------- Workload suite ----------
+   ./bench --suite [options] builds one scorecard of the requested shape and
+   times every core operation on it. Results are one row per operation:
+   ns/op, ops/sec, work items (KPIs, edges, ...) per second, and the
+   process's peak RSS once the operation finished. */
+
+enum { CASE_LOWER, CASE_UPPER, CASE_MIXED };
+enum { OUT_TEXT, OUT_JSON, OUT_CSV };
+
+typedef struct Workload {
+    int perspectives;
+    long kpis;              /* in total, spread over the perspectives */
+    int skewed;             /* 0: uniform, 1: perspective r gets weight 1/(r+1) */
+    double depDensity;      /* fraction of the P*(P-1) possible edges */
+    int casing;             /* how names are spelled on insert and lookup */
+    long lookups;
+    int reps;
+    int output;
+    unsigned seed;
+} Workload;
+
+typedef struct OpResult {
+    const char *op;
+    long ops;
+    double items;           /* work units per op, e.g. KPIs visited */
+    double sec;
+    long peakRssKiB;
+} OpResult;
+
+#define SUITE_MAX_OPS 16
+
+/* xorshift32: deterministic across platforms, unlike rand() */
+static unsigned nextRand(unsigned *s) {
+    unsigned x = *s;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return *s = x;
+}
+
+/* peak resident set size in KiB (ru_maxrss is already KiB on Linux) */
+static long peakRssKiB(void) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) return -1;
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+}
+
+/* "Persp" + index in base-26 letters (perspective names may not hold digits),
+   cased as the workload asks */
+static void workloadName(char *out, const char *prefix, long i, int casing, unsigned *rng) {
+    char *p = out;
+    for (const char *s = prefix; *s; ++s) *p++ = *s;
+    do { *p++ = (char)('a' + i % 26); i /= 26; } while (i > 0);
+    *p = '\0';
+    for (p = out; *p; ++p) {
+        int upper = casing == CASE_UPPER || (casing == CASE_MIXED && (nextRand(rng) & 1));
+        *p = (char)(upper ? toupper((unsigned char)*p) : tolower((unsigned char)*p));
+    }
+}
+
+/* perspective of every KPI: round robin, or sampled from the 1/(r+1) weights */
+static int *workloadPlacement(const Workload *w, unsigned *rng) {
+    int *at = malloc((size_t)w->kpis * sizeof(int));
+    double *cdf = malloc((size_t)w->perspectives * sizeof(double));
+    if (!at || !cdf) { perror("malloc"); exit(1); }
+    double total = 0.0;
+    for (int p = 0; p < w->perspectives; ++p) cdf[p] = total += 1.0 / (double)(p + 1);
+    for (long k = 0; k < w->kpis; ++k) {
+        if (!w->skewed) { at[k] = (int)(k % w->perspectives); continue; }
+        double u = (double)nextRand(rng) / 4294967296.0 * total;
+        int lo = 0, hi = w->perspectives - 1;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (cdf[mid] > u) hi = mid; else lo = mid + 1;
+        }
+        at[k] = lo;
+    }
+    free(cdf);
+    return at;
+}
+
+/* stdout to /dev/null for the renderers; returns the saved descriptor or -1 */
+static int muteStdout(void) {
+    fflush(stdout);
+    int saved = dup(1);
+    int devnull = open("/dev/null", O_WRONLY);
+    if (saved < 0 || devnull < 0) {
+        if (saved >= 0) close(saved);
+        if (devnull >= 0) close(devnull);
+        return -1;
+    }
+    dup2(devnull, 1);
+    close(devnull);
+    return saved;
+}
+
+static void unmuteStdout(int saved) {
+    if (saved < 0) return;
+    fflush(stdout);
+    dup2(saved, 1);
+    close(saved);
+}
+
+/* cheap queries repeat until the timer has something to measure */
+#define SUITE_MIN_SEC 0.05
+
+static long timeRepeated(void (*fn)(void *), void *ctx, int minReps, double *sec) {
+    long n = 0;
+    double t0 = nowSec(), t;
+    do {
+        for (int r = 0; r < minReps; ++r) fn(ctx);
+        n += minReps;
+        t = nowSec() - t0;
+    } while (t < SUITE_MIN_SEC);
+    *sec = t;
+    return n;
+}
+
+typedef struct QueryCtx {
+    Graph *g;
+    int32_t period;
+    PerspectiveResult *persp;
+    EvaluationResult ev;
+} QueryCtx;
+
+static void scoresOnce(void *p) {
+    QueryCtx *q = (QueryCtx*)p;
+    queryPerspectives(q->g, q->period, q->persp, q->g->numNodes);
+}
+
+static void evaluateOnce(void *p) {
+    QueryCtx *q = (QueryCtx*)p;
+    queryEvaluation(q->g, q->period, q->persp, q->g->numNodes, NULL, 0, &q->ev);
+}
+
+static void distributionOnce(void *p) {
+    QueryCtx *q = (QueryCtx*)p;
+    KPIRank worst[50], best[50];
+    KPIDistribution d;
+    queryDistribution(q->g, q->period, 50, worst, best, NULL, &d);
+}
+
+static void evaluateRenderOnce(void *p) {
+    evaluatePerformanceWithDependencies(((QueryCtx*)p)->g);
+}
+
+static void addResult(OpResult *res, int *n, const char *op, long ops, double items, double sec) {
+    OpResult *r = &res[(*n)++];
+    r->op = op;
+    r->ops = ops;
+    r->items = items;
+    r->sec = sec;
+    r->peakRssKiB = peakRssKiB();
+}
+
+static void printSuite(const Workload *w, const OpResult *res, int n, int height, const AllocStats *as) {
+    static const char *casings[] = { "lower", "upper", "mixed" };
+    if (w->output == OUT_JSON) {
+        printf("{\"config\": {\"perspectives\": %d, \"kpis\": %ld, \"shape\": \"%s\", \"dep_density\": %g, "
+               "\"casing\": \"%s\", \"lookups\": %ld, \"reps\": %d, \"seed\": %u, \"kernel\": \"%s\"},\n",
+               w->perspectives, w->kpis, w->skewed ? "skewed" : "uniform", w->depDensity,
+               casings[w->casing], w->lookups, w->reps, w->seed, kpiKernelName());
+        printf(" \"tree_height\": %d, \"alloc_calls\": %ld, \"alloc_bytes\": %ld, \"results\": [", height,
+               as->mallocCalls, (long)as->bytes);
+        for (int i = 0; i < n; ++i) {
+            const OpResult *r = &res[i];
+            printf("%s\n  {\"op\": \"%s\", \"ops\": %ld, \"items_per_op\": %.0f, \"total_ms\": %.3f, "
+                   "\"ns_per_op\": %.2f, \"ops_per_sec\": %.0f, \"items_per_sec\": %.0f, \"peak_rss_kib\": %ld}",
+                   i ? "," : "", r->op, r->ops, r->items, r->sec * 1e3,
+                   r->sec * 1e9 / (double)r->ops, r->sec > 0.0 ? (double)r->ops / r->sec : 0.0,
+                   r->sec > 0.0 ? (double)r->ops * r->items / r->sec : 0.0, r->peakRssKiB);
+        }
+        printf("\n]}\n");
+    } else if (w->output == OUT_CSV) {
+        printf("op,ops,items_per_op,total_ms,ns_per_op,ops_per_sec,items_per_sec,peak_rss_kib\n");
+        for (int i = 0; i < n; ++i) {
+            const OpResult *r = &res[i];
+            printf("%s,%ld,%.0f,%.3f,%.2f,%.0f,%.0f,%ld\n", r->op, r->ops, r->items, r->sec * 1e3,
+                   r->sec * 1e9 / (double)r->ops, r->sec > 0.0 ? (double)r->ops / r->sec : 0.0,
+                   r->sec > 0.0 ? (double)r->ops * r->items / r->sec : 0.0, r->peakRssKiB);
+        }
+    } else {
+        printf("Workload: %d perspectives, %ld KPIs (%s), dependency density %g, %s names, seed %u\n",
+               w->perspectives, w->kpis, w->skewed ? "skewed" : "uniform", w->depDensity,
+               casings[w->casing], w->seed);
+        printf("  tree height %d, %ld pool allocations (%.1f MiB)\n", height, as->mallocCalls,
+               (double)as->bytes / (1024.0 * 1024.0));
+        printf("  %-18s %10s %12s %14s %14s %10s\n", "op", "ops", "ns/op", "ops/sec", "items/sec", "peak RSS");
+        for (int i = 0; i < n; ++i) {
+            const OpResult *r = &res[i];
+            printf("  %-18s %10ld %12.2f %14.0f %14.0f %7.1f MiB\n", r->op, r->ops,
+                   r->sec * 1e9 / (double)r->ops, r->sec > 0.0 ? (double)r->ops / r->sec : 0.0,
+                   r->sec > 0.0 ? (double)r->ops * r->items / r->sec : 0.0, (double)r->peakRssKiB / 1024.0);
+        }
+    }
+}
+
+static void runSuite(const Workload *w) {
+    OpResult res[SUITE_MAX_OPS];
+    int nres = 0;
+    unsigned rng = w->seed ? w->seed : 1;
+    char name[MAX_NAME_LEN], kname[MAX_NAME_LEN];
+    FILE *quiet = fopen("/dev/null", "w");
+    if (quiet) setMessageStream(quiet);          /* addDependency reports every edge */
+
+    Graph g;
+    initGraph(&g);
+
+    double t0 = nowSec();
+    for (int p = 0; p < w->perspectives; ++p) {
+        workloadName(name, "Persp", p, w->casing, &rng);
+        addPerspectiveIfNotExists(&g, name);
+    }
+    addResult(res, &nres, "add-perspective", w->perspectives, 1, nowSec() - t0);
+    int height = perspectiveTreeHeight(&g);
+
+    long edges = (long)(w->depDensity * (double)w->perspectives * (double)(w->perspectives - 1));
+    if (edges > 0 && w->perspectives > 1) {
+        char to[MAX_NAME_LEN];
+        t0 = nowSec();
+        for (long e = 0; e < edges; ++e) {
+            int a = (int)(nextRand(&rng) % (unsigned)w->perspectives);
+            int b = (int)(nextRand(&rng) % (unsigned)(w->perspectives - 1));
+            if (b >= a) ++b;
+            workloadName(name, "Persp", a, w->casing, &rng);
+            workloadName(to, "Persp", b, w->casing, &rng);
+            addDependency(&g, name, to);
+        }
+        addResult(res, &nres, "add-dependency", edges, 1, nowSec() - t0);
+    }
+
+    int *at = workloadPlacement(w, &rng);
+    t0 = nowSec();
+    for (long k = 0; k < w->kpis; ++k) {
+        workloadName(name, "Persp", at[k], w->casing, &rng);
+        snprintf(kname, sizeof(kname), "KPI %ld", k);
+        addKPIRecord(&g, name, kname, (float)(1 + nextRand(&rng) % 100), (float)(nextRand(&rng) % 130));
+    }
+    addResult(res, &nres, "kpi-insert", w->kpis, 1, nowSec() - t0);
+
+    /* feed updates: new values for existing KPIs, found by name */
+    if (w->kpis > 0) {
+        t0 = nowSec();
+        for (long i = 0; i < w->lookups; ++i) {
+            long k = (long)(nextRand(&rng) % (unsigned long)w->kpis);
+            workloadName(name, "Persp", at[k], w->casing, &rng);
+            snprintf(kname, sizeof(kname), "KPI %ld", k);
+            upsertKPI(&g, name, kname, (float)(1 + nextRand(&rng) % 100), (float)(nextRand(&rng) % 130));
+        }
+        addResult(res, &nres, "kpi-upsert", w->lookups, 1, nowSec() - t0);
+    }
+    free(at);
+
+    /* lookups: 90% hits spelled in the workload's casing, 10% misses */
+    volatile int sink = 0;
+    t0 = nowSec();
+    for (long i = 0; i < w->lookups; ++i) {
+        unsigned r = nextRand(&rng);
+        workloadName(name, r % 10 ? "Persp" : "Missing", (long)(r / 10 % (unsigned)w->perspectives), w->casing, &rng);
+        sink += findPerspective(&g, name);
+    }
+    addResult(res, &nres, "find-perspective", w->lookups, 1, nowSec() - t0);
+
+    /* the name generation above is part of the measured loop; time it alone */
+    t0 = nowSec();
+    for (long i = 0; i < w->lookups; ++i) {
+        unsigned r = nextRand(&rng);
+        workloadName(name, r % 10 ? "Persp" : "Missing", (long)(r / 10 % (unsigned)w->perspectives), w->casing, &rng);
+        sink += name[0];
+    }
+    res[nres - 1].sec -= nowSec() - t0;
+    if (res[nres - 1].sec < 0.0) res[nres - 1].sec = 0.0;
+    (void)sink;
+
+    /* computeScores became queryPerspectives (current values, from the aggregates) */
+    QueryCtx q = { &g, PERIOD_LATEST, NULL, { 0 } };
+    q.persp = malloc((size_t)w->perspectives * sizeof(PerspectiveResult));
+    if (!q.persp) { perror("malloc"); exit(1); }
+    double sec;
+    long n = timeRepeated(scoresOnce, &q, w->reps, &sec);
+    addResult(res, &nres, "compute-scores", n, (double)w->perspectives, sec);
+    n = timeRepeated(evaluateOnce, &q, w->reps, &sec);
+    addResult(res, &nres, "evaluate-query", n, (double)w->perspectives, sec);
+    q.period = 0;                               /* as-of: visits every KPI */
+    n = timeRepeated(evaluateOnce, &q, w->reps, &sec);
+    addResult(res, &nres, "evaluate-as-of", n, (double)w->kpis, sec);
+    q.period = PERIOD_LATEST;
+    n = timeRepeated(distributionOnce, &q, 1, &sec);
+    addResult(res, &nres, "distribution", n, (double)w->kpis, sec);
+
+    setReportFormat(&g, REPORT_PLAIN);
+    int saved = muteStdout();
+    if (saved >= 0) {
+        n = timeRepeated(evaluateRenderOnce, &q, w->reps, &sec);
+        t0 = nowSec();
+        generateScorecard(&g);                  /* one full scorecard is plenty */
+        double renderSec = nowSec() - t0;
+        unmuteStdout(saved);
+        addResult(res, &nres, "evaluate-render", n, (double)w->perspectives, sec);
+        addResult(res, &nres, "render-scorecard", 1, (double)w->kpis, renderSec);
+    }
+    free(q.persp);
+
+    AllocStats as;
+    getAllocStats(&g, &as);
+    t0 = nowSec();
+    freeAll(&g);
+    addResult(res, &nres, "free-all", 1, (double)w->kpis, nowSec() - t0);
+
+    setMessageStream(NULL);
+    if (quiet) fclose(quiet);
+    printSuite(w, res, nres, height, &as);
+}
+
+static int suiteUsage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s --suite [--perspectives N] [--kpis N] [--shape uniform|skewed]\n"
+            "       [--deps DENSITY] [--case lower|upper|mixed] [--lookups N] [--reps N]\n"
+            "       [--seed N] [--output text|json|csv]\n", prog);
+    return 2;
+}
+
+static int suiteMain(int argc, char **argv) {
+    Workload w = { 4, 1000000L, 0, 0.0, CASE_MIXED, 1000000L, 5, OUT_TEXT, 42u };
+    for (int i = 2; i < argc; ++i) {
+        const char *opt = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val) return suiteUsage(argv[0]);
+        ++i;
+        if (strcmp(opt, "--perspectives") == 0) w.perspectives = atoi(val);
+        else if (strcmp(opt, "--kpis") == 0) w.kpis = atol(val);
+        else if (strcmp(opt, "--lookups") == 0) w.lookups = atol(val);
+        else if (strcmp(opt, "--reps") == 0) w.reps = atoi(val);
+        else if (strcmp(opt, "--seed") == 0) w.seed = (unsigned)strtoul(val, NULL, 10);
+        else if (strcmp(opt, "--deps") == 0) w.depDensity = atof(val);
+        else if (strcmp(opt, "--shape") == 0 && strcmp(val, "uniform") == 0) w.skewed = 0;
+        else if (strcmp(opt, "--shape") == 0 && strcmp(val, "skewed") == 0) w.skewed = 1;
+        else if (strcmp(opt, "--case") == 0 && strcmp(val, "lower") == 0) w.casing = CASE_LOWER;
+        else if (strcmp(opt, "--case") == 0 && strcmp(val, "upper") == 0) w.casing = CASE_UPPER;
+        else if (strcmp(opt, "--case") == 0 && strcmp(val, "mixed") == 0) w.casing = CASE_MIXED;
+        else if (strcmp(opt, "--output") == 0 && strcmp(val, "text") == 0) w.output = OUT_TEXT;
+        else if (strcmp(opt, "--output") == 0 && strcmp(val, "json") == 0) w.output = OUT_JSON;
+        else if (strcmp(opt, "--output") == 0 && strcmp(val, "csv") == 0) w.output = OUT_CSV;
+        else return suiteUsage(argv[0]);
+    }
+    if (w.perspectives <= 0 || w.kpis < 0 || w.lookups <= 0 || w.reps <= 0 ||
+        w.depDensity < 0.0 || w.depDensity > 1.0)
+        return suiteUsage(argv[0]);
+    runSuite(&w);
+    return 0;
+}
+
+/* ---------- Query server load generator ---------- */
+
+enum { REQ_EVALUATE, REQ_DEPS, REQ_SCORECARD, REQ_UPDATE, REQ_KINDS };
+static const char *const reqNames[REQ_KINDS] = { "evaluate", "deps", "scorecard", "set-achieved" };
+
+typedef struct LoadOptions {
+    const char *connect;        /* NULL: serve a generated scorecard in-process */
+    int clients;
+    double seconds;
+    long kpis;
+    int perspectives;
+    int updateRate;             /* set-achieved requests per second (one extra client) */
+    const char *format;
+} LoadOptions;
+
+/* latencies of one client, in seconds, per request kind */
+typedef struct LoadClient {
+    const LoadOptions *opt;
+    const char *address;
+    int updater;
+    unsigned seed;
+    double deadline;
+    double *lat[REQ_KINDS];
+    long count[REQ_KINDS];
+    long cap[REQ_KINDS];
+    long errors;
+} LoadClient;
+
+typedef struct ServeArg {
+    Graph *graph;
+    const char *address;
+    int readers;
+    int rc;
+} ServeArg;
+
+static void *serveThread(void *p) {
+    ServeArg *a = (ServeArg*)p;
+    a->rc = runServer(a->graph, a->address, a->readers);
+    return NULL;
+}
+
+/* the server may still be starting: retry for a while */
+static int connectRetry(const char *address) {
+    for (int i = 0; i < 200; ++i) {
+        int fd = connectServer(address);
+        if (fd >= 0) return fd;
+        struct timespec ts = { 0, 10 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    return -1;
+}
+
+static void loadRecord(LoadClient *c, int kind, double sec) {
+    if (c->count[kind] == c->cap[kind]) {
+        c->cap[kind] = c->cap[kind] ? c->cap[kind] * 2 : 4096;
+        c->lat[kind] = realloc(c->lat[kind], (size_t)c->cap[kind] * sizeof(double));
+        if (!c->lat[kind]) { perror("realloc"); exit(1); }
+    }
+    c->lat[kind][c->count[kind]++] = sec;
+}
+
+/* readers cycle 8 evaluations : 1 dependency list : 1 scorecard as fast as
+   replies come back; the updater paces set-achieved requests */
+static void *loadClientMain(void *p) {
+    LoadClient *c = (LoadClient*)p;
+    int fd = connectRetry(c->address);
+    if (fd < 0) { c->errors++; return NULL; }
+    char *reply = NULL, req[160];
+    size_t cap = 0;
+    snprintf(req, sizeof(req), "format %s", c->opt->format);
+    if (serverRequest(fd, req, &reply, &cap) < 0) c->errors++;
+    double interval = c->updater ? 1.0 / c->opt->updateRate : 0.0;
+    double next = nowSec();
+    for (long i = 0; ; ++i) {
+        double t0 = nowSec();
+        if (t0 >= c->deadline) break;
+        int kind = c->updater ? REQ_UPDATE : i % 10 < 8 ? REQ_EVALUATE : i % 10 == 8 ? REQ_DEPS : REQ_SCORECARD;
+        if (kind == REQ_UPDATE) {
+            if (t0 < next) {
+                double wait = next - t0;
+                struct timespec ts = { (time_t)wait, (long)((wait - (double)(time_t)wait) * 1e9) };
+                nanosleep(&ts, NULL);
+                t0 = nowSec();
+            }
+            next += interval;
+            char pers[MAX_NAME_LEN];
+            long k = (long)(nextRand(&c->seed) % (unsigned)c->opt->kpis);
+            workloadName(pers, "Persp", k % c->opt->perspectives, CASE_LOWER, &c->seed);
+            snprintf(req, sizeof(req), "set-achieved %s \"KPI %ld\" %u", pers, k, nextRand(&c->seed) % 160);
+        } else {
+            snprintf(req, sizeof(req), "%s", reqNames[kind]);
+        }
+        if (serverRequest(fd, req, &reply, &cap) < 0) { c->errors++; if (cap == 0) break; continue; }
+        loadRecord(c, kind, nowSec() - t0);
+    }
+    serverRequest(fd, "quit", &reply, &cap);
+    close(fd);
+    free(reply);
+    return NULL;
+}
+
+static int cmpDouble(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void runLoad(const LoadOptions *opt) {
+    char address[64];
+    Graph g;
+    ServeArg serve = { &g, address, opt->clients, 0 };
+    pthread_t server;
+    if (opt->connect) {
+        snprintf(address, sizeof(address), "%s", opt->connect);
+    } else {
+        /* same shape as the scenario benchmark: perspectives with random
+           dependencies, KPIs round robin */
+        unsigned rng = 11u;
+        char name[MAX_NAME_LEN], to[MAX_NAME_LEN];
+        FILE *quiet = fopen("/dev/null", "w");
+        if (quiet) setMessageStream(quiet);
+        initGraph(&g);
+        for (int p = 0; p < opt->perspectives; ++p) {
+            workloadName(name, "Persp", p, CASE_LOWER, &rng);
+            addPerspectiveIfNotExists(&g, name);
+        }
+        for (int e = 0; e < opt->perspectives * 2; ++e) {
+            workloadName(name, "Persp", (long)(nextRand(&rng) % opt->perspectives), CASE_LOWER, &rng);
+            workloadName(to, "Persp", (long)(nextRand(&rng) % opt->perspectives), CASE_LOWER, &rng);
+            if (strcmp(name, to) != 0) addDependency(&g, name, to);
+        }
+        for (long i = 0; i < opt->kpis; ++i) {
+            snprintf(name, sizeof(name), "KPI %ld", i);
+            addKPIRecord(&g, g.nodes[i % opt->perspectives], name, 100.0f, (float)(nextRand(&rng) % 160));
+        }
+        setMessageStream(stderr);
+        if (quiet) fclose(quiet);
+        snprintf(address, sizeof(address), "unix:bench_server_%ld.sock", (long)getpid());
+        if (pthread_create(&server, NULL, serveThread, &serve) != 0) { perror("pthread_create"); exit(1); }
+    }
+
+    int n = opt->clients + (opt->updateRate > 0);
+    LoadClient *cl = calloc((size_t)n, sizeof(LoadClient));
+    pthread_t *tids = malloc((size_t)n * sizeof(pthread_t));
+    if (!cl || !tids) { perror("malloc"); exit(1); }
+    /* wait for the listener before the clock starts */
+    int probe = connectRetry(address);
+    if (probe < 0) { fprintf(stderr, "cannot connect to '%s'\n", address); exit(1); }
+    double t0 = nowSec();
+    for (int i = 0; i < n; ++i) {
+        cl[i].opt = opt;
+        cl[i].address = address;
+        cl[i].updater = i == opt->clients;
+        cl[i].seed = 1234u + (unsigned)i * 7919u;
+        cl[i].deadline = t0 + opt->seconds;
+        if (pthread_create(&tids[i], NULL, loadClientMain, &cl[i]) != 0) { perror("pthread_create"); exit(1); }
+    }
+    for (int i = 0; i < n; ++i) pthread_join(tids[i], NULL);
+    double elapsed = nowSec() - t0;
+
+    char *reply = NULL;
+    size_t cap = 0;
+    char version[128] = "";
+    if (serverRequest(probe, "version", &reply, &cap) > 0) {
+        snprintf(version, sizeof(version), "%s", reply);
+        version[strcspn(version, "\n")] = '\0';
+    }
+    if (!opt->connect) {
+        serverRequest(probe, "shutdown", &reply, &cap);
+        pthread_join(server, NULL);
+        freeAll(&g);
+        setMessageStream(NULL);
+    }
+    close(probe);
+    free(reply);
+
+    if (opt->connect) printf("Query server at %s (%d clients, %.1f s, %d updates/s, %s)\n",
+                             address, opt->clients, elapsed, opt->updateRate, opt->format);
+    else printf("Query server (%ld KPIs, %d perspectives, %d clients, %d reader threads, %.1f s, %d updates/s, %s)\n",
+                opt->kpis, opt->perspectives, opt->clients, opt->clients, elapsed, opt->updateRate, opt->format);
+    long reads = 0, errors = 0;
+    for (int i = 0; i < n; ++i) errors += cl[i].errors;
+    for (int kind = 0; kind < REQ_KINDS; ++kind) {
+        long total = 0;
+        for (int i = 0; i < n; ++i) total += cl[i].count[kind];
+        if (!total) continue;
+        double *all = malloc((size_t)total * sizeof(double));
+        if (!all) { perror("malloc"); exit(1); }
+        long at = 0;
+        for (int i = 0; i < n; ++i) {
+            if (cl[i].count[kind]) memcpy(all + at, cl[i].lat[kind], (size_t)cl[i].count[kind] * sizeof(double));
+            at += cl[i].count[kind];
+            free(cl[i].lat[kind]);
+        }
+        qsort(all, (size_t)total, sizeof(double), cmpDouble);
+        printf("  %-12s: %8ld requests  p50 %8.3f ms  p99 %8.3f ms  %9.0f QPS\n", reqNames[kind], total,
+               all[(total - 1) / 2] * 1e3, all[(long)((double)(total - 1) * 0.99)] * 1e3, (double)total / elapsed);
+        if (kind != REQ_UPDATE) reads += total;
+        free(all);
+    }
+    printf("  reads       : %8ld requests, %.0f QPS over %d connections%s%s\n", reads, (double)reads / elapsed,
+           opt->clients, version[0] ? "; served " : "", version);
+    if (errors) printf("  errors      : %ld\n", errors);
+    free(cl);
+    free(tids);
+}
+
+static int loadUsage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s --load [--connect ADDRESS] [--clients N] [--seconds S] [--kpis N]\n"
+            "       [--perspectives N] [--updates PER_SECOND] [--format color|plain|json|csv]\n", prog);
+    return 2;
+}
+
+static int loadMain(int argc, char **argv) {
+    LoadOptions o = { NULL, 4, 5.0, 20000L, 16, 200, "json" };
+    for (int i = 2; i < argc; ++i) {
+        const char *opt = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val) return loadUsage(argv[0]);
+        ++i;
+        if (strcmp(opt, "--connect") == 0) o.connect = val;
+        else if (strcmp(opt, "--clients") == 0) o.clients = atoi(val);
+        else if (strcmp(opt, "--seconds") == 0) o.seconds = atof(val);
+        else if (strcmp(opt, "--kpis") == 0) o.kpis = atol(val);
+        else if (strcmp(opt, "--perspectives") == 0) o.perspectives = atoi(val);
+        else if (strcmp(opt, "--updates") == 0) o.updateRate = atoi(val);
+        else if (strcmp(opt, "--format") == 0 && parseReportFormat(val) >= 0) o.format = val;
+        else return loadUsage(argv[0]);
+    }
+    if (o.clients < 1 || o.clients > SERVER_MAX_READERS || o.seconds <= 0.0 || o.kpis < 1 ||
+        o.perspectives < 1 || o.updateRate < 0)
+        return loadUsage(argv[0]);
+    runLoad(&o);
+    return 0;
+}
+
+/* ---------- Resident memory ---------- */
+
+typedef struct MemoryOptions {
+    long kpis;
+    int perspectives;
+    int shared;             /* every perspective uses the same KPI names */
+} MemoryOptions;
+
+/* current resident set size in KiB (peak where /proc is missing) */
+static long rssKiB(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    long pages, resident;
+    if (!f) return peakRssKiB();
+    int ok = fscanf(f, "%ld %ld", &pages, &resident) == 2;
+    fclose(f);
+    return ok ? resident * (sysconf(_SC_PAGESIZE) / 1024) : peakRssKiB();
+}
+
+static void runMemory(const MemoryOptions *o) {
+    unsigned rng = 42;
+    char (*pers)[MAX_NAME_LEN] = malloc((size_t)o->perspectives * sizeof(*pers));
+    for (int p = 0; p < o->perspectives; ++p) workloadName(pers[p], "Persp", p, CASE_LOWER, &rng);
+    char name[MAX_NAME_LEN];
+    Graph g;
+    initGraph(&g);
+    long before = rssKiB();
+    double t0 = nowSec();
+    for (long i = 0; i < o->kpis; ++i) {
+        long n = o->shared ? i / o->perspectives : i;
+        snprintf(name, sizeof(name), "KPI %ld", n);
+        upsertKPI(&g, pers[i % o->perspectives], name, (float)(1 + nextRand(&rng) % 100),
+                  (float)(nextRand(&rng) % 130));
+    }
+    double buildSec = nowSec() - t0;
+    long after = rssKiB();
+    AllocStats as;
+    getAllocStats(&g, &as);
+    double perKpi = o->kpis ? (double)(after - before) * 1024.0 / (double)o->kpis : 0.0;
+
+    printf("Memory (%ld KPIs, %d perspectives, %s names)\n", o->kpis, o->perspectives,
+           o->shared ? "shared" : "unique");
+    printf("  KPI record : %zu bytes\n", sizeof(KPI));
+    printf("  build      : %8.3f s  %7.1f ns/KPI\n", buildSec, o->kpis ? buildSec * 1e9 / (double)o->kpis : 0.0);
+    printf("  resident   : %8.1f MiB (+%.1f MiB, %.1f bytes/KPI), peak %.1f MiB\n",
+           (double)after / 1024.0, (double)(after - before) / 1024.0, perKpi, (double)peakRssKiB() / 1024.0);
+    printf("  reserved   : %8.1f MiB: KPI arrays + indexes %.1f MiB, names %.1f MiB\n",
+           (double)as.bytes / (1024.0 * 1024.0), (double)as.kpiBytes / (1024.0 * 1024.0),
+           (double)as.nameBytes / (1024.0 * 1024.0));
+    freeAll(&g);
+    free(pers);
+}
+
+static int memoryUsage(const char *prog) {
+    fprintf(stderr, "usage: %s --memory [--kpis N] [--perspectives N] [--names unique|shared]\n", prog);
+    return 2;
+}
+
+static int memoryMain(int argc, char **argv) {
+    MemoryOptions o = { 10000000L, 16, 0 };
+    for (int i = 2; i < argc; ++i) {
+        const char *opt = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val) return memoryUsage(argv[0]);
+        ++i;
+        if (strcmp(opt, "--kpis") == 0) o.kpis = atol(val);
+        else if (strcmp(opt, "--perspectives") == 0) o.perspectives = atoi(val);
+        else if (strcmp(opt, "--names") == 0 && strcmp(val, "unique") == 0) o.shared = 0;
+        else if (strcmp(opt, "--names") == 0 && strcmp(val, "shared") == 0) o.shared = 1;
+        else return memoryUsage(argv[0]);
+    }
+    if (o.kpis < 0 || o.perspectives < 1) return memoryUsage(argv[0]);
+    runMemory(&o);
+    return 0;
+}
+
+/* ---------- Concurrent ingest ---------- */
+
+typedef struct IngestOptions {
+    long kpis;              /* KPIs the scorecard starts with */
+    int perspectives;
+    int shards;
+    long records;           /* per run, split evenly over the producers */
+    int producers;          /* runs with 1, 2, 4, ... up to this many */
+    int inserts;            /* every record adds a new KPI (else updates of existing ones) */
+} IngestOptions;
+
+typedef struct IngestFeed {
+    const IngestOptions *opt;
+    struct Ingest *in;      /* NULL: apply with the direct calls */
+    Graph *graph;
+    char (*pers)[MAX_NAME_LEN];
+    int self;
+    long count;
+    long rejected;
+} IngestFeed;
+
+/* record i of one producer's feed: observations and set-achieved edits of
+   existing KPIs (3:1), or new KPIs */
+static void feedRecord(const IngestFeed *f, long i, unsigned *rng, char *name, size_t cap, IngestRecord *r) {
+    const IngestOptions *o = f->opt;
+    unsigned x = nextRand(rng);
+    if (o->inserts) {
+        snprintf(name, cap, "Feed %d KPI %ld", f->self, i);
+        r->op = INGEST_KPI;
+        r->perspective = (int)(x % (unsigned)o->perspectives);
+        r->period = PERIOD_LATEST;
+    } else {
+        long k = (long)(x % (unsigned long)o->kpis);
+        snprintf(name, cap, "KPI %ld", k);
+        /* achieved edits keep to their own quarter of the KPIs: the dated
+           observations give the others a history, which refuses them */
+        r->op = k % 4 ? INGEST_KPI : INGEST_ACHIEVED;
+        r->perspective = (int)(k % o->perspectives);
+        r->period = (int32_t)(1 + i);
+    }
+    r->kpi = name;
+    r->target = (float)(1 + nextRand(rng) % 100);
+    r->achieved = (float)(nextRand(rng) % 130);
+}
+
+static void *feedMain(void *p) {
+    IngestFeed *f = (IngestFeed*)p;
+    unsigned rng = 977u + (unsigned)f->self * 7919u;
+    char name[64];
+    IngestRecord r;
+    for (long i = 0; i < f->count; ++i) {
+        feedRecord(f, i, &rng, name, sizeof(name), &r);
+        int rc;
+        if (f->in) rc = ingestPush(f->in, &r);
+        else if (r.op == INGEST_ACHIEVED) rc = updateKPIAchieved(f->graph, f->pers[r.perspective], r.kpi, r.achieved);
+        else if (r.period != PERIOD_LATEST)
+            rc = recordKPIObservation(f->graph, f->pers[r.perspective], r.kpi, r.period, r.target, r.achieved);
+        else rc = addKPIRecord(f->graph, f->pers[r.perspective], r.kpi, r.target, r.achieved);
+        if (rc != 0) f->rejected++;
+    }
+    return NULL;
+}
+
+static void ingestScorecard(Graph *g, const IngestOptions *o, char (*pers)[MAX_NAME_LEN]) {
+    unsigned rng = 42;
+    char name[64];
+    initGraph(g);
+    for (int p = 0; p < o->perspectives; ++p) addPerspectiveIfNotExists(g, pers[p]);
+    for (long k = 0; k < o->kpis; ++k) {
+        snprintf(name, sizeof(name), "KPI %ld", k);
+        upsertKPI(g, pers[k % o->perspectives], name, (float)(1 + nextRand(&rng) % 100),
+                  (float)(nextRand(&rng) % 130));
+    }
+}
+
+/* per-perspective averages and counts, to compare two graphs exactly */
+static int sameScores(const Graph *a, const Graph *b) {
+    int n = perspectiveCount(a);
+    PerspectiveResult *ra = malloc((size_t)n * sizeof(*ra)), *rb = malloc((size_t)n * sizeof(*rb));
+    if (!ra || !rb) { perror("malloc"); exit(1); }
+    int same = queryPerspectives(a, PERIOD_LATEST, ra, n) == n && queryPerspectives(b, PERIOD_LATEST, rb, n) == n;
+    for (int i = 0; same && i < n; ++i)
+        same = ra[i].kpiCount == rb[i].kpiCount && ra[i].average == rb[i].average;
+    free(ra);
+    free(rb);
+    return same;
+}
+
+/* one run: producers feed threads (0 = the direct calls on this thread);
+   returns the elapsed seconds until every record is applied */
+static double ingestRun(const IngestOptions *o, char (*pers)[MAX_NAME_LEN], Graph *g, int producers,
+                        IngestStats *st) {
+    int n = producers ? producers : 1;
+    IngestFeed *feeds = calloc((size_t)n, sizeof(IngestFeed));
+    pthread_t *tids = malloc((size_t)n * sizeof(pthread_t));
+    if (!feeds || !tids) { perror("malloc"); exit(1); }
+    ingestScorecard(g, o, pers);
+    double t0 = nowSec();
+    struct Ingest *in = producers ? ingestOpen(g, o->shards) : NULL;
+    for (int i = 0; i < n; ++i) {
+        feeds[i].opt = o;
+        feeds[i].in = in;
+        feeds[i].graph = g;
+        feeds[i].pers = pers;
+        feeds[i].self = i;
+        feeds[i].count = o->records / n + (i < o->records % n);
+    }
+    if (!producers) {
+        feedMain(&feeds[0]);
+    } else {
+        for (int i = 0; i < n; ++i)
+            if (pthread_create(&tids[i], NULL, feedMain, &feeds[i]) != 0) { perror("pthread_create"); exit(1); }
+        for (int i = 0; i < n; ++i) pthread_join(tids[i], NULL);
+        ingestClose(in, st);
+    }
+    double sec = nowSec() - t0;
+    if (!producers) {
+        memset(st, 0, sizeof(*st));
+        st->pushed = o->records;
+        st->rejected = feeds[0].rejected;
+        st->applied = st->pushed - st->rejected;
+    }
+    free(feeds);
+    free(tids);
+    return sec;
+}
+
+static void runIngest(const IngestOptions *o) {
+    unsigned rng = 7;
+    char (*pers)[MAX_NAME_LEN] = malloc((size_t)o->perspectives * sizeof(*pers));
+    if (!pers) { perror("malloc"); exit(1); }
+    for (int p = 0; p < o->perspectives; ++p) workloadName(pers[p], "Persp", p, CASE_LOWER, &rng);
+    printf("Ingest (%ld KPIs, %d perspectives, %d shards, %ld records per run, %s)\n", o->kpis,
+           o->perspectives, o->shards, o->records, o->inserts ? "new KPIs" : "observations + set-achieved");
+
+    Graph direct, g;
+    IngestStats st;
+    double base = ingestRun(o, pers, &direct, 0, &st);
+    printf("  direct calls : %9.0f records/s  %7.1f ns/record  (one thread, no pipeline)\n",
+           (double)o->records / base, base * 1e9 / (double)o->records);
+    for (int producers = 1; producers <= o->producers; producers *= 2) {
+        double sec = ingestRun(o, pers, &g, producers, &st);
+        printf("  %2d producer%s : %9.0f records/s  %7.1f ns/record  %5.2fx  %ld batches, %ld full waits%s%s\n",
+               producers, producers == 1 ? " " : "s", (double)o->records / sec, sec * 1e9 / (double)o->records,
+               base / sec, st.batches, st.fullWaits, st.rejected ? ", rejected" : "",
+               producers == 1 ? (sameScores(&direct, &g) ? ", same scores as direct" : ", SCORES DIFFER") : "");
+        freeAll(&g);
+    }
+    freeAll(&direct);
+    free(pers);
+}
+
+static int ingestUsage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s --ingest [--kpis N] [--perspectives N] [--shards N] [--records N]\n"
+            "       [--producers N] [--feed updates|inserts]\n", prog);
+    return 2;
+}
+
+static int ingestMain(int argc, char **argv) {
+    IngestOptions o = { 1000000L, 16, 8, 4000000L, 8, 0 };
+    for (int i = 2; i < argc; ++i) {
+        const char *opt = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!val) return ingestUsage(argv[0]);
+        ++i;
+        if (strcmp(opt, "--kpis") == 0) o.kpis = atol(val);
+        else if (strcmp(opt, "--perspectives") == 0) o.perspectives = atoi(val);
+        else if (strcmp(opt, "--shards") == 0) o.shards = atoi(val);
+        else if (strcmp(opt, "--records") == 0) o.records = atol(val);
+        else if (strcmp(opt, "--producers") == 0) o.producers = atoi(val);
+        else if (strcmp(opt, "--feed") == 0 && strcmp(val, "updates") == 0) o.inserts = 0;
+        else if (strcmp(opt, "--feed") == 0 && strcmp(val, "inserts") == 0) o.inserts = 1;
+        else return ingestUsage(argv[0]);
+    }
+    if (o.kpis < 1 || o.perspectives < 1 || o.shards < 1 || o.shards > INGEST_MAX_SHARDS ||
+        o.records < 1 || o.producers < 1)
+        return ingestUsage(argv[0]);
+    runIngest(&o);
+    return 0;
+}
+
+static void countEvent(const Graph *g, const BandEvent *ev, void *context) {
+    (void)g; (void)ev;
+    ++*(long*)context;
+}
+
+/* set-achieved on random KPIs with and without a band listener, against
+   finding the same changes by rescanning every KPI after each edit */
+static void benchAlerts(long kpis) {
+    const int np = 64;
+    const long ops = 200000;
+    long sizes[] = { 1000, kpis / 10, kpis };
+    char name[MAX_NAME_LEN], to[MAX_NAME_LEN];
+    FILE *quiet = fopen("/dev/null", "w");
+    printf("Band alerts (%d perspectives, %ld random achieved values per row)\n", np, ops);
+    printf("  %10s %12s %12s %14s %12s\n", "KPIs", "no listener", "listener", "events/edit", "rescan");
+    for (int s = 0; s < 3; ++s) {
+        long n = sizes[s];
+        if (n < np || (s > 0 && n <= sizes[s - 1])) continue;
+        unsigned rng = 5u;
+        Graph g;
+        initGraph(&g);
+        if (quiet) setMessageStream(quiet);
+        for (int p = 0; p < np; ++p) {
+            workloadName(name, "Persp", p, CASE_LOWER, &rng);
+            addPerspectiveIfNotExists(&g, name);
+        }
+        for (int e = 0; e < np * 2; ++e) {
+            workloadName(name, "Persp", (long)(nextRand(&rng) % np), CASE_LOWER, &rng);
+            workloadName(to, "Persp", (long)(nextRand(&rng) % np), CASE_LOWER, &rng);
+            if (strcmp(name, to) != 0) addDependency(&g, name, to);
+        }
+        setMessageStream(NULL);
+        for (long i = 0; i < n; ++i) {
+            snprintf(name, sizeof(name), "KPI %ld", i);
+            addKPIRecord(&g, g.nodes[i % np], name, 100.0f, (float)(nextRand(&rng) % 160));
+        }
+        double sec[2];
+        long events = 0;
+        for (int listen = 0; listen < 2; ++listen) {
+            setBandListener(&g, listen ? countEvent : NULL, &events);
+            unsigned r = 99u;
+            double t0 = nowSec();
+            for (long i = 0; i < ops; ++i) {
+                long k = (long)(nextRand(&r) % (unsigned)n);
+                snprintf(name, sizeof(name), "KPI %ld", k);
+                updateKPIAchieved(&g, g.nodes[k % np], name, (float)(nextRand(&r) % 160));
+            }
+            sec[listen] = nowSec() - t0;
+        }
+        setBandListener(&g, NULL, NULL);
+
+        /* the alternative: a full band pass over every KPI per edit */
+        KPIBatchStats *st = malloc((size_t)np * sizeof(KPIBatchStats));
+        if (!st) { perror("malloc"); exit(1); }
+        long rescans = n > 100000 ? 20 : 200;
+        double t0 = nowSec();
+        for (long i = 0; i < rescans; ++i) evaluateKPIStats(&g, PERIOD_LATEST, st);
+        double rescanSec = nowSec() - t0;
+        free(st);
+
+        printf("  %10ld %9.1f ns %9.1f ns %14.3f %9.0f ns\n", n, sec[0] * 1e9 / ops, sec[1] * 1e9 / ops,
+               (double)events / ops, rescanSec * 1e9 / rescans);
+        freeAll(&g);
+    }
+    if (quiet) fclose(quiet);
+}
+
+/* name-keyed edits in one perspective of n KPIs through the KPI index,
+   against the list walk a lookup used to cost */
+static void benchUpsert(long kpis) {
+    const long ops = 200000;
+    long sizes[] = { 1000, kpis / 10, kpis };
+    char name[MAX_NAME_LEN];
+    printf("KPI edits by name (one perspective, %ld random existing KPIs per row)\n", ops);
+    printf("  %10s %10s %10s %12s %12s\n", "KPIs", "upsert", "achieved", "delete+add", "list walk");
+    for (int s = 0; s < 3; ++s) {
+        long n = sizes[s];
+        if (n < 1 || (s > 0 && n <= sizes[s - 1])) continue;
+        Graph g;
+        initGraph(&g);
+        for (long i = 0; i < n; ++i) {
+            snprintf(name, sizeof(name), "KPI %ld", i);
+            addKPIRecord(&g, "Operations", name, 50.0f, (float)(i % 130));
+        }
+        unsigned rng = 42u;
+        double t0 = nowSec();
+        for (long i = 0; i < ops; ++i) {
+            snprintf(name, sizeof(name), "kpi %u", nextRand(&rng) % (unsigned)n);
+            upsertKPI(&g, "Operations", name, 50.0f, (float)(i % 130));
+        }
+        double upsertSec = nowSec() - t0;
+        t0 = nowSec();
+        for (long i = 0; i < ops; ++i) {
+            snprintf(name, sizeof(name), "KPI %u", nextRand(&rng) % (unsigned)n);
+            updateKPIAchieved(&g, "Operations", name, (float)(i % 130));
+        }
+        double updateSec = nowSec() - t0;
+        t0 = nowSec();
+        for (long i = 0; i < ops; ++i) {
+            snprintf(name, sizeof(name), "KPI %u", nextRand(&rng) % (unsigned)n);
+            deleteKPI(&g, "Operations", name);
+            addKPIRecord(&g, "Operations", name, 50.0f, (float)(i % 130));
+        }
+        double churnSec = nowSec() - t0;
+
+        /* the old linear lookup, on fewer probes when the list is long */
+        long walks = n > 100000 ? 200 : 2000;
+        int id = findPerspective(&g, "Operations");
+        const PersNode *node = g.pers[id];
+        volatile long found = 0;
+        t0 = nowSec();
+        for (long i = 0; i < walks; ++i) {
+            snprintf(name, sizeof(name), "kpi %u", nextRand(&rng) % (unsigned)n);
+            for (int j = node->kpiLen; j-- > 0; ) {
+                const KPI *k = &node->kpis[j];
+                if (k->name && strcasecmp(kpiNameOf(&g, k), name) == 0) { found++; break; }
+            }
+        }
+        double walkSec = nowSec() - t0;
+
+        float lo = 0.0f, hi = 0.0f;
+        int counted = queryPerspectiveRange(&g, id, &lo, &hi);
+        printf("  %10ld %7.1f ns %7.1f ns %9.1f ns %9.0f ns   (%d KPIs, %.0f%%..%.0f%%)\n", n,
+               upsertSec * 1e9 / ops, updateSec * 1e9 / ops, churnSec * 1e9 / ops,
+               walkSec * 1e9 / walks, counted, lo, hi);
+        freeAll(&g);
+    }
+}
+
+/* what-if batch: many small override sets on one baseline, against applying
+   each set, evaluating and reverting it */
+static void benchScenarios(long kpis) {
+    const int np = 256, nscen = 10000, per = 8, naive = 500;
+    unsigned rng = 7u;
+    char name[MAX_NAME_LEN], kname[MAX_NAME_LEN];
+    FILE *quiet = fopen("/dev/null", "w");
+    if (quiet) setMessageStream(quiet);
+    Graph g;
+    initGraph(&g);
+    for (int p = 0; p < np; ++p) {
+        workloadName(name, "Persp", p, CASE_LOWER, &rng);
+        addPerspectiveIfNotExists(&g, name);
+    }
+    for (int e = 0; e < np * 2; ++e) {
+        workloadName(name, "Persp", (long)(nextRand(&rng) % np), CASE_LOWER, &rng);
+        workloadName(kname, "Persp", (long)(nextRand(&rng) % np), CASE_LOWER, &rng);
+        if (strcmp(name, kname) != 0) addDependency(&g, name, kname);
+    }
+    for (long i = 0; i < kpis; ++i) {
+        snprintf(kname, sizeof(kname), "KPI %ld", i);
+        addKPIRecord(&g, g.nodes[i % np], kname, 100.0f, (float)(nextRand(&rng) % 160));
+    }
+    setMessageStream(NULL);
+    if (quiet) fclose(quiet);
+
+    /* names live in one table: scenario s, override o -> KPI index */
+    KPIOverride *ov = malloc((size_t)nscen * per * sizeof(KPIOverride));
+    char (*names)[MAX_NAME_LEN] = malloc((size_t)nscen * per * MAX_NAME_LEN);
+    Scenario *sc = malloc((size_t)nscen * sizeof(Scenario));
+    ScenarioResult *res = malloc((size_t)nscen * sizeof(ScenarioResult));
+    ImpactEdge *edges = malloc((size_t)nscen * per * 8 * sizeof(ImpactEdge));
+    if (!ov || !names || !sc || !res || !edges) { perror("malloc"); exit(1); }
+    for (int i = 0; i < nscen * per; ++i) {
+        long k = (long)(nextRand(&rng) % (unsigned long)kpis);
+        snprintf(names[i], MAX_NAME_LEN, "KPI %ld", k);
+        ov[i].perspective = g.nodes[k % np];
+        ov[i].kpi = names[i];
+        ov[i].achieved = (float)(nextRand(&rng) % 160);
+    }
+    for (int i = 0; i < nscen; ++i) {
+        sc[i].name = NULL;
+        sc[i].overrides = ov + (size_t)i * per;
+        sc[i].count = per;
+    }
+
+    printf("What-if scenarios (%d scenarios x %d overrides, %d perspectives, %ld KPIs)\n",
+           nscen, per, np, kpis);
+    static const int counts[] = { 1, 2, 4 };
+    int total = 0;
+    for (int c = 0; c < 3; ++c) {
+        setEvalThreads(&g, counts[c]);
+        runScenarios(&g, sc, nscen, res, NULL, edges, nscen * per * 8, NULL);   /* warm-up */
+        double t0 = nowSec();
+        total = runScenarios(&g, sc, nscen, res, NULL, edges, nscen * per * 8, NULL);
+        double sec = nowSec() - t0;
+        printf("  batch, %d thread%s : %8.3f ms  %7.0f ns/scenario  (%d new impact edges)\n",
+               counts[c], counts[c] == 1 ? " " : "s", sec * 1e3, sec * 1e9 / nscen, total);
+    }
+    setEvalThreads(&g, 1);
+
+    /* apply / evaluate / revert on the graph itself, checking the batch */
+    PerspectiveResult *persp = malloc((size_t)np * sizeof(PerspectiveResult));
+    float *saved = malloc((size_t)per * sizeof(float));
+    if (!persp || !saved) { perror("malloc"); exit(1); }
+    float worst = 0.0f;
+    int mismatches = 0;
+    double t0 = nowSec();
+    for (int i = 0; i < naive; ++i) {
+        for (int o = 0; o < per; ++o) {
+            const KPIOverride *x = &sc[i].overrides[o];
+            saved[o] = lookupKPI(&g, x->perspective, x->kpi)->achieved;
+            updateKPIAchieved(&g, x->perspective, x->kpi, x->achieved);
+        }
+        EvaluationResult ev;
+        queryEvaluation(&g, PERIOD_LATEST, persp, np, NULL, 0, &ev);
+        float d = ev.overall - res[i].overall;
+        if (d < 0.0f) d = -d;
+        if (d > worst) worst = d;
+        if (ev.lowest != res[i].lowest || ev.numImpacts != res[i].numImpacts) mismatches++;
+        for (int o = per; o-- > 0; ) updateKPIAchieved(&g, sc[i].overrides[o].perspective, sc[i].overrides[o].kpi, saved[o]);
+    }
+    double sec = nowSec() - t0;
+    printf("  apply+evaluate+revert: %7.0f ns/scenario  (max overall diff %.2g, lowest / impact mismatches %d of %d)\n",
+           sec * 1e9 / naive, worst, mismatches, naive);
+    free(persp);
+    free(saved);
+    free(ov);
+    free(names);
+    free(sc);
+    free(res);
+    free(edges);
+    freeAll(&g);
+}
+
+/* the pre-renderer scorecard loop: one printf per KPI (baseline) */
+static void printfScorecard(const Graph *g) {
+    for (int id = 0; id < g->numNodes; ++id) {
+        printf("\nPerspective: %s\n", g->nodes[id]);
+        const PersNode *node = g->pers[id];
+        for (int j = node->kpiLen; j-- > 0; ) {
+            const KPI *t = &node->kpis[j];
+            if (!t->name) continue;
+            float perf = t->target != 0.0f ? (t->achieved / t->target) * 100.0f : 0.0f;
+            const char *col = perf > 100.0f ? ANSI_BLUE : perf >= 80.0f ? ANSI_GREEN :
+                              perf >= 20.0f ? ANSI_YELLOW : ANSI_RED;
+            printf("  - %s | Target: %.2f | Achieved: %.2f | Performance: %s%.2f%%%s\n",
+                   kpiNameOf(g, t), t->target, t->achieved, col, perf, ANSI_RESET);
+        }
+    }
+    fflush(stdout);
+}
+
+/* scorecard rendering cost per format, output sent to /dev/null */
+static void benchRender(long kpis) {
+    Graph g;
+    initGraph(&g);
+    buildScorecard(&g, kpis);
+    static const char *names[] = { "color", "plain", "json", "csv" };
+    double sec[5];
+
+    int saved = muteStdout();
+    if (saved < 0) { printf("Render benchmark skipped\n"); freeAll(&g); return; }
+    for (int f = 0; f < 5; ++f) {
+        double t0 = nowSec();
+        if (f == 4) {
+            printfScorecard(&g);
+        } else {
+            setReportFormat(&g, (ReportFormat)f);
+            generateScorecard(&g);
+        }
+        sec[f] = nowSec() - t0;
+    }
+    unmuteStdout(saved);
+
+    /* the same data through the query API: no formatting, no output */
+    KPIResult batch[256];
+    KPICursor cur;
+    volatile float sink = 0.0f;
+    double t0 = nowSec();
+    for (int id = nextPerspectiveByName(&g, -1); id != -1; id = nextPerspectiveByName(&g, id)) {
+        int n;
+        openKPICursor(&g, id, PERIOD_LATEST, &cur);
+        while ((n = readKPIs(&cur, batch, 256)) > 0)
+            for (int i = 0; i < n; ++i) sink += batch[i].performance;
+    }
+    double querySec = nowSec() - t0;
+    (void)sink;
+
+    printf("Scorecard rendering (%ld KPIs, to /dev/null)\n", kpis);
+    printf("  printf    : %8.3f ms  %7.2f ns/KPI  (per-KPI printf baseline)\n", sec[4] * 1e3, sec[4] * 1e9 / (double)kpis);
+    for (int f = 0; f < 4; ++f)
+        printf("  %-9s : %8.3f ms  %7.2f ns/KPI\n", names[f], sec[f] * 1e3, sec[f] * 1e9 / (double)kpis);
+    printf("  query API : %8.3f ms  %7.2f ns/KPI  (readKPIs, nothing rendered)\n", querySec * 1e3, querySec * 1e9 / (double)kpis);
+    freeAll(&g);
+}
+
+/* company -> 8 divisions -> 64 units: full roll-up at 1..8 threads, then
+   re-rolling after one unit changed (only its path should be recomputed) */
+static void benchHierarchy(long kpis, int reps) {
+    static const char *pers[] = { "Financial", "Customer", "Internal", "Learning" };
+    const int divisions = 8, unitsPer = 8;
+    Hierarchy h;
+    initHierarchy(&h);
+    char name[MAX_NAME_LEN], parent[MAX_NAME_LEN];
+    addUnit(&h, "Company", NULL);
+    for (int d = 0; d < divisions; ++d) {
+        snprintf(parent, sizeof(parent), "Division %d", d);
+        addUnit(&h, parent, "Company");
+        for (int u = 0; u < unitsPer; ++u) {
+            snprintf(name, sizeof(name), "Unit %d.%d", d, u);
+            addUnit(&h, name, parent);
+        }
+    }
+    int numUnits = divisions * unitsPer;
+    srand(42);
+    for (long i = 0; i < kpis; ++i) {
+        snprintf(name, sizeof(name), "Unit %ld.%ld", i % numUnits / unitsPer, i % unitsPer);
+        Graph *g = unitGraph(&h, findUnit(&h, name));
+        char kname[MAX_NAME_LEN];
+        snprintf(kname, sizeof(kname), "KPI %ld", i);
+        addKPIRecord(g, pers[i % 4], kname, (float)(1 + rand() % 100), (float)(rand() % 130));
+    }
+
+    printf("Hierarchy roll-up (%ld KPIs in %d units under %d divisions)\n", kpis, numUnits, divisions);
+    static const int counts[] = { 1, 2, 4, 8 };
+    PerspectiveResult first[4], now[4];
+    int company = findUnit(&h, "Company");
+    rollup(&h, PERIOD_LATEST);                      /* builds every unit's KPI columns */
+    double base = 0.0;
+    for (int c = 0; c < 4; ++c) {
+        setRollupThreads(&h, counts[c]);
+        int n = 0;
+        double t0 = nowSec();
+        for (int r = 0; r < reps; ++r) {
+            h.rolled = 0;                           /* force a full roll-up */
+            n = rollup(&h, PERIOD_LATEST);
+        }
+        double sec = (nowSec() - t0) / reps;
+        if (c == 0) { base = sec; queryRollup(&h, company, first, 4); }
+        queryRollup(&h, company, now, 4);
+        int same = 1;
+        for (int p = 0; p < 4; ++p) same &= now[p].average == first[p].average && now[p].kpiCount == first[p].kpiCount;
+        printf("  full, %d thr : %8.3f ms (%.2fx)  %d units recomputed, results %s\n",
+               counts[c], sec * 1e3, base / sec, n, same ? "identical" : "DIFFER");
+    }
+
+    /* one changed unit: its own KPIs once more, then unit -> division -> company.
+       The same KPI is re-added each time, so under DUPLICATE_UPDATE the
+       company gains one KPI, however many reps. */
+    Graph *g = unitGraph(&h, findUnit(&h, "Unit 3.5"));
+    int n = 0;
+    double t0 = nowSec();
+    for (int r = 0; r < reps; ++r) {
+        addKPIRecord(g, "Financial", "KPI changed", 50.0f, (float)(r % 100));
+        n = rollup(&h, PERIOD_LATEST);
+    }
+    double incSec = (nowSec() - t0) / reps;
+    queryRollup(&h, company, now, 4);
+    long total = 0;
+    for (int p = 0; p < 4; ++p) total += now[p].kpiCount;
+    printf("  one unit     : %8.3f ms  %d units recomputed, company sees %ld KPIs (expected %ld)\n",
+           incSec * 1e3, n, total, kpis + 1);
+    setRollupThreads(&h, 1);
+    freeHierarchy(&h);
+}
+
+static int cmpFloat(const void *a, const void *b) {
+    float x = *(const float*)a, y = *(const float*)b;
+    return x < y ? -1 : x > y;
+}
+
+/* fused distribution pass vs one scan per statistic (exact percentiles by
+   sorting, band counts, k worst / best from the sorted copy) */
+static void benchDistribution(long kpis, int reps) {
+    const int k = 50;
+    Graph g;
+    initGraph(&g);
+    buildScorecard(&g, kpis);
+    KPIRank worst[50], best[50];
+    KPIBatchStats per[4];
+    KPIDistribution d;
+
+    double t0 = nowSec();
+    for (int r = 0; r < reps; ++r) queryDistribution(&g, PERIOD_LATEST, k, worst, best, per, &d);
+    double fusedSec = (nowSec() - t0) / reps;
+
+    float *perf = malloc((size_t)kpis * sizeof(float));
+    if (!perf) { perror("malloc"); exit(1); }
+    long n = 0;
+    int bands[BAND_COUNT] = { 0, 0, 0, 0 };
+    volatile float sink = 0.0f;
+    t0 = nowSec();
+    for (int r = 0; r < reps; ++r) {
+        /* pass 1: band counts */
+        for (int b = 0; b < BAND_COUNT; ++b) bands[b] = 0;
+        for (int id = 0; id < g.numNodes; ++id) {
+            KPIBatchStats st;
+            perspectiveKPIStats(&g, id, &st);
+            for (int b = 0; b < BAND_COUNT; ++b) bands[b] += st.bands[b];
+        }
+        /* pass 2: gather and sort for percentiles and the extremes */
+        n = 0;
+        for (int id = 0; id < g.numNodes; ++id)
+            for (int j = g.pers[id]->kpiLen; j-- > 0; ) {
+                const KPI *t = &g.pers[id]->kpis[j];
+                if (t->name) perf[n++] = (t->achieved / t->target) * 100.0f;
+            }
+        qsort(perf, (size_t)n, sizeof(float), cmpFloat);
+        sink += perf[0] + perf[n - 1];
+    }
+    double separateSec = (nowSec() - t0) / reps;
+    (void)sink;
+
+    const double qs[3] = { 0.50, 0.90, 0.99 };
+    const float got[3] = { d.p50, d.p90, d.p99 };
+    double worstErr = 0.0;
+    for (int q = 0; q < 3; ++q) {
+        long rank = (long)(qs[q] * (double)n);
+        if ((double)rank < qs[q] * (double)n) ++rank;
+        float exact = perf[rank > 0 ? rank - 1 : 0];
+        double err = exact != 0.0f ? (got[q] - exact) / exact : 0.0;
+        if (err < 0) err = -err;
+        if (err > worstErr) worstErr = err;
+    }
+    int worstOk = d.worstCount == k && worst[0].performance == perf[0] && best[0].performance == perf[n - 1];
+    int bandsOk = 1;
+    for (int b = 0; b < BAND_COUNT; ++b) bandsOk &= bands[b] == d.bands[b];
+    free(perf);
+
+    printf("Distribution (%ld KPIs, k = %d)\n", kpis, k);
+    printf("  fused     : %8.3f ms  %7.2f ns/KPI  (heaps + bands + sketch, one scan)\n",
+           fusedSec * 1e3, fusedSec * 1e9 / (double)kpis);
+    printf("  separate  : %8.3f ms  %7.2f ns/KPI  (band pass + gather + sort)\n",
+           separateSec * 1e3, separateSec * 1e9 / (double)kpis);
+    printf("  check     : p50 %.2f p90 %.2f p99 %.2f, worst relative error %.3f%%, extremes %s, bands %s\n",
+           d.p50, d.p90, d.p99, worstErr * 100.0, worstOk ? "match" : "DIFFER", bandsOk ? "match" : "DIFFER");
+    freeAll(&g);
+}
+
+/* list walk vs columnar kernel over the same scorecard */
+static void benchColumnar(long kpis, int reps) {
+    Graph g;
+    initGraph(&g);
+    buildScorecard(&g, kpis);
+
+    KPIBatchStats list, cols;
+    volatile double sink = 0.0;
+
+    setColumnarKPIs(&g, 0);
+    double t0 = nowSec();
+    for (int r = 0; r < reps; ++r) sink += statsPass(&g, &list);
+    double listSec = (nowSec() - t0) / reps;
+
+    setColumnarKPIs(&g, 1);
+    t0 = nowSec();
+    statsPass(&g, &cols);                     /* first pass builds the columns */
+    double buildSec = nowSec() - t0;
+    t0 = nowSec();
+    for (int r = 0; r < reps; ++r) sink += statsPass(&g, &cols);
+    double colSec = (nowSec() - t0) / reps;
+    (void)sink;
+
+    printf("KPIs: %ld, repetitions: %d, kernel: %s\n", kpis, reps, kpiKernelName());
+    printf("  list walk : %8.3f ms/pass  %7.2f ns/KPI\n", listSec * 1e3, listSec * 1e9 / (double)kpis);
+    printf("  columnar  : %8.3f ms/pass  %7.2f ns/KPI  (build %.3f ms, once)\n",
+           colSec * 1e3, colSec * 1e9 / (double)kpis, buildSec * 1e3);
+    printf("  speedup   : %.2fx\n", colSec > 0.0 ? listSec / colSec : 0.0);
+    printf("  check     : count %d/%d, sum %.1f/%.1f, bands R%d A%d G%d B%d / R%d A%d G%d B%d\n",
+           list.count, cols.count, list.sumPerf, cols.sumPerf,
+           list.bands[BAND_RED], list.bands[BAND_AMBER], list.bands[BAND_GREEN], list.bands[BAND_BLUE],
+           cols.bands[BAND_RED], cols.bands[BAND_AMBER], cols.bands[BAND_GREEN], cols.bands[BAND_BLUE]);
+
+    freeAll(&g);
+}
+
+/* ---------- Perspective tree balance ---------- */
+
+/* log2 without libm: integer part by halving, then one fraction bit per squaring */
+static double log2Of(double x) {
+    double r = 0.0, bit = 1.0;
+    while (x >= 2.0) { x /= 2.0; r += 1.0; }
+    for (int i = 0; i < 30; ++i) {
+        x *= x;
+        bit /= 2.0;
+        if (x >= 2.0) { x /= 2.0; r += bit; }
+    }
+    return r;
+}
+
+/* "Persp" + index as four base-26 letters, most significant first, so
+   increasing i gives names in increasing (case-insensitive) order */
+static void sortedName(char *out, long i, int mixedCase) {
+    char *p = out + sprintf(out, "Persp");
+    for (long d = 26L * 26 * 26; d > 0; d /= 26) *p++ = (char)('a' + (i / d) % 26);
+    *p = '\0';
+    if (mixedCase)
+        for (p = out; *p; ++p) if ((p - out + i) & 1) *p = (char)toupper((unsigned char)*p);
+}
+
+/* inserts n names in sorted order; 1 if the tree is taller than the AVL
+   bound 1.44 log2(n + 2) */
+static int treeRun(long n, const char *order) {
+    Graph g;
+    initGraph(&g);
+    char name[MAX_NAME_LEN];
+    for (long i = 0; i < n; ++i) {
+        long at = strcmp(order, "descending") == 0 ? n - 1 - i : i;
+        sortedName(name, at, strcmp(order, "mixed-case") == 0);
+        addPerspectiveIfNotExists(&g, name);
+    }
+    int height = perspectiveTreeHeight(&g), count = g.numNodes;
+    double bound = 1.44 * log2Of((double)n + 2.0);
+    int bad = count != n || height > bound;
+    printf("  %-11s: %ld names, height %d, bound %.2f  %s\n", order, n, height, bound, bad ? "FAIL" : "ok");
+    freeAll(&g);
+    return bad;
+}
+
+static int treeMain(int argc, char **argv) {
+    long n = 100000L;
+    if (argc == 4 && strcmp(argv[2], "--names") == 0) n = atol(argv[3]);
+    else if (argc != 2) n = -1;
+    if (n < 1 || n > 26L * 26 * 26 * 26) {
+        fprintf(stderr, "usage: %s --tree [--names N]   (N up to 456976)\n", argv[0]);
+        return 2;
+    }
+    printf("Perspective tree balance\n");
+    int bad = treeRun(n, "ascending") | treeRun(n, "descending") | treeRun(n, "mixed-case");
+    return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--suite") == 0) return suiteMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--load") == 0) return loadMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--memory") == 0) return memoryMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--ingest") == 0) return ingestMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "--tree") == 0) return treeMain(argc, argv);
+    long kpis = (argc > 1) ? atol(argv[1]) : 1000000L;
+    int reps = (argc > 2) ? atoi(argv[2]) : 20;
+    if (kpis <= 0 || reps <= 0) {
+        fprintf(stderr, "usage: %s [kpis] [reps]\n", argv[0]);
+        return 2;
+    }
+    benchAlloc(kpis);
+    benchSnapshot(kpis);
+    benchWal(kpis);
+    benchHistory(kpis, reps);
+    benchUpsert(kpis);
+    benchAlerts(kpis);
+    benchParallel(kpis, reps);
+    benchRender(kpis);
+    benchDistribution(kpis, reps);
+    benchScenarios(kpis);
+    benchHierarchy(kpis, reps);
+    benchColumnar(kpis, reps);
+    return 0;
+}
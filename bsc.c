@@ -1,502 +1,6748 @@
-#include "bsc.h"
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <stdio.h>
-
-/* ---------- Helpers ---------- */
-
-/* safe lowercase copy into out (caller ensures out length) */
-static void toLowerCopy(char *out, const char *in, int outlen) {
-    if (!in || !out) return;
-    int i;
-    for (i = 0; i < outlen - 1 && in[i]; ++i) out[i] = (char)tolower((unsigned char)in[i]);
-    out[i] = '\0';
-}
-
-/* case-insensitive compare */
-static int strcmp_ci(const char *a, const char *b) {
-    if (!a || !b) return (a==b)?0:(a?1:-1);
-    while (*a && *b) {
-        char ca = (char)tolower((unsigned char)*a);
-        char cb = (char)tolower((unsigned char)*b);
-        if (ca != cb) return (ca < cb) ? -1 : 1;
-        ++a; ++b;
-    }
-    if (*a) return 1;
-    if (*b) return -1;
-    return 0;
-}
-
-/* check if a string is all digits (ignoring leading/trailing spaces) */
-static int isAllDigits(const char *s) {
-    if (!s) return 0;
-    while (isspace((unsigned char)*s)) ++s;
-    if (*s == '\0') return 0;
-    while (*s) {
-        if (!isdigit((unsigned char)*s) && !isspace((unsigned char)*s)) return 0;
-        ++s;
-    }
-    return 1;
-}
-
-/* check if string contains any digit */
-static int containsDigit(const char *s) {
-    if (!s) return 0;
-    while (*s) { if (isdigit((unsigned char)*s)) return 1; ++s; }
-    return 0;
-}
-
-/* ---------- BST functions (PersNode) ---------- */
-
-/* create a new BST perspective node */
-static PersNode *createPersNode(const char *name) {
-    PersNode *p = (PersNode*)malloc(sizeof(PersNode));
-    if (!p) { perror("malloc"); exit(EXIT_FAILURE); }
-    strncpy(p->name, name, MAX_NAME_LEN-1);
-    p->name[MAX_NAME_LEN-1] = '\0';
-    p->kpiList = NULL;
-    p->left = p->right = NULL;
-    return p;
-}
-
-/* insert into BST using case-sensitive order for structure determinism,
-   but equality checks elsewhere should be case-insensitive */
-static PersNode *bst_insert(PersNode *root, const char *name) {
-    if (!root) return createPersNode(name);
-    int cmp = strcmp(name, root->name);
-    if (cmp < 0) root->left = bst_insert(root->left, name);
-    else if (cmp > 0) root->right = bst_insert(root->right, name);
-    return root;
-}
-
-/* search BST by name, case-insensitive; returns pointer or NULL */
-static PersNode *bst_search_ci(PersNode *root, const char *name) {
-    if (!root) return NULL;
-    if (strcmp_ci(root->name, name) == 0) return root;
-    PersNode *L = bst_search_ci(root->left, name);
-    if (L) return L;
-    return bst_search_ci(root->right, name);
-}
-
-/* inorder traversal with callback (callback receives PersNode* and user pointer) */
-typedef void (*PersCallback)(PersNode *, void *);
-static void bst_inorder(PersNode *root, PersCallback cb, void *ud) {
-    if (!root) return;
-    bst_inorder(root->left, cb, ud);
-    cb(root, ud);
-    bst_inorder(root->right, cb, ud);
-}
-
-/* free KPIs for one node */
-static void freeKPIList(KPI *k) {
-    while (k) {
-        KPI *nx = k->next;
-        free(k);
-        k = nx;
-    }
-}
-
-/* free BST (nodes + their KPI lists) */
-static void bst_free_all(PersNode *root) {
-    if (!root) return;
-    bst_free_all(root->left);
-    bst_free_all(root->right);
-    freeKPIList(root->kpiList);
-    free(root);
-}
-
-/* ---------- Graph + mapping functions ---------- */
-
-/* initialize Graph */
-void initGraph(Graph *graph) {
-    if (!graph) return;
-    graph->numNodes = 0;
-    graph->bstRoot = NULL;
-    for (int i = 0; i < MAX_PERSPECTIVES; ++i) {
-        graph->nodes[i][0] = '\0';
-        for (int j = 0; j < MAX_PERSPECTIVES; ++j) graph->adj[i][j] = 0;
-    }
-}
-
-/* return index in graph->nodes for a name (case-insensitive), or -1 */
-int findPerspective(const Graph *graph, const char *name) {
-    if (!graph || !name) return -1;
-    char tmp[MAX_NAME_LEN];
-    toLowerCopy(tmp, name, sizeof(tmp));
-    for (int i = 0; i < graph->numNodes; ++i) {
-        char cur[MAX_NAME_LEN];
-        toLowerCopy(cur, graph->nodes[i], sizeof(cur));
-        if (strcmp(tmp, cur) == 0) return i;
-    }
-    return -1;
-}
-
-/* Add perspective into mapping and BST if not present */
-void addPerspectiveIfNotExists(Graph *graph, const char *name) {
-    if (!graph || !name || name[0] == '\0') return;
-    if (findPerspective(graph, name) != -1) return; /* already mapped */
-
-    if (graph->numNodes >= MAX_PERSPECTIVES) {
-        printf("Cannot add perspective — limit reached (%d).\n", MAX_PERSPECTIVES);
-        return;
-    }
-
-    /* add to mapping list (preserve original case as given) */
-    strncpy(graph->nodes[graph->numNodes], name, MAX_NAME_LEN-1);
-    graph->nodes[graph->numNodes][MAX_NAME_LEN-1] = '\0';
-    graph->numNodes++;
-
-    /* insert into BST as well */
-    graph->bstRoot = bst_insert(graph->bstRoot, name);
-}
-
-/* add directed edge from->to */
-void addDependency(Graph *graph, const char *from, const char *to) {
-    if (!graph || !from || !to) return;
-    /* ensure both exist in mapping (and BST) */
-    addPerspectiveIfNotExists(graph, from);
-    addPerspectiveIfNotExists(graph, to);
-    int fi = findPerspective(graph, from);
-    int ti = findPerspective(graph, to);
-    if (fi == -1 || ti == -1) {
-        printf("One or both perspectives not found (unexpected).\n");
-        return;
-    }
-    if (!graph->adj[fi][ti]) {
-        graph->adj[fi][ti] = 1;
-        printf("Added dependency: %s -> %s\n", graph->nodes[fi], graph->nodes[ti]);
-    } else {
-        printf("Dependency already exists: %s -> %s\n", graph->nodes[fi], graph->nodes[ti]);
-    }
-}
-
-/* Display adjacency list of dependencies */
-void showDependencies(const Graph *graph) {
-    if (!graph) return;
-    printf("\n--- Perspective Dependencies ---\n");
-    if (graph->numNodes == 0) { printf("  (no perspectives defined)\n"); return; }
-    for (int i = 0; i < graph->numNodes; ++i) {
-        printf("%s -> ", graph->nodes[i]);
-        int found = 0;
-        for (int j = 0; j < graph->numNodes; ++j) {
-            if (graph->adj[i][j]) {
-                if (found) printf(", ");
-                printf("%s", graph->nodes[j]);
-                found = 1;
-            }
-        }
-        if (!found) printf("None");
-        printf("\n");
-    }
-}
-
-/* ---------- KPI operations (now per-perspective inside BST) ---------- */
-
-/* interactive addKPI: prompts user for perspective and KPI; auto-creates perspective
-   only when a non-numeric name is entered (numeric input selects an existing index). */
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include "bsc.h"
-
-void addKPI(Graph *graph) {
-    if (!graph) return;
-
-    printf("\n=== Add New Key Performance Indicator (KPI) ===\n");
-
-    /* --- Step 1: Display existing perspectives --- */
-    printf("\nExisting Perspectives (count = %d):\n", graph->numNodes);
-    if (graph->numNodes == 0) {
-        printf("  (no perspectives yet — adding a new one will create it)\n");
-    } else {
-        for (int i = 0; i < graph->numNodes; ++i) {
-            printf("  %d. %s\n", i + 1, graph->nodes[i]);
-        }
-    }
-
-    /* --- Step 2: Ask for perspective name --- */
-    char perspective[MAX_NAME_LEN];
-    printf("\nEnter Perspective name (choose by number OR type perspective name): ");
-    if (!fgets(perspective, sizeof(perspective), stdin)) return;
-    perspective[strcspn(perspective, "\r\n")] = '\0';
-
-    if (perspective[0] == '\0') {
-        printf("Perspective name cannot be empty.\n");
-        return;
-    }
-
-    /* --- Step 3: Handle numeric input properly --- */
-    if (isdigit((unsigned char)perspective[0])) {
-        int idx = atoi(perspective);
-        if (idx <= 0 || idx > graph->numNodes) {
-            printf("Invalid number. Please choose a valid perspective number.\n");
-            return;
-        }
-        strcpy(perspective, graph->nodes[idx - 1]);
-    } else {
-        /* Reject digits in perspective names */
-        for (char *p = perspective; *p; ++p) {
-            if (isdigit((unsigned char)*p)) {
-                printf("Perspective names cannot contain digits.\n");
-                return;
-            }
-        }
-        addPerspectiveIfNotExists(graph, perspective);
-    }
-
-    /* --- Step 4: Input KPI details --- */
-    char kpiName[MAX_NAME_LEN];
-    float target, achieved;
-
-    printf("Enter full name of the Key Performance Indicator: ");
-    if (!fgets(kpiName, sizeof(kpiName), stdin)) return;
-    kpiName[strcspn(kpiName, "\r\n")] = '\0';
-    if (kpiName[0] == '\0') {
-        printf("KPI name cannot be empty.\n");
-        return;
-    }
-
-    printf("Enter Target value (1-100): ");
-
-    if (scanf("%f", &target) != 1 || target < 1.0f || target > 100.0f) {
-        printf("Invalid target. Must be between 1 and 100.\n");
-        while (getchar() != '\n');
-        return;
-    }
-
-    printf("Enter Achieved value (can exceed target if performance is high): ");
-    if (scanf("%f", &achieved) != 1 || achieved < 0.0f) {
-        printf("Invalid achieved value.\n");
-        while (getchar() != '\n');
-        return;
-    }
-    while (getchar() != '\n'); // clear buffer
-
-    /* --- Step 5: Add KPI node --- */
-    PersNode *pnode = graph->bstRoot;
-    while (pnode) {
-        int cmp = strcasecmp(perspective, pnode->name);
-        if (cmp == 0) break;
-        else if (cmp < 0) pnode = pnode->left;
-        else pnode = pnode->right;
-    }
-
-    if (!pnode) {
-        printf("Unexpected error: perspective not found.\n");
-        return;
-    }
-
-    KPI *newKPI = (KPI *)malloc(sizeof(KPI));
-    strcpy(newKPI->name, kpiName);
-    newKPI->target = target;
-    newKPI->achieved = achieved;
-    newKPI->next = pnode->kpiList;
-    pnode->kpiList = newKPI;
-
-    printf("\n Key Performance Indicator added successfully under '%s'.\n", perspective);
-}
-
-
-/* display all KPIs by traversing BST inorder and printing each node's KPIs */
-static void printNodeKPIs(PersNode *node, void *ud) {
-    (void)ud;
-    printf("\nPerspective: %s\n", node->name);
-    if (!node->kpiList) {
-        printf("  (No Key Performance Indicators yet)\n");
-        return;
-    }
-    KPI *t = node->kpiList;
-    while (t) {
-        float perf = 0.0f;
-        if (t->target != 0.0f) perf = (t->achieved / t->target) * 100.0f;
-
-        /* choose colour based on perf */
-        const char *col = ANSI_RESET;
-        if (perf > 100.0f) col = ANSI_BLUE;          /* More than 100% */
-        else if (perf >= 80.0f) col = ANSI_GREEN;    /* Meeting expectation */
-        else if (perf >= 20.0f) col = ANSI_YELLOW;   /* Amber (20% - 79.99%) */
-        else col = ANSI_RED;                         /* < 20% */
-
-        printf("  - %s | Target: %.2f | Achieved: %.2f | Performance: %s%.2f%%%s\n",
-               t->name, t->target, t->achieved, col, perf, ANSI_RESET);
-        t = t->next;
-    }
-}
-
-
-void displayKPIs(const Graph *graph) {
-    if (!graph) return;
-    if (!graph->bstRoot) {
-        printf("No perspectives / Key Performance Indicators defined yet.\n");
-        return;
-    }
-    bst_inorder(graph->bstRoot, (PersCallback)printNodeKPIs, NULL);
-}
-
-/* Generate scorecard: simple list of KPI performances by visiting BST */
-void generateScorecard(const Graph *graph) {
-    if (!graph) return;
-    if (!graph->bstRoot) { printf("No data to generate scorecard.\n"); return; }
-
-    printf("\n=== Scorecard (per Key Performance Indicator performance) ===\n");
-    /* reuse printNodeKPIs which prints KPIs with performance */
-    bst_inorder(graph->bstRoot, (PersCallback)printNodeKPIs, NULL);
-}
-
-/* ---------- NEW: computeScores helper ---------- */
-/*
-   computeScores fills the provided arrays (totalPerf[] and count[]) by traversing
-   the BST. It is used by evaluatePerformanceWithDependencies.
-*/
-typedef struct {
-    const Graph *graph;
-    float *totalPerf;
-    int *count;
-} ComputeCtx;
-
-static void computeScoresNode(PersNode *node, void *ud) {
-    ComputeCtx *ctx = (ComputeCtx*)ud;
-    if (!node || !ctx) return;
-    int idx = findPerspective(ctx->graph, node->name);
-    if (idx == -1) return;
-    float sum = 0.0f;
-    int c = 0;
-    KPI *k = node->kpiList;
-    while (k) {
-        if (k->target != 0.0f) {
-            sum += (k->achieved / k->target) * 100.0f;
-            c++;
-        }
-        k = k->next;
-    }
-    if (c > 0) {
-        ctx->totalPerf[idx] = sum;
-        ctx->count[idx] = c;
-    } else {
-        ctx->totalPerf[idx] = 0.0f;
-        ctx->count[idx] = 0;
-    }
-}
-
-static void computeScores(const Graph *graph, float totalPerf[], int count[]) {
-    if (!graph) return;
-    ComputeCtx ctx;
-    ctx.graph = graph;
-    ctx.totalPerf = totalPerf;
-    ctx.count = count;
-    /* initialize arrays */
-    for (int i = 0; i < MAX_PERSPECTIVES; ++i) {
-        totalPerf[i] = 0.0f;
-        count[i] = 0;
-    }
-    if (graph->bstRoot)
-        bst_inorder(graph->bstRoot, computeScoresNode, &ctx);
-}
-
-void evaluatePerformanceWithDependencies(const Graph *graph) {
-    if (!graph) return;
-    if (!graph->bstRoot || graph->numNodes == 0) {
-        printf("No data to evaluate.\n");
-        return;
-    }
-
-    /* arrays to be filled by computeScores */
-    float totalPerf[MAX_PERSPECTIVES];
-    int count[MAX_PERSPECTIVES];
-
-    computeScores(graph, totalPerf, count);
-
-    /* print averages */
-    printf("\n--- Perspective Averages ---\n");
-    float avg[MAX_PERSPECTIVES];
-    for (int i = 0; i < MAX_PERSPECTIVES; ++i) avg[i] = 0.0f;
-
-    int present = 0;
-    float overallSum = 0.0f;
-    for (int i = 0; i < graph->numNodes; ++i) {
-        if (count[i] > 0) {
-            avg[i] = totalPerf[i] / (float)count[i];
-
-            const char *col = ANSI_RESET;
-            if (avg[i] > 100.0f) col = ANSI_BLUE;      /* More than 100% */
-            else if (avg[i] >= 80.0f) col = ANSI_GREEN;/* Meeting expectation */
-            else if (avg[i] >= 20.0f) col = ANSI_YELLOW;/* Amber (20% - <80%) */
-            else col = ANSI_RED;                       /* <20% */
-
-            printf("%s: %s%.2f%%%s\n", graph->nodes[i], col, avg[i], ANSI_RESET);
-
-            overallSum += avg[i];
-            present++;
-        } else {
-            avg[i] = 0.0f;
-            printf("%s: (No KPI data)\n", graph->nodes[i]);
-        }
-    }
-
-    float overall = (present > 0) ? (overallSum / (float)present) : 0.0f;
-
-    /* dependency impact analysis */
-    printf("\n--- Dependency Impact Analysis ---\n");
-    int anyImpact = 0;
-    for (int i = 0; i < graph->numNodes; ++i) {
-        for (int j = 0; j < graph->numNodes; ++j) {
-            if (graph->adj[i][j] && avg[i] > 0.0f && avg[i] < 80.0f) {
-                const char *col = (avg[i] < 20.0f) ? ANSI_RED : ANSI_YELLOW;
-                printf("%sLow performance in %s (%.2f%%) may affect %s.%s\n",
-                       col, graph->nodes[i], avg[i], graph->nodes[j], ANSI_RESET);
-                anyImpact = 1;
-            }
-        }
-    }
-    if (!anyImpact) {
-        printf("No dependency impacts detected based on current averages (threshold: < 80%%).\n");
-    }
-
-    /* find lowest performer (among those with KPI data) */
-    float min = 1e9f;
-    int minIdx = -1;
-    for (int i = 0; i < graph->numNodes; ++i) {
-        if (count[i] > 0 && avg[i] < min) {
-            min = avg[i];
-            minIdx = i;
-        }
-    }
-
-    printf("\nOverall Performance: %.2f%%\n", overall);
-    if (minIdx != -1) {
-        const char *col = ANSI_RESET;
-        if (avg[minIdx] > 100.0f) col = ANSI_BLUE;
-        else if (avg[minIdx] >= 80.0f) col = ANSI_GREEN;
-        else if (avg[minIdx] >= 20.0f) col = ANSI_YELLOW;
-        else col = ANSI_RED;
-        printf("Lowest Performing Perspective: %s (%s%.2f%%%s)\n",
-               graph->nodes[minIdx], col, avg[minIdx], ANSI_RESET);
-    } else {
-        printf("No perspective had KPI data to determine lowest performer.\n");
-    }
-}
-
-/* display numbered list of perspectives using mapping order */
-void displayPerspectives(const Graph *graph)
-{
-    if (!graph) { printf("(No graph available)\n"); return; }
-    printf("\nExisting Perspectives (count = %d):\n", graph->numNodes);
-    if (graph->numNodes == 0) { printf("  (no perspectives defined)\n"); return; }
-    for (int i = 0; i < graph->numNodes; ++i) {
-        printf("  %d. %s\n", i + 1, graph->nodes[i]);
-    }
-}
-
-/* free all memory: free BST (which frees KPI lists) and reset mapping */
-void freeAll(Graph *graph) {
-    if (!graph) return;
-    bst_free_all(graph->bstRoot);
-    graph->bstRoot = NULL;
-    graph->numNodes = 0;
-    for (int i = 0; i < MAX_PERSPECTIVES; ++i) {
-        graph->nodes[i][0] = '\0';
-        for (int j = 0; j < MAX_PERSPECTIVES; ++j) graph->adj[i][j] = 0;
-    }
-}
+#define _POSIX_C_SOURCE 200809L
+#include "bsc.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#endif
+
+/* per-thread storage (GCC, Clang and MinGW; MSVC spells it differently) */
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+/* ---------- Helpers ---------- */
+
+/* safe lowercase copy into out (caller ensures out length) */
+static void toLowerCopy(char *out, const char *in, int outlen) {
+    if (!in || !out) return;
+    int i;
+    for (i = 0; i < outlen - 1 && in[i]; ++i) out[i] = (char)tolower((unsigned char)in[i]);
+    out[i] = '\0';
+}
+
+/* case-insensitive compare; orders exactly like strcmp on toLowerCopy'd names */
+static int strcmp_ci(const char *a, const char *b) {
+    if (!a || !b) return (a==b)?0:(a?1:-1);
+    while (*a && *b) {
+        unsigned char ca = (unsigned char)tolower((unsigned char)*a);
+        unsigned char cb = (unsigned char)tolower((unsigned char)*b);
+        if (ca != cb) return (ca < cb) ? -1 : 1;
+        ++a; ++b;
+    }
+    if (*a) return 1;
+    if (*b) return -1;
+    return 0;
+}
+
+/* check if a string is all digits (ignoring leading/trailing spaces) */
+static int isAllDigits(const char *s) {
+    if (!s) return 0;
+    while (isspace((unsigned char)*s)) ++s;
+    if (*s == '\0') return 0;
+    while (*s) {
+        if (!isdigit((unsigned char)*s) && !isspace((unsigned char)*s)) return 0;
+        ++s;
+    }
+    return 1;
+}
+
+/* check if string contains any digit */
+static int containsDigit(const char *s) {
+    if (!s) return 0;
+    while (*s) { if (isdigit((unsigned char)*s)) return 1; ++s; }
+    return 0;
+}
+
+/* monotonic wall clock in seconds (for throughput reporting) */
+static double nowSeconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, cnt;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (double)cnt.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+#endif
+}
+
+/* ---------- Instrumentation ----------
+   STAT_* hooks on the hot paths; all of them vanish without BSC_STATS.
+   Each thread counts into its own block with plain relaxed loads and
+   stores (no shared read-modify-write); getStats merges the blocks. A
+   block outlives its thread and is handed to the next new one, so counts
+   are never lost. The per-row operations are timed on one call in
+   STAT_SAMPLE_EVERY; every call is still counted. */
+#ifdef BSC_STATS
+#define STAT_SAMPLE_EVERY 64
+
+typedef struct StatBlock {
+    BscStats s;
+    uint32_t tick[STAT_OP_COUNT];       /* calls by this thread, wrapping */
+    int inUse;
+    struct StatBlock *next;
+} StatBlock;
+
+static StatBlock *statBlocks;           /* every block made, never freed */
+static pthread_mutex_t statLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t statOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t statKey;
+static THREAD_LOCAL StatBlock *statOwn;
+
+/* 1 = time every call */
+static const uint32_t statSampling[STAT_OP_COUNT] = {
+    [STAT_FIND_PERSPECTIVE] = STAT_SAMPLE_EVERY,
+    [STAT_INSERT_KPI] = STAT_SAMPLE_EVERY,
+    [STAT_SCORE_PERSPECTIVE] = 1,
+    [STAT_QUERY_PERSPECTIVES] = 1,
+    [STAT_EVALUATE] = 1,
+    [STAT_RENDER] = 1,
+    [STAT_DISTRIBUTION] = 1
+};
+
+static void statRelease(void *block) {
+    pthread_mutex_lock(&statLock);
+    ((StatBlock *)block)->inUse = 0;
+    pthread_mutex_unlock(&statLock);
+}
+
+static void statKeyInit(void) {
+    if (pthread_key_create(&statKey, statRelease) != 0) {
+        perror("pthread_key_create");
+        exit(1);
+    }
+}
+
+static StatBlock *statAttach(void) {
+    pthread_once(&statOnce, statKeyInit);
+    pthread_mutex_lock(&statLock);
+    StatBlock *b = statBlocks;
+    while (b && b->inUse) b = b->next;
+    if (!b) {
+        /* not xrealloc: it counts allocations itself */
+        b = calloc(1, sizeof(*b));
+        if (!b) {
+            perror("calloc");
+            exit(1);
+        }
+        b->next = statBlocks;
+        statBlocks = b;
+    }
+    b->inUse = 1;
+    pthread_mutex_unlock(&statLock);
+    pthread_setspecific(statKey, b);
+    return statOwn = b;
+}
+
+static inline BscStats *statSelf(void) {
+    return &(statOwn ? statOwn : statAttach())->s;
+}
+
+/* only the owning thread writes a block; the atomics keep getStats' reads
+   of it well defined */
+static inline void statBump(uint64_t *slot, uint64_t n) {
+    __atomic_store_n(slot, __atomic_load_n(slot, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+static inline void statRaise(uint64_t *slot, uint64_t v) {
+    if (v > __atomic_load_n(slot, __ATOMIC_RELAXED)) __atomic_store_n(slot, v, __ATOMIC_RELAXED);
+}
+
+static uint64_t nowNanos(void) {
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER cnt;
+    if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&cnt);
+    return (uint64_t)((double)cnt.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* count the call; returns its start time, or 0 when it is not sampled.
+   A thread's first calls are not sampled: they carry one-off setup that
+   would weigh STAT_SAMPLE_EVERY times in the mean. */
+static inline uint64_t statBegin(StatOp op) {
+    statBump(&statSelf()->op[op].calls, 1);
+    if (++statOwn->tick[op] % statSampling[op]) return 0;
+    return nowNanos();
+}
+
+static void statEnd(StatOp op, uint64_t start) {
+    if (!start) return;
+    uint64_t ns = nowNanos() - start;
+    OpStats *o = &statOwn->s.op[op];
+    int b = 0;
+    while (b < STAT_HIST_BUCKETS - 1 && (ns >> b) != 0) ++b;
+    statBump(&o->timed, 1);
+    statBump(&o->ns, ns);
+    statBump(&o->hist[b], 1);
+    statRaise(&o->maxNs, ns);
+}
+
+#define STAT_ADD(field, n)      statBump(&statSelf()->field, (uint64_t)(n))
+#define STAT_MAX(field, v)      statRaise(&statSelf()->field, (uint64_t)(v))
+#define STAT_START(op, t)       uint64_t t = statBegin(op)
+#define STAT_STOP(op, t)        statEnd(op, t)
+#define STAT_ONLY(...)          __VA_ARGS__
+#else
+#define STAT_ADD(field, n)      ((void)0)
+#define STAT_MAX(field, v)      ((void)0)
+#define STAT_START(op, t)       ((void)0)
+#define STAT_STOP(op, t)        ((void)0)
+#define STAT_ONLY(...)
+#endif
+
+/* status and error messages of edits, loads, snapshots and the log
+   (reports always go to stdout) */
+static FILE *messageStream;
+
+static void message(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(messageStream ? messageStream : stdout, fmt, ap);
+    va_end(ap);
+}
+
+void setMessageStream(FILE *stream) {
+    messageStream = stream;
+}
+
+/* drop the rest of an input line (stops at EOF too) */
+void discardLine(void) {
+    int c;
+    while ((c = getchar()) != '\n' && c != EOF) {}
+}
+
+/* KPI field validation shared by the interactive and bulk paths */
+static int validTarget(float target) { return target >= 1.0f && target <= 100.0f; }
+static int validAchieved(float achieved) { return achieved >= 0.0f; }
+
+/* realloc or die, matching the malloc failure policy used for nodes */
+static void *xrealloc(void *ptr, size_t size) {
+    STAT_ADD(allocCalls, 1);
+    STAT_ADD(allocBytes, size);
+    void *p = realloc(ptr, size);
+    if (!p && size) { perror("realloc"); exit(EXIT_FAILURE); }
+    return p;
+}
+
+/* write-ahead log hooks (defined with the log below) */
+enum { WAL_PERSPECTIVE = 1, WAL_DEPENDENCY = 2, WAL_KPI = 3, WAL_OBSERVATION = 4,
+       WAL_KPI_VALUES = 5, WAL_KPI_DELETE = 6 };
+static void walPut(Graph *graph, int type, const void *a, size_t alen, const void *b, size_t blen);
+static void walReset(Graph *graph);
+
+/* band alert hooks (defined with the alerts below): a KPI edit takes a
+   watch before it touches the aggregates and reports it afterwards;
+   nothing is recorded when the graph has no listener */
+typedef struct BandWatch {
+    int active;
+    int kpiBand;            /* -1: no KPI watched */
+    float kpiPerf;
+    int persBand;           /* -1: no KPI data */
+    float persAverage;
+} BandWatch;
+static void watchBefore(const Graph *graph, const PersNode *pnode, const KPI *k, BandWatch *w);
+static void watchAfter(Graph *graph, const PersNode *pnode, const KPI *k, const BandWatch *w);
+static void watchDependency(Graph *graph, int from, int to);
+
+/* ingest hooks (defined with the pipeline below): while one is open, edits
+   run on several consumer threads at once. A consumer stages what would
+   touch graph-wide storage (new names, history entries and chunks, log
+   records, band events) in its own shard and merges it under the shared
+   lock once per batch. The stage* hooks return 0 on any other thread.
+   Tables that grow keep their old block until the pipeline closes, as
+   another shard may still be reading it. */
+static void sharedLock(Graph *graph);
+static void sharedUnlock(Graph *graph);
+static void *growShared(Graph *graph, void *old, size_t used, size_t size);
+static void bumpVersion(Graph *graph);
+static uint32_t stageName(Graph *graph, PersNode *pnode, int slot, const char *name);
+static const char *stagedName(const Graph *graph, uint32_t handle);
+static int stagedIn(const Graph *graph, const PersNode *pnode);
+static uint32_t stageHistoryNew(Graph *graph);
+static int stageHistoryFree(Graph *graph, uint32_t handle);
+static ObjPool *chunkPoolOf(Graph *graph);
+static int stageBandEvent(Graph *graph, const BandEvent *ev);
+static int stageWalRecord(Graph *graph, int type, const void *a, size_t alen, const void *b, size_t blen);
+
+/* ---------- Object pools ---------- */
+
+/* chunk header padded so objects after it stay suitably aligned */
+typedef union PoolAlign { PoolChunk hdr; void *p; double d; long long ll; } PoolAlign;
+
+static void poolInit(ObjPool *pool, size_t objSize) {
+    size_t align = sizeof(PoolAlign);
+    pool->chunks = NULL;
+    pool->cursor = pool->limit = NULL;
+    pool->freeList = NULL;
+    pool->objSize = (objSize + align - 1) / align * align;
+    pool->nextChunkObjs = POOL_FIRST_CHUNK_OBJS;
+    pool->chunkCount = 0;
+    pool->objects = 0;
+    pool->bytes = 0;
+}
+
+/* hand out one uninitialised object: a freed one if any, else the next
+   slot of the newest chunk, grabbing a new chunk when full */
+static void *poolAlloc(ObjPool *pool) {
+    if (pool->freeList) {
+        void *obj = pool->freeList;
+        pool->freeList = *(void**)obj;
+        pool->objects++;
+        return obj;
+    }
+    if (pool->cursor == pool->limit) {
+        size_t size = sizeof(PoolAlign) + (size_t)pool->nextChunkObjs * pool->objSize;
+        STAT_ADD(allocCalls, 1);
+        STAT_ADD(allocBytes, size);
+        PoolChunk *c = (PoolChunk*)malloc(size);
+        if (!c) { perror("malloc"); exit(EXIT_FAILURE); }
+        c->next = pool->chunks;
+        pool->chunks = c;
+        pool->cursor = (char*)c + sizeof(PoolAlign);
+        pool->limit = (char*)c + size;
+        pool->chunkCount++;
+        pool->bytes += size;
+        if (pool->nextChunkObjs < POOL_MAX_CHUNK_OBJS) pool->nextChunkObjs *= 2;
+    }
+    void *obj = pool->cursor;
+    pool->cursor += pool->objSize;
+    pool->objects++;
+    return obj;
+}
+
+/* give one object back for reuse (objSize always holds a pointer) */
+static void poolFree(ObjPool *pool, void *obj) {
+    *(void**)obj = pool->freeList;
+    pool->freeList = obj;
+    pool->objects--;
+}
+
+/* hand every chunk and given-back object of from over to into; from is
+   left empty (the unused tail of its newest chunk is not reused) */
+static void poolAdopt(ObjPool *into, ObjPool *from) {
+    if (from->chunks) {
+        PoolChunk *last = from->chunks;
+        while (last->next) last = last->next;
+        last->next = into->chunks;
+        into->chunks = from->chunks;
+    }
+    if (from->freeList) {
+        void *last = from->freeList;
+        while (*(void**)last) last = *(void**)last;
+        *(void**)last = into->freeList;
+        into->freeList = from->freeList;
+    }
+    into->chunkCount += from->chunkCount;
+    into->objects += from->objects;
+    into->bytes += from->bytes;
+    poolInit(from, from->objSize);
+}
+
+/* release every chunk at once; the pool is reusable afterwards */
+static void poolReleaseAll(ObjPool *pool) {
+    PoolChunk *c = pool->chunks;
+    while (c) {
+        PoolChunk *nx = c->next;
+        free(c);
+        c = nx;
+    }
+    poolInit(pool, pool->objSize);
+}
+
+/* ---------- BST functions (PersNode) ---------- */
+
+/* create a new BST perspective node */
+static PersNode *createPersNode(ObjPool *pool, const char *name, int id) {
+    PersNode *p = (PersNode*)poolAlloc(pool);
+    strncpy(p->name, name, MAX_NAME_LEN-1);
+    p->name[MAX_NAME_LEN-1] = '\0';
+    p->id = id;
+    p->height = 1;
+    p->kpis = NULL;
+    p->kpiLen = p->kpiCap = 0;
+    p->kpiIndex = NULL;
+    p->kpiIndexCap = 0;
+    p->kpiCount = 0;
+    p->kpiShadowed = 0;
+    memset(&p->cols, 0, sizeof(p->cols));
+    p->perfSum = 0.0;
+    p->perfCount = 0;
+    p->perfStale = 0;
+    p->perfMin = p->perfMax = 0.0f;
+    p->left = p->right = NULL;
+    return p;
+}
+
+/* AVL helpers */
+static int bst_height(const PersNode *n) { return n ? n->height : 0; }
+
+static void bst_update(PersNode *n) {
+    int hl = bst_height(n->left), hr = bst_height(n->right);
+    n->height = 1 + (hl > hr ? hl : hr);
+}
+
+static PersNode *bst_rotate_right(PersNode *n) {
+    PersNode *l = n->left;
+    n->left = l->right;
+    l->right = n;
+    bst_update(n);
+    bst_update(l);
+    return l;
+}
+
+static PersNode *bst_rotate_left(PersNode *n) {
+    PersNode *r = n->right;
+    n->right = r->left;
+    r->left = n;
+    bst_update(n);
+    bst_update(r);
+    return r;
+}
+
+/* restore the AVL invariant at n after one of its subtrees grew */
+static PersNode *bst_rebalance(PersNode *n) {
+    bst_update(n);
+    int bal = bst_height(n->left) - bst_height(n->right);
+    if (bal > 1) {
+        if (bst_height(n->left->left) < bst_height(n->left->right))
+            n->left = bst_rotate_left(n->left);
+        return bst_rotate_right(n);
+    }
+    if (bal < -1) {
+        if (bst_height(n->right->right) < bst_height(n->right->left))
+            n->right = bst_rotate_right(n->right);
+        return bst_rotate_left(n);
+    }
+    return n;
+}
+
+/* insert into the AVL tree. Insert and search share one case-insensitive
+   ordering (strcmp_ci), so mixed-case names land where lookups expect them.
+   *created receives the node holding name. */
+static PersNode *bst_insert(ObjPool *pool, PersNode *root, const char *name, int id,
+                            PersNode **created) {
+    if (!root) return *created = createPersNode(pool, name, id);
+    int cmp = strcmp_ci(name, root->name);
+    if (cmp < 0) root->left = bst_insert(pool, root->left, name, id, created);
+    else if (cmp > 0) root->right = bst_insert(pool, root->right, name, id, created);
+    else { *created = root; return root; }
+    return bst_rebalance(root);
+}
+
+#ifdef BSC_STATS
+/* levels above node, which must be in the tree */
+static int bst_depth(const PersNode *root, const PersNode *node) {
+    int depth = 0;
+    while (root != node) {
+        root = strcmp_ci(node->name, root->name) < 0 ? root->left : root->right;
+        ++depth;
+    }
+    return depth;
+}
+#endif
+
+
+/* KPIs in list order (newest first), deleted slots skipped:
+   for (k = kpiFirst(node); k; k = kpiNext(node, k)) */
+static KPI *kpiNext(const PersNode *node, const KPI *k) {
+    while (k != node->kpis)
+        if ((--k)->name) return (KPI*)k;
+    return NULL;
+}
+
+static KPI *kpiFirst(const PersNode *node) {
+    return node->kpiLen ? kpiNext(node, node->kpis + node->kpiLen) : NULL;
+}
+
+/* min / max performance of a perspective's KPIs; returns the KPIs counted */
+static int scanPerfRange(const PersNode *node, float *min, float *max) {
+    int n = 0;
+    for (const KPI *k = kpiFirst(node); k; k = kpiNext(node, k)) {
+        if (k->target == 0.0f) continue;
+        float perf = (k->achieved / k->target) * 100.0f;
+        if (n == 0 || perf < *min) *min = perf;
+        if (n == 0 || perf > *max) *max = perf;
+        n++;
+    }
+    return n;
+}
+
+/* count one edit while min / max are only bounds; after perfCount of them
+   a rescan makes them exact again */
+static void aggregateEdited(PersNode *pnode) {
+    if (pnode->perfStale && ++pnode->perfStale > pnode->perfCount) {
+        scanPerfRange(pnode, &pnode->perfMin, &pnode->perfMax);
+        pnode->perfStale = 0;
+    }
+}
+
+/* average performance from a double sum; divided before narrowing so large
+   perspectives keep the sum's precision */
+static float perfAverage(double sum, int count) {
+    return count > 0 ? (float)(sum / count) : 0.0f;
+}
+
+/* fold one KPI's performance into its perspective's running aggregates */
+static void aggregateAdd(PersNode *pnode, const KPI *k) {
+    if (k->target == 0.0f) return;
+    float perf = (k->achieved / k->target) * 100.0f;
+    if (pnode->perfCount == 0 || perf < pnode->perfMin) pnode->perfMin = perf;
+    if (pnode->perfCount == 0 || perf > pnode->perfMax) pnode->perfMax = perf;
+    if (pnode->perfCount == 0) pnode->perfStale = 0;
+    pnode->perfSum += perf;
+    pnode->perfCount++;
+    aggregateEdited(pnode);
+}
+
+/* take one KPI's old values out of the aggregates; removing an extreme only
+   marks min / max stale instead of rescanning the list */
+static void aggregateRemove(PersNode *pnode, float oldTarget, float oldAchieved) {
+    if (oldTarget == 0.0f) return;
+    float old = (oldAchieved / oldTarget) * 100.0f;
+    pnode->perfSum -= old;
+    if (--pnode->perfCount == 0) {
+        pnode->perfSum = 0.0;
+        pnode->perfStale = 0;
+    } else if (!pnode->perfStale && (old <= pnode->perfMin || old >= pnode->perfMax)) {
+        pnode->perfStale = 1;
+    } else {
+        aggregateEdited(pnode);
+    }
+}
+
+/* replace one KPI's contribution after its values changed in place */
+static void aggregateReplace(PersNode *pnode, const KPI *k, float oldTarget, float oldAchieved) {
+    aggregateRemove(pnode, oldTarget, oldAchieved);
+    aggregateAdd(pnode, k);
+}
+
+/* ---------- Interned KPI names ---------- */
+
+#define NAME_POOL_FIRST_BYTES 4096
+#define NAME_STAGED 0x80000000u     /* handle bit: staged by an ingest shard; the pool stays below */
+
+/* FNV-1a of a name exactly as given (interning is case-sensitive) */
+static uint32_t hashExactName(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+static uint32_t nameHashAt(const NamePool *pool, uint32_t handle) {
+    uint32_t h;
+    memcpy(&h, pool->bytes + handle - 4, sizeof(h));
+    return h;
+}
+
+/* double the index (first size 64) and reinsert every handle */
+static void nameIndexGrow(NamePool *pool) {
+    uint32_t *old = pool->index;
+    uint32_t oldCap = pool->indexCap;
+    uint32_t cap = oldCap ? oldCap * 2 : 64;
+    pool->index = xrealloc(NULL, (size_t)cap * sizeof(uint32_t));
+    memset(pool->index, 0, (size_t)cap * sizeof(uint32_t));
+    pool->indexCap = cap;
+    for (uint32_t i = 0; i < oldCap; ++i) {
+        if (!old[i]) continue;
+        uint32_t slot = nameHashAt(pool, old[i]) & (cap - 1);
+        while (pool->index[slot]) slot = (slot + 1) & (cap - 1);
+        pool->index[slot] = old[i];
+    }
+    free(old);
+}
+
+/* bytes of the entry whose name starts at handle: hash, name and NUL,
+   padded so the next hash stays aligned */
+static uint32_t nameEntrySize(size_t nameLen) {
+    return (uint32_t)((sizeof(uint32_t) + nameLen + 1 + 3) & ~(size_t)3);
+}
+
+/* index slot holding name, or the empty slot where it belongs */
+static uint32_t nameSlot(const NamePool *pool, uint32_t h, const char *name) {
+    uint32_t mask = pool->indexCap - 1, slot = h & mask;
+    for (; pool->index[slot]; slot = (slot + 1) & mask) {
+        uint32_t c = pool->index[slot];
+        if (nameHashAt(pool, c) == h && strcmp(pool->bytes + c, name) == 0) break;
+    }
+    return slot;
+}
+
+/* Rebuild the pool from the names live KPIs still use, in their old order,
+   and renumber the KPIs' handles; names only deleted KPIs used are gone.
+   O(KPI slots + pool bytes). Leaves room for as many bytes again, so the
+   next compaction is as far off. Not while a pipeline shares the pool. */
+static void compactNames(Graph *graph) {
+    NamePool *pool = &graph->names;
+    if (graph->ingest || !pool->len) return;
+    /* old handle / 4 -> new handle, 0 = unused */
+    uint32_t *moved = xrealloc(NULL, ((size_t)pool->len / 4 + 1) * sizeof(uint32_t));
+    memset(moved, 0, ((size_t)pool->len / 4 + 1) * sizeof(uint32_t));
+    for (int i = 0; i < graph->numNodes; ++i) {
+        const PersNode *pnode = graph->pers[i];
+        for (int j = 0; j < pnode->kpiLen; ++j)
+            if (pnode->kpis[j].name) moved[pnode->kpis[j].name / 4] = 1;
+    }
+
+    uint32_t len = 0, count = 0;
+    for (uint32_t at = 0; at < pool->len; ) {
+        uint32_t size = nameEntrySize(strlen(pool->bytes + at + 4));
+        if (moved[(at + 4) / 4]) {
+            moved[(at + 4) / 4] = len + 4;
+            len += size;
+            count++;
+        }
+        at += size;
+    }
+    uint32_t cap = len < NAME_POOL_FIRST_BYTES / 2 ? NAME_POOL_FIRST_BYTES
+                 : len <= NAME_STAGED / 2 ? len * 2 : NAME_STAGED;
+    char *bytes = xrealloc(NULL, cap);
+    for (uint32_t at = 0; at < pool->len; ) {
+        uint32_t size = nameEntrySize(strlen(pool->bytes + at + 4));
+        uint32_t to = moved[(at + 4) / 4];
+        if (to) memcpy(bytes + to - 4, pool->bytes + at, size);
+        at += size;
+    }
+    for (int i = 0; i < graph->numNodes; ++i) {
+        PersNode *pnode = graph->pers[i];
+        for (int j = 0; j < pnode->kpiLen; ++j)
+            if (pnode->kpis[j].name) pnode->kpis[j].name = moved[pnode->kpis[j].name / 4];
+    }
+    free(moved);
+
+    free(pool->bytes);
+    free(pool->index);
+    pool->bytes = bytes;
+    pool->len = len;
+    pool->cap = cap;
+    pool->index = NULL;
+    pool->indexCap = 0;
+    pool->count = count;
+    pool->released = 0;
+    pool->compactions++;
+    while ((pool->count + 1) * 2 > pool->indexCap) nameIndexGrow(pool);
+    for (uint32_t at = 0; at < len; at += nameEntrySize(strlen(bytes + at + 4))) {
+        uint32_t slot = nameSlot(pool, nameHashAt(pool, at + 4), bytes + at + 4);
+        pool->index[slot] = at + 4;
+    }
+}
+
+/* compact rather than grow once the KPIs deleted since the last compaction
+   are at least half the slots a compaction walks (amortised O(1) each) */
+static int namesWorthCompacting(const Graph *graph) {
+    if (graph->ingest || !graph->names.released) return 0;
+    uint64_t slots = 0;
+    for (int i = 0; i < graph->numNodes; ++i) slots += (uint64_t)graph->pers[i]->kpiLen;
+    return (uint64_t)graph->names.released * 2 >= slots;
+}
+
+/* the handle of name, stored on first use. A name already in the pool is
+   found before the buffer can move, so name may point into it. Storing a
+   new name may compact the pool, which renumbers every KPI's handle.
+   Ingest consumers stage names instead and intern them per batch, under
+   the shared lock. */
+static uint32_t internName(Graph *graph, const char *name) {
+    NamePool *pool = &graph->names;
+    uint32_t h = hashExactName(name);
+    if ((pool->count + 1) * 2 > pool->indexCap) nameIndexGrow(pool);
+    uint32_t slot = nameSlot(pool, h, name);
+    if (pool->index[slot]) return pool->index[slot];
+    uint64_t need = nameEntrySize(strlen(name));
+    if (pool->len + need > pool->cap && namesWorthCompacting(graph)) {
+        compactNames(graph);
+        slot = nameSlot(pool, h, name);
+    }
+    if (pool->len + need > pool->cap) {
+        uint64_t cap = pool->cap ? pool->cap : NAME_POOL_FIRST_BYTES;
+        while (cap < pool->len + need) cap *= 2;
+        if (cap > NAME_STAGED) {
+            fprintf(stderr, "KPI name pool full\n");
+            exit(EXIT_FAILURE);
+        }
+        char *bytes = growShared(graph, pool->bytes, pool->len, (size_t)cap);
+        __atomic_store_n(&pool->bytes, bytes, __ATOMIC_RELEASE);
+        pool->cap = (uint32_t)cap;
+    }
+    uint32_t handle = pool->len + (uint32_t)sizeof(h);
+    memcpy(pool->bytes + pool->len, &h, sizeof(h));
+    strcpy(pool->bytes + handle, name);
+    pool->len += (uint32_t)need;
+    pool->index[slot] = handle;
+    pool->count++;
+    return handle;
+}
+
+const char *kpiNameOf(const Graph *graph, const KPI *kpi) {
+    if (!graph || !kpi || !kpi->name) return NULL;
+    if (kpi->name & NAME_STAGED) return stagedName(graph, kpi->name);
+    return __atomic_load_n(&graph->names.bytes, __ATOMIC_ACQUIRE) + kpi->name;
+}
+
+/* accepted as a KPI name: not empty and short enough to keep whole */
+static int validKPIName(const char *name) {
+    return name[0] != '\0' && strlen(name) < MAX_KPI_NAME_LEN;
+}
+
+/* ---------- KPI name index ---------- */
+
+/* FNV-1a of a KPI name folded to lower case */
+static unsigned hashKPIName(const char *s) {
+    unsigned h = 2166136261u;
+    for (; *s; ++s) {
+        h ^= (unsigned char)tolower((unsigned char)*s);
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* does a stored KPI name match name case-insensitively? */
+static int kpiNameIs(const char *stored, const char *name) {
+    int i = 0;
+    for (; name[i]; ++i)
+        if (tolower((unsigned char)stored[i]) != tolower((unsigned char)name[i])) return 0;
+    return stored[i] == '\0';
+}
+
+/* the slot naming name, or the empty slot where it would go (index non-empty) */
+static KPISlot *kpiSlot(const Graph *graph, const PersNode *pnode, const char *name, unsigned h) {
+    unsigned mask = (unsigned)(pnode->kpiIndexCap - 1);
+    for (unsigned i = h & mask; ; i = (i + 1) & mask) {
+        KPISlot *s = &pnode->kpiIndex[i];
+        if (!s->kpi) return s;
+        if (s->hash == h && kpiNameIs(kpiNameOf(graph, &pnode->kpis[s->kpi - 1]), name)) return s;
+    }
+}
+
+/* double the index (first size 8) and reinsert every entry */
+static void kpiIndexGrow(PersNode *pnode) {
+    KPISlot *old = pnode->kpiIndex;
+    int oldCap = pnode->kpiIndexCap;
+    int cap = oldCap ? oldCap * 2 : 8;
+    pnode->kpiIndex = xrealloc(NULL, (size_t)cap * sizeof(KPISlot));
+    memset(pnode->kpiIndex, 0, (size_t)cap * sizeof(KPISlot));
+    pnode->kpiIndexCap = cap;
+    unsigned mask = (unsigned)(cap - 1);
+    for (int i = 0; i < oldCap; ++i) {
+        if (!old[i].kpi) continue;
+        unsigned slot = old[i].hash & mask;
+        while (pnode->kpiIndex[slot].kpi) slot = (slot + 1) & mask;
+        pnode->kpiIndex[slot] = old[i];
+    }
+    free(old);
+}
+
+/* empty a slot, shifting later entries of the probe run back (no tombstones) */
+static void kpiIndexRemove(PersNode *pnode, KPISlot *slot) {
+    KPISlot *idx = pnode->kpiIndex;
+    unsigned mask = (unsigned)(pnode->kpiIndexCap - 1);
+    unsigned i = (unsigned)(slot - idx), j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (!idx[j].kpi) break;
+        unsigned home = idx[j].hash & mask;
+        /* the entry at j may move to i unless its home lies in (i, j] */
+        int stays = i < j ? (home > i && home <= j) : (home > i || home <= j);
+        if (!stays) {
+            idx[i] = idx[j];
+            i = j;
+        }
+    }
+    idx[i].kpi = 0;
+}
+
+/* the KPI a name lookup finds (the newest of that name), or NULL */
+static KPI *findKPI(const Graph *graph, const PersNode *pnode, const char *name) {
+    if (!pnode->kpiIndexCap) return NULL;
+    uint32_t pos = kpiSlot(graph, pnode, name, hashKPIName(name))->kpi;
+    return pos ? &pnode->kpis[pos - 1] : NULL;
+}
+
+/* the index slot for name, growing the index first so one more entry fits;
+   *h receives the name's hash */
+static KPISlot *kpiSlotForInsert(const Graph *graph, PersNode *pnode, const char *name, unsigned *h) {
+    if ((pnode->kpiCount + 1) * 2 > pnode->kpiIndexCap) kpiIndexGrow(pnode);
+    *h = hashKPIName(name);
+    return kpiSlot(graph, pnode, name, *h);
+}
+
+/* point every name at its newest KPI again after the array was compacted */
+static void kpiIndexRebuild(const Graph *graph, PersNode *pnode) {
+    memset(pnode->kpiIndex, 0, (size_t)pnode->kpiIndexCap * sizeof(KPISlot));
+    pnode->kpiShadowed = 0;
+    for (int i = 0; i < pnode->kpiLen; ++i) {
+        const char *name = kpiNameOf(graph, &pnode->kpis[i]);
+        unsigned h = hashKPIName(name);
+        KPISlot *slot = kpiSlot(graph, pnode, name, h);
+        if (slot->kpi) pnode->kpiShadowed++;
+        slot->hash = h;
+        slot->kpi = (uint32_t)i + 1;
+    }
+}
+
+/* append a new KPI to a perspective's array and point its name at it, so an
+   older KPI of the same name becomes shadowed (not logged). slot / h come
+   from kpiSlotForInsert when the caller already probed (slot NULL = probe).
+   Earlier KPI pointers into the perspective may move. */
+static KPI *linkKPI(Graph *graph, PersNode *pnode, const char *name, float target, float achieved,
+                    KPISlot *slot, unsigned h) {
+    STAT_START(STAT_INSERT_KPI, t0);
+    BandWatch w;
+    watchBefore(graph, pnode, NULL, &w);
+    bumpVersion(graph);
+    if (!slot) slot = kpiSlotForInsert(graph, pnode, name, &h);
+    if (pnode->kpiLen == pnode->kpiCap) {
+        pnode->kpiCap = pnode->kpiCap ? pnode->kpiCap * 2 : 4;
+        pnode->kpis = xrealloc(pnode->kpis, (size_t)pnode->kpiCap * sizeof(KPI));
+    }
+    /* before the new slot exists: interning may compact the pool */
+    uint32_t handle = stageName(graph, pnode, pnode->kpiLen, name);
+    if (!handle) handle = internName(graph, name);
+    KPI *k = &pnode->kpis[pnode->kpiLen++];
+    k->name = handle;
+    k->target = target;
+    k->achieved = achieved;
+    k->history = 0;
+    if (slot->kpi) pnode->kpiShadowed++;
+    slot->hash = h;
+    slot->kpi = (uint32_t)pnode->kpiLen;
+    pnode->kpiCount++;
+    pnode->cols.dirty = 1;
+    aggregateAdd(pnode, k);
+    watchAfter(graph, pnode, NULL, &w);
+    STAT_STOP(STAT_INSERT_KPI, t0);
+    return k;
+}
+
+/* add a new KPI to a perspective */
+static KPI *insertKPI(Graph *graph, PersNode *pnode, const char *name, float target, float achieved,
+                      KPISlot *slot, unsigned h) {
+    KPI *k = linkKPI(graph, pnode, name, target, achieved, slot, h);
+    if (graph->wal) {
+        struct { uint32_t pers; float target, achieved; } rec = { (uint32_t)pnode->id, target, achieved };
+        const char *stored = kpiNameOf(graph, k);
+        walPut(graph, WAL_KPI, &rec, sizeof(rec), stored, strlen(stored));
+    }
+    return k;
+}
+
+/* ---------- KPI history ---------- */
+
+static KPIObservation *historyAt(const KPIHistory *h, int i) {
+    return &h->chunks[i / HISTORY_CHUNK_OBS]->obs[i % HISTORY_CHUNK_OBS];
+}
+
+/* index of the last observation with period <= period, or -1 */
+static int historyFind(const KPIHistory *h, int32_t period) {
+    int lo = 0, hi = h->count;          /* first index with period > period */
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (historyAt(h, mid)->period <= period) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo - 1;
+}
+
+/* the table entry of a history handle */
+static KPIHistory *historyEntry(const Graph *graph, uint32_t handle) {
+    KPIHistory **pages = __atomic_load_n(&graph->historyPages, __ATOMIC_ACQUIRE);
+    return &pages[(handle - 1) / HISTORY_PAGE_ENTRIES][(handle - 1) % HISTORY_PAGE_ENTRIES];
+}
+
+/* the history a KPI's handle names, or NULL */
+static KPIHistory *historyOf(const Graph *graph, const KPI *k) {
+    return k->history ? historyEntry(graph, k->history) : NULL;
+}
+
+/* an unused table entry's handle (a freed one first); with a pipeline
+   open, callers hold the shared lock */
+static uint32_t historyTake(Graph *graph) {
+    uint32_t handle = graph->freeHistory;
+    if (handle) {
+        graph->freeHistory = historyEntry(graph, handle)->nextFree;
+    } else {
+        if (graph->numHistories == graph->capHistories) {
+            uint32_t page = graph->capHistories / HISTORY_PAGE_ENTRIES;
+            if (page == graph->capHistoryPages) {
+                uint32_t cap = page ? page * 2 : 4;
+                KPIHistory **pages = growShared(graph, graph->historyPages, page * sizeof(KPIHistory*),
+                                                cap * sizeof(KPIHistory*));
+                __atomic_store_n(&graph->historyPages, pages, __ATOMIC_RELEASE);
+                graph->capHistoryPages = cap;
+            }
+            graph->historyPages[page] = xrealloc(NULL, HISTORY_PAGE_ENTRIES * sizeof(KPIHistory));
+            graph->capHistories += HISTORY_PAGE_ENTRIES;
+        }
+        handle = ++graph->numHistories;
+    }
+    return handle;
+}
+
+/* an empty history from the table */
+static uint32_t historyNew(Graph *graph) {
+    uint32_t handle = stageHistoryNew(graph);
+    if (!handle) handle = historyTake(graph);
+    KPIHistory *h = historyEntry(graph, handle);
+    h->chunks = NULL;
+    h->count = 0;
+    h->capChunks = 0;
+    h->nextFree = 0;
+    return handle;
+}
+
+/* make room for one more observation (allocates the history on first use) */
+static KPIHistory *historyReserve(Graph *graph, KPI *k, int extra) {
+    if (!k->history) k->history = historyNew(graph);
+    KPIHistory *h = historyOf(graph, k);
+    int needChunks = (h->count + extra + HISTORY_CHUNK_OBS - 1) / HISTORY_CHUNK_OBS;
+    if (needChunks > h->capChunks) {
+        int cap = h->capChunks ? h->capChunks : 2;
+        while (cap < needChunks) cap *= 2;
+        h->chunks = xrealloc(h->chunks, (size_t)cap * sizeof(HistoryChunk*));
+        h->capChunks = cap;
+    }
+    int haveChunks = (h->count + HISTORY_CHUNK_OBS - 1) / HISTORY_CHUNK_OBS;
+    ObjPool *chunks = chunkPoolOf(graph);
+    for (int c = haveChunks; c < needChunks; ++c) h->chunks[c] = (HistoryChunk*)poolAlloc(chunks);
+    return h;
+}
+
+/* replace k's (empty) history with n observations already in period order */
+static void historyLoad(Graph *graph, KPI *k, const KPIObservation *obs, int n) {
+    KPIHistory *h = historyReserve(graph, k, n);
+    for (int c = 0; c * HISTORY_CHUNK_OBS < n; ++c) {
+        int m = n - c * HISTORY_CHUNK_OBS;
+        if (m > HISTORY_CHUNK_OBS) m = HISTORY_CHUNK_OBS;
+        memcpy(h->chunks[c]->obs, obs + c * HISTORY_CHUNK_OBS, (size_t)m * sizeof(KPIObservation));
+    }
+    h->count = n;
+}
+
+/* performance % of an observation (0 for a zero target, as in the reports) */
+static float obsPerf(const KPIObservation *o) {
+    return o->target != 0.0f ? (o->achieved / o->target) * 100.0f : 0.0f;
+}
+
+/* record an observation without logging it; k is the KPI if the caller
+   already knows it (NULL = look it up / create it). Returns the KPI. */
+static KPI *applyObservation(Graph *graph, PersNode *pnode, KPI *k, const char *name,
+                             int32_t period, float target, float achieved) {
+    bumpVersion(graph);
+    if (!k) k = findKPI(graph, pnode, name);
+    if (!k) k = linkKPI(graph, pnode, name, target, achieved, NULL, 0);
+    BandWatch w;
+    watchBefore(graph, pnode, k, &w);
+    KPIHistory *h = historyOf(graph, k);
+
+    int at = h ? historyFind(h, period) : -1;
+    if (at >= 0 && historyAt(h, at)->period == period) {
+        historyAt(h, at)->target = target;       /* correction of a known period */
+        historyAt(h, at)->achieved = achieved;
+    } else {
+        h = historyReserve(graph, k, 1);
+        /* late data: shift newer observations up by one (appends shift nothing) */
+        for (int i = h->count; i > at + 1; --i) *historyAt(h, i) = *historyAt(h, i - 1);
+        KPIObservation *o = historyAt(h, at + 1);
+        o->period = period;
+        o->target = target;
+        o->achieved = achieved;
+        h->count++;
+    }
+
+    /* current values follow the newest observation */
+    const KPIObservation *latest = historyAt(h, h->count - 1);
+    if (latest->target != k->target || latest->achieved != k->achieved) {
+        float oldTarget = k->target, oldAchieved = k->achieved;
+        k->target = latest->target;
+        k->achieved = latest->achieved;
+        pnode->cols.dirty = 1;
+        aggregateReplace(pnode, k, oldTarget, oldAchieved);
+        watchAfter(graph, pnode, k, &w);
+    }
+    return k;
+}
+
+/* values of k as of period: its latest observation at or before period, or
+   its current values when it has no history. Returns 0 if nothing applies. */
+static int kpiValuesAsOf(const Graph *graph, const KPI *k, int32_t period,
+                         float *target, float *achieved, int32_t *seen) {
+    const KPIHistory *h = historyOf(graph, k);
+    int at = -1;
+    if (h && period != PERIOD_LATEST) {
+        at = historyFind(h, period);
+        if (at < 0) return 0;
+    } else if (h) {
+        at = h->count - 1;
+    }
+    if (at >= 0) {
+        const KPIObservation *o = historyAt(h, at);
+        *target = o->target;
+        *achieved = o->achieved;
+        *seen = o->period;
+    } else {
+        *target = k->target;
+        *achieved = k->achieved;
+        *seen = PERIOD_LATEST;
+    }
+    return 1;
+}
+
+/* give a history's chunks and directory back; its table entry becomes unused */
+static void historyFree(Graph *graph, uint32_t handle) {
+    KPIHistory *h = historyEntry(graph, handle);
+    ObjPool *chunks = chunkPoolOf(graph);
+    for (int c = 0; c * HISTORY_CHUNK_OBS < h->count; ++c) poolFree(chunks, h->chunks[c]);
+    free(h->chunks);
+    h->chunks = NULL;
+    h->count = h->capChunks = 0;
+    if (stageHistoryFree(graph, handle)) return;
+    h->nextFree = graph->freeHistory;
+    graph->freeHistory = handle;
+}
+
+/* set a KPI's current values in place (not logged). Only for KPIs without
+   a history: theirs follow the latest observation, so callers refuse the
+   undated edit and ask for a dated one. */
+static void assignKPI(Graph *graph, PersNode *pnode, KPI *k, float target, float achieved) {
+    bumpVersion(graph);
+    if (target == k->target && achieved == k->achieved) return;
+    BandWatch w;
+    watchBefore(graph, pnode, k, &w);
+    float oldTarget = k->target, oldAchieved = k->achieved;
+    k->target = target;
+    k->achieved = achieved;
+    pnode->cols.dirty = 1;
+    aggregateReplace(pnode, k, oldTarget, oldAchieved);
+    watchAfter(graph, pnode, k, &w);
+}
+
+/* slide the live KPIs of a perspective down over the deleted slots */
+static void kpiCompact(const Graph *graph, PersNode *pnode) {
+    int n = 0;
+    for (int i = 0; i < pnode->kpiLen; ++i)
+        if (pnode->kpis[i].name) pnode->kpis[n++] = pnode->kpis[i];
+    pnode->kpiLen = n;
+    kpiIndexRebuild(graph, pnode);
+}
+
+/* remove a KPI and its history (not logged); when it shadowed an older KPI
+   of the same name, that one becomes the name's KPI again. The slot stays
+   behind as a deleted one; once those outnumber the live KPIs the array is
+   compacted (amortised O(1) per delete). */
+static void unlinkKPI(Graph *graph, PersNode *pnode, KPI *k) {
+    BandWatch w;
+    watchBefore(graph, pnode, NULL, &w);
+    bumpVersion(graph);
+    const char *name = kpiNameOf(graph, k);
+    unsigned h = hashKPIName(name);
+    KPISlot *slot = kpiSlot(graph, pnode, name, h);
+    if (slot->kpi != (uint32_t)(k - pnode->kpis) + 1) {
+        pnode->kpiShadowed--;
+    } else {
+        kpiIndexRemove(pnode, slot);
+        /* older KPIs sit further down the list, the first match is the newest */
+        for (KPI *t = pnode->kpiShadowed ? kpiNext(pnode, k) : NULL; t; t = kpiNext(pnode, t)) {
+            if (!kpiNameIs(kpiNameOf(graph, t), name)) continue;
+            slot = kpiSlot(graph, pnode, name, h);
+            slot->hash = h;
+            slot->kpi = (uint32_t)(t - pnode->kpis) + 1;
+            pnode->kpiShadowed--;
+            break;
+        }
+    }
+    pnode->kpiCount--;
+    pnode->cols.dirty = 1;
+    aggregateRemove(pnode, k->target, k->achieved);
+    watchAfter(graph, pnode, NULL, &w);
+    if (k->history) historyFree(graph, k->history);
+    k->name = 0;
+    __atomic_fetch_add(&graph->names.released, 1, __ATOMIC_RELAXED);    /* shards delete in parallel */
+    k->history = 0;
+    while (pnode->kpiLen > 0 && !pnode->kpis[pnode->kpiLen - 1].name) pnode->kpiLen--;
+    /* a KPI staged by this ingest batch is found by its slot until the merge */
+    if (pnode->kpiLen - pnode->kpiCount > pnode->kpiCount && !stagedIn(graph, pnode)) kpiCompact(graph, pnode);
+}
+
+/* ---------- Graph + mapping functions ---------- */
+
+/* initialize Graph (tables are allocated lazily on first insert) */
+void initGraph(Graph *graph) {
+    if (!graph) return;
+    graph->nodes = NULL;
+    graph->folded = NULL;
+    graph->hashes = NULL;
+    graph->pers = NULL;
+    graph->adj = NULL;
+    graph->index = NULL;
+    graph->indexCap = 0;
+    graph->numNodes = 0;
+    graph->capNodes = 0;
+    graph->numEdges = 0;
+    graph->columnar = 0;
+    graph->pool = NULL;
+    graph->format = REPORT_COLOR;
+    graph->duplicates = DUPLICATE_UPDATE;
+    graph->bandListener = NULL;
+    graph->bandContext = NULL;
+    graph->wal = NULL;
+    graph->snapshotId = graph->snapshotParent = 0;
+    graph->version = 0;
+    poolInit(&graph->persPool, sizeof(PersNode));
+    poolInit(&graph->chunkPool, sizeof(HistoryChunk));
+    memset(&graph->names, 0, sizeof(graph->names));
+    graph->historyPages = NULL;
+    graph->numHistories = graph->capHistories = graph->capHistoryPages = 0;
+    graph->freeHistory = 0;
+    graph->ingest = NULL;
+    graph->bstRoot = NULL;
+}
+
+/* FNV-1a over an already case-folded name */
+static unsigned hashName(const char *s) {
+    unsigned h = 2166136261u;
+    while (*s) { h ^= (unsigned char)*s++; h *= 16777619u; }
+    return h;
+}
+
+/* rebuild the name index with cap slots (power of two) */
+static void rehashIndex(Graph *graph, int cap) {
+    free(graph->index);
+    graph->index = xrealloc(NULL, (size_t)cap * sizeof(int));
+    memset(graph->index, 0, (size_t)cap * sizeof(int));
+    graph->indexCap = cap;
+    for (int id = 0; id < graph->numNodes; ++id) {
+        unsigned slot = graph->hashes[id] & (unsigned)(cap - 1);
+        while (graph->index[slot]) slot = (slot + 1) & (unsigned)(cap - 1);
+        graph->index[slot] = id + 1;
+    }
+}
+
+/* probe the index for a folded name; returns id or -1 */
+static int lookupFolded(const Graph *graph, const char *folded, unsigned h) {
+    if (!graph->indexCap) return -1;
+    unsigned mask = (unsigned)(graph->indexCap - 1);
+    STAT_ADD(indexLookups, 1);
+    for (unsigned slot = h & mask; graph->index[slot]; slot = (slot + 1) & mask) {
+        int id = graph->index[slot] - 1;
+        STAT_ADD(indexProbes, 1);
+        if (graph->hashes[id] == h && strcmp(graph->folded[id], folded) == 0) return id;
+    }
+    return -1;
+}
+
+/* make room for one more perspective in the per-id tables */
+static void growNodes(Graph *graph) {
+    if (graph->numNodes < graph->capNodes) return;
+    int cap = graph->capNodes ? graph->capNodes * 2 : INITIAL_PERSPECTIVE_CAPACITY;
+    graph->nodes = xrealloc(graph->nodes, (size_t)cap * sizeof(*graph->nodes));
+    graph->folded = xrealloc(graph->folded, (size_t)cap * sizeof(*graph->folded));
+    graph->hashes = xrealloc(graph->hashes, (size_t)cap * sizeof(*graph->hashes));
+    graph->pers = xrealloc(graph->pers, (size_t)cap * sizeof(*graph->pers));
+    graph->adj = xrealloc(graph->adj, (size_t)cap * sizeof(*graph->adj));
+    for (int i = graph->capNodes; i < cap; ++i) {
+        graph->adj[i].to = NULL;
+        graph->adj[i].count = graph->adj[i].cap = 0;
+    }
+    graph->capNodes = cap;
+}
+
+/* insert edge target into a sorted out-list; returns 1 if added, 0 if present */
+static int adjInsert(AdjList *a, int to) {
+    int lo = 0, hi = a->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (a->to[mid] < to) lo = mid + 1; else hi = mid;
+    }
+    if (lo < a->count && a->to[lo] == to) return 0;
+    if (a->count == a->cap) {
+        a->cap = a->cap ? a->cap * 2 : 4;
+        a->to = xrealloc(a->to, (size_t)a->cap * sizeof(int));
+    }
+    memmove(a->to + lo + 1, a->to + lo, (size_t)(a->count - lo) * sizeof(int));
+    a->to[lo] = to;
+    a->count++;
+    return 1;
+}
+
+/* return index in graph->nodes for a name (case-insensitive), or -1 */
+int findPerspective(const Graph *graph, const char *name) {
+    if (!graph || !name) return -1;
+    STAT_START(STAT_FIND_PERSPECTIVE, t0);
+    char tmp[MAX_NAME_LEN];
+    toLowerCopy(tmp, name, sizeof(tmp));
+    int id = lookupFolded(graph, tmp, hashName(tmp));
+    STAT_STOP(STAT_FIND_PERSPECTIVE, t0);
+    return id;
+}
+
+/* map a name to its id, adding it to the tables, index and BST if new */
+static int internPerspective(Graph *graph, const char *name) {
+    char folded[MAX_NAME_LEN];
+    toLowerCopy(folded, name, sizeof(folded));
+    unsigned h = hashName(folded);
+    int id = lookupFolded(graph, folded, h);
+    if (id != -1) return id; /* already mapped */
+
+    growNodes(graph);
+    id = graph->numNodes;
+    graph->version++;
+
+    /* add to mapping list (preserve original case as given) */
+    strncpy(graph->nodes[id], name, MAX_NAME_LEN-1);
+    graph->nodes[id][MAX_NAME_LEN-1] = '\0';
+    strcpy(graph->folded[id], folded);
+    graph->hashes[id] = h;
+    graph->numNodes++;
+
+    /* keep the index at most half full */
+    if (graph->numNodes * 2 > graph->indexCap) {
+        rehashIndex(graph, graph->indexCap ? graph->indexCap * 2 : INITIAL_PERSPECTIVE_CAPACITY * 2);
+    } else {
+        unsigned mask = (unsigned)(graph->indexCap - 1);
+        unsigned slot = h & mask;
+        while (graph->index[slot]) slot = (slot + 1) & mask;
+        graph->index[slot] = id + 1;
+    }
+
+    /* insert into BST as well */
+    graph->bstRoot = bst_insert(&graph->persPool, graph->bstRoot, graph->nodes[id], id,
+                                &graph->pers[id]);
+    STAT_ONLY(int depth = bst_depth(graph->bstRoot, graph->pers[id]));
+    STAT_ADD(treeInserts, 1);
+    STAT_ADD(treeInsertDepth, depth);
+    STAT_MAX(treeInsertMaxDepth, depth);
+    if (graph->wal) {
+        uint32_t rec = (uint32_t)id;
+        walPut(graph, WAL_PERSPECTIVE, &rec, sizeof(rec), graph->nodes[id], strlen(graph->nodes[id]));
+    }
+    return id;
+}
+
+/* Add perspective into mapping and BST if not present */
+void addPerspectiveIfNotExists(Graph *graph, const char *name) {
+    if (!graph || !name || name[0] == '\0') return;
+    internPerspective(graph, name);
+}
+
+/* add directed edge from->to */
+void addDependency(Graph *graph, const char *from, const char *to) {
+    if (!graph || !from || !to) return;
+    if (from[0] == '\0' || to[0] == '\0') {
+        message("Perspective names cannot be empty.\n");
+        return;
+    }
+    /* ensure both exist in mapping (and BST) */
+    int fi = internPerspective(graph, from);
+    int ti = internPerspective(graph, to);
+    if (adjInsert(&graph->adj[fi], ti)) {
+        graph->numEdges++;
+        if (graph->wal) {
+            uint32_t rec[2] = { (uint32_t)fi, (uint32_t)ti };
+            walPut(graph, WAL_DEPENDENCY, rec, sizeof(rec), NULL, 0);
+        }
+        message("Added dependency: %s -> %s\n", graph->nodes[fi], graph->nodes[ti]);
+        watchDependency(graph, fi, ti);
+    } else {
+        message("Dependency already exists: %s -> %s\n", graph->nodes[fi], graph->nodes[ti]);
+    }
+}
+
+/* ---------- KPI operations (now per-perspective inside BST) ---------- */
+
+/* interactive addKPI: prompts user for perspective and KPI; auto-creates perspective
+   only when a non-numeric name is entered (numeric input selects an existing index). */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "bsc.h"
+
+/* assignKPI + write-ahead log record */
+static void setKPIValues(Graph *graph, PersNode *pnode, KPI *k, float target, float achieved) {
+    assignKPI(graph, pnode, k, target, achieved);
+    if (graph->wal) {
+        struct { uint32_t pers; float target, achieved; } rec = { (uint32_t)pnode->id, target, achieved };
+        const char *name = kpiNameOf(graph, k);
+        walPut(graph, WAL_KPI_VALUES, &rec, sizeof(rec), name, strlen(name));
+    }
+}
+
+/* add a KPI under a duplicate policy; returns it (NULL if the policy
+   rejected it, or if updating it would overwrite its history's latest
+   observation) and sets *created */
+static KPI *putKPI(Graph *graph, PersNode *pnode, const char *name, float target, float achieved,
+                   DuplicatePolicy policy, int *created) {
+    unsigned h;
+    KPISlot *slot = kpiSlotForInsert(graph, pnode, name, &h);
+    KPI *k = policy == DUPLICATE_APPEND || !slot->kpi ? NULL : &pnode->kpis[slot->kpi - 1];
+    *created = !k;
+    if (!k) return insertKPI(graph, pnode, name, target, achieved, slot, h);
+    if (policy == DUPLICATE_REJECT || k->history) return NULL;
+    setKPIValues(graph, pnode, k, target, achieved);
+    return k;
+}
+
+/* whether putKPI refused name for its history rather than the policy */
+static int refusedForHistory(const Graph *graph, const PersNode *pnode, const char *name) {
+    const KPI *k = findKPI(graph, pnode, name);
+    return k && k->history;
+}
+
+/* perspective node and KPI for a name pair; NULL if either is unknown */
+static KPI *lookupKPINode(const Graph *graph, const char *perspective, const char *name,
+                          PersNode **pnode) {
+    if (!graph || !perspective || !name) return NULL;
+    int id = findPerspective(graph, perspective);
+    if (id < 0) return NULL;
+    *pnode = graph->pers[id];
+    return findKPI(graph, *pnode, name);
+}
+
+void addKPI(Graph *graph) {
+    if (!graph) return;
+
+    printf("\n=== Add New Key Performance Indicator (KPI) ===\n");
+
+    /* --- Step 1: Display existing perspectives --- */
+    printf("\nExisting Perspectives (count = %d):\n", graph->numNodes);
+    if (graph->numNodes == 0) {
+        printf("  (no perspectives yet — adding a new one will create it)\n");
+    } else {
+        for (int i = 0; i < graph->numNodes; ++i) {
+            printf("  %d. %s\n", i + 1, graph->nodes[i]);
+        }
+    }
+
+    /* --- Step 2: Ask for perspective name --- */
+    char perspective[MAX_NAME_LEN];
+    printf("\nEnter Perspective name (choose by number OR type perspective name): ");
+    if (!fgets(perspective, sizeof(perspective), stdin)) return;
+    perspective[strcspn(perspective, "\r\n")] = '\0';
+
+    if (perspective[0] == '\0') {
+        printf("Perspective name cannot be empty.\n");
+        return;
+    }
+
+    /* --- Step 3: Handle numeric input properly --- */
+    if (isdigit((unsigned char)perspective[0])) {
+        int idx = atoi(perspective);
+        if (idx <= 0 || idx > graph->numNodes) {
+            printf("Invalid number. Please choose a valid perspective number.\n");
+            return;
+        }
+        strcpy(perspective, graph->nodes[idx - 1]);
+    } else {
+        /* Reject digits in perspective names */
+        for (char *p = perspective; *p; ++p) {
+            if (isdigit((unsigned char)*p)) {
+                printf("Perspective names cannot contain digits.\n");
+                return;
+            }
+        }
+        addPerspectiveIfNotExists(graph, perspective);
+    }
+
+    /* --- Step 4: Input KPI details --- */
+    char kpiName[MAX_KPI_NAME_LEN];
+    float target, achieved;
+
+    printf("Enter full name of the Key Performance Indicator: ");
+    if (!fgets(kpiName, sizeof(kpiName), stdin)) return;
+    kpiName[strcspn(kpiName, "\r\n")] = '\0';
+    if (kpiName[0] == '\0') {
+        printf("KPI name cannot be empty.\n");
+        return;
+    }
+
+    printf("Enter Target value (1-100): ");
+
+    if (scanf("%f", &target) != 1 || !validTarget(target)) {
+        printf("Invalid target. Must be between 1 and 100.\n");
+        discardLine();
+        return;
+    }
+
+    printf("Enter Achieved value (can exceed target if performance is high): ");
+    if (scanf("%f", &achieved) != 1 || !validAchieved(achieved)) {
+        printf("Invalid achieved value.\n");
+        discardLine();
+        return;
+    }
+    discardLine(); // clear buffer
+
+    /* --- Step 5: Add KPI node --- */
+    int id = findPerspective(graph, perspective);
+    if (id == -1) {
+        printf("Unexpected error: perspective not found.\n");
+        return;
+    }
+
+    int created;
+    if (!putKPI(graph, graph->pers[id], kpiName, target, achieved, graph->duplicates, &created)) {
+        if (refusedForHistory(graph, graph->pers[id], kpiName))
+            printf("'%s' under '%s' has a history; record its new values for a period instead.\n",
+                   kpiName, perspective);
+        else
+            printf("A Key Performance Indicator named '%s' already exists under '%s'.\n", kpiName, perspective);
+        return;
+    }
+
+    if (created) printf("\n Key Performance Indicator added successfully under '%s'.\n", perspective);
+    else printf("\n Key Performance Indicator '%s' updated under '%s'.\n", kpiName, perspective);
+}
+
+int addKPIRecord(Graph *graph, const char *perspective, const char *name,
+                 float target, float achieved) {
+    if (!graph || !perspective || !name) return -1;
+    if (perspective[0] == '\0' || containsDigit(perspective)) return -1;
+    if (!validKPIName(name) || !validTarget(target) || !validAchieved(achieved)) return -1;
+    int id = internPerspective(graph, perspective);
+    int created;
+    return putKPI(graph, graph->pers[id], name, target, achieved, graph->duplicates, &created) ? 0 : -1;
+}
+
+void setDuplicatePolicy(Graph *graph, DuplicatePolicy policy) {
+    if (graph) graph->duplicates = policy;
+}
+
+int parseDuplicatePolicy(const char *name) {
+    if (!name) return -1;
+    if (strcmp_ci(name, "update") == 0) return DUPLICATE_UPDATE;
+    if (strcmp_ci(name, "reject") == 0) return DUPLICATE_REJECT;
+    if (strcmp_ci(name, "append") == 0) return DUPLICATE_APPEND;
+    return -1;
+}
+
+const KPI *lookupKPI(const Graph *graph, const char *perspective, const char *name) {
+    PersNode *pnode;
+    return lookupKPINode(graph, perspective, name, &pnode);
+}
+
+int upsertKPI(Graph *graph, const char *perspective, const char *name,
+              float target, float achieved) {
+    if (!graph || !perspective || !name) return -1;
+    if (perspective[0] == '\0' || containsDigit(perspective)) return -1;
+    if (!validKPIName(name) || !validTarget(target) || !validAchieved(achieved)) return -1;
+    int id = internPerspective(graph, perspective);
+    int created;
+    if (!putKPI(graph, graph->pers[id], name, target, achieved, DUPLICATE_UPDATE, &created)) return -1;
+    return created;
+}
+
+int updateKPIAchieved(Graph *graph, const char *perspective, const char *name, float achieved) {
+    PersNode *pnode;
+    KPI *k = lookupKPINode(graph, perspective, name, &pnode);
+    if (!k || k->history || !validAchieved(achieved)) return -1;
+    setKPIValues(graph, pnode, k, k->target, achieved);
+    return 0;
+}
+
+/* unlinkKPI + write-ahead log record */
+static void removeKPI(Graph *graph, PersNode *pnode, KPI *k) {
+    if (graph->wal) {
+        uint32_t rec = (uint32_t)pnode->id;
+        const char *stored = kpiNameOf(graph, k);
+        walPut(graph, WAL_KPI_DELETE, &rec, sizeof(rec), stored, strlen(stored));
+    }
+    unlinkKPI(graph, pnode, k);
+}
+
+int deleteKPI(Graph *graph, const char *perspective, const char *name) {
+    PersNode *pnode;
+    KPI *k = lookupKPINode(graph, perspective, name, &pnode);
+    if (!k) return -1;
+    removeKPI(graph, pnode, k);
+    return 0;
+}
+
+/* applyObservation + write-ahead log record */
+static KPI *recordObservation(Graph *graph, PersNode *pnode, KPI *k, const char *name,
+                              int32_t period, float target, float achieved) {
+    k = applyObservation(graph, pnode, k, name, period, target, achieved);
+    if (graph->wal) {
+        struct { uint32_t pers; int32_t period; float target, achieved; } rec =
+            { (uint32_t)pnode->id, period, target, achieved };
+        const char *stored = kpiNameOf(graph, k);
+        walPut(graph, WAL_OBSERVATION, &rec, sizeof(rec), stored, strlen(stored));
+    }
+    return k;
+}
+
+int recordKPIObservation(Graph *graph, const char *perspective, const char *name,
+                         int32_t period, float target, float achieved) {
+    if (!graph || !perspective || !name) return -1;
+    if (perspective[0] == '\0' || containsDigit(perspective)) return -1;
+    if (!validKPIName(name) || !validTarget(target) || !validAchieved(achieved)) return -1;
+    if (period < 0 || period == PERIOD_LATEST) return -1;
+    int id = internPerspective(graph, perspective);
+    recordObservation(graph, graph->pers[id], NULL, name, period, target, achieved);
+    return 0;
+}
+
+/* mean performance of observations [from, to) */
+static float windowAverage(const KPIHistory *h, int from, int to) {
+    double sum = 0.0;
+    for (int i = from; i < to; ++i) sum += obsPerf(historyAt(h, i));
+    return to > from ? (float)(sum / (to - from)) : 0.0f;
+}
+
+int kpiTrend(const Graph *graph, const char *perspective, const char *name,
+             int32_t asOf, int window, KPITrend *out) {
+    if (!graph || !perspective || !name || !out || window < 1) return -1;
+    memset(out, 0, sizeof(*out));
+    int id = findPerspective(graph, perspective);
+    const KPI *k = id >= 0 ? findKPI(graph, graph->pers[id], name) : NULL;
+    const KPIHistory *h = k ? historyOf(graph, k) : NULL;
+    if (!h) return -1;
+    int end = historyFind(h, asOf) + 1;       /* window is [start, end) */
+    if (end == 0) return -1;
+    int start = end > window ? end - window : 0;
+    int n = end - start;
+
+    /* average and least-squares slope against the observation index */
+    double sy = 0.0, sxy = 0.0;
+    for (int i = 0; i < n; ++i) {
+        double y = obsPerf(historyAt(h, start + i));
+        sy += y;
+        sxy += (double)i * y;
+    }
+    double sx = (double)n * (n - 1) / 2.0;
+    double sxx = (double)(n - 1) * n * (2 * n - 1) / 6.0;
+    double den = n * sxx - sx * sx;
+    out->samples = n;
+    out->firstPeriod = historyAt(h, start)->period;
+    out->lastPeriod = historyAt(h, end - 1)->period;
+    out->average = (float)(sy / n);
+    out->slope = den > 0.0 ? (float)((n * sxy - sx * sy) / den) : 0.0f;
+
+    int prevStart = start > window ? start - window : 0;
+    out->prevSamples = start - prevStart;
+    if (out->prevSamples > 0) {
+        out->prevAverage = windowAverage(h, prevStart, start);
+        out->change = out->average - out->prevAverage;
+    }
+    return 0;
+}
+
+void showKPITrend(const Graph *graph, const char *perspective, const char *name,
+                  int32_t asOf, int window) {
+    KPITrend t;
+    if (kpiTrend(graph, perspective, name, asOf, window, &t) != 0) {
+        printf("No history for '%s' in '%s'%s.\n", name, perspective,
+               asOf == PERIOD_LATEST ? "" : " up to that period");
+        return;
+    }
+    printf("\nTrend for '%s' (%s), periods %d..%d (%d observation%s):\n",
+           name, perspective, (int)t.firstPeriod, (int)t.lastPeriod, t.samples, t.samples == 1 ? "" : "s");
+    printf("  Rolling average : %.2f%%\n", t.average);
+    printf("  Trend           : %+.2f points per observation\n", t.slope);
+    if (t.prevSamples > 0)
+        printf("  Previous window : %.2f%% (%+.2f points)\n", t.prevAverage, t.change);
+    else
+        printf("  Previous window : (no earlier observations)\n");
+}
+
+
+/* ---------- Report rendering ---------- */
+
+/* Reports are formatted into a buffer that is kept between reports and
+   written to stdout with a single write(). Each thread has its own buffer,
+   so the query server's readers render concurrently; while a thread
+   captures (see beginReportCapture) rbFlush leaves the report in it. */
+typedef struct ReportBuf {
+    char *data;
+    size_t len;
+    size_t cap;
+} ReportBuf;
+
+static THREAD_LOCAL ReportBuf reportBuf;
+static THREAD_LOCAL int reportCapture;
+
+static const char *const bandNames[BAND_COUNT] = { "red", "amber", "green", "blue" };
+static const char *const bandColours[BAND_COUNT] = { ANSI_RED, ANSI_YELLOW, ANSI_GREEN, ANSI_BLUE };
+
+/* band of a performance %, same cut-offs as the report colours */
+static PerfBand perfBand(float perf) {
+    if (perf > 100.0f) return BAND_BLUE;         /* More than 100% */
+    if (perf >= 80.0f) return BAND_GREEN;        /* Meeting expectation */
+    if (perf >= 20.0f) return BAND_AMBER;        /* Amber (20% - 79.99%) */
+    return BAND_RED;                             /* < 20% */
+}
+
+static void rbReserve(size_t extra) {
+    ReportBuf *b = &reportBuf;
+    if (b->len + extra <= b->cap) return;
+    size_t cap = b->cap ? b->cap : 64 * 1024;
+    while (cap < b->len + extra) cap *= 2;
+    b->data = xrealloc(b->data, cap);
+    b->cap = cap;
+}
+
+static void rbPut(const char *s, size_t n) {
+    rbReserve(n);
+    memcpy(reportBuf.data + reportBuf.len, s, n);
+    reportBuf.len += n;
+}
+
+static void rbStr(const char *s) { rbPut(s, strlen(s)); }
+
+static void rbPrintf(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(reportBuf.data + reportBuf.len, reportBuf.cap - reportBuf.len, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n >= reportBuf.cap - reportBuf.len) {
+        rbReserve((size_t)n + 1);
+        va_start(ap, fmt);
+        vsnprintf(reportBuf.data + reportBuf.len, reportBuf.cap - reportBuf.len, fmt, ap);
+        va_end(ap);
+    }
+    reportBuf.len += (size_t)n;
+}
+
+/* "%.2f" without going through printf. A float times 100 is exact in a
+   double, so rounding it half to even (as printf does) gives the same
+   digits; anything unusual falls back to snprintf. */
+static void rbFixed2(float v) {
+    double x = (double)v * 100.0;
+    if (!(x >= 0.0 && x < 1e15)) { rbPrintf("%.2f", v); return; }
+    long long c = (long long)x;
+    double frac = x - (double)c;
+    if (frac > 0.5 || (frac == 0.5 && (c & 1))) c++;
+    char tmp[24];
+    int i = sizeof(tmp);
+    tmp[--i] = (char)('0' + c % 10); c /= 10;
+    tmp[--i] = (char)('0' + c % 10); c /= 10;
+    tmp[--i] = '.';
+    do { tmp[--i] = (char)('0' + c % 10); c /= 10; } while (c);
+    rbPut(tmp + i, sizeof(tmp) - (size_t)i);
+}
+
+static void rbInt(long v) { rbPrintf("%ld", v); }
+
+static void rbJsonStr(const char *s) {
+    rbPut("\"", 1);
+    for (; *s; ++s) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') { char e[2] = { '\\', (char)c }; rbPut(e, 2); }
+        else if (c < 0x20) rbPrintf("\\u%04x", c);
+        else rbPut(s, 1);
+    }
+    rbPut("\"", 1);
+}
+
+/* CSV field, quoted when needed (the loader reads the same quoting back) */
+static void rbCsvStr(const char *s) {
+    if (!strpbrk(s, ",\"\r\n")) { rbStr(s); return; }
+    rbPut("\"", 1);
+    for (; *s; ++s) {
+        if (*s == '"') rbPut("\"", 1);
+        rbPut(s, 1);
+    }
+    rbPut("\"", 1);
+}
+
+/* write the buffered report to stdout in one call and reset the buffer */
+static void rbFlush(void) {
+    if (reportCapture) return;
+    fflush(stdout);                 /* keep earlier printf output in front */
+    const char *p = reportBuf.data;
+    size_t left = reportBuf.len;
+    while (left > 0) {
+#ifdef _WIN32
+        int n = _write(1, p, left > 0x40000000u ? 0x40000000u : (unsigned)left);
+#else
+        ssize_t n = write(1, p, left);
+#endif
+        if (n <= 0) { perror("write"); break; }
+        p += n;
+        left -= (size_t)n;
+    }
+    reportBuf.len = 0;
+}
+
+/* reports rendered from here on stay in this thread's buffer */
+static void beginReportCapture(void) {
+    reportBuf.len = 0;
+    reportCapture = 1;
+}
+
+/* the captured text (valid until the thread's next report) */
+static const char *endReportCapture(size_t *len) {
+    reportCapture = 0;
+    *len = reportBuf.len;
+    reportBuf.len = 0;
+    return reportBuf.data ? reportBuf.data : "";
+}
+
+/* release the calling thread's buffer (before a thread exits) */
+static void rbRelease(void) {
+    free(reportBuf.data);
+    reportBuf.data = NULL;
+    reportBuf.len = reportBuf.cap = 0;
+}
+
+/* colour code for a band, or "" when colours are off */
+static const char *bandColour(const Graph *graph, PerfBand band) {
+    return graph->format == REPORT_COLOR ? bandColours[band] : "";
+}
+
+static const char *colourReset(const Graph *graph) {
+    return graph->format == REPORT_COLOR ? ANSI_RESET : "";
+}
+
+void setReportFormat(Graph *graph, ReportFormat format) {
+    if (graph && format >= REPORT_COLOR && format <= REPORT_CSV) graph->format = format;
+}
+
+int parseReportFormat(const char *name) {
+    static const char *const names[] = { "color", "plain", "json", "csv" };
+    if (!name) return -1;
+    for (int i = 0; i < 4; ++i)
+        if (strcmp_ci(name, names[i]) == 0) return i;
+    if (strcmp_ci(name, "colour") == 0 || strcmp_ci(name, "text") == 0) return REPORT_COLOR;
+    return -1;
+}
+
+/* renders one perspective's KPIs as of a period, read through a cursor */
+#define REPORT_BATCH 256
+
+static void renderPerspectiveKPIs(const Graph *graph, int id, int32_t period, int first) {
+    ReportFormat fmt = graph->format;
+    const char *pname = perspectiveName(graph, id);
+
+    if (fmt == REPORT_JSON) {
+        rbStr(first ? "\n  {\"name\": " : ",\n  {\"name\": ");
+        rbJsonStr(pname);
+        rbStr(", \"kpis\": [");
+    } else if (fmt != REPORT_CSV) {
+        rbStr("\nPerspective: ");
+        rbStr(pname);
+        rbStr("\n");
+        if (!graph->pers[id]->kpiCount) rbStr("  (No Key Performance Indicators yet)\n");
+    }
+
+    KPICursor cur;
+    KPIResult batch[REPORT_BATCH];
+    int firstKpi = 1, n;
+    openKPICursor(graph, id, period, &cur);
+    while ((n = readKPIs(&cur, batch, REPORT_BATCH)) > 0) {
+        for (int i = 0; i < n; ++i) {
+            const KPIResult *r = &batch[i];
+            if (fmt == REPORT_JSON) {
+                rbStr(firstKpi ? "\n    {\"name\": " : ",\n    {\"name\": ");
+                rbJsonStr(r->name);
+                if (r->hasValue) {
+                    rbStr(", \"target\": "); rbFixed2(r->target);
+                    rbStr(", \"achieved\": "); rbFixed2(r->achieved);
+                    rbStr(", \"performance\": "); rbFixed2(r->performance);
+                    rbStr(", \"band\": \""); rbStr(bandNames[r->band]); rbStr("\"");
+                    rbStr(", \"period\": ");
+                    if (r->period != PERIOD_LATEST) rbInt(r->period); else rbStr("null");
+                } else {
+                    rbStr(", \"target\": null, \"achieved\": null, \"performance\": null, \"band\": null, \"period\": null");
+                }
+                rbStr("}");
+            } else if (fmt == REPORT_CSV) {
+                rbCsvStr(pname); rbStr(",");
+                rbCsvStr(r->name); rbStr(",");
+                if (r->hasValue) {
+                    rbFixed2(r->target); rbStr(",");
+                    rbFixed2(r->achieved); rbStr(",");
+                    rbFixed2(r->performance); rbStr(",");
+                    rbStr(bandNames[r->band]); rbStr(",");
+                    if (r->period != PERIOD_LATEST) rbInt(r->period);
+                } else {
+                    rbStr(",,,,");
+                }
+                rbStr("\n");
+            } else if (!r->hasValue) {
+                rbStr("  - "); rbStr(r->name);
+                rbPrintf(" | (no observation at or before period %d)\n", (int)period);
+            } else {
+                rbStr("  - "); rbStr(r->name);
+                rbStr(" | Target: "); rbFixed2(r->target);
+                rbStr(" | Achieved: "); rbFixed2(r->achieved);
+                rbStr(" | Performance: "); rbStr(bandColour(graph, r->band));
+                rbFixed2(r->performance); rbStr("%"); rbStr(colourReset(graph));
+                if (r->period != PERIOD_LATEST) { rbStr(" | Period: "); rbInt(r->period); }
+                rbStr("\n");
+            }
+            firstKpi = 0;
+        }
+    }
+    if (fmt == REPORT_JSON) rbStr(firstKpi ? "]}" : "\n  ]}");
+}
+
+/* heading / framing around the perspectives, visited in name order */
+static void renderKPIs(const Graph *graph, int32_t period, const char *heading) {
+    STAT_START(STAT_RENDER, t0);
+    if (graph->format == REPORT_JSON) {
+        rbStr("{\"report\": \"scorecard\", \"period\": ");
+        if (period != PERIOD_LATEST) rbInt(period); else rbStr("null");
+        rbStr(", \"perspectives\": [");
+    } else if (graph->format == REPORT_CSV) {
+        rbStr("perspective,kpi,target,achieved,performance,band,period\n");
+    } else if (heading) {
+        rbStr(heading);
+    }
+    int first = 1;
+    for (int id = nextPerspectiveByName(graph, -1); id != -1; id = nextPerspectiveByName(graph, id)) {
+        renderPerspectiveKPIs(graph, id, period, first);
+        first = 0;
+    }
+    if (graph->format == REPORT_JSON) rbStr(first ? "]}\n" : "\n]}\n");
+    rbFlush();
+    STAT_STOP(STAT_RENDER, t0);
+}
+
+/* display all KPIs by traversing BST inorder and printing each node's KPIs */
+void displayKPIs(const Graph *graph) {
+    if (!graph) return;
+    if (!graph->bstRoot && graph->format <= REPORT_PLAIN) {
+        rbStr("No perspectives / Key Performance Indicators defined yet.\n");
+        rbFlush();
+        return;
+    }
+    renderKPIs(graph, PERIOD_LATEST, NULL);
+}
+
+/* Generate scorecard: simple list of KPI performances by visiting BST */
+void generateScorecard(const Graph *graph) {
+    generateScorecardForPeriod(graph, PERIOD_LATEST);
+}
+
+void generateScorecardForPeriod(const Graph *graph, int32_t period) {
+    if (!graph) return;
+    if (!graph->bstRoot && graph->format <= REPORT_PLAIN) {
+        rbStr("No data to generate scorecard.\n");
+        rbFlush();
+        return;
+    }
+
+    char heading[128];
+    if (period == PERIOD_LATEST)
+        snprintf(heading, sizeof(heading), "\n=== Scorecard (per Key Performance Indicator performance) ===\n");
+    else
+        snprintf(heading, sizeof(heading), "\n=== Scorecard for period %d (per Key Performance Indicator performance) ===\n", (int)period);
+    renderKPIs(graph, period, heading);
+}
+
+/* Display adjacency list of dependencies. CSV has a row per edge, and one
+   with an empty "to" for a perspective without edges. */
+void showDependencies(const Graph *graph) {
+    if (!graph) return;
+    ReportFormat fmt = graph->format;
+    if (fmt == REPORT_JSON) rbStr("{\"report\": \"dependencies\", \"perspectives\": [");
+    else if (fmt == REPORT_CSV) rbStr("perspective,to\n");
+    else rbStr("\n--- Perspective Dependencies ---\n");
+    if (graph->numNodes == 0 && fmt <= REPORT_PLAIN) rbStr("  (no perspectives defined)\n");
+    int to[64];
+    for (int i = 0; i < graph->numNodes; ++i) {
+        if (fmt == REPORT_JSON) {
+            rbStr(i ? ",\n  {\"name\": " : "\n  {\"name\": ");
+            rbJsonStr(graph->nodes[i]);
+            rbStr(", \"to\": [");
+        } else if (fmt != REPORT_CSV) {
+            rbStr(graph->nodes[i]);
+            rbStr(" -> ");
+        }
+        int total = queryDependencies(graph, i, 0, to, 64);
+        for (int e = 0; e < total; ++e) {
+            if (e && e % 64 == 0) queryDependencies(graph, i, e, to, 64);
+            const char *name = graph->nodes[to[e % 64]];
+            if (fmt == REPORT_JSON) {
+                if (e) rbStr(", ");
+                rbJsonStr(name);
+            } else if (fmt == REPORT_CSV) {
+                rbCsvStr(graph->nodes[i]); rbStr(","); rbCsvStr(name); rbStr("\n");
+            } else {
+                if (e) rbStr(", ");
+                rbStr(name);
+            }
+        }
+        if (fmt == REPORT_JSON) {
+            rbStr("]}");
+        } else if (fmt == REPORT_CSV) {
+            if (total == 0) { rbCsvStr(graph->nodes[i]); rbStr(",\n"); }
+        } else {
+            if (total == 0) rbStr("None");
+            rbStr("\n");
+        }
+    }
+    if (fmt == REPORT_JSON) rbStr(graph->numNodes ? "\n]}\n" : "]}\n");
+    rbFlush();
+}
+
+/* ---------- Band alerts ---------- */
+
+/* band of a perspective's current average, computed like the evaluation
+   report does; -1 when no KPI counts */
+static int averageBand(const PersNode *pnode, float *average) {
+    if (pnode->perfCount == 0) { *average = 0.0f; return -1; }
+    *average = perfAverage(pnode->perfSum, pnode->perfCount);
+    return perfBand(*average);
+}
+
+/* does the evaluation report impact edges out of a perspective with this average? */
+static int averageImpacts(int band, float average) {
+    return band != -1 && average > 0.0f && average < 80.0f;
+}
+
+static float kpiCurrentPerf(const KPI *k) {
+    return k->target != 0.0f ? (k->achieved / k->target) * 100.0f : 0.0f;
+}
+
+static void watchBefore(const Graph *graph, const PersNode *pnode, const KPI *k, BandWatch *w) {
+    w->active = graph->bandListener != NULL;
+    if (!w->active) return;
+    w->kpiBand = -1;
+    if (k) {
+        w->kpiPerf = kpiCurrentPerf(k);
+        w->kpiBand = perfBand(w->kpiPerf);
+    }
+    w->persBand = averageBand(pnode, &w->persAverage);
+}
+
+static void emitBandEvent(Graph *graph, BandEventKind kind, int perspective, const char *kpi,
+                          int affected, int from, int to, float before, float after) {
+    BandEvent ev = { kind, perspective, kpi, affected, from, to, before, after };
+    if (!stageBandEvent(graph, &ev)) graph->bandListener(graph, &ev, graph->bandContext);
+}
+
+/* Compare with the watch: the KPI's band, the perspective's band and,
+   when the average crossed the impact threshold, one event per dependency
+   edge leaving the perspective. O(out-degree), whatever the graph size. */
+static void watchAfter(Graph *graph, const PersNode *pnode, const KPI *k, const BandWatch *w) {
+    if (!w->active || !graph->bandListener) return;
+    if (k && w->kpiBand != -1) {
+        float perf = kpiCurrentPerf(k);
+        int band = perfBand(perf);
+        if (band != w->kpiBand)
+            emitBandEvent(graph, BAND_EVENT_KPI, pnode->id, kpiNameOf(graph, k), -1, w->kpiBand, band,
+                          w->kpiPerf, perf);
+    }
+    float average;
+    int band = averageBand(pnode, &average);
+    if (band != w->persBand)
+        emitBandEvent(graph, BAND_EVENT_PERSPECTIVE, pnode->id, NULL, -1, w->persBand, band, w->persAverage, average);
+    int was = averageImpacts(w->persBand, w->persAverage), is = averageImpacts(band, average);
+    if (was == is) return;
+    const AdjList *a = &graph->adj[pnode->id];
+    for (int e = 0; e < a->count; ++e)
+        emitBandEvent(graph, is ? BAND_EVENT_IMPACT : BAND_EVENT_IMPACT_CLEARED, pnode->id, NULL, a->to[e],
+                      w->persBand, band, w->persAverage, average);
+}
+
+/* a new edge out of a weak perspective is a new impact */
+static void watchDependency(Graph *graph, int from, int to) {
+    if (!graph->bandListener) return;
+    float average;
+    int band = averageBand(graph->pers[from], &average);
+    if (averageImpacts(band, average))
+        emitBandEvent(graph, BAND_EVENT_IMPACT, from, NULL, to, band, band, average, average);
+}
+
+void setBandListener(Graph *graph, BandListener listener, void *context) {
+    if (!graph) return;
+    graph->bandListener = listener;
+    graph->bandContext = context;
+}
+
+void showBandEvent(const Graph *graph, const BandEvent *ev) {
+    static const char *const kinds[] = { "kpi", "perspective", "impact", "impact-cleared" };
+    if (!graph || !ev) return;
+    const char *pname = graph->nodes[ev->perspective];
+    const char *affected = ev->affected >= 0 ? graph->nodes[ev->affected] : NULL;
+
+    switch (graph->format) {
+    case REPORT_JSON:
+        rbStr("{\"event\": \""); rbStr(kinds[ev->kind]);
+        rbStr("\", \"perspective\": "); rbJsonStr(pname);
+        if (ev->kpi) { rbStr(", \"kpi\": "); rbJsonStr(ev->kpi); }
+        if (affected) { rbStr(", \"affected\": "); rbJsonStr(affected); }
+        rbStr(", \"from\": ");
+        if (ev->from != -1) { rbStr("\""); rbStr(bandNames[ev->from]); rbStr("\""); } else rbStr("null");
+        rbStr(", \"to\": ");
+        if (ev->to != -1) { rbStr("\""); rbStr(bandNames[ev->to]); rbStr("\""); } else rbStr("null");
+        rbStr(", \"before\": ");
+        if (ev->from != -1) rbFixed2(ev->before); else rbStr("null");
+        rbStr(", \"after\": ");
+        if (ev->to != -1) rbFixed2(ev->after); else rbStr("null");
+        rbStr("}\n");
+        break;
+
+    case REPORT_CSV:
+        /* event,perspective,kpi,affected,from,to,before,after */
+        rbStr(kinds[ev->kind]); rbStr(",");
+        rbCsvStr(pname); rbStr(",");
+        if (ev->kpi) rbCsvStr(ev->kpi);
+        rbStr(",");
+        if (affected) rbCsvStr(affected);
+        rbStr(",");
+        if (ev->from != -1) rbStr(bandNames[ev->from]);
+        rbStr(",");
+        if (ev->to != -1) rbStr(bandNames[ev->to]);
+        rbStr(",");
+        if (ev->from != -1) rbFixed2(ev->before);
+        rbStr(",");
+        if (ev->to != -1) rbFixed2(ev->after);
+        rbStr("\n");
+        break;
+
+    default: {
+        const char *on = ev->to != -1 ? bandColour(graph, (PerfBand)ev->to) : "";
+        const char *off = ev->to != -1 ? colourReset(graph) : "";
+        rbStr(on);
+        rbStr("Alert: ");
+        if (ev->kind == BAND_EVENT_KPI) {
+            rbStr("KPI '"); rbStr(ev->kpi); rbStr("' in "); rbStr(pname);
+        } else if (ev->kind == BAND_EVENT_PERSPECTIVE) {
+            rbStr(pname); rbStr(" average");
+        }
+        if (ev->kind == BAND_EVENT_IMPACT) {
+            rbStr("low performance in "); rbStr(pname); rbStr(" (");
+            rbFixed2(ev->after); rbStr("%) may now affect "); rbStr(affected); rbStr(".");
+        } else if (ev->kind == BAND_EVENT_IMPACT_CLEARED) {
+            rbStr(pname); rbStr(" ("); if (ev->to != -1) { rbFixed2(ev->after); rbStr("%"); } else rbStr("no data");
+            rbStr(") no longer affects "); rbStr(affected); rbStr(".");
+        } else if (ev->from == -1) {
+            rbStr(" is now "); rbStr(bandNames[ev->to]); rbStr(" ("); rbFixed2(ev->after); rbStr("%).");
+        } else if (ev->to == -1) {
+            rbStr(" has no KPI data any more (was "); rbStr(bandNames[ev->from]); rbStr(").");
+        } else {
+            rbStr(" moved "); rbStr(bandNames[ev->from]); rbStr(" -> "); rbStr(bandNames[ev->to]);
+            rbStr(" ("); rbFixed2(ev->before); rbStr("% -> "); rbFixed2(ev->after); rbStr("%).");
+        }
+        rbStr(off);
+        rbStr("\n");
+        break;
+    }
+    }
+    rbFlush();
+}
+
+/* ---------- Columnar KPI store + ratio kernel ---------- */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BSC_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/* cumulative threshold counts -> disjoint band counts */
+static void finishBands(KPIBatchStats *out, int valid, int ge20, int ge80, int gt100) {
+    out->count = valid;
+    out->bands[BAND_BLUE] = gt100;
+    out->bands[BAND_GREEN] = ge80 - gt100;
+    out->bands[BAND_AMBER] = ge20 - ge80;
+    out->bands[BAND_RED] = valid - ge20;
+}
+
+static void kernelScalar(const float *t, const float *a, int n, float *perfOut, KPIBatchStats *out) {
+    double sum = 0.0;
+    int valid = 0, ge20 = 0, ge80 = 0, gt100 = 0;
+    for (int i = 0; i < n; ++i) {
+        float perf = 0.0f;
+        if (t[i] != 0.0f) {
+            perf = (a[i] / t[i]) * 100.0f;
+            sum += perf;
+            valid++;
+            ge20 += perf >= 20.0f;
+            ge80 += perf >= 80.0f;
+            gt100 += perf > 100.0f;
+        }
+        if (perfOut) perfOut[i] = perf;
+    }
+    out->sumPerf = sum;
+    finishBands(out, valid, ge20, ge80, gt100);
+}
+
+#ifdef BSC_X86_KERNELS
+__attribute__((target("sse2")))
+static void kernelSSE2(const float *t, const float *a, int n, float *perfOut, KPIBatchStats *out) {
+    const __m128 zero = _mm_setzero_ps(), hundred = _mm_set1_ps(100.0f);
+    const __m128 c20 = _mm_set1_ps(20.0f), c80 = _mm_set1_ps(80.0f);
+    __m128d sum = _mm_setzero_pd();
+    int valid = 0, ge20 = 0, ge80 = 0, gt100 = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 vt = _mm_loadu_ps(t + i), va = _mm_loadu_ps(a + i);
+        __m128 ok = _mm_cmpneq_ps(vt, zero);
+        __m128 perf = _mm_and_ps(_mm_mul_ps(_mm_div_ps(va, vt), hundred), ok);
+        if (perfOut) _mm_storeu_ps(perfOut + i, perf);
+        sum = _mm_add_pd(sum, _mm_cvtps_pd(perf));
+        sum = _mm_add_pd(sum, _mm_cvtps_pd(_mm_movehl_ps(perf, perf)));
+        valid += __builtin_popcount((unsigned)_mm_movemask_ps(ok));
+        ge20 += __builtin_popcount((unsigned)_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(perf, c20), ok)));
+        ge80 += __builtin_popcount((unsigned)_mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(perf, c80), ok)));
+        gt100 += __builtin_popcount((unsigned)_mm_movemask_ps(_mm_cmpgt_ps(perf, hundred)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    KPIBatchStats tail;
+    kernelScalar(t + i, a + i, n - i, perfOut ? perfOut + i : NULL, &tail);
+    out->sumPerf = lanes[0] + lanes[1] + tail.sumPerf;
+    finishBands(out, valid + tail.count,
+                ge20 + tail.count - tail.bands[BAND_RED],
+                ge80 + tail.bands[BAND_GREEN] + tail.bands[BAND_BLUE],
+                gt100 + tail.bands[BAND_BLUE]);
+}
+
+__attribute__((target("avx2")))
+static void kernelAVX2(const float *t, const float *a, int n, float *perfOut, KPIBatchStats *out) {
+    const __m256 zero = _mm256_setzero_ps(), hundred = _mm256_set1_ps(100.0f);
+    const __m256 c20 = _mm256_set1_ps(20.0f), c80 = _mm256_set1_ps(80.0f);
+    __m256d sumLo = _mm256_setzero_pd(), sumHi = _mm256_setzero_pd();
+    int valid = 0, ge20 = 0, ge80 = 0, gt100 = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 vt = _mm256_loadu_ps(t + i), va = _mm256_loadu_ps(a + i);
+        __m256 ok = _mm256_cmp_ps(vt, zero, _CMP_NEQ_UQ);
+        __m256 perf = _mm256_and_ps(_mm256_mul_ps(_mm256_div_ps(va, vt), hundred), ok);
+        if (perfOut) _mm256_storeu_ps(perfOut + i, perf);
+        sumLo = _mm256_add_pd(sumLo, _mm256_cvtps_pd(_mm256_castps256_ps128(perf)));
+        sumHi = _mm256_add_pd(sumHi, _mm256_cvtps_pd(_mm256_extractf128_ps(perf, 1)));
+        valid += __builtin_popcount((unsigned)_mm256_movemask_ps(ok));
+        ge20 += __builtin_popcount((unsigned)_mm256_movemask_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(perf, c20, _CMP_GE_OQ), ok)));
+        ge80 += __builtin_popcount((unsigned)_mm256_movemask_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(perf, c80, _CMP_GE_OQ), ok)));
+        gt100 += __builtin_popcount((unsigned)_mm256_movemask_ps(
+                    _mm256_cmp_ps(perf, hundred, _CMP_GT_OQ)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sumLo, sumHi));
+    KPIBatchStats tail;
+    kernelScalar(t + i, a + i, n - i, perfOut ? perfOut + i : NULL, &tail);
+    out->sumPerf = lanes[0] + lanes[1] + lanes[2] + lanes[3] + tail.sumPerf;
+    finishBands(out, valid + tail.count,
+                ge20 + tail.count - tail.bands[BAND_RED],
+                ge80 + tail.bands[BAND_GREEN] + tail.bands[BAND_BLUE],
+                gt100 + tail.bands[BAND_BLUE]);
+}
+#endif
+
+typedef void (*PerfKernelFn)(const float *, const float *, int, float *, KPIBatchStats *);
+static PerfKernelFn perfKernel = NULL;
+static const char *perfKernelName = "scalar";
+
+/* pick the widest kernel this CPU supports (once) */
+static void selectKernel(void) {
+    if (perfKernel) return;
+    perfKernel = kernelScalar;
+#ifdef BSC_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) { perfKernel = kernelAVX2; perfKernelName = "avx2"; }
+    else if (__builtin_cpu_supports("sse2")) { perfKernel = kernelSSE2; perfKernelName = "sse2"; }
+#endif
+}
+
+void kpiPerfKernel(const float *target, const float *achieved, int n,
+                   float *perfOut, KPIBatchStats *out) {
+    if (!out) return;
+    selectKernel();
+    perfKernel(target, achieved, n > 0 ? n : 0, perfOut, out);
+}
+
+const char *kpiKernelName(void) {
+    selectKernel();
+    return perfKernelName;
+}
+
+/* (re)build a perspective's columns from its KPI list when stale */
+static void buildColumns(PersNode *node) {
+    KPIColumns *c = &node->cols;
+    if (!c->dirty) return;
+    int n = node->kpiCount;
+    if (n > c->cap) {
+        c->cap = n;
+        c->target = xrealloc(c->target, (size_t)n * sizeof(float));
+        c->achieved = xrealloc(c->achieved, (size_t)n * sizeof(float));
+        c->kpi = xrealloc(c->kpi, (size_t)n * sizeof(const KPI *));
+    }
+    int i = 0;
+    for (const KPI *k = kpiFirst(node); k; k = kpiNext(node, k), ++i) {
+        c->target[i] = k->target;
+        c->achieved[i] = k->achieved;
+        c->kpi[i] = k;
+    }
+    c->count = n;
+    c->dirty = 0;
+}
+
+/* list-walk equivalent of the kernel */
+static void listKPIStats(const PersNode *node, KPIBatchStats *out) {
+    double sum = 0.0;
+    int valid = 0, ge20 = 0, ge80 = 0, gt100 = 0;
+    for (const KPI *k = kpiFirst(node); k; k = kpiNext(node, k)) {
+        if (k->target == 0.0f) continue;
+        float perf = (k->achieved / k->target) * 100.0f;
+        sum += perf;
+        valid++;
+        ge20 += perf >= 20.0f;
+        ge80 += perf >= 80.0f;
+        gt100 += perf > 100.0f;
+    }
+    out->sumPerf = sum;
+    finishBands(out, valid, ge20, ge80, gt100);
+}
+
+/* stats of one node via the columnar kernel (building its columns when
+   stale) or the list walk */
+static void nodeKPIStats(Graph *graph, PersNode *node, KPIBatchStats *out) {
+    if (graph->columnar) {
+        buildColumns(node);
+        kpiPerfKernel(node->cols.target, node->cols.achieved, node->cols.count, NULL, out);
+    } else {
+        listKPIStats(node, out);
+    }
+}
+
+void setColumnarKPIs(Graph *graph, int enabled) {
+    if (graph) graph->columnar = enabled ? 1 : 0;
+}
+
+void perspectiveKPIStats(Graph *graph, int id, KPIBatchStats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!graph || id < 0 || id >= graph->numNodes) return;
+    nodeKPIStats(graph, graph->pers[id], out);
+}
+
+/* ---------- Work-stealing pool + parallel score pass ---------- */
+
+/* Each batch of tasks is split into one contiguous block per thread. A
+   thread pops its own block from the tail and, once empty, steals from the
+   head of the others. Tasks never create tasks, so a thread that finds
+   every deque empty is done. The calling thread works as thread 0. */
+typedef void (*TaskFn)(void *ctx, int task);
+
+typedef struct WorkDeque {
+    pthread_mutex_t lock;
+    int *items;
+    int head;               /* thieves take from here */
+    int tail;               /* owner pops below here */
+} WorkDeque;
+
+struct WorkPool {
+    int threads;
+    pthread_t *tids;
+    WorkDeque *deques;
+    int *items;
+    int itemsCap;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    /* a new batch (or shutdown) */
+    pthread_cond_t idle;    /* the last helper finished its batch */
+    unsigned long batch;
+    int busy;               /* helpers still inside the current batch */
+    int shutdown;
+    TaskFn fn;
+    void *ctx;
+    pthread_mutex_t run;    /* one batch at a time; other callers wait here */
+};
+
+typedef struct WorkerArg {
+    struct WorkPool *pool;
+    int self;
+} WorkerArg;
+
+static int dequeTake(WorkDeque *d, int fromTail, int *task) {
+    int ok = 0;
+    pthread_mutex_lock(&d->lock);
+    if (d->head < d->tail) {
+        *task = fromTail ? d->items[--d->tail] : d->items[d->head++];
+        ok = 1;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return ok;
+}
+
+static void workerRun(struct WorkPool *pool, int self) {
+    int task;
+    for (;;) {
+        if (dequeTake(&pool->deques[self], 1, &task)) { pool->fn(pool->ctx, task); continue; }
+        int stolen = 0;
+        for (int j = 1; j < pool->threads && !stolen; ++j)
+            stolen = dequeTake(&pool->deques[(self + j) % pool->threads], 0, &task);
+        if (!stolen) return;
+        pool->fn(pool->ctx, task);
+    }
+}
+
+static void *workerMain(void *p) {
+    WorkerArg *arg = (WorkerArg*)p;
+    struct WorkPool *pool = arg->pool;
+    int self = arg->self;
+    free(arg);
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->batch == seen && !pool->shutdown) pthread_cond_wait(&pool->wake, &pool->lock);
+        if (pool->shutdown) { pthread_mutex_unlock(&pool->lock); return NULL; }
+        seen = pool->batch;
+        pthread_mutex_unlock(&pool->lock);
+
+        workerRun(pool, self);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) pthread_cond_signal(&pool->idle);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static struct WorkPool *poolStart(int threads) {
+    struct WorkPool *pool = xrealloc(NULL, sizeof(*pool));
+    memset(pool, 0, sizeof(*pool));
+    pool->threads = threads;
+    pool->tids = xrealloc(NULL, (size_t)threads * sizeof(pthread_t));
+    pool->deques = xrealloc(NULL, (size_t)threads * sizeof(WorkDeque));
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_mutex_init(&pool->run, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    for (int t = 0; t < threads; ++t) {
+        pthread_mutex_init(&pool->deques[t].lock, NULL);
+        pool->deques[t].items = NULL;
+        pool->deques[t].head = pool->deques[t].tail = 0;
+    }
+    for (int t = 1; t < threads; ++t) {
+        WorkerArg *arg = xrealloc(NULL, sizeof(*arg));
+        arg->pool = pool;
+        arg->self = t;
+        if (pthread_create(&pool->tids[t], NULL, workerMain, arg) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+static void poolStop(struct WorkPool *pool) {
+    if (!pool) return;
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int t = 1; t < pool->threads; ++t) pthread_join(pool->tids[t], NULL);
+    for (int t = 0; t < pool->threads; ++t) pthread_mutex_destroy(&pool->deques[t].lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->idle);
+    pthread_mutex_destroy(&pool->run);
+    free(pool->items);
+    free(pool->deques);
+    free(pool->tids);
+    free(pool);
+}
+
+/* run fn(ctx, 0..ntasks-1) on the pool (serially without one) and wait.
+   Callers on different threads may share a pool; their batches queue up. */
+static void poolRun(struct WorkPool *pool, TaskFn fn, void *ctx, int ntasks) {
+    if (!pool || pool->threads < 2 || ntasks < 2) {
+        for (int t = 0; t < ntasks; ++t) fn(ctx, t);
+        return;
+    }
+    pthread_mutex_lock(&pool->run);
+    if (ntasks > pool->itemsCap) {
+        pool->items = xrealloc(pool->items, (size_t)ntasks * sizeof(int));
+        pool->itemsCap = ntasks;
+    }
+    for (int t = 0; t < ntasks; ++t) pool->items[t] = t;
+
+    pthread_mutex_lock(&pool->lock);
+    for (int w = 0; w < pool->threads; ++w) {
+        WorkDeque *d = &pool->deques[w];
+        pthread_mutex_lock(&d->lock);
+        d->items = pool->items;
+        d->head = (int)((long)ntasks * w / pool->threads);
+        d->tail = (int)((long)ntasks * (w + 1) / pool->threads);
+        pthread_mutex_unlock(&d->lock);
+    }
+    pool->fn = fn;
+    pool->ctx = ctx;
+    pool->busy = pool->threads - 1;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    workerRun(pool, 0);
+
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->run);
+}
+
+void setEvalThreads(Graph *graph, int threads) {
+    if (!graph) return;
+    if (threads < 1) threads = 1;
+    if (threads > EVAL_MAX_THREADS) threads = EVAL_MAX_THREADS;
+    int current = graph->pool ? graph->pool->threads : 1;
+    if (threads == current) return;
+    poolStop(graph->pool);
+    graph->pool = threads > 1 ? poolStart(threads) : NULL;
+}
+
+/* running performance sum + band counters of a chunk (scalar, in order) */
+typedef struct PerfAcc {
+    double sum;
+    int valid, ge20, ge80, gt100;
+} PerfAcc;
+
+static void perfAccAdd(PerfAcc *a, const Graph *graph, const KPI *k, int32_t period) {
+    float target, achieved;
+    int32_t seen;
+    if (!kpiValuesAsOf(graph, k, period, &target, &achieved, &seen) || target == 0.0f) return;
+    float perf = (achieved / target) * 100.0f;
+    a->sum += perf;
+    a->valid++;
+    a->ge20 += perf >= 20.0f;
+    a->ge80 += perf >= 80.0f;
+    a->gt100 += perf > 100.0f;
+}
+
+static void perfAccFinish(const PerfAcc *a, KPIBatchStats *out) {
+    out->sumPerf = a->sum;
+    finishBands(out, a->valid, a->ge20, a->ge80, a->gt100);
+}
+
+static void mergeStats(KPIBatchStats *dst, const KPIBatchStats *src) {
+    dst->sumPerf += src->sumPerf;
+    dst->count += src->count;
+    for (int b = 0; b < BAND_COUNT; ++b) dst->bands[b] += src->bands[b];
+}
+
+/* period stats of kpis[] slots [from, to), walked newest first like the
+   list; tombstones are skipped */
+static void slotStats(const Graph *graph, const PersNode *node, int from, int to, int32_t period,
+                      KPIBatchStats *out) {
+    PerfAcc acc;
+    STAT_ONLY(int visited = 0);
+    memset(&acc, 0, sizeof(acc));
+    for (int i = to; i-- > from; ) {
+        const KPI *k = &node->kpis[i];
+        if (!k->name) continue;
+        perfAccAdd(&acc, graph, k, period);
+        STAT_ONLY(++visited);
+    }
+    STAT_ADD(kpisVisited, visited);
+    perfAccFinish(&acc, out);
+}
+
+/* slots of period chunk c: EVAL_CHUNK_KPIS of them counted down from the newest */
+static void chunkSlots(const PersNode *node, int c, int *from, int *to) {
+    *to = node->kpiLen - c * EVAL_CHUNK_KPIS;
+    *from = *to > EVAL_CHUNK_KPIS ? *to - EVAL_CHUNK_KPIS : 0;
+}
+
+/* chunks of one perspective: column chunks for the current values, slot
+   chunks (tombstones included) for a period */
+static int nodeChunks(const PersNode *node, int32_t period) {
+    int n = period == PERIOD_LATEST ? node->cols.count : node->kpiLen;
+    return (n + EVAL_CHUNK_KPIS - 1) / EVAL_CHUNK_KPIS;
+}
+
+/* one perspective, chunk by chunk on the calling thread; the chunk
+   boundaries and merge order match the pool's, so the results do too.
+   Current values go through the columns, built here when stale; period
+   passes read kpis[] slots and write nothing. */
+static void nodeStatsChunked(const Graph *graph, PersNode *node, int32_t period, KPIBatchStats *out) {
+    STAT_START(STAT_SCORE_PERSPECTIVE, t0);
+    memset(out, 0, sizeof(*out));
+    KPIBatchStats part;
+    if (period == PERIOD_LATEST) {
+        buildColumns(node);
+        const KPIColumns *c = &node->cols;
+        for (int from = 0; from < c->count; from += EVAL_CHUNK_KPIS) {
+            int n = c->count - from < EVAL_CHUNK_KPIS ? c->count - from : EVAL_CHUNK_KPIS;
+            kpiPerfKernel(c->target + from, c->achieved + from, n, NULL, &part);
+            mergeStats(out, &part);
+        }
+        STAT_ADD(kpisVisited, c->count);
+        STAT_STOP(STAT_SCORE_PERSPECTIVE, t0);
+        return;
+    }
+    for (int c = 0, n = nodeChunks(node, period); c < n; ++c) {
+        int from, to;
+        chunkSlots(node, c, &from, &to);
+        slotStats(graph, node, from, to, period, &part);
+        mergeStats(out, &part);
+    }
+    STAT_STOP(STAT_SCORE_PERSPECTIVE, t0);
+}
+
+/* one parallel score pass: task t is chunk chunk[t] of perspective pers[t]
+   and writes partial[t] */
+typedef struct EvalJob {
+    const Graph *graph;
+    int32_t period;
+    int *pers;
+    int *chunk;
+    KPIBatchStats *partial;
+} EvalJob;
+
+static void buildColumnsTask(void *ctx, int t) {
+    Graph *graph = (Graph*)ctx;
+    buildColumns(graph->pers[t]);
+}
+
+static void evalChunkTask(void *ctx, int t) {
+    EvalJob *job = (EvalJob*)ctx;
+    const PersNode *node = job->graph->pers[job->pers[t]];
+    KPIBatchStats *out = &job->partial[t];
+    STAT_START(STAT_SCORE_PERSPECTIVE, t0);
+    if (job->period == PERIOD_LATEST) {
+        const KPIColumns *c = &node->cols;
+        int from = job->chunk[t] * EVAL_CHUNK_KPIS;
+        int n = c->count - from < EVAL_CHUNK_KPIS ? c->count - from : EVAL_CHUNK_KPIS;
+        STAT_ADD(kpisVisited, n);
+        kpiPerfKernel(c->target + from, c->achieved + from, n, NULL, out);
+    } else {
+        int from, to;
+        chunkSlots(node, job->chunk[t], &from, &to);
+        slotStats(job->graph, node, from, to, job->period, out);
+    }
+    STAT_STOP(STAT_SCORE_PERSPECTIVE, t0);
+}
+
+/* the pool pass proper. For PERIOD_LATEST the columns must be current; a
+   period pass only reads the graph. The task table is allocated per call,
+   so concurrent passes share nothing but the pool, and poolRun takes them
+   one at a time. */
+static void poolStats(const Graph *graph, int32_t period, KPIBatchStats *out) {
+    int np = graph->numNodes;
+    memset(out, 0, (size_t)np * sizeof(KPIBatchStats));
+    int ntasks = 0;
+    for (int i = 0; i < np; ++i) ntasks += nodeChunks(graph->pers[i], period);
+    if (ntasks == 0) return;
+    EvalJob job = { graph, period, NULL, NULL, NULL };
+    job.pers = xrealloc(NULL, (size_t)ntasks * (2 * sizeof(int)));
+    job.chunk = job.pers + ntasks;
+    job.partial = xrealloc(NULL, (size_t)ntasks * sizeof(KPIBatchStats));
+    int t = 0;
+    for (int i = 0; i < np; ++i) {
+        for (int c = 0, n = nodeChunks(graph->pers[i], period); c < n; ++c, ++t) {
+            job.pers[t] = i;
+            job.chunk[t] = c;
+        }
+    }
+    poolRun(graph->pool, evalChunkTask, &job, ntasks);
+
+    /* merge in task order: same additions in the same order for any thread count */
+    for (t = 0; t < ntasks; ++t) mergeStats(&out[job.pers[t]], &job.partial[t]);
+    free(job.pers);
+    free(job.partial);
+}
+
+void evaluateKPIStats(Graph *graph, int32_t period, KPIBatchStats *out) {
+    if (!graph || !out) return;
+    int np = graph->numNodes;
+    if (!graph->pool) {
+        for (int i = 0; i < np; ++i) nodeStatsChunked(graph, graph->pers[i], period, &out[i]);
+        return;
+    }
+    /* the columns give every chunk random access into its perspective */
+    if (period == PERIOD_LATEST) poolRun(graph->pool, buildColumnsTask, graph, np);
+    poolStats(graph, period, out);
+}
+
+/* ---------- Query API ---------- */
+
+int perspectiveCount(const Graph *graph) {
+    return graph ? graph->numNodes : 0;
+}
+
+const char *perspectiveName(const Graph *graph, int id) {
+    if (!graph || id < 0 || id >= graph->numNodes) return NULL;
+    return graph->nodes[id];
+}
+
+int nextPerspectiveByName(const Graph *graph, int prev) {
+    if (!graph || !graph->bstRoot) return -1;
+    const PersNode *n = graph->bstRoot, *best = NULL;
+    if (prev < 0 || prev >= graph->numNodes) {
+        while (n->left) n = n->left;
+        return n->id;
+    }
+    const char *name = graph->pers[prev]->name;
+    STAT_ONLY(int depth = 0);
+    while (n) {             /* smallest name greater than prev's */
+        if (strcmp_ci(n->name, name) > 0) { best = n; n = n->left; }
+        else n = n->right;
+        STAT_ONLY(++depth);
+    }
+    STAT_ADD(treeSearches, 1);
+    STAT_ADD(treeSearchDepth, depth);
+    STAT_MAX(treeSearchMaxDepth, depth);
+    return best ? best->id : -1;
+}
+
+void openKPICursor(const Graph *graph, int id, int32_t period, KPICursor *cur) {
+    if (!cur) return;
+    cur->graph = graph;
+    cur->node = (graph && id >= 0 && id < graph->numNodes) ? graph->pers[id] : NULL;
+    cur->next = cur->node ? cur->node->kpiLen : 0;
+    cur->period = period;
+}
+
+int readKPIs(KPICursor *cur, KPIResult *out, int cap) {
+    if (!cur || !out) return 0;
+    int n = 0;
+    while (cur->next > 0 && n < cap) {
+        const KPI *k = &cur->node->kpis[--cur->next];
+        if (!k->name) continue;
+        KPIResult *r = &out[n++];
+        r->name = kpiNameOf(cur->graph, k);
+        r->hasValue = kpiValuesAsOf(cur->graph, k, cur->period, &r->target, &r->achieved, &r->period);
+        if (!r->hasValue) {
+            r->target = r->achieved = 0.0f;
+            r->period = cur->period;
+        }
+        r->performance = (r->hasValue && r->target != 0.0f) ? (r->achieved / r->target) * 100.0f : 0.0f;
+        r->band = perfBand(r->performance);
+    }
+    STAT_ADD(kpisVisited, n);
+    return n;
+}
+
+int queryDependencies(const Graph *graph, int id, int first, int *to, int cap) {
+    if (!graph || id < 0 || id >= graph->numNodes) return 0;
+    const AdjList *a = &graph->adj[id];
+    for (int e = first; e >= 0 && e < a->count && e - first < cap; ++e) to[e - first] = a->to[e];
+    return a->count;
+}
+
+/* average of a perspective from its sum / count */
+static void fillPerspective(const Graph *graph, int id, double sum, int count, PerspectiveResult *r) {
+    r->name = graph->nodes[id];
+    r->id = id;
+    r->kpiCount = count;
+    r->average = perfAverage(sum, count);
+    r->band = perfBand(r->average);
+}
+
+int queryPerspectiveRange(const Graph *graph, int id, float *min, float *max) {
+    if (!graph || id < 0 || id >= graph->numNodes || !min || !max) return 0;
+    const PersNode *node = graph->pers[id];
+    if (node->perfStale) return scanPerfRange(node, min, max);
+    if (node->perfCount > 0) {
+        *min = node->perfMin;
+        *max = node->perfMax;
+    }
+    return node->perfCount;
+}
+
+/*
+   Current averages come from the running aggregates kept in each PersNode,
+   so they are O(P) and never touch individual KPIs. A past period needs
+   every KPI's value at that period (O(KPIs * log history)); that pass is
+   spread over the graph's worker threads when it has some.
+*/
+int queryPerspectives(const Graph *graph, int32_t period, PerspectiveResult *out, int cap) {
+    if (!graph) return 0;
+    STAT_START(STAT_QUERY_PERSPECTIVES, t0);
+    int np = graph->numNodes;
+    if (period == PERIOD_LATEST) {
+        for (int i = 0; i < np && i < cap; ++i) {
+            const PersNode *node = graph->pers[i];
+            fillPerspective(graph, i, node->perfCount > 0 ? node->perfSum : 0.0, node->perfCount, &out[i]);
+        }
+    } else if (graph->pool && cap >= np) {
+        KPIBatchStats *stats = xrealloc(NULL, (size_t)np * sizeof(KPIBatchStats));
+        poolStats(graph, period, stats);
+        for (int i = 0; i < np; ++i)
+            fillPerspective(graph, i, stats[i].sumPerf, stats[i].count, &out[i]);
+        free(stats);
+    } else {
+        for (int i = 0; i < np && i < cap; ++i) {
+            KPIBatchStats st;
+            nodeStatsChunked(graph, graph->pers[i], period, &st);
+            fillPerspective(graph, i, st.sumPerf, st.count, &out[i]);
+        }
+    }
+    STAT_STOP(STAT_QUERY_PERSPECTIVES, t0);
+    return np;
+}
+
+/* overall / lowest / impact edges from already computed perspective results */
+static void summariseEvaluation(const Graph *graph, const PerspectiveResult *persp,
+                                ImpactEdge *impacts, int impactCap, EvaluationResult *out) {
+    int np = graph->numNodes;
+    float overallSum = 0.0f;
+    float min = 1e9f;
+    out->numPerspectives = np;
+    out->numImpacts = 0;
+    out->withData = 0;
+    out->lowest = -1;
+    out->lowestAverage = 0.0f;
+    for (int i = 0; i < np; ++i) {
+        const PerspectiveResult *r = &persp[i];
+        if (r->kpiCount == 0) continue;
+        overallSum += r->average;
+        out->withData++;
+        /* lowest performer (among those with KPI data) */
+        if (r->average < min) {
+            min = r->average;
+            out->lowest = i;
+            out->lowestAverage = r->average;
+        }
+        /* dependency impact: weak (but non-zero) perspectives affect their targets */
+        if (!(r->average > 0.0f && r->average < 80.0f)) continue;
+        const AdjList *a = &graph->adj[i];
+        for (int e = 0; e < a->count; ++e, ++out->numImpacts) {
+            if (out->numImpacts >= impactCap) continue;
+            ImpactEdge *edge = &impacts[out->numImpacts];
+            edge->from = i;
+            edge->to = a->to[e];
+            edge->fromAverage = r->average;
+            edge->band = r->band;
+        }
+    }
+    out->overall = out->withData > 0 ? overallSum / (float)out->withData : 0.0f;
+}
+
+int queryEvaluation(const Graph *graph, int32_t period,
+                    PerspectiveResult *persp, int perspCap,
+                    ImpactEdge *impacts, int impactCap, EvaluationResult *out) {
+    if (!graph || !out || (perspCap > 0 && !persp) || (impactCap > 0 && !impacts)) return -1;
+    memset(out, 0, sizeof(*out));
+    out->period = period;
+    out->lowest = -1;
+    if (perspCap < graph->numNodes) return -1;
+    STAT_START(STAT_EVALUATE, t0);
+    queryPerspectives(graph, period, persp, perspCap);
+    summariseEvaluation(graph, persp, impacts, impactCap, out);
+    STAT_STOP(STAT_EVALUATE, t0);
+    return 0;
+}
+
+/* ---------- Distribution analytics ---------- */
+
+void sketchInit(QuantileSketch *s) {
+    memset(s, 0, sizeof(*s));
+}
+
+/* bucket of a value straight from its float bits: exponent, then the top
+   SKETCH_SUB_BITS of the mantissa */
+static int sketchBucket(float v) {
+    if (!(v > 0.0f)) return 0;
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    int e = (int)((bits >> 23) & 0xff) - 127;
+    if (e < SKETCH_MIN_EXP) return 0;
+    if (e >= SKETCH_MAX_EXP) return SKETCH_BUCKETS - 1;
+    return 1 + ((e - SKETCH_MIN_EXP) << SKETCH_SUB_BITS) + (int)((bits >> (23 - SKETCH_SUB_BITS)) & ((1u << SKETCH_SUB_BITS) - 1));
+}
+
+/* midpoint of a regular bucket */
+static float sketchValue(int b) {
+    int i = b - 1;
+    uint32_t e = (uint32_t)((i >> SKETCH_SUB_BITS) + SKETCH_MIN_EXP + 127);
+    uint32_t sub = (uint32_t)(i & ((1 << SKETCH_SUB_BITS) - 1));
+    uint32_t loBits = (e << 23) | (sub << (23 - SKETCH_SUB_BITS));
+    uint32_t hiBits = loBits + (1u << (23 - SKETCH_SUB_BITS));   /* carries into the exponent */
+    float lo, hi;
+    memcpy(&lo, &loBits, sizeof(lo));
+    memcpy(&hi, &hiBits, sizeof(hi));
+    return lo + (hi - lo) * 0.5f;
+}
+
+void sketchAdd(QuantileSketch *s, float v) {
+    if (s->count == 0 || v < s->min) s->min = v;
+    if (s->count == 0 || v > s->max) s->max = v;
+    s->count++;
+    s->buckets[sketchBucket(v)]++;
+}
+
+float sketchQuantile(const QuantileSketch *s, double q) {
+    if (!s || s->count == 0) return 0.0f;
+    if (q <= 0.0) return s->min;
+    if (q >= 1.0) return s->max;
+    uint64_t rank = (uint64_t)(q * (double)s->count);
+    if ((double)rank < q * (double)s->count) ++rank;         /* ceil: nearest rank */
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    int b = 0;
+    for (; b < SKETCH_BUCKETS; ++b) {
+        seen += s->buckets[b];
+        if (seen >= rank) break;
+    }
+    /* the end buckets have no width; the exact extremes stand in for them */
+    float v = b == 0 ? s->min : b == SKETCH_BUCKETS - 1 ? s->max : sketchValue(b);
+    return v < s->min ? s->min : v > s->max ? s->max : v;
+}
+
+/* ranking order: performance, then perspective id, then name */
+static int rankLess(const KPIRank *a, const KPIRank *b) {
+    if (a->performance != b->performance) return a->performance < b->performance;
+    if (a->perspective != b->perspective) return a->perspective < b->perspective;
+    return strcmp(a->name, b->name) < 0;
+}
+
+/* bounded heap over a caller array; maxHeap keeps the root the largest
+   (used to hold the k smallest), otherwise the smallest */
+typedef struct RankHeap {
+    KPIRank *items;
+    int count;
+    int cap;
+    int maxHeap;
+} RankHeap;
+
+static int heapAbove(const RankHeap *h, const KPIRank *a, const KPIRank *b) {
+    return h->maxHeap ? rankLess(b, a) : rankLess(a, b);
+}
+
+static void heapSiftDown(RankHeap *h, int i, int n) {
+    KPIRank x = h->items[i];
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) break;
+        if (c + 1 < n && heapAbove(h, &h->items[c + 1], &h->items[c])) ++c;
+        if (!heapAbove(h, &h->items[c], &x)) break;
+        h->items[i] = h->items[c];
+        i = c;
+    }
+    h->items[i] = x;
+}
+
+static void heapOffer(RankHeap *h, const KPIRank *x) {
+    if (h->count < h->cap) {
+        int i = h->count++;
+        while (i > 0) {
+            int p = (i - 1) / 2;
+            if (!heapAbove(h, x, &h->items[p])) break;
+            h->items[i] = h->items[p];
+            i = p;
+        }
+        h->items[i] = *x;
+    } else if (h->cap > 0 && heapAbove(h, &h->items[0], x)) {
+        h->items[0] = *x;               /* x beats the worst one kept */
+        heapSiftDown(h, 0, h->count);
+    }
+}
+
+/* heap sort in place: a max-heap ends ascending, a min-heap descending */
+static void heapFinish(RankHeap *h) {
+    for (int n = h->count - 1; n > 0; --n) {
+        KPIRank top = h->items[0];
+        h->items[0] = h->items[n];
+        h->items[n] = top;
+        heapSiftDown(h, 0, n);
+    }
+}
+
+int queryDistribution(const Graph *graph, int32_t period, int k,
+                      KPIRank *worst, KPIRank *best, KPIBatchStats *perPerspective,
+                      KPIDistribution *out) {
+    if (!graph || !out || k < 0) return -1;
+    STAT_START(STAT_DISTRIBUTION, t0);
+    RankHeap low = { worst, 0, worst ? k : 0, 1 };
+    RankHeap high = { best, 0, best ? k : 0, 0 };
+    QuantileSketch sketch;      /* ~12 KB, on the stack so the query stays allocation free */
+    sketchInit(&sketch);
+    memset(out, 0, sizeof(*out));
+    out->period = period;
+    double sum = 0.0;
+
+    for (int id = 0; id < graph->numNodes; ++id) {
+        KPIBatchStats st;
+        memset(&st, 0, sizeof(st));
+        const PersNode *node = graph->pers[id];
+        for (const KPI *t = kpiFirst(node); t; t = kpiNext(node, t)) {
+            float target, achieved;
+            int32_t seen;
+            if (!kpiValuesAsOf(graph, t, period, &target, &achieved, &seen) || target == 0.0f) continue;
+            KPIRank r = { kpiNameOf(graph, t), id, (achieved / target) * 100.0f, BAND_RED };
+            r.band = perfBand(r.performance);
+            st.sumPerf += r.performance;
+            st.count++;
+            st.bands[r.band]++;
+            sketchAdd(&sketch, r.performance);
+            heapOffer(&low, &r);
+            heapOffer(&high, &r);
+        }
+        STAT_ADD(kpisVisited, st.count);
+        sum += st.sumPerf;
+        for (int b = 0; b < BAND_COUNT; ++b) out->bands[b] += st.bands[b];
+        if (perPerspective) perPerspective[id] = st;
+    }
+
+    heapFinish(&low);
+    heapFinish(&high);
+    out->kpis = (long)sketch.count;
+    out->mean = sketch.count ? sum / (double)sketch.count : 0.0;
+    out->min = sketch.min;
+    out->max = sketch.max;
+    out->p50 = sketchQuantile(&sketch, 0.50);
+    out->p90 = sketchQuantile(&sketch, 0.90);
+    out->p99 = sketchQuantile(&sketch, 0.99);
+    out->worstCount = low.count;
+    out->bestCount = high.count;
+    STAT_STOP(STAT_DISTRIBUTION, t0);
+    return 0;
+}
+
+/* one ranked list in the graph's format */
+static void renderRanking(const Graph *graph, const char *title, const KPIRank *r, int n) {
+    switch (graph->format) {
+    case REPORT_JSON:
+        rbStr(", \""); rbStr(title); rbStr("\": [");
+        for (int i = 0; i < n; ++i) {
+            rbStr(i ? ",\n  {\"perspective\": " : "\n  {\"perspective\": ");
+            rbJsonStr(graph->nodes[r[i].perspective]);
+            rbStr(", \"kpi\": "); rbJsonStr(r[i].name);
+            rbStr(", \"performance\": "); rbFixed2(r[i].performance);
+            rbStr(", \"band\": \""); rbStr(bandNames[r[i].band]); rbStr("\"}");
+        }
+        rbStr(n ? "\n]" : "]");
+        break;
+    case REPORT_CSV:
+        for (int i = 0; i < n; ++i) {
+            rbStr(title); rbStr(",");
+            rbCsvStr(graph->nodes[r[i].perspective]); rbStr(",");
+            rbCsvStr(r[i].name); rbStr(",");
+            rbFixed2(r[i].performance); rbStr(",");
+            rbStr(bandNames[r[i].band]); rbStr("\n");
+        }
+        break;
+    default:
+        rbPrintf("\n--- %d %s KPIs ---\n", n, strcmp(title, "worst") == 0 ? "Lowest" : "Highest");
+        if (n == 0) rbStr("  (no KPI data)\n");
+        for (int i = 0; i < n; ++i) {
+            rbPrintf("%4d. ", i + 1);
+            rbStr(graph->nodes[r[i].perspective]); rbStr(" / "); rbStr(r[i].name); rbStr(": ");
+            rbStr(bandColour(graph, r[i].band)); rbFixed2(r[i].performance); rbStr("%");
+            rbStr(colourReset(graph)); rbStr("\n");
+        }
+        break;
+    }
+}
+
+void showDistribution(const Graph *graph, int32_t period, int k) {
+    if (!graph) return;
+    if (k < 0) k = 0;
+    int n = graph->numNodes;
+    KPIRank *worst = xrealloc(NULL, (size_t)(k ? k : 1) * sizeof(KPIRank));
+    KPIRank *best = xrealloc(NULL, (size_t)(k ? k : 1) * sizeof(KPIRank));
+    KPIBatchStats *per = xrealloc(NULL, (size_t)(n ? n : 1) * sizeof(KPIBatchStats));
+    KPIDistribution d;
+    queryDistribution(graph, period, k, worst, best, per, &d);
+    static const float pct[3] = { 50.0f, 90.0f, 99.0f };
+    const float pv[3] = { d.p50, d.p90, d.p99 };
+
+    switch (graph->format) {
+    case REPORT_JSON:
+        rbStr("{\"report\": \"distribution\", \"period\": ");
+        if (period != PERIOD_LATEST) rbInt(period); else rbStr("null");
+        rbStr(", \"kpis\": "); rbInt(d.kpis);
+        if (d.kpis) {
+            rbStr(", \"mean\": "); rbFixed2((float)d.mean);
+            rbStr(", \"min\": "); rbFixed2(d.min);
+            rbStr(", \"max\": "); rbFixed2(d.max);
+            rbStr(", \"p50\": "); rbFixed2(d.p50);
+            rbStr(", \"p90\": "); rbFixed2(d.p90);
+            rbStr(", \"p99\": "); rbFixed2(d.p99);
+        } else {
+            rbStr(", \"mean\": null, \"min\": null, \"max\": null, \"p50\": null, \"p90\": null, \"p99\": null");
+        }
+        rbStr(", \"bands\": [");
+        for (int i = 0; i < n; ++i) {
+            rbStr(i ? ",\n  {\"perspective\": " : "\n  {\"perspective\": ");
+            rbJsonStr(graph->nodes[i]);
+            for (int b = 0; b < BAND_COUNT; ++b) {
+                rbStr(", \""); rbStr(bandNames[b]); rbStr("\": "); rbInt(per[i].bands[b]);
+            }
+            rbStr("}");
+        }
+        rbStr(n ? "\n]" : "]");
+        renderRanking(graph, "worst", worst, d.worstCount);
+        renderRanking(graph, "best", best, d.bestCount);
+        rbStr("}\n");
+        break;
+
+    case REPORT_CSV:
+        /* long form: section, perspective, kpi / statistic, value, band */
+        rbStr("section,perspective,kpi,value,band\n");
+        rbStr("summary,,kpis,"); rbInt(d.kpis); rbStr(",\n");
+        if (d.kpis) {
+            rbStr("summary,,mean,"); rbFixed2((float)d.mean); rbStr(",\n");
+            rbStr("summary,,min,"); rbFixed2(d.min); rbStr(","); rbStr(bandNames[perfBand(d.min)]); rbStr("\n");
+            rbStr("summary,,max,"); rbFixed2(d.max); rbStr(","); rbStr(bandNames[perfBand(d.max)]); rbStr("\n");
+            for (int q = 0; q < 3; ++q) {
+                rbPrintf("percentile,,p%d,", (int)pct[q]); rbFixed2(pv[q]); rbStr(",");
+                rbStr(bandNames[perfBand(pv[q])]); rbStr("\n");
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            for (int b = 0; b < BAND_COUNT; ++b) {
+                rbStr("bands,"); rbCsvStr(graph->nodes[i]); rbStr(",,");
+                rbInt(per[i].bands[b]); rbStr(","); rbStr(bandNames[b]); rbStr("\n");
+            }
+        }
+        renderRanking(graph, "worst", worst, d.worstCount);
+        renderRanking(graph, "best", best, d.bestCount);
+        break;
+
+    default:
+        if (period != PERIOD_LATEST) rbPrintf("\n=== KPI Distribution for period %d ===\n", (int)period);
+        else rbStr("\n=== KPI Distribution ===\n");
+        rbStr("KPIs with data: "); rbInt(d.kpis); rbStr("\n");
+        if (d.kpis) {
+            rbStr("Mean: "); rbFixed2((float)d.mean);
+            rbStr("%  Min: "); rbFixed2(d.min);
+            rbStr("%  Max: "); rbFixed2(d.max); rbStr("%\n");
+            rbStr("Percentiles (within 1%):");
+            for (int q = 0; q < 3; ++q) {
+                rbPrintf(" p%d ", (int)pct[q]); rbStr(bandColour(graph, perfBand(pv[q])));
+                rbFixed2(pv[q]); rbStr("%"); rbStr(colourReset(graph));
+            }
+            rbStr("\n");
+        }
+
+        rbStr("\n--- KPIs per Band ---\n");
+        rbPrintf("%-24s %8s %8s %8s %8s\n", "Perspective", "red", "amber", "green", "blue");
+        for (int i = 0; i < n; ++i) {
+            rbPrintf("%-24s", graph->nodes[i]);
+            for (int b = 0; b < BAND_COUNT; ++b) rbPrintf(" %8d", per[i].bands[b]);
+            rbStr("\n");
+        }
+        rbPrintf("%-24s", "(all)");
+        for (int b = 0; b < BAND_COUNT; ++b) rbPrintf(" %8d", d.bands[b]);
+        rbStr("\n");
+
+        renderRanking(graph, "worst", worst, d.worstCount);
+        renderRanking(graph, "best", best, d.bestCount);
+        break;
+    }
+    rbFlush();
+    free(worst);
+    free(best);
+    free(per);
+}
+
+/* ---------- What-if scenarios ---------- */
+
+#define SCENARIO_CHUNK 32       /* scenarios per pool task */
+
+/* read-only state shared by every scenario of a batch */
+typedef struct ScenarioJob {
+    const Graph *graph;
+    const Scenario *scenarios;
+    int n;
+    ScenarioResult *results;
+    float *averages;
+    ImpactEdge *impacts;
+    int impactCap;
+    int writing;                    /* second pass: store the new impact edges */
+    const PerspectiveResult *base;  /* baseline, per perspective id */
+    const int *byAverage;           /* perspectives with data, lowest (average, id) first */
+    int withData;
+    double baseSum;                 /* sum of the baseline averages with data */
+    int baseImpacts;
+    int maxOverrides;
+} ScenarioJob;
+
+/* per-task scratch: open-addressing maps of the KPIs and perspectives one
+   scenario touches, sized for the largest scenario of the batch */
+typedef struct ScenarioScratch {
+    const KPI **kpi;
+    float *perf;                /* override performance per KPI slot */
+    int *pid;                   /* -1 = empty slot */
+    double *delta;              /* change of the perspective's sum */
+    float *avg;                 /* its average in the scenario */
+    int *touched;               /* perspective slots in first-touched order */
+} ScenarioScratch;
+
+static unsigned scenarioCap(int count) {
+    unsigned cap = 8;
+    while (cap < 2u * (unsigned)count) cap *= 2;
+    return cap;
+}
+
+static unsigned ptrHash(const void *p) {
+    uintptr_t v = (uintptr_t)p >> 4;
+    return (unsigned)(v ^ (v >> 29)) * 2654435761u;
+}
+
+/* slot of perspective pid in the scratch map (-1 if not touched) */
+static int scenarioSlot(const ScenarioScratch *w, unsigned mask, int pid) {
+    for (unsigned s = ((unsigned)pid * 2654435761u) & mask; w->pid[s] >= 0; s = (s + 1) & mask)
+        if (w->pid[s] == pid) return (int)s;
+    return -1;
+}
+
+static int weakAverage(float avg) { return avg > 0.0f && avg < 80.0f; }
+
+static void evaluateScenario(const ScenarioJob *job, ScenarioScratch *w, int si) {
+    const Graph *graph = job->graph;
+    const Scenario *sc = &job->scenarios[si];
+    ScenarioResult *r = &job->results[si];
+    unsigned mask = scenarioCap(sc->count) - 1;
+    memset(w->kpi, 0, (mask + 1) * sizeof(const KPI *));
+    memset(w->pid, 0xff, (mask + 1) * sizeof(int));
+    int ntouched = 0, ignored = 0;
+
+    for (int o = 0; o < sc->count; ++o) {
+        const KPIOverride *ov = &sc->overrides[o];
+        int pid = ov->perspective && ov->kpi ? findPerspective(graph, ov->perspective) : -1;
+        const KPI *k = pid >= 0 ? findKPI(graph, graph->pers[pid], ov->kpi) : NULL;
+        if (!k || !validAchieved(ov->achieved)) { ignored++; continue; }
+        if (k->target == 0.0f) continue;            /* counted in no average */
+        float perf = (ov->achieved / k->target) * 100.0f;
+
+        /* a KPI named again replaces its earlier override */
+        unsigned ks = ptrHash(k) & mask;
+        while (w->kpi[ks] && w->kpi[ks] != k) ks = (ks + 1) & mask;
+        float prior = w->kpi[ks] ? w->perf[ks] : (k->achieved / k->target) * 100.0f;
+        w->kpi[ks] = k;
+        w->perf[ks] = perf;
+
+        unsigned ps = ((unsigned)pid * 2654435761u) & mask;
+        while (w->pid[ps] >= 0 && w->pid[ps] != pid) ps = (ps + 1) & mask;
+        if (w->pid[ps] < 0) {
+            w->pid[ps] = pid;
+            w->delta[ps] = 0.0;
+            w->touched[ntouched++] = (int)ps;
+        }
+        w->delta[ps] += (double)perf - (double)prior;
+    }
+
+    double sum = job->baseSum;
+    int changed = 0, impacts = job->baseImpacts, resolved = 0, added = 0;
+    int lowest = -1;
+    float lowAvg = 0.0f;
+    for (int t = 0; t < ntouched; ++t) {
+        int slot = w->touched[t], pid = w->pid[slot];
+        const PersNode *node = graph->pers[pid];
+        float before = job->base[pid].average;
+        float after = perfAverage(node->perfSum + w->delta[slot], node->perfCount);
+        w->avg[slot] = after;
+        if (after != before) changed++;
+        sum += (double)after - (double)before;
+        if (lowest < 0 || after < lowAvg || (after == lowAvg && pid < lowest)) {
+            lowest = pid;
+            lowAvg = after;
+        }
+
+        /* impact edges follow the weak / not weak state of their source */
+        const AdjList *a = &graph->adj[pid];
+        if (weakAverage(before) && !weakAverage(after)) {
+            resolved += a->count;
+            impacts -= a->count;
+        } else if (!weakAverage(before) && weakAverage(after)) {
+            if (job->writing) {
+                for (int e = 0; e < a->count; ++e) {
+                    ImpactEdge *edge = &job->impacts[r->firstNewImpact + added + e];
+                    edge->from = pid;
+                    edge->to = a->to[e];
+                    edge->fromAverage = after;
+                    edge->band = perfBand(after);
+                }
+            }
+            added += a->count;
+            impacts += a->count;
+        }
+    }
+    if (job->writing) return;
+
+    /* the lowest untouched perspective is the first untouched one by average */
+    for (int i = 0; i < job->withData; ++i) {
+        int pid = job->byAverage[i];
+        if (ntouched && scenarioSlot(w, mask, pid) >= 0) continue;
+        float avg = job->base[pid].average;
+        if (lowest < 0 || avg < lowAvg || (avg == lowAvg && pid < lowest)) {
+            lowest = pid;
+            lowAvg = avg;
+        }
+        break;
+    }
+
+    r->overall = job->withData > 0 ? (float)(sum / job->withData) : 0.0f;
+    r->lowest = job->withData > 0 ? lowest : -1;
+    r->lowestAverage = job->withData > 0 ? lowAvg : 0.0f;
+    r->changed = changed;
+    r->ignored = ignored;
+    r->numImpacts = impacts;
+    r->numResolved = resolved;
+    r->numNewImpacts = added;
+    r->firstNewImpact = 0;
+
+    if (job->averages) {
+        int np = graph->numNodes;
+        float *row = job->averages + (size_t)si * (size_t)np;
+        for (int i = 0; i < np; ++i) row[i] = job->base[i].average;
+        for (int t = 0; t < ntouched; ++t) row[w->pid[w->touched[t]]] = w->avg[w->touched[t]];
+    }
+}
+
+static void scenarioTask(void *ctx, int t) {
+    const ScenarioJob *job = (const ScenarioJob*)ctx;
+    size_t cap = scenarioCap(job->maxOverrides);
+    ScenarioScratch w;
+    w.kpi = xrealloc(NULL, cap * sizeof(const KPI *));
+    w.perf = xrealloc(NULL, cap * sizeof(float));
+    w.pid = xrealloc(NULL, cap * sizeof(int));
+    w.delta = xrealloc(NULL, cap * sizeof(double));
+    w.avg = xrealloc(NULL, cap * sizeof(float));
+    w.touched = xrealloc(NULL, cap * sizeof(int));
+    int end = (t + 1) * SCENARIO_CHUNK < job->n ? (t + 1) * SCENARIO_CHUNK : job->n;
+    for (int si = t * SCENARIO_CHUNK; si < end; ++si) {
+        const ScenarioResult *r = &job->results[si];
+        if (job->writing && (r->numNewImpacts == 0 ||
+                             r->firstNewImpact + r->numNewImpacts > job->impactCap)) continue;
+        evaluateScenario(job, &w, si);
+    }
+    free(w.kpi);
+    free(w.perf);
+    free(w.pid);
+    free(w.delta);
+    free(w.avg);
+    free(w.touched);
+}
+
+typedef struct AverageKey {
+    float average;
+    int id;
+} AverageKey;
+
+static int cmpAverageKey(const void *a, const void *b) {
+    const AverageKey *x = (const AverageKey*)a, *y = (const AverageKey*)b;
+    if (x->average != y->average) return x->average < y->average ? -1 : 1;
+    return x->id - y->id;
+}
+
+static void runScenarioPass(ScenarioJob *job) {
+    int ntasks = (job->n + SCENARIO_CHUNK - 1) / SCENARIO_CHUNK;
+    if (job->graph->pool) poolRun(job->graph->pool, scenarioTask, job, ntasks);
+    else for (int t = 0; t < ntasks; ++t) scenarioTask(job, t);
+}
+
+int runScenarios(const Graph *graph, const Scenario *scenarios, int n,
+                 ScenarioResult *results, float *averages,
+                 ImpactEdge *impacts, int impactCap, EvaluationResult *baseline) {
+    if (!graph || n < 0 || (n > 0 && (!scenarios || !results)) || (impactCap > 0 && !impacts)) return -1;
+    int np = graph->numNodes;
+    PerspectiveResult *base = xrealloc(NULL, (size_t)(np ? np : 1) * sizeof(PerspectiveResult));
+    int *byAverage = xrealloc(NULL, (size_t)(np ? np : 1) * sizeof(int));
+    AverageKey *keys = xrealloc(NULL, (size_t)(np ? np : 1) * sizeof(AverageKey));
+    EvaluationResult ev;
+    queryEvaluation(graph, PERIOD_LATEST, base, np, NULL, 0, &ev);
+    if (baseline) *baseline = ev;
+
+    ScenarioJob job;
+    memset(&job, 0, sizeof(job));
+    job.graph = graph;
+    job.scenarios = scenarios;
+    job.n = n;
+    job.results = results;
+    job.averages = averages;
+    job.impacts = impacts;
+    job.impactCap = impactCap;
+    job.base = base;
+    job.byAverage = byAverage;
+    job.baseImpacts = ev.numImpacts;
+    for (int i = 0; i < np; ++i) {
+        if (base[i].kpiCount == 0) continue;
+        keys[job.withData].average = base[i].average;
+        keys[job.withData++].id = i;
+        job.baseSum += base[i].average;
+    }
+    qsort(keys, (size_t)job.withData, sizeof(AverageKey), cmpAverageKey);
+    for (int i = 0; i < job.withData; ++i) byAverage[i] = keys[i].id;
+    free(keys);
+    for (int i = 0; i < n; ++i)
+        if (scenarios[i].count > job.maxOverrides) job.maxOverrides = scenarios[i].count;
+
+    runScenarioPass(&job);
+    int total = 0;
+    for (int i = 0; i < n; ++i) {
+        results[i].firstNewImpact = total;
+        total += results[i].numNewImpacts;
+    }
+    if (impactCap > 0 && total > 0) {
+        job.writing = 1;
+        runScenarioPass(&job);
+    }
+    free(base);
+    free(byAverage);
+    return total;
+}
+
+/* "From -> To" list of a scenario's new impact edges, for CSV */
+static void rbImpactList(const Graph *graph, const ImpactEdge *e, int n) {
+    size_t len = 0;
+    for (int i = 0; i < n; ++i) len += strlen(graph->nodes[e[i].from]) + strlen(graph->nodes[e[i].to]) + 5;
+    char *buf = xrealloc(NULL, len + 1), *p = buf;
+    *p = '\0';
+    for (int i = 0; i < n; ++i)
+        p += sprintf(p, "%s%s -> %s", i ? "; " : "", graph->nodes[e[i].from], graph->nodes[e[i].to]);
+    rbCsvStr(buf);
+    free(buf);
+}
+
+void showScenarios(const Graph *graph, const Scenario *scenarios, int n) {
+    if (!graph || n < 0 || (n > 0 && !scenarios)) return;
+    ScenarioResult *res = xrealloc(NULL, (size_t)(n ? n : 1) * sizeof(ScenarioResult));
+    EvaluationResult base;
+    int total = runScenarios(graph, scenarios, n, res, NULL, NULL, 0, &base);
+    ImpactEdge *edges = xrealloc(NULL, (size_t)(total > 0 ? total : 1) * sizeof(ImpactEdge));
+    if (total > 0) runScenarios(graph, scenarios, n, res, NULL, edges, total, &base);
+
+    switch (graph->format) {
+    case REPORT_JSON:
+        rbStr("{\"report\": \"scenarios\", \"baseline\": {\"overall\": "); rbFixed2(base.overall);
+        rbStr(", \"lowest\": ");
+        if (base.lowest >= 0) { rbJsonStr(graph->nodes[base.lowest]); rbStr(", \"lowestAverage\": "); rbFixed2(base.lowestAverage); }
+        else rbStr("null, \"lowestAverage\": null");
+        rbStr(", \"impacts\": "); rbInt(base.numImpacts);
+        rbStr("}, \"scenarios\": [");
+        for (int i = 0; i < n; ++i) {
+            const ScenarioResult *r = &res[i];
+            rbStr(i ? ",\n  {\"name\": " : "\n  {\"name\": ");
+            rbJsonStr(scenarios[i].name ? scenarios[i].name : "");
+            rbStr(", \"overall\": "); rbFixed2(r->overall);
+            rbStr(", \"change\": "); rbFixed2(r->overall - base.overall);
+            rbStr(", \"lowest\": ");
+            if (r->lowest >= 0) { rbJsonStr(graph->nodes[r->lowest]); rbStr(", \"lowestAverage\": "); rbFixed2(r->lowestAverage); }
+            else rbStr("null, \"lowestAverage\": null");
+            rbStr(", \"changed\": "); rbInt(r->changed);
+            rbStr(", \"impacts\": "); rbInt(r->numImpacts);
+            rbStr(", \"resolved\": "); rbInt(r->numResolved);
+            rbStr(", \"ignored\": "); rbInt(r->ignored);
+            rbStr(", \"newImpacts\": [");
+            for (int e = 0; e < r->numNewImpacts; ++e) {
+                const ImpactEdge *ed = &edges[r->firstNewImpact + e];
+                rbStr(e ? ", {\"from\": " : "{\"from\": "); rbJsonStr(graph->nodes[ed->from]);
+                rbStr(", \"to\": "); rbJsonStr(graph->nodes[ed->to]);
+                rbStr(", \"fromAverage\": "); rbFixed2(ed->fromAverage);
+                rbStr(", \"band\": \""); rbStr(bandNames[ed->band]); rbStr("\"}");
+            }
+            rbStr("]}");
+        }
+        rbStr(n ? "\n]}\n" : "]}\n");
+        break;
+
+    case REPORT_CSV:
+        rbStr("scenario,overall,change,lowest,lowest_average,changed,impacts,resolved,ignored,new_impacts\n");
+        for (int i = 0; i < n; ++i) {
+            const ScenarioResult *r = &res[i];
+            rbCsvStr(scenarios[i].name ? scenarios[i].name : ""); rbStr(",");
+            rbFixed2(r->overall); rbStr(",");
+            rbFixed2(r->overall - base.overall); rbStr(",");
+            if (r->lowest >= 0) { rbCsvStr(graph->nodes[r->lowest]); rbStr(","); rbFixed2(r->lowestAverage); }
+            else rbStr(",");
+            rbStr(","); rbInt(r->changed);
+            rbStr(","); rbInt(r->numImpacts);
+            rbStr(","); rbInt(r->numResolved);
+            rbStr(","); rbInt(r->ignored);
+            rbStr(","); rbImpactList(graph, edges + r->firstNewImpact, r->numNewImpacts);
+            rbStr("\n");
+        }
+        break;
+
+    default:
+        rbPrintf("\n=== What-if Scenarios (%d) ===\n", n);
+        rbStr("Baseline: overall "); rbStr(bandColour(graph, perfBand(base.overall)));
+        rbFixed2(base.overall); rbStr("%"); rbStr(colourReset(graph));
+        if (base.lowest >= 0) {
+            rbStr(", lowest "); rbStr(graph->nodes[base.lowest]); rbStr(" (");
+            rbFixed2(base.lowestAverage); rbStr("%)");
+        }
+        rbPrintf(", %d impact edge%s\n", base.numImpacts, base.numImpacts == 1 ? "" : "s");
+        for (int i = 0; i < n; ++i) {
+            const ScenarioResult *r = &res[i];
+            float change = r->overall - base.overall;
+            rbStr("\n"); rbStr(scenarios[i].name ? scenarios[i].name : "(unnamed)");
+            rbStr(": overall "); rbStr(bandColour(graph, perfBand(r->overall)));
+            rbFixed2(r->overall); rbStr("%"); rbStr(colourReset(graph));
+            rbStr(change < 0.0f ? " (" : " (+"); rbFixed2(change); rbStr(")");
+            if (r->lowest >= 0) {
+                rbStr(", lowest "); rbStr(graph->nodes[r->lowest]); rbStr(" (");
+                rbFixed2(r->lowestAverage); rbStr("%)");
+            }
+            rbPrintf(", %d perspective%s changed\n", r->changed, r->changed == 1 ? "" : "s");
+            for (int e = 0; e < r->numNewImpacts; ++e) {
+                const ImpactEdge *ed = &edges[r->firstNewImpact + e];
+                rbStr("  new impact: "); rbStr(graph->nodes[ed->from]); rbStr(" -> ");
+                rbStr(graph->nodes[ed->to]); rbStr(" ("); rbStr(graph->nodes[ed->from]); rbStr(" at ");
+                rbStr(bandColour(graph, ed->band)); rbFixed2(ed->fromAverage); rbStr("%");
+                rbStr(colourReset(graph)); rbStr(")\n");
+            }
+            if (r->numResolved)
+                rbPrintf("  %d baseline impact%s resolved\n", r->numResolved, r->numResolved == 1 ? "" : "s");
+            if (r->ignored)
+                rbPrintf("  %d override%s ignored (unknown KPI or invalid value)\n", r->ignored, r->ignored == 1 ? "" : "s");
+        }
+        break;
+    }
+    rbFlush();
+    free(res);
+    free(edges);
+}
+
+/* ---------- Scorecard hierarchy ---------- */
+
+void initHierarchy(Hierarchy *h) {
+    if (!h) return;
+    h->units = NULL;
+    h->numUnits = h->capUnits = 0;
+    initGraph(&h->unitNames);
+    initGraph(&h->perspectives);
+    h->capStats = 0;
+    h->period = PERIOD_LATEST;
+    h->rolled = 0;
+    h->maxDepth = 0;
+    h->order = NULL;
+    h->pool = NULL;
+}
+
+int findUnit(const Hierarchy *h, const char *name) {
+    if (!h || !name) return -1;
+    return findPerspective(&h->unitNames, name);
+}
+
+Graph *unitGraph(Hierarchy *h, int unit) {
+    if (!h || unit < 0 || unit >= h->numUnits) return NULL;
+    return &h->units[unit]->graph;
+}
+
+/* totals of unit and its ancestors are out of date */
+static void markPathStale(Hierarchy *h, int unit) {
+    for (; unit != -1 && !h->units[unit]->stale; unit = h->units[unit]->parent)
+        h->units[unit]->stale = 1;
+}
+
+int addUnit(Hierarchy *h, const char *name, const char *parent) {
+    if (!h || !name || name[0] == '\0' || findUnit(h, name) != -1) return -1;
+    int p = -1;
+    if (parent && parent[0] != '\0' && (p = findUnit(h, parent)) == -1) return -1;
+
+    if (h->numUnits == h->capUnits) {
+        h->capUnits = h->capUnits ? h->capUnits * 2 : 16;
+        h->units = xrealloc(h->units, (size_t)h->capUnits * sizeof(*h->units));
+        h->order = xrealloc(h->order, (size_t)h->capUnits * sizeof(int));
+    }
+    ScorecardUnit *u = xrealloc(NULL, sizeof(*u));
+    memset(u, 0, sizeof(*u));
+    strncpy(u->name, name, MAX_NAME_LEN - 1);
+    initGraph(&u->graph);
+    u->parent = p;
+    u->depth = p == -1 ? 0 : h->units[p]->depth + 1;
+    u->own = xrealloc(NULL, (size_t)(h->capStats ? h->capStats : 1) * sizeof(KPIBatchStats));
+    u->total = xrealloc(NULL, (size_t)(h->capStats ? h->capStats : 1) * sizeof(KPIBatchStats));
+    memset(u->own, 0, (size_t)h->capStats * sizeof(KPIBatchStats));
+    memset(u->total, 0, (size_t)h->capStats * sizeof(KPIBatchStats));
+    u->seenVersion = u->graph.version;
+    u->ownDirty = 1;
+
+    int id = h->numUnits++;
+    h->units[id] = u;
+    addPerspectiveIfNotExists(&h->unitNames, name);
+    if (p != -1) {
+        ScorecardUnit *pu = h->units[p];
+        if (pu->numChildren == pu->capChildren) {
+            pu->capChildren = pu->capChildren ? pu->capChildren * 2 : 4;
+            pu->children = xrealloc(pu->children, (size_t)pu->capChildren * sizeof(int));
+        }
+        pu->children[pu->numChildren++] = id;
+    }
+    if (u->depth > h->maxDepth) h->maxDepth = u->depth;
+    markPathStale(h, id);
+    return id;
+}
+
+void setRollupThreads(Hierarchy *h, int threads) {
+    if (!h) return;
+    if (threads < 1) threads = 1;
+    if (threads > EVAL_MAX_THREADS) threads = EVAL_MAX_THREADS;
+    int current = h->pool ? h->pool->threads : 1;
+    if (threads == current) return;
+    poolStop(h->pool);
+    h->pool = threads > 1 ? poolStart(threads) : NULL;
+}
+
+/* roll-up pass context: tasks index into ids */
+typedef struct RollupJob {
+    Hierarchy *h;
+    const int *ids;
+    int numPersp;
+} RollupJob;
+
+/* a unit's own KPIs, per hierarchy perspective */
+static void rollupOwnTask(void *ctx, int t) {
+    RollupJob *job = (RollupJob*)ctx;
+    ScorecardUnit *u = job->h->units[job->ids[t]];
+    memset(u->own, 0, (size_t)job->numPersp * sizeof(KPIBatchStats));
+    for (int i = 0; i < u->graph.numNodes; ++i) {
+        KPIBatchStats st;
+        nodeStatsChunked(&u->graph, u->graph.pers[i], job->h->period, &st);
+        mergeStats(&u->own[u->globalId[i]], &st);
+    }
+    u->seenVersion = u->graph.version;
+    u->ownDirty = 0;
+}
+
+/* a unit's totals from its own stats and its children's totals */
+static void rollupMergeTask(void *ctx, int t) {
+    RollupJob *job = (RollupJob*)ctx;
+    ScorecardUnit *u = job->h->units[job->ids[t]];
+    memcpy(u->total, u->own, (size_t)job->numPersp * sizeof(KPIBatchStats));
+    for (int c = 0; c < u->numChildren; ++c) {
+        const KPIBatchStats *ct = job->h->units[u->children[c]]->total;
+        for (int i = 0; i < job->numPersp; ++i) mergeStats(&u->total[i], &ct[i]);
+    }
+    u->stale = 0;
+}
+
+int rollup(Hierarchy *h, int32_t period) {
+    if (!h) return 0;
+    int forceAll = !h->rolled || period != h->period;
+    h->period = period;
+    h->rolled = 1;
+
+    /* find the changed units and give their new perspectives hierarchy ids */
+    for (int id = 0; id < h->numUnits; ++id) {
+        ScorecardUnit *u = h->units[id];
+        if (forceAll || u->graph.version != u->seenVersion) u->ownDirty = 1;
+        if (!u->ownDirty) continue;
+        if (u->graph.numNodes > u->mapped) {
+            u->globalId = xrealloc(u->globalId, (size_t)u->graph.numNodes * sizeof(int));
+            for (; u->mapped < u->graph.numNodes; ++u->mapped) {
+                addPerspectiveIfNotExists(&h->perspectives, u->graph.nodes[u->mapped]);
+                u->globalId[u->mapped] = findPerspective(&h->perspectives, u->graph.nodes[u->mapped]);
+            }
+        }
+        markPathStale(h, id);
+    }
+    int numPersp = h->perspectives.numNodes;
+    if (numPersp > h->capStats) {
+        int cap = h->capStats ? h->capStats : 4;
+        while (cap < numPersp) cap *= 2;
+        for (int id = 0; id < h->numUnits; ++id) {
+            ScorecardUnit *u = h->units[id];
+            u->own = xrealloc(u->own, (size_t)cap * sizeof(KPIBatchStats));
+            u->total = xrealloc(u->total, (size_t)cap * sizeof(KPIBatchStats));
+            memset(u->own + h->capStats, 0, (size_t)(cap - h->capStats) * sizeof(KPIBatchStats));
+            memset(u->total + h->capStats, 0, (size_t)(cap - h->capStats) * sizeof(KPIBatchStats));
+        }
+        h->capStats = cap;
+    }
+
+    /* own stats of every changed unit, in parallel */
+    RollupJob job = { h, h->order, numPersp };
+    int n = 0;
+    for (int id = 0; id < h->numUnits; ++id)
+        if (h->units[id]->ownDirty) h->order[n++] = id;
+    poolRun(h->pool, rollupOwnTask, &job, n);
+
+    /* totals bottom-up: every stale unit of one depth at once (their
+       children sit one level deeper and are already done) */
+    int recomputed = 0;
+    for (int depth = h->maxDepth; depth >= 0; --depth) {
+        n = 0;
+        for (int id = 0; id < h->numUnits; ++id)
+            if (h->units[id]->stale && h->units[id]->depth == depth) h->order[n++] = id;
+        poolRun(h->pool, rollupMergeTask, &job, n);
+        recomputed += n;
+    }
+    return recomputed;
+}
+
+int queryRollup(const Hierarchy *h, int unit, PerspectiveResult *out, int cap) {
+    if (!h || unit < 0 || unit >= h->numUnits) return 0;
+    const ScorecardUnit *u = h->units[unit];
+    int n = h->rolled ? h->perspectives.numNodes : 0;
+    for (int i = 0; i < n && i < cap; ++i)
+        fillPerspective(&h->perspectives, i, u->total[i].sumPerf, u->total[i].count, &out[i]);
+    return n;
+}
+
+/* one unit and its subtree in the report format */
+static void renderUnit(const Hierarchy *h, int unit, int first) {
+    const Graph *fmt = &h->perspectives;
+    const ScorecardUnit *u = h->units[unit];
+    int np = h->perspectives.numNodes;
+    long kpis = 0;
+    for (int i = 0; i < np; ++i) kpis += u->total[i].count;
+
+    switch (fmt->format) {
+    case REPORT_JSON:
+        rbStr(first ? "{\"unit\": " : ", {\"unit\": "); rbJsonStr(u->name);
+        rbStr(", \"kpis\": "); rbInt(kpis);
+        rbStr(", \"perspectives\": [");
+        for (int i = 0; i < np; ++i) {
+            const KPIBatchStats *t = &u->total[i];
+            rbStr(i ? ", {\"name\": " : "{\"name\": "); rbJsonStr(h->perspectives.nodes[i]);
+            rbStr(", \"kpis\": "); rbInt(t->count);
+            if (t->count > 0) {
+                float avg = perfAverage(t->sumPerf, t->count);
+                rbStr(", \"average\": "); rbFixed2(avg);
+                rbStr(", \"band\": \""); rbStr(bandNames[perfBand(avg)]); rbStr("\"");
+            } else {
+                rbStr(", \"average\": null, \"band\": null");
+            }
+            for (int b = 0; b < BAND_COUNT; ++b) {
+                rbStr(", \""); rbStr(bandNames[b]); rbStr("\": "); rbInt(t->bands[b]);
+            }
+            rbStr("}");
+        }
+        rbStr("], \"children\": [");
+        for (int c = 0; c < u->numChildren; ++c) renderUnit(h, u->children[c], c == 0);
+        rbStr("]}");
+        return;
+
+    case REPORT_CSV:
+        for (int i = 0; i < np; ++i) {
+            const KPIBatchStats *t = &u->total[i];
+            rbCsvStr(u->name); rbStr(",");
+            if (u->parent != -1) rbCsvStr(h->units[u->parent]->name);
+            rbStr(","); rbInt(u->depth); rbStr(",");
+            rbCsvStr(h->perspectives.nodes[i]); rbStr(","); rbInt(t->count); rbStr(",");
+            if (t->count > 0) {
+                float avg = perfAverage(t->sumPerf, t->count);
+                rbFixed2(avg); rbStr(","); rbStr(bandNames[perfBand(avg)]);
+            } else {
+                rbStr(",");
+            }
+            for (int b = 0; b < BAND_COUNT; ++b) { rbStr(","); rbInt(t->bands[b]); }
+            rbStr("\n");
+        }
+        break;
+
+    default:
+        for (int d = 0; d < u->depth; ++d) rbStr("  ");
+        rbStr(u->name); rbStr(" ("); rbInt(kpis); rbStr(" KPIs)\n");
+        for (int d = 0; d <= u->depth; ++d) rbStr("  ");
+        for (int i = 0, shown = 0; i < np; ++i) {
+            const KPIBatchStats *t = &u->total[i];
+            if (t->count == 0) continue;
+            float avg = perfAverage(t->sumPerf, t->count);
+            if (shown++) rbStr(" | ");
+            rbStr(h->perspectives.nodes[i]); rbStr(": ");
+            rbStr(bandColour(fmt, perfBand(avg))); rbFixed2(avg); rbStr("%"); rbStr(colourReset(fmt));
+        }
+        if (kpis == 0) rbStr("(No KPI data)");
+        rbStr("\n");
+        break;
+    }
+    for (int c = 0; c < u->numChildren; ++c) renderUnit(h, u->children[c], 0);
+}
+
+void showRollup(const Hierarchy *h, int unit) {
+    if (!h) return;
+    ReportFormat f = h->perspectives.format;
+    if (f == REPORT_JSON) {
+        rbStr("{\"report\": \"rollup\", \"period\": ");
+        if (h->rolled && h->period != PERIOD_LATEST) rbInt(h->period); else rbStr("null");
+        rbStr(", \"units\": [");
+    } else if (f == REPORT_CSV) {
+        rbStr("unit,parent,depth,perspective,kpis,average,band,red,amber,green,blue\n");
+    } else if (h->rolled && h->period != PERIOD_LATEST) {
+        rbPrintf("\n=== Business Unit Roll-up for period %d ===\n", (int)h->period);
+    } else {
+        rbStr("\n=== Business Unit Roll-up ===\n");
+    }
+    if (!h->rolled || h->numUnits == 0) {
+        if (f <= REPORT_PLAIN) rbStr("No business units rolled up yet.\n");
+    } else if (unit >= 0 && unit < h->numUnits) {
+        renderUnit(h, unit, 1);
+    } else {
+        int first = 1;
+        for (int id = 0; id < h->numUnits; ++id) {
+            if (h->units[id]->parent != -1) continue;
+            renderUnit(h, id, first);
+            first = 0;
+        }
+    }
+    if (f == REPORT_JSON) rbStr("]}\n");
+    rbFlush();
+}
+
+void freeHierarchy(Hierarchy *h) {
+    if (!h) return;
+    for (int id = 0; id < h->numUnits; ++id) {
+        ScorecardUnit *u = h->units[id];
+        freeAll(&u->graph);
+        free(u->children);
+        free(u->globalId);
+        free(u->own);
+        free(u->total);
+        free(u);
+    }
+    free(h->units);
+    free(h->order);
+    poolStop(h->pool);
+    ReportFormat format = h->perspectives.format;
+    freeAll(&h->unitNames);
+    freeAll(&h->perspectives);
+    initHierarchy(h);
+    h->perspectives.format = format;
+}
+
+/* ---------- Stats report ---------- */
+
+static const char *const statOpNames[STAT_OP_COUNT] = {
+    "find-perspective", "insert-kpi", "score-perspective",
+    "query-perspectives", "evaluate", "render", "distribution"
+};
+
+#ifdef BSC_STATS
+#define STAT_WORDS (sizeof(BscStats) / sizeof(uint64_t))
+
+/* the max fields merge by maximum, everything else by sum */
+static int statIsMax(size_t word) {
+    static const size_t maxOffsets[] = {
+        offsetof(BscStats, treeInsertMaxDepth), offsetof(BscStats, treeSearchMaxDepth)
+    };
+    size_t off = word * sizeof(uint64_t);
+    if (off < sizeof(((BscStats *)0)->op))
+        return off % sizeof(OpStats) == offsetof(OpStats, maxNs);
+    for (size_t i = 0; i < sizeof(maxOffsets) / sizeof(maxOffsets[0]); ++i)
+        if (off == maxOffsets[i]) return 1;
+    return 0;
+}
+#endif
+
+int getStats(BscStats *out) {
+#ifdef BSC_STATS
+    if (!out) return 0;
+    uint64_t *sum = (uint64_t *)out;
+    memset(out, 0, sizeof(*out));
+    pthread_mutex_lock(&statLock);
+    for (StatBlock *b = statBlocks; b; b = b->next) {
+        uint64_t *w = (uint64_t *)&b->s;
+        for (size_t i = 0; i < STAT_WORDS; ++i) {
+            uint64_t v = __atomic_load_n(&w[i], __ATOMIC_RELAXED);
+            if (!statIsMax(i)) sum[i] += v;
+            else if (v > sum[i]) sum[i] = v;
+        }
+    }
+    pthread_mutex_unlock(&statLock);
+    return 0;
+#else
+    if (out) memset(out, 0, sizeof(*out));
+    return -1;
+#endif
+}
+
+void resetStats(void) {
+#ifdef BSC_STATS
+    pthread_mutex_lock(&statLock);
+    for (StatBlock *b = statBlocks; b; b = b->next) {
+        uint64_t *w = (uint64_t *)&b->s;
+        for (size_t i = 0; i < STAT_WORDS; ++i) __atomic_store_n(&w[i], 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&statLock);
+#endif
+}
+
+static void rbU64(uint64_t v) { rbPrintf("%" PRIu64, v); }
+
+/* mean as "x.yy" (0 when there were no samples) */
+static void rbMean(uint64_t total, uint64_t n) {
+    rbFixed2(n ? (float)((double)total / (double)n) : 0.0f);
+}
+
+/* label of a latency bucket: its lower bound */
+static void rbBucket(int b) {
+    uint64_t lo = b ? (uint64_t)1 << (b - 1) : 0;
+    if (lo >= 1000000000u) rbPrintf("%" PRIu64 " s", lo / 1000000000u);
+    else if (lo >= 1000000u) rbPrintf("%" PRIu64 " ms", lo / 1000000u);
+    else if (lo >= 1000u) rbPrintf("%" PRIu64 " us", lo / 1000u);
+    else rbPrintf("%" PRIu64 " ns", lo);
+}
+
+void showStats(const Graph *graph, int histograms) {
+    ReportFormat fmt = graph ? graph->format : REPORT_COLOR;
+    BscStats st;
+    if (getStats(&st) != 0) {
+        if (fmt == REPORT_JSON) rbStr("{\"report\": \"stats\", \"enabled\": false}\n");
+        else if (fmt == REPORT_CSV) rbStr("metric,value\nenabled,0\n");
+        else rbStr("Statistics are not compiled in (rebuild with -DBSC_STATS).\n");
+        rbFlush();
+        return;
+    }
+
+    static const char *const counterNames[] = {
+        "index_lookups", "index_probes", "tree_inserts", "tree_insert_depth", "tree_insert_max_depth",
+        "tree_searches", "tree_search_depth", "tree_search_max_depth", "kpis_visited",
+        "alloc_calls", "alloc_bytes"
+    };
+    const uint64_t counters[] = {
+        st.indexLookups, st.indexProbes, st.treeInserts, st.treeInsertDepth, st.treeInsertMaxDepth,
+        st.treeSearches, st.treeSearchDepth, st.treeSearchMaxDepth, st.kpisVisited,
+        st.allocCalls, st.allocBytes
+    };
+    int numCounters = (int)(sizeof(counters) / sizeof(counters[0]));
+
+    switch (fmt) {
+    case REPORT_JSON:
+        rbStr("{\"report\": \"stats\", \"enabled\": true, \"operations\": [");
+        for (int i = 0; i < STAT_OP_COUNT; ++i) {
+            const OpStats *o = &st.op[i];
+            rbStr(i ? ",\n  {\"op\": \"" : "\n  {\"op\": \""); rbStr(statOpNames[i]);
+            rbStr("\", \"calls\": "); rbU64(o->calls);
+            rbStr(", \"timed\": "); rbU64(o->timed);
+            rbStr(", \"total_ns\": "); rbU64(o->ns);
+            rbStr(", \"max_ns\": "); rbU64(o->maxNs);
+            if (histograms) {
+                /* [bucket lower bound in ns, count] for the non-empty buckets */
+                rbStr(", \"histogram\": [");
+                for (int b = 0, any = 0; b < STAT_HIST_BUCKETS; ++b) {
+                    if (!o->hist[b]) continue;
+                    rbStr(any ? ", [" : "["); rbU64(b ? (uint64_t)1 << (b - 1) : 0);
+                    rbStr(", "); rbU64(o->hist[b]); rbStr("]");
+                    any = 1;
+                }
+                rbStr("]");
+            }
+            rbStr("}");
+        }
+        rbStr("\n]");
+        for (int i = 0; i < numCounters; ++i) {
+            rbStr(", \""); rbStr(counterNames[i]); rbStr("\": "); rbU64(counters[i]);
+        }
+        rbStr("}\n");
+        break;
+
+    case REPORT_CSV:
+        /* one metric per row: op.calls / op.timed / op.total_ns / op.max_ns /
+           op.hist_<lower ns>; the last three cover the timed calls */
+        rbStr("metric,value\nenabled,1\n");
+        for (int i = 0; i < STAT_OP_COUNT; ++i) {
+            const OpStats *o = &st.op[i];
+            rbStr(statOpNames[i]); rbStr(".calls,"); rbU64(o->calls); rbStr("\n");
+            rbStr(statOpNames[i]); rbStr(".timed,"); rbU64(o->timed); rbStr("\n");
+            rbStr(statOpNames[i]); rbStr(".total_ns,"); rbU64(o->ns); rbStr("\n");
+            rbStr(statOpNames[i]); rbStr(".max_ns,"); rbU64(o->maxNs); rbStr("\n");
+            for (int b = 0; histograms && b < STAT_HIST_BUCKETS; ++b) {
+                if (!o->hist[b]) continue;
+                rbStr(statOpNames[i]); rbStr(".hist_"); rbU64(b ? (uint64_t)1 << (b - 1) : 0);
+                rbStr(","); rbU64(o->hist[b]); rbStr("\n");
+            }
+        }
+        for (int i = 0; i < numCounters; ++i) {
+            rbStr(counterNames[i]); rbStr(","); rbU64(counters[i]); rbStr("\n");
+        }
+        break;
+
+    default:
+        rbStr("\n--- Core Statistics ---\n");
+        /* times come from the timed calls; total ms scales their mean to all calls */
+        rbPrintf("%-20s %12s %12s %14s %12s %12s\n", "operation", "calls", "timed", "total ms",
+                 "avg ns", "max ns");
+        for (int i = 0; i < STAT_OP_COUNT; ++i) {
+            const OpStats *o = &st.op[i];
+            double avg = o->timed ? (double)o->ns / (double)o->timed : 0.0;
+            rbPrintf("%-20s %12" PRIu64 " %12" PRIu64 " %14.3f %12.1f %12" PRIu64 "\n", statOpNames[i],
+                     o->calls, o->timed, avg * (double)o->calls / 1e6, avg, o->maxNs);
+        }
+        rbStr("\nPerspective index : "); rbU64(st.indexLookups); rbStr(" lookups, ");
+        rbMean(st.indexProbes, st.indexLookups); rbStr(" probes each\n");
+        rbStr("Perspective tree  : "); rbU64(st.treeInserts); rbStr(" inserts (depth avg ");
+        rbMean(st.treeInsertDepth, st.treeInserts); rbStr(", max "); rbU64(st.treeInsertMaxDepth);
+        rbStr("), "); rbU64(st.treeSearches); rbStr(" searches (depth avg ");
+        rbMean(st.treeSearchDepth, st.treeSearches); rbStr(", max "); rbU64(st.treeSearchMaxDepth);
+        rbStr(")\n");
+        rbStr("KPIs visited      : "); rbU64(st.kpisVisited); rbStr("\n");
+        rbStr("Allocations       : "); rbU64(st.allocCalls); rbStr(" calls, ");
+        rbFixed2((float)((double)st.allocBytes / (1024.0 * 1024.0))); rbStr(" MiB requested\n");
+
+        for (int i = 0; histograms && i < STAT_OP_COUNT; ++i) {
+            const OpStats *o = &st.op[i];
+            if (!o->timed) continue;
+            uint64_t peak = 0;
+            for (int b = 0; b < STAT_HIST_BUCKETS; ++b) if (o->hist[b] > peak) peak = o->hist[b];
+            rbStr("\nLatency of "); rbStr(statOpNames[i]); rbStr(" (timed calls per bucket, lower bound)\n");
+            for (int b = 0; b < STAT_HIST_BUCKETS; ++b) {
+                if (!o->hist[b]) continue;
+                rbStr("  >= ");
+                size_t mark = reportBuf.len;
+                rbBucket(b);
+                for (size_t pad = reportBuf.len - mark; pad < 8; ++pad) rbStr(" ");
+                rbPrintf(" %12" PRIu64 " ", o->hist[b]);
+                int bar = (int)((o->hist[b] * 40 + peak - 1) / peak);
+                for (int k = 0; k < bar; ++k) rbStr("#");
+                rbStr("\n");
+            }
+        }
+        break;
+    }
+    rbFlush();
+}
+
+void evaluatePerformanceWithDependencies(const Graph *graph) {
+    evaluatePerformanceForPeriod(graph, PERIOD_LATEST);
+}
+
+void evaluatePerformanceForPeriod(const Graph *graph, int32_t period) {
+    if (!graph) return;
+    if (!graph->bstRoot || graph->numNodes == 0) {
+        rbStr("No data to evaluate.\n");
+        rbFlush();
+        return;
+    }
+
+    /* the report renders the query API's results; a first summary with
+       no room for edges tells how many impact edges there are */
+    STAT_START(STAT_RENDER, t0);
+    int n = graph->numNodes;
+    PerspectiveResult *res = xrealloc(NULL, (size_t)n * sizeof(PerspectiveResult));
+    ImpactEdge *imp = NULL;
+    EvaluationResult ev;
+    queryEvaluation(graph, period, res, n, NULL, 0, &ev);
+    if (ev.numImpacts > 0) {
+        imp = xrealloc(NULL, (size_t)ev.numImpacts * sizeof(ImpactEdge));
+        summariseEvaluation(graph, res, imp, ev.numImpacts, &ev);
+    }
+
+    switch (graph->format) {
+    case REPORT_JSON:
+        rbStr("{\"report\": \"evaluation\", \"period\": ");
+        if (period != PERIOD_LATEST) rbInt(period); else rbStr("null");
+        rbStr(", \"perspectives\": [");
+        for (int i = 0; i < n; ++i) {
+            rbStr(i ? ",\n  {\"name\": " : "\n  {\"name\": ");
+            rbJsonStr(res[i].name);
+            rbStr(", \"kpis\": "); rbInt(res[i].kpiCount);
+            if (res[i].kpiCount > 0) {
+                rbStr(", \"average\": "); rbFixed2(res[i].average);
+                rbStr(", \"band\": \""); rbStr(bandNames[res[i].band]); rbStr("\"}");
+            } else {
+                rbStr(", \"average\": null, \"band\": null}");
+            }
+        }
+        rbStr(n ? "\n], \"impacts\": [" : "], \"impacts\": [");
+        for (int k = 0; k < ev.numImpacts; ++k) {
+            rbStr(k ? ",\n  {\"from\": " : "\n  {\"from\": ");
+            rbJsonStr(graph->nodes[imp[k].from]);
+            rbStr(", \"to\": "); rbJsonStr(graph->nodes[imp[k].to]);
+            rbStr(", \"average\": "); rbFixed2(imp[k].fromAverage); rbStr("}");
+        }
+        rbStr(ev.numImpacts ? "\n], \"overall\": " : "], \"overall\": ");
+        rbFixed2(ev.overall);
+        rbStr(", \"lowest\": ");
+        if (ev.lowest != -1) {
+            rbStr("{\"name\": "); rbJsonStr(graph->nodes[ev.lowest]);
+            rbStr(", \"average\": "); rbFixed2(ev.lowestAverage); rbStr("}}\n");
+        } else {
+            rbStr("null}\n");
+        }
+        break;
+
+    case REPORT_CSV:
+        /* one row per perspective; impacts lists the perspectives a weak one may affect.
+           Edges come grouped by source in perspective order. */
+        rbStr("perspective,kpis,average,band,impacts\n");
+        for (int i = 0, k = 0; i < n; ++i) {
+            rbCsvStr(res[i].name); rbStr(","); rbInt(res[i].kpiCount); rbStr(",");
+            if (res[i].kpiCount > 0) { rbFixed2(res[i].average); rbStr(","); rbStr(bandNames[res[i].band]); }
+            else rbStr(",");
+            rbStr(",");
+            int first = k;
+            while (k < ev.numImpacts && imp[k].from == i) ++k;
+            if (k > first) {
+                char *list = xrealloc(NULL, (size_t)(k - first) * MAX_NAME_LEN);
+                size_t used = 0;
+                for (int e = first; e < k; ++e) {
+                    if (e > first) list[used++] = ';';
+                    size_t len = strlen(graph->nodes[imp[e].to]);
+                    memcpy(list + used, graph->nodes[imp[e].to], len);
+                    used += len;
+                }
+                list[used] = '\0';
+                rbCsvStr(list);
+                free(list);
+            }
+            rbStr("\n");
+        }
+        break;
+
+    default:
+        if (period != PERIOD_LATEST) rbPrintf("\n=== Evaluation for period %d ===\n", (int)period);
+
+        /* print averages */
+        rbStr("\n--- Perspective Averages ---\n");
+        for (int i = 0; i < n; ++i) {
+            rbStr(res[i].name);
+            if (res[i].kpiCount > 0) {
+                rbStr(": "); rbStr(bandColour(graph, res[i].band));
+                rbFixed2(res[i].average); rbStr("%"); rbStr(colourReset(graph)); rbStr("\n");
+            } else {
+                rbStr(": (No KPI data)\n");
+            }
+        }
+
+        /* dependency impact analysis */
+        rbStr("\n--- Dependency Impact Analysis ---\n");
+        for (int k = 0; k < ev.numImpacts; ++k) {
+            rbStr(bandColour(graph, imp[k].band)); rbStr("Low performance in ");
+            rbStr(graph->nodes[imp[k].from]);
+            rbStr(" ("); rbFixed2(imp[k].fromAverage); rbStr("%) may affect ");
+            rbStr(graph->nodes[imp[k].to]); rbStr("."); rbStr(colourReset(graph)); rbStr("\n");
+        }
+        if (ev.numImpacts == 0)
+            rbStr("No dependency impacts detected based on current averages (threshold: < 80%).\n");
+
+        rbStr("\nOverall Performance: "); rbFixed2(ev.overall); rbStr("%\n");
+        if (ev.lowest != -1) {
+            rbStr("Lowest Performing Perspective: "); rbStr(graph->nodes[ev.lowest]);
+            rbStr(" ("); rbStr(bandColour(graph, res[ev.lowest].band));
+            rbFixed2(ev.lowestAverage); rbStr("%"); rbStr(colourReset(graph)); rbStr(")\n");
+        } else {
+            rbStr("No perspective had KPI data to determine lowest performer.\n");
+        }
+        break;
+    }
+    rbFlush();
+
+    free(res);
+    free(imp);
+    STAT_STOP(STAT_RENDER, t0);
+}
+
+/* ---------- Transitive dependency impact ---------- */
+
+/* Tarjan's strongly connected components, iterative so deep dependency
+   chains cannot overflow the C stack. comp[v] receives the component id;
+   components are numbered in reverse topological order (sinks first).
+   Returns the number of components. */
+static int findComponents(const Graph *graph, int *comp) {
+    int n = graph->numNodes;
+    int *order = xrealloc(NULL, (size_t)n * sizeof(int));
+    int *low = xrealloc(NULL, (size_t)n * sizeof(int));
+    int *stk = xrealloc(NULL, (size_t)n * sizeof(int));
+    int *callV = xrealloc(NULL, (size_t)n * sizeof(int));
+    int *callE = xrealloc(NULL, (size_t)n * sizeof(int));
+    char *onStk = xrealloc(NULL, (size_t)n);
+    for (int v = 0; v < n; ++v) { order[v] = -1; onStk[v] = 0; }
+
+    int counter = 0, sp = 0, ncomp = 0;
+    for (int s = 0; s < n; ++s) {
+        if (order[s] != -1) continue;
+        int csp = 0;
+        order[s] = low[s] = counter++;
+        stk[sp++] = s; onStk[s] = 1;
+        callV[csp] = s; callE[csp] = 0; csp++;
+        while (csp > 0) {
+            int v = callV[csp-1];
+            const AdjList *a = &graph->adj[v];
+            if (callE[csp-1] < a->count) {
+                int w = a->to[callE[csp-1]++];
+                if (order[w] == -1) {
+                    order[w] = low[w] = counter++;
+                    stk[sp++] = w; onStk[w] = 1;
+                    callV[csp] = w; callE[csp] = 0; csp++;
+                } else if (onStk[w] && order[w] < low[v]) {
+                    low[v] = order[w];
+                }
+                continue;
+            }
+            if (low[v] == order[v]) {
+                int w;
+                do { w = stk[--sp]; onStk[w] = 0; comp[w] = ncomp; } while (w != v);
+                ncomp++;
+            }
+            csp--;
+            if (csp > 0 && low[v] < low[callV[csp-1]]) low[callV[csp-1]] = low[v];
+        }
+    }
+    free(order); free(low); free(stk); free(callV); free(callE); free(onStk);
+    return ncomp;
+}
+
+/* per-perspective averages (0 when no KPI data), as printed by the evaluation */
+static void computeAverages(const Graph *graph, float *avg) {
+    for (int i = 0; i < graph->numNodes; ++i) {
+        const PersNode *node = graph->pers[i];
+        avg[i] = perfAverage(node->perfSum, node->perfCount);
+    }
+}
+
+/* Cycles, then what every under-80% perspective reaches downstream. JSON
+   lists both; CSV has a row per perspective: its average, the number of
+   the cycle it is in (empty if none) and, for a weak one, the perspectives
+   it reaches with their path lengths (';'-separated, in BFS order). */
+void evaluateTransitiveImpact(const Graph *graph) {
+    if (!graph) return;
+    if (graph->numNodes == 0) {
+        rbStr("No data to evaluate.\n");
+        rbFlush();
+        return;
+    }
+    ReportFormat fmt = graph->format;
+
+    int n = graph->numNodes;
+    int *comp = xrealloc(NULL, (size_t)n * sizeof(int));
+    int ncomp = findComponents(graph, comp);
+
+    /* group members by component (counting sort) */
+    int *start = xrealloc(NULL, (size_t)(ncomp + 1) * sizeof(int));
+    int *members = xrealloc(NULL, (size_t)n * sizeof(int));
+    memset(start, 0, (size_t)(ncomp + 1) * sizeof(int));
+    for (int v = 0; v < n; ++v) start[comp[v] + 1]++;
+    for (int c = 0; c < ncomp; ++c) start[c + 1] += start[c];
+    int *fill = xrealloc(NULL, (size_t)ncomp * sizeof(int));
+    memcpy(fill, start, (size_t)ncomp * sizeof(int));
+    for (int v = 0; v < n; ++v) members[fill[comp[v]]++] = v;
+    free(fill);
+
+    /* cycles: components with more than one member, or a self-edge;
+       numbered from 1 in component order */
+    int *cycle = xrealloc(NULL, (size_t)ncomp * sizeof(int));
+    int cycles = 0;
+    for (int c = 0; c < ncomp; ++c) {
+        int size = start[c + 1] - start[c];
+        int cyclic = size > 1;
+        if (size == 1) {
+            int v = members[start[c]];
+            const AdjList *a = &graph->adj[v];
+            for (int e = 0; e < a->count; ++e) if (a->to[e] == v) cyclic = 1;
+        }
+        cycle[c] = cyclic ? ++cycles : 0;
+    }
+    if (fmt == REPORT_JSON) {
+        rbStr("{\"report\": \"impact\", \"cycles\": [");
+        for (int c = 0; c < ncomp; ++c) {
+            if (!cycle[c]) continue;
+            rbStr(cycle[c] > 1 ? ",\n  [" : "\n  [");
+            for (int m = start[c]; m < start[c + 1]; ++m) {
+                if (m > start[c]) rbStr(", ");
+                rbJsonStr(graph->nodes[members[m]]);
+            }
+            rbStr("]");
+        }
+        rbStr(cycles ? "\n], \"impacts\": [" : "], \"impacts\": [");
+    } else if (fmt == REPORT_CSV) {
+        rbStr("perspective,average,band,cycle,reaches,path_lengths\n");
+    } else {
+        rbStr("\n--- Transitive Dependency Impact ---\n");
+        for (int c = 0; c < ncomp; ++c) {
+            if (!cycle[c]) continue;
+            rbStr(bandColour(graph, BAND_AMBER));
+            rbStr("Dependency cycle among: ");
+            for (int m = start[c]; m < start[c + 1]; ++m) {
+                if (m > start[c]) rbStr(", ");
+                rbStr(graph->nodes[members[m]]);
+            }
+            rbStr(colourReset(graph));
+            rbStr("\n");
+        }
+        if (!cycles) rbStr("No dependency cycles detected.\n");
+    }
+
+    /* every under-80% source: one BFS over what it reaches gives both the
+       downstream count and the shortest path lengths */
+    float *avg = xrealloc(NULL, (size_t)n * sizeof(float));
+    int *dist = xrealloc(NULL, (size_t)n * sizeof(int));
+    int *queue = xrealloc(NULL, (size_t)n * sizeof(int));
+    computeAverages(graph, avg);
+    for (int v = 0; v < n; ++v) dist[v] = -1;
+
+    int impacts = 0;
+    for (int i = 0; i < n; ++i) {
+        int tail = 0;
+        if (avg[i] > 0.0f && avg[i] < 80.0f) {
+            int head = 0;
+            dist[i] = 0;
+            queue[tail++] = i;
+            while (head < tail) {
+                int v = queue[head++];
+                const AdjList *a = &graph->adj[v];
+                for (int e = 0; e < a->count; ++e) {
+                    int w = a->to[e];
+                    if (dist[w] != -1) continue;
+                    dist[w] = dist[v] + 1;
+                    queue[tail++] = w;
+                }
+            }
+        }
+        int reached = tail > 1 ? tail - 1 : 0;      /* queue[0] is the source itself */
+        PerfBand band = perfBand(avg[i]);
+        if (fmt == REPORT_CSV) {
+            rbCsvStr(graph->nodes[i]); rbStr(",");
+            if (graph->pers[i]->perfCount > 0) { rbFixed2(avg[i]); rbStr(","); rbStr(bandNames[band]); }
+            else rbStr(",");
+            rbStr(",");
+            if (cycle[comp[i]]) rbInt(cycle[comp[i]]);
+            rbStr(",");
+            if (reached) {
+                char *list = xrealloc(NULL, (size_t)reached * MAX_NAME_LEN);
+                size_t used = 0;
+                for (int q = 1; q < tail; ++q) {
+                    if (q > 1) list[used++] = ';';
+                    size_t len = strlen(graph->nodes[queue[q]]);
+                    memcpy(list + used, graph->nodes[queue[q]], len);
+                    used += len;
+                }
+                list[used] = '\0';
+                rbCsvStr(list);
+                free(list);
+            }
+            rbStr(",");
+            for (int q = 1; q < tail; ++q) {
+                if (q > 1) rbStr(";");
+                rbInt(dist[queue[q]]);
+            }
+            rbStr("\n");
+        } else if (reached && fmt == REPORT_JSON) {
+            rbStr(impacts ? ",\n  {\"from\": " : "\n  {\"from\": ");
+            rbJsonStr(graph->nodes[i]);
+            rbStr(", \"average\": "); rbFixed2(avg[i]);
+            rbStr(", \"band\": \""); rbStr(bandNames[band]);
+            rbStr("\", \"reaches\": [");
+            for (int q = 1; q < tail; ++q) {
+                rbStr(q > 1 ? ", {\"name\": " : "{\"name\": ");
+                rbJsonStr(graph->nodes[queue[q]]);
+                rbStr(", \"path_length\": "); rbInt(dist[queue[q]]); rbStr("}");
+            }
+            rbStr("]}");
+        } else if (reached) {
+            rbStr(bandColour(graph, band));
+            rbStr("Low performance in "); rbStr(graph->nodes[i]);
+            rbStr(" ("); rbFixed2(avg[i]);
+            rbPrintf("%%) reaches %d downstream perspective(s):", reached);
+            rbStr(colourReset(graph)); rbStr("\n");
+            for (int q = 1; q < tail; ++q)
+                rbPrintf("  -> %s (path length %d)\n", graph->nodes[queue[q]], dist[queue[q]]);
+        }
+        if (reached) impacts++;
+        for (int q = 0; q < tail; ++q) dist[queue[q]] = -1;
+    }
+    if (fmt == REPORT_JSON)
+        rbStr(impacts ? "\n]}\n" : "]}\n");
+    else if (fmt != REPORT_CSV && !impacts)
+        rbStr("No transitive impacts detected based on current averages (threshold: < 80%).\n");
+    rbFlush();
+
+    free(comp); free(start); free(members); free(cycle);
+    free(avg); free(dist); free(queue);
+}
+
+/* ---------- Bulk KPI load (memory-mapped CSV/TSV) ---------- */
+
+/* read-only view of a whole file: mmap on POSIX, a heap copy elsewhere */
+typedef struct MappedFile {
+    const char *data;
+    size_t size;
+    void *base;     /* mapping or heap block to release */
+} MappedFile;
+
+static int mapFile(const char *path, MappedFile *mf) {
+    mf->data = NULL; mf->size = 0; mf->base = NULL;
+#ifdef _WIN32
+    FILE *f = fopen(path, "rb");
+    if (!f) return -1;
+    if (fseek(f, 0, SEEK_END) != 0) { fclose(f); return -1; }
+    long len = ftell(f);
+    rewind(f);
+    if (len < 0) { fclose(f); return -1; }
+    if (len > 0) {
+        mf->base = malloc((size_t)len);
+        if (!mf->base || fread(mf->base, 1, (size_t)len, f) != (size_t)len) {
+            free(mf->base); mf->base = NULL; fclose(f); return -1;
+        }
+    }
+    fclose(f);
+    mf->size = (size_t)len;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { close(fd); return -1; }
+    mf->size = (size_t)st.st_size;
+    if (mf->size > 0) {
+        void *m = mmap(NULL, mf->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) { close(fd); return -1; }
+        posix_madvise(m, mf->size, POSIX_MADV_SEQUENTIAL);
+        mf->base = m;
+    }
+    close(fd);
+#endif
+    mf->data = (const char*)mf->base;
+    return 0;
+}
+
+static void unmapFile(MappedFile *mf) {
+    if (!mf->base) return;
+#ifdef _WIN32
+    free(mf->base);
+#else
+    munmap(mf->base, mf->size);
+#endif
+    mf->base = NULL;
+    mf->data = NULL;
+    mf->size = 0;
+}
+
+/* copy the next delimited field of [*cur, end) into out, trimming surrounding
+   whitespace and honouring "double quoted" CSV fields ("" escapes a quote).
+   Sets *overflow when the field does not fit; advances *cur past the delimiter. */
+static void nextField(const char **cur, const char *end, char delim,
+                      char *out, size_t outlen, int *overflow) {
+    const char *p = *cur;
+    size_t n = 0;
+    *overflow = 0;
+    while (p < end && *p != delim && isspace((unsigned char)*p)) ++p;
+    if (p < end && *p == '"') {
+        ++p;
+        while (p < end) {
+            if (*p == '"') {
+                if (p + 1 < end && p[1] == '"') { ++p; }
+                else { ++p; break; }
+            }
+            if (n + 1 < outlen) out[n++] = *p; else *overflow = 1;
+            ++p;
+        }
+        while (p < end && *p != delim) ++p;
+    } else {
+        const char *start = p;
+        while (p < end && *p != delim) ++p;
+        const char *stop = p;
+        while (stop > start && isspace((unsigned char)stop[-1])) --stop;
+        size_t len = (size_t)(stop - start);
+        if (len >= outlen) { len = outlen - 1; *overflow = 1; }
+        memcpy(out, start, len);
+        n = len;
+    }
+    out[n] = '\0';
+    *cur = (p < end) ? p + 1 : end;
+}
+
+/* parse a whole field as a float; rejects empty input and trailing junk */
+static int parseFloatField(const char *s, float *out) {
+    char *endp;
+    if (*s == '\0') return 0;
+    *out = strtof(s, &endp);
+    return endp != s && *endp == '\0';
+}
+
+#define LOAD_MAX_REPORTED 20   /* rejected rows printed individually */
+
+int loadKPIsFromFile(Graph *graph, const char *path, LoadStats *stats) {
+    LoadStats st = {0, 0, 0, 0.0};
+    if (stats) *stats = st;
+    if (!graph || !path) return -1;
+
+    double t0 = nowSeconds();
+    MappedFile mf;
+    if (mapFile(path, &mf) != 0) {
+        message("Cannot read '%s'.\n", path);
+        return -1;
+    }
+
+    const char *p = mf.data;
+    const char *end = mf.data + mf.size;
+
+    /* TSV if the first line has a tab, CSV otherwise */
+    const char *firstEol = mf.size ? memchr(p, '\n', mf.size) : NULL;
+    if (!firstEol) firstEol = end;
+    char delim = (mf.size && memchr(p, '\t', (size_t)(firstEol - p))) ? '\t' : ',';
+
+    /* consecutive rows usually share a perspective (and, in history files,
+       a KPI): cache the last lookups */
+    char lastPers[MAX_NAME_LEN] = "";
+    PersNode *lastNode = NULL;
+    KPI *lastKpi = NULL;
+
+    long lineNo = 0;
+    int sawData = 0;
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) eol = end;
+        const char *lineEnd = eol;
+        if (lineEnd > p && lineEnd[-1] == '\r') --lineEnd;
+        const char *cur = p;
+        p = (eol < end) ? eol + 1 : end;
+        ++lineNo;
+
+        const char *q = cur;
+        while (q < lineEnd && isspace((unsigned char)*q)) ++q;
+        if (q == lineEnd) continue;                 /* blank line */
+
+        char fPers[MAX_NAME_LEN], fKpi[MAX_KPI_NAME_LEN], fTarget[32], fAchieved[32], fPeriod[16];
+        int ovPers, ovKpi, ovTarget, ovAchieved, ovPeriod = 0;
+        nextField(&cur, lineEnd, delim, fPers, sizeof(fPers), &ovPers);
+        nextField(&cur, lineEnd, delim, fKpi, sizeof(fKpi), &ovKpi);
+        nextField(&cur, lineEnd, delim, fTarget, sizeof(fTarget), &ovTarget);
+        nextField(&cur, lineEnd, delim, fAchieved, sizeof(fAchieved), &ovAchieved);
+        int dated = cur < lineEnd;
+        if (dated) nextField(&cur, lineEnd, delim, fPeriod, sizeof(fPeriod), &ovPeriod);
+        int extra = cur < lineEnd;
+
+        float target = 0.0f, achieved = 0.0f;
+        int targetOk = !ovTarget && parseFloatField(fTarget, &target);
+
+        /* a first row whose target column is not numeric is a header */
+        if (!sawData) {
+            sawData = 1;
+            if (!targetOk && !extra) continue;
+        }
+        st.rowsRead++;
+
+        const char *reason = NULL;
+        if (fPers[0] == '\0') reason = "perspective name cannot be empty";
+        else if (ovPers) reason = "perspective name too long";
+        else if (containsDigit(fPers)) reason = "perspective names cannot contain digits";
+        else if (fKpi[0] == '\0') reason = "KPI name cannot be empty";
+        else if (ovKpi) reason = "KPI name too long";
+        else if (extra) reason = "expected 4 or 5 fields (perspective, kpi, target, achieved[, period])";
+        else if (!targetOk || !validTarget(target)) reason = "target must be between 1 and 100";
+        else if (ovAchieved || !parseFloatField(fAchieved, &achieved) || !validAchieved(achieved))
+            reason = "invalid achieved value";
+        long period = 0;
+        if (!reason && dated) {
+            char *endp;
+            period = strtol(fPeriod, &endp, 10);
+            if (ovPeriod || endp == fPeriod || *endp != '\0' || period < 0 || period >= PERIOD_LATEST)
+                reason = "period must be a non-negative integer";
+        }
+
+        PersNode *pnode = NULL;
+        if (!reason) {
+            if (lastNode && strcmp(lastPers, fPers) == 0) {
+                pnode = lastNode;
+            } else {
+                int id = internPerspective(graph, fPers);
+                pnode = graph->pers[id];
+            }
+        }
+
+        if (reason) {
+            if (st.rowsRejected < LOAD_MAX_REPORTED)
+                message("  line %ld rejected: %s\n", lineNo, reason);
+            st.rowsRejected++;
+            continue;
+        }
+
+        if (pnode != lastNode) lastKpi = NULL;
+        strcpy(lastPers, fPers);
+        lastNode = pnode;
+        if (!dated) {
+            int created;
+            lastKpi = NULL;                         /* an insert may move the perspective's KPIs */
+            if (!putKPI(graph, pnode, fKpi, target, achieved, graph->duplicates, &created)) {
+                if (st.rowsRejected < LOAD_MAX_REPORTED)
+                    message("  line %ld rejected: KPI '%s' %s\n", lineNo, fKpi,
+                            refusedForHistory(graph, pnode, fKpi) ? "has a history and no period"
+                                                                  : "already exists");
+                st.rowsRejected++;
+                continue;
+            }
+        } else {
+            KPI *hint = (lastKpi && strcmp_ci(kpiNameOf(graph, lastKpi), fKpi) == 0) ? lastKpi : NULL;
+            lastKpi = recordObservation(graph, pnode, hint, fKpi, (int32_t)period, target, achieved);
+        }
+        st.rowsLoaded++;
+    }
+
+    unmapFile(&mf);
+    st.seconds = nowSeconds() - t0;
+
+    if (st.rowsRejected > LOAD_MAX_REPORTED)
+        message("  ... %ld more rejected rows not shown\n", st.rowsRejected - LOAD_MAX_REPORTED);
+    message("Loaded %ld of %ld rows from '%s' (%ld rejected) in %.3f s",
+           st.rowsLoaded, st.rowsRead, path, st.rowsRejected, st.seconds);
+    if (st.seconds > 0.0) message(" — %.0f rows/sec", (double)st.rowsRead / st.seconds);
+    message("\n");
+
+    if (stats) *stats = st;
+    return 0;
+}
+
+/* ---------- Binary snapshot (save / mmap load) ---------- */
+
+/* On-disk layout (native little-endian, every section 8-byte aligned):
+     SnapHeader
+     SnapPers[numPerspectives]        names in id order + KPI range
+     uint32 rowStart[numPerspectives+1], uint32 dest[numEdges]   (CSR edges)
+     SnapKPI[numKPIs]                 grouped by perspective, in list order
+     uint32 histCount[numKPIs]        observations per KPI, same order
+     KPIObservation[numObservations]  each KPI's history, oldest first
+     char names[nameBytes]            each distinct KPI name once, NUL-terminated
+   checksum covers every byte after the header and doubles as the snapshot's
+   identity; parent is the identity of the snapshot the graph was based on
+   when this one was written (lets a write-ahead log tell whether it has
+   already been folded in). Field offsets are identical on 32- and 64-bit
+   builds. Version 1 (no parent), 2 (no history) and 3 (KPI names inline,
+   SnapKPIFixed) files are still accepted. */
+#define SNAPSHOT_MAGIC      "BSCSNAP"
+#define SNAPSHOT_VERSION    4u
+#define SNAPSHOT_V1_HEADER  80u
+#define SNAPSHOT_V2_HEADER  88u
+#define SNAPSHOT_V3_HEADER  112u
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+typedef struct SnapHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t byteOrder;
+    uint32_t numPerspectives;
+    uint32_t numEdges;
+    uint32_t reserved;
+    uint64_t numKPIs;
+    uint64_t persOffset;
+    uint64_t edgeOffset;
+    uint64_t kpiOffset;
+    uint64_t fileSize;
+    uint64_t checksum;
+    uint64_t parent;        /* version 2+ */
+    uint64_t histOffset;    /* version 3+ */
+    uint64_t obsOffset;
+    uint64_t numObservations;
+    uint64_t nameOffset;    /* version 4+ */
+    uint64_t nameBytes;
+} SnapHeader;
+
+typedef struct SnapPers {
+    char name[MAX_NAME_LEN];
+    char pad[2];
+    uint32_t kpiCount;
+    uint64_t kpiStart;
+} SnapPers;
+
+typedef struct SnapKPI {
+    uint32_t name;          /* offset in the names section */
+    uint32_t nameLen;
+    float target;
+    float achieved;
+} SnapKPI;
+
+typedef struct SnapKPIFixed {   /* versions 1-3 */
+    char name[MAX_NAME_LEN];
+    char pad[2];
+    float target;
+    float achieved;
+} SnapKPIFixed;
+
+/* compile-time layout checks (negative array size on mismatch) */
+typedef char SnapHeaderSizeCheck[sizeof(SnapHeader) == 128 ? 1 : -1];
+typedef char SnapPersSizeCheck[sizeof(SnapPers) == 64 ? 1 : -1];
+typedef char SnapKPISizeCheck[sizeof(SnapKPI) == 16 ? 1 : -1];
+typedef char SnapKPIFixedSizeCheck[sizeof(SnapKPIFixed) == 60 ? 1 : -1];
+typedef char SnapObsSizeCheck[sizeof(KPIObservation) == 12 ? 1 : -1];
+
+static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+/* 64-bit checksum with four independent multiply-rotate lanes (xxHash64-style
+   rounds) so multi-megabyte snapshots verify at close to memory bandwidth */
+static uint64_t checksum64(const unsigned char *p, size_t n) {
+    const uint64_t P1 = 11400714785074694791ULL, P2 = 14029467366897019727ULL;
+    uint64_t v[4] = { P1 + P2, P2, 0, (uint64_t)0 - P1 };
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t w;
+            memcpy(&w, p + i + 8 * l, sizeof(w));
+            v[l] = rotl64(v[l] + w * P2, 31) * P1;
+        }
+    }
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18);
+    h += (uint64_t)n;
+    for (; i < n; ++i) h = (h ^ p[i]) * 1099511628211ULL;
+    h ^= h >> 33; h *= P2;
+    h ^= h >> 29; h *= P1;
+    h ^= h >> 32;
+    return h;
+}
+
+static uint64_t align8(uint64_t x) { return (x + 7) & ~(uint64_t)7; }
+
+/* write buf to path atomically: temp file, flush to disk, rename over */
+static int writeFileAtomic(const char *path, const void *buf, size_t len) {
+    size_t plen = strlen(path);
+    char *tmp = xrealloc(NULL, plen + 5);
+    memcpy(tmp, path, plen);
+    memcpy(tmp + plen, ".tmp", 5);
+    FILE *f = fopen(tmp, "wb");
+    if (!f) { free(tmp); return -1; }
+    int ok = fwrite(buf, 1, len, f) == len && fflush(f) == 0;
+#ifndef _WIN32
+    if (ok) ok = fsync(fileno(f)) == 0;
+#endif
+    if (fclose(f) != 0) ok = 0;
+#ifdef _WIN32
+    if (ok) remove(path);
+#endif
+    if (ok) ok = rename(tmp, path) == 0;
+    if (!ok) remove(tmp);
+    free(tmp);
+    return ok ? 0 : -1;
+}
+
+/* write a snapshot of graph; *id receives its checksum (identity) */
+static int writeSnapshot(const Graph *graph, const char *path, uint64_t *id) {
+    double t0 = nowSeconds();
+    uint32_t np = (uint32_t)graph->numNodes, ne = (uint32_t)graph->numEdges;
+    uint64_t nk = 0, no = 0, nb = 0;
+    /* names section offset of each pool handle in use (handles are 4-aligned) */
+    uint32_t *nameAt = xrealloc(NULL, ((size_t)graph->names.len / 4 + 1) * sizeof(uint32_t));
+    memset(nameAt, 0xff, ((size_t)graph->names.len / 4 + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < np; ++i) {
+        const PersNode *node = graph->pers[i];
+        for (const KPI *k = kpiFirst(node); k; k = kpiNext(node, k)) {
+            nk++;
+            if (k->history) no += (uint64_t)historyOf(graph, k)->count;
+            if (nameAt[k->name / 4] != UINT32_MAX) continue;
+            nameAt[k->name / 4] = (uint32_t)nb;
+            nb += strlen(kpiNameOf(graph, k)) + 1;
+        }
+    }
+
+    SnapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.headerSize = sizeof(SnapHeader);
+    hdr.byteOrder = SNAPSHOT_BYTE_ORDER;
+    hdr.parent = graph->snapshotId;
+    hdr.numPerspectives = np;
+    hdr.numEdges = ne;
+    hdr.numKPIs = nk;
+    hdr.persOffset = sizeof(SnapHeader);
+    hdr.edgeOffset = align8(hdr.persOffset + (uint64_t)np * sizeof(SnapPers));
+    hdr.kpiOffset = align8(hdr.edgeOffset + ((uint64_t)np + 1 + ne) * sizeof(uint32_t));
+    hdr.histOffset = align8(hdr.kpiOffset + nk * sizeof(SnapKPI));
+    hdr.obsOffset = align8(hdr.histOffset + nk * sizeof(uint32_t));
+    hdr.numObservations = no;
+    hdr.nameOffset = align8(hdr.obsOffset + no * sizeof(KPIObservation));
+    hdr.nameBytes = nb;
+    hdr.fileSize = hdr.nameOffset + nb;
+
+    unsigned char *buf = xrealloc(NULL, (size_t)hdr.fileSize);
+    memset(buf, 0, (size_t)hdr.fileSize);
+    SnapPers *sp = (SnapPers*)(buf + hdr.persOffset);
+    uint32_t *rowStart = (uint32_t*)(buf + hdr.edgeOffset);
+    uint32_t *dest = rowStart + np + 1;
+    SnapKPI *sk = (SnapKPI*)(buf + hdr.kpiOffset);
+    uint32_t *histCount = (uint32_t*)(buf + hdr.histOffset);
+    KPIObservation *obs = (KPIObservation*)(buf + hdr.obsOffset);
+    char *names = (char*)(buf + hdr.nameOffset);
+
+    uint64_t kpos = 0, opos = 0;
+    uint32_t epos = 0;
+    for (uint32_t i = 0; i < np; ++i) {
+        memcpy(sp[i].name, graph->nodes[i], MAX_NAME_LEN);
+        sp[i].kpiStart = kpos;
+        const PersNode *node = graph->pers[i];
+        for (const KPI *k = kpiFirst(node); k; k = kpiNext(node, k), ++kpos) {
+            const char *name = kpiNameOf(graph, k);
+            sk[kpos].name = nameAt[k->name / 4];
+            sk[kpos].nameLen = (uint32_t)strlen(name);
+            memcpy(names + sk[kpos].name, name, sk[kpos].nameLen + 1);
+            sk[kpos].target = k->target;
+            sk[kpos].achieved = k->achieved;
+            const KPIHistory *h = historyOf(graph, k);
+            histCount[kpos] = h ? (uint32_t)h->count : 0;
+            for (int c = 0; h && c * HISTORY_CHUNK_OBS < h->count; ++c) {
+                int n = h->count - c * HISTORY_CHUNK_OBS;
+                if (n > HISTORY_CHUNK_OBS) n = HISTORY_CHUNK_OBS;
+                memcpy(obs + opos, h->chunks[c]->obs, (size_t)n * sizeof(KPIObservation));
+                opos += (uint64_t)n;
+            }
+        }
+        sp[i].kpiCount = (uint32_t)(kpos - sp[i].kpiStart);
+        rowStart[i] = epos;
+        const AdjList *a = &graph->adj[i];
+        for (int e = 0; e < a->count; ++e) dest[epos++] = (uint32_t)a->to[e];
+    }
+    rowStart[np] = epos;
+    free(nameAt);
+
+    hdr.checksum = checksum64(buf + sizeof(SnapHeader), (size_t)(hdr.fileSize - sizeof(SnapHeader)));
+    memcpy(buf, &hdr, sizeof(hdr));
+    int rc = writeFileAtomic(path, buf, (size_t)hdr.fileSize);
+    free(buf);
+    if (rc != 0) {
+        message("Cannot write snapshot '%s'.\n", path);
+        return -1;
+    }
+    message("Saved snapshot '%s': %u perspectives, %u dependencies, %llu KPIs", path, np, ne, (unsigned long long)nk);
+    if (no) message(", %llu observations", (unsigned long long)no);
+    message(" in %.1f ms\n", (nowSeconds() - t0) * 1e3);
+    if (id) *id = hdr.checksum;
+    return 0;
+}
+
+int saveSnapshot(const Graph *graph, const char *path) {
+    if (!graph || !path) return -1;
+    return writeSnapshot(graph, path, NULL);
+}
+
+/* header + bounds validation of a mapped snapshot; returns NULL if usable */
+static const char *checkSnapshot(const MappedFile *mf, const SnapHeader *hdr) {
+    if (mf->size < SNAPSHOT_V1_HEADER) return "file too small";
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return "not a scorecard snapshot";
+    if (hdr->byteOrder != SNAPSHOT_BYTE_ORDER) return "written with a different byte order";
+    if (hdr->version < 1 || hdr->version > SNAPSHOT_VERSION) return "unsupported snapshot version";
+    uint32_t hsize = hdr->version == 1 ? SNAPSHOT_V1_HEADER :
+                     hdr->version == 2 ? SNAPSHOT_V2_HEADER :
+                     hdr->version == 3 ? SNAPSHOT_V3_HEADER : (uint32_t)sizeof(SnapHeader);
+    size_t kpiSize = hdr->version < 4 ? sizeof(SnapKPIFixed) : sizeof(SnapKPI);
+    if (hdr->headerSize != hsize || mf->size < hsize || hdr->fileSize != mf->size)
+        return "truncated or resized file";
+    uint64_t np = hdr->numPerspectives, ne = hdr->numEdges;
+    if (hdr->persOffset != hsize ||
+        hdr->edgeOffset < hdr->persOffset + np * sizeof(SnapPers) ||
+        hdr->kpiOffset < hdr->edgeOffset + (np + 1 + ne) * sizeof(uint32_t) ||
+        hdr->kpiOffset > hdr->fileSize || hdr->numKPIs > (hdr->fileSize - hdr->kpiOffset) / kpiSize ||
+        (hdr->edgeOffset & 7) || (hdr->kpiOffset & 7))
+        return "inconsistent section table";
+    uint64_t kpiEnd = hdr->kpiOffset + hdr->numKPIs * kpiSize;
+    uint64_t obsEnd = hdr->version < 4 ? hdr->fileSize : hdr->nameOffset;
+    if (hdr->version < 3) {
+        if (kpiEnd != hdr->fileSize) return "inconsistent section table";
+    } else if (hdr->histOffset < kpiEnd || hdr->histOffset > hdr->fileSize ||
+               hdr->numKPIs > (hdr->fileSize - hdr->histOffset) / sizeof(uint32_t) ||
+               hdr->obsOffset < hdr->histOffset + hdr->numKPIs * sizeof(uint32_t) ||
+               hdr->obsOffset > hdr->fileSize ||
+               hdr->numObservations > (hdr->fileSize - hdr->obsOffset) / sizeof(KPIObservation) ||
+               obsEnd < hdr->obsOffset + hdr->numObservations * sizeof(KPIObservation) ||
+               (hdr->version < 4 && obsEnd != hdr->obsOffset + hdr->numObservations * sizeof(KPIObservation)) ||
+               obsEnd > hdr->fileSize || hdr->fileSize - obsEnd != hdr->nameBytes ||
+               (hdr->histOffset & 7) || (hdr->obsOffset & 7)) {
+        return "inconsistent section table";
+    }
+    if (checksum64((const unsigned char*)mf->data + hsize, mf->size - hsize) != hdr->checksum)
+        return "checksum mismatch";
+    return NULL;
+}
+
+int loadSnapshot(Graph *graph, const char *path) {
+    if (!graph || !path) return -1;
+    double t0 = nowSeconds();
+    MappedFile mf;
+    if (mapFile(path, &mf) != 0) {
+        message("Cannot read snapshot '%s'.\n", path);
+        return -1;
+    }
+    SnapHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (mf.size) memcpy(&hdr, mf.data, mf.size < sizeof(hdr) ? mf.size : sizeof(hdr));
+    if (hdr.version == 1) hdr.parent = 0;
+    if (hdr.version < 3) hdr.histOffset = hdr.obsOffset = hdr.numObservations = 0;
+    if (hdr.version < 4) hdr.nameOffset = hdr.nameBytes = 0;
+    const char *err = checkSnapshot(&mf, &hdr);
+
+    /* views into the mapping, read while the graph is rebuilt below; every
+       name, edge and KPI is copied, nothing points into the file afterwards */
+    const SnapPers *sp = (const SnapPers*)(mf.data + hdr.persOffset);
+    const uint32_t *rowStart = (const uint32_t*)(mf.data + hdr.edgeOffset);
+    const uint32_t *dest = rowStart + hdr.numPerspectives + 1;
+    const SnapKPI *sk = (const SnapKPI*)(mf.data + hdr.kpiOffset);
+    const SnapKPIFixed *skFixed = (const SnapKPIFixed*)(mf.data + hdr.kpiOffset);
+    const uint32_t *histCount = (const uint32_t*)(mf.data + hdr.histOffset);
+    const KPIObservation *obs = (const KPIObservation*)(mf.data + hdr.obsOffset);
+    const char *names = mf.data + hdr.nameOffset;
+    uint32_t np = hdr.numPerspectives;
+
+    for (uint32_t i = 0; !err && i < np; ++i) {
+        if (!memchr(sp[i].name, '\0', MAX_NAME_LEN) || sp[i].name[0] == '\0') err = "bad perspective name";
+        else if (sp[i].kpiStart > hdr.numKPIs || sp[i].kpiCount > hdr.numKPIs - sp[i].kpiStart) err = "bad KPI range";
+        else if (rowStart[i] > rowStart[i + 1] || rowStart[i + 1] > hdr.numEdges) err = "bad edge row";
+    }
+
+    /* where each KPI's history starts; histories must be in period order */
+    uint64_t *obsStart = NULL;
+    if (!err && hdr.numObservations > 0) {
+        obsStart = xrealloc(NULL, (size_t)hdr.numKPIs * sizeof(uint64_t));
+        uint64_t pos = 0;
+        for (uint64_t j = 0; j < hdr.numKPIs && !err; ++j) {
+            obsStart[j] = pos;
+            if (histCount[j] > hdr.numObservations - pos) { err = "bad history length"; break; }
+            for (uint32_t o = 0; o < histCount[j]; ++o) {
+                int32_t period = obs[pos + o].period;
+                if (period < 0 || period == PERIOD_LATEST || (o > 0 && period <= obs[pos + o - 1].period)) {
+                    err = "history out of order";
+                    break;
+                }
+            }
+            pos += histCount[j];
+        }
+        if (!err && pos != hdr.numObservations) err = "bad history length";
+    }
+    if (err) {
+        message("Cannot load snapshot '%s': %s.\n", path, err);
+        free(obsStart);
+        unmapFile(&mf);
+        return -2;
+    }
+
+    Wal *wal = graph->wal;
+    graph->wal = NULL;          /* snapshot contents are not re-logged */
+    freeAll(graph);
+
+    for (uint32_t i = 0; i < np && !err; ++i)
+        if (internPerspective(graph, sp[i].name) != (int)i) err = "duplicate perspective name";
+    for (uint32_t i = 0; i < np && !err; ++i) {
+        for (uint32_t e = rowStart[i]; e < rowStart[i + 1]; ++e) {
+            if (dest[e] >= np) { err = "bad edge target"; break; }
+            if (adjInsert(&graph->adj[i], (int)dest[e])) graph->numEdges++;
+        }
+    }
+    for (uint32_t i = 0; i < np && !err; ++i) {
+        PersNode *pnode = graph->pers[i];
+        /* insertKPI prepends, so walk each run backwards to keep list order */
+        for (uint64_t r = sp[i].kpiCount; r-- > 0; ) {
+            uint64_t j = sp[i].kpiStart + r;
+            const char *name;
+            float target, achieved;
+            if (hdr.version < 4) {
+                const SnapKPIFixed *k = &skFixed[j];
+                if (!memchr(k->name, '\0', MAX_NAME_LEN)) { err = "bad KPI name"; break; }
+                name = k->name;
+                target = k->target;
+                achieved = k->achieved;
+            } else {
+                const SnapKPI *k = &sk[j];
+                if (k->nameLen >= MAX_KPI_NAME_LEN || k->name >= hdr.nameBytes ||
+                    hdr.nameBytes - k->name <= k->nameLen || names[k->name + k->nameLen] != '\0' ||
+                    memchr(names + k->name, '\0', k->nameLen)) { err = "bad KPI name"; break; }
+                name = names + k->name;
+                target = k->target;
+                achieved = k->achieved;
+            }
+            KPI *kpi = insertKPI(graph, pnode, name, target, achieved, NULL, 0);
+            if (obsStart && histCount[j] > 0) historyLoad(graph, kpi, obs + obsStart[j], (int)histCount[j]);
+        }
+    }
+    free(obsStart);
+    unmapFile(&mf);
+    if (err) {
+        message("Cannot load snapshot '%s': %s.\n", path, err);
+        freeAll(graph);
+        graph->wal = wal;
+        if (wal) walReset(graph);
+        return -2;
+    }
+    graph->snapshotId = hdr.checksum;
+    graph->snapshotParent = hdr.parent;
+    graph->wal = wal;
+    if (wal) walReset(graph);   /* the log now continues from this snapshot */
+    message("Loaded snapshot '%s': %u perspectives, %u dependencies, %llu KPIs",
+           path, np, hdr.numEdges, (unsigned long long)hdr.numKPIs);
+    if (hdr.numObservations) message(", %llu observations", (unsigned long long)hdr.numObservations);
+    message(" in %.1f ms\n", (nowSeconds() - t0) * 1e3);
+    return 0;
+}
+
+/* ---------- Write-ahead log ---------- */
+
+/* Log layout: WalHeader, then records
+     uint32 checksum | uint16 payload length | uint8 type | payload
+   checksum is FNV-1a over length, type and payload. Payloads:
+     WAL_PERSPECTIVE  uint32 id, name bytes          (id the name must map to)
+     WAL_DEPENDENCY   uint32 from id, uint32 to id
+     WAL_KPI          uint32 perspective id, float target, float achieved, name bytes
+     WAL_OBSERVATION  uint32 perspective id, int32 period, float target, float achieved, name bytes
+     WAL_KPI_VALUES   uint32 perspective id, float target, float achieved, name bytes
+     WAL_KPI_DELETE   uint32 perspective id, name bytes
+   base is the snapshot identity the records apply on top of. */
+#define WAL_MAGIC       "BSCWAL"
+#define WAL_VERSION     1u
+#define WAL_RECORD_HDR  7u
+
+typedef struct WalHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t base;
+} WalHeader;
+
+static uint32_t fnv1a32(uint32_t h, const unsigned char *p, size_t n) {
+    while (n--) { h ^= *p++; h *= 16777619u; }
+    return h;
+}
+
+static uint32_t walRecordSum(const unsigned char *rec, size_t payloadLen) {
+    return fnv1a32(2166136261u, rec + 4, 3 + payloadLen);
+}
+
+static int walSync(FILE *f) {
+    if (fflush(f) != 0) return -1;
+#ifndef _WIN32
+    if (fsync(fileno(f)) != 0) return -1;
+#endif
+    return 0;
+}
+
+/* empty the log file and stamp it with the graph's current snapshot */
+static int walWriteHeader(Wal *wal, uint64_t base) {
+    WalHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, WAL_MAGIC, sizeof(WAL_MAGIC));
+    hdr.version = WAL_VERSION;
+    hdr.base = base;
+    if (wal->file) fclose(wal->file);
+    wal->file = fopen(wal->path, "wb");
+    if (!wal->file) return -1;
+    if (fwrite(&hdr, sizeof(hdr), 1, wal->file) != 1 || walSync(wal->file) != 0) return -1;
+    wal->file = freopen(wal->path, "ab", wal->file);
+    return wal->file ? 0 : -1;
+}
+
+/* append one record of payload a + b to a buffer: the log's, or an ingest
+   shard's until its batch is merged */
+static void walEncode(unsigned char **buf, size_t *len, size_t *cap,
+                      int type, const void *a, size_t alen, const void *b, size_t blen) {
+    size_t plen = alen + blen;
+    if (*len + WAL_RECORD_HDR + plen > *cap) {
+        *cap = (*cap ? *cap * 2 : 4096) + WAL_RECORD_HDR + plen;
+        *buf = xrealloc(*buf, *cap);
+    }
+    unsigned char *rec = *buf + *len;
+    uint16_t len16 = (uint16_t)plen;
+    memcpy(rec + 4, &len16, sizeof(len16));
+    rec[6] = (unsigned char)type;
+    if (alen) memcpy(rec + WAL_RECORD_HDR, a, alen);
+    if (blen) memcpy(rec + WAL_RECORD_HDR + alen, b, blen);
+    uint32_t sum = walRecordSum(rec, plen);
+    memcpy(rec, &sum, sizeof(sum));
+    *len += WAL_RECORD_HDR + plen;
+}
+
+/* count records just added to the log's buffer; commits the group once it
+   is full or old enough */
+static void walAdded(Graph *graph, int records) {
+    Wal *wal = graph->wal;
+    double now = nowSeconds();
+    if (wal->pending == 0) wal->firstPending = now;
+    wal->pending += records;
+    wal->records += records;
+    if (wal->pending >= WAL_GROUP_RECORDS || wal->len >= WAL_GROUP_BYTES ||
+        (now - wal->firstPending) * 1e3 >= WAL_GROUP_MS)
+        walCommit(graph);
+}
+
+static void walPut(Graph *graph, int type, const void *a, size_t alen, const void *b, size_t blen) {
+    if (stageWalRecord(graph, type, a, alen, b, blen)) return;
+    Wal *wal = graph->wal;
+    walEncode(&wal->buf, &wal->len, &wal->cap, type, a, alen, b, blen);
+    walAdded(graph, 1);
+}
+
+int walCommit(Graph *graph) {
+    Wal *wal = graph ? graph->wal : NULL;
+    if (!wal || wal->pending == 0) return 0;
+    int ok = wal->file && fwrite(wal->buf, 1, wal->len, wal->file) == wal->len && walSync(wal->file) == 0;
+    wal->len = 0;
+    wal->pending = 0;
+    wal->commits++;
+    if (!ok) {
+        message("Write-ahead log '%s': write failed, recent changes are not durable.\n", wal->path);
+        return -1;
+    }
+    return 0;
+}
+
+/* drop buffered records and restart the log from the current snapshot */
+static void walReset(Graph *graph) {
+    Wal *wal = graph->wal;
+    wal->len = 0;
+    wal->pending = 0;
+    if (walWriteHeader(wal, graph->snapshotId) != 0)
+        message("Write-ahead log '%s': cannot reset log.\n", wal->path);
+}
+
+/* apply one verified record; returns NULL or a reason it does not fit the graph */
+static const char *walApply(Graph *graph, int type, const unsigned char *p, size_t len) {
+    char name[MAX_KPI_NAME_LEN];
+    uint32_t u[2];
+    float f[2];
+    switch (type) {
+    case WAL_PERSPECTIVE:
+        if (len < 5 || len - 4 >= MAX_NAME_LEN) return "bad perspective record";
+        memcpy(u, p, 4);
+        memcpy(name, p + 4, len - 4);
+        name[len - 4] = '\0';
+        if (internPerspective(graph, name) != (int)u[0]) return "perspective id mismatch";
+        return NULL;
+    case WAL_DEPENDENCY:
+        if (len != 8) return "bad dependency record";
+        memcpy(u, p, 8);
+        if (u[0] >= (uint32_t)graph->numNodes || u[1] >= (uint32_t)graph->numNodes)
+            return "unknown perspective id";
+        if (adjInsert(&graph->adj[u[0]], (int)u[1])) graph->numEdges++;
+        return NULL;
+    case WAL_KPI:
+        if (len < 13 || len - 12 >= MAX_KPI_NAME_LEN) return "bad KPI record";
+        memcpy(u, p, 4);
+        memcpy(f, p + 4, 8);
+        memcpy(name, p + 12, len - 12);
+        name[len - 12] = '\0';
+        if (u[0] >= (uint32_t)graph->numNodes) return "unknown perspective id";
+        insertKPI(graph, graph->pers[u[0]], name, f[0], f[1], NULL, 0);
+        return NULL;
+    case WAL_OBSERVATION: {
+        int32_t period;
+        if (len < 17 || len - 16 >= MAX_KPI_NAME_LEN) return "bad observation record";
+        memcpy(u, p, 4);
+        memcpy(&period, p + 4, 4);
+        memcpy(f, p + 8, 8);
+        memcpy(name, p + 16, len - 16);
+        name[len - 16] = '\0';
+        if (u[0] >= (uint32_t)graph->numNodes) return "unknown perspective id";
+        applyObservation(graph, graph->pers[u[0]], NULL, name, period, f[0], f[1]);
+        return NULL;
+    }
+    case WAL_KPI_VALUES:
+    case WAL_KPI_DELETE: {
+        size_t fixed = type == WAL_KPI_VALUES ? 12 : 4;
+        if (len <= fixed || len - fixed >= MAX_KPI_NAME_LEN) return "bad KPI edit record";
+        memcpy(u, p, 4);
+        if (type == WAL_KPI_VALUES) memcpy(f, p + 4, 8);
+        memcpy(name, p + fixed, len - fixed);
+        name[len - fixed] = '\0';
+        if (u[0] >= (uint32_t)graph->numNodes) return "unknown perspective id";
+        PersNode *pnode = graph->pers[u[0]];
+        KPI *k = findKPI(graph, pnode, name);
+        if (!k) return "unknown KPI";
+        if (type == WAL_KPI_VALUES && k->history) return "undated edit of a KPI with a history";
+        if (type == WAL_KPI_VALUES) assignKPI(graph, pnode, k, f[0], f[1]);
+        else unlinkKPI(graph, pnode, k);
+        return NULL;
+    }
+    }
+    return "unknown record type";
+}
+
+long walOpen(Graph *graph, const char *path) {
+    if (!graph || !path) return -1;
+    walClose(graph);
+    double t0 = nowSeconds();
+
+    Wal *wal = xrealloc(NULL, sizeof(Wal));
+    memset(wal, 0, sizeof(*wal));
+    wal->path = xrealloc(NULL, strlen(path) + 1);
+    strcpy(wal->path, path);
+
+    MappedFile mf = { NULL, 0, NULL };
+    int exists = mapFile(path, &mf) == 0 && mf.size > 0;
+    size_t good = sizeof(WalHeader);
+    int discard = 0;
+    const char *err = NULL;
+    if (exists) {
+        WalHeader hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        memcpy(&hdr, mf.data, mf.size < sizeof(hdr) ? mf.size : sizeof(hdr));
+        if (mf.size < sizeof(hdr) || memcmp(hdr.magic, WAL_MAGIC, sizeof(WAL_MAGIC)) != 0)
+            err = "not a scorecard write-ahead log";
+        else if (hdr.version != WAL_VERSION)
+            err = "unsupported log version";
+        else if (hdr.base != graph->snapshotId) {
+            if (graph->snapshotId != 0 && hdr.base == graph->snapshotParent) discard = 1;
+            else err = "log belongs to a different snapshot";
+        }
+
+        /* replay complete, checksummed records; stop at the first torn one */
+        while (!err && !discard && good + WAL_RECORD_HDR <= mf.size) {
+            const unsigned char *rec = (const unsigned char*)mf.data + good;
+            uint16_t plen;
+            uint32_t sum;
+            memcpy(&plen, rec + 4, sizeof(plen));
+            memcpy(&sum, rec, sizeof(sum));
+            if (good + WAL_RECORD_HDR + plen > mf.size || walRecordSum(rec, plen) != sum) break;
+            err = walApply(graph, rec[6], rec + WAL_RECORD_HDR, plen);
+            if (err) break;
+            good += WAL_RECORD_HDR + plen;
+            wal->replayed++;
+        }
+    }
+    if (err) {
+        message("Cannot use write-ahead log '%s': %s.\n", path, err);
+        unmapFile(&mf);
+        free(wal->path);
+        free(wal);
+        return -1;
+    }
+
+    int torn = exists && !discard && good < mf.size;
+    if (torn) {
+        message("Write-ahead log '%s': dropped torn tail of %lu bytes.\n",
+               path, (unsigned long)(mf.size - good));
+#ifdef _WIN32
+        writeFileAtomic(path, mf.data, good);
+#else
+        if (truncate(path, (off_t)good) != 0) perror("truncate");
+#endif
+    }
+    unmapFile(&mf);
+
+    if (!exists || discard) {
+        if (discard) message("Write-ahead log '%s' is already contained in the snapshot; starting a new log.\n", path);
+        if (walWriteHeader(wal, graph->snapshotId) != 0) err = "cannot create log";
+    } else {
+        wal->file = fopen(path, "ab");
+        if (!wal->file) err = "cannot open log for append";
+    }
+    if (err) {
+        message("Cannot use write-ahead log '%s': %s.\n", path, err);
+        if (wal->file) fclose(wal->file);
+        free(wal->path);
+        free(wal);
+        return -1;
+    }
+
+    graph->wal = wal;
+    if (wal->replayed > 0) {
+        double sec = nowSeconds() - t0;
+        message("Replayed %ld write-ahead log records from '%s' in %.1f ms", wal->replayed, path, sec * 1e3);
+        if (sec > 0.0) message(" (%.0f records/sec)", (double)wal->replayed / sec);
+        message("\n");
+    }
+    return wal->replayed;
+}
+
+int walCheckpoint(Graph *graph, const char *snapshotPath) {
+    if (!graph || !snapshotPath) return -1;
+    if (!graph->wal) {
+        if (saveSnapshot(graph, snapshotPath) != 0) return -1;
+    } else {
+        walCommit(graph);
+        uint64_t id;
+        if (writeSnapshot(graph, snapshotPath, &id) != 0) return -1;
+        graph->snapshotParent = graph->snapshotId;
+        graph->snapshotId = id;
+        walReset(graph);
+    }
+    if (graph->names.released) compactNames(graph);
+    return 0;
+}
+
+void walClose(Graph *graph) {
+    if (!graph || !graph->wal) return;
+    Wal *wal = graph->wal;
+    walCommit(graph);
+    if (wal->file) fclose(wal->file);
+    free(wal->buf);
+    free(wal->path);
+    free(wal);
+    graph->wal = NULL;
+}
+
+/* ---------- Query server ---------- */
+
+#ifndef _WIN32
+
+/* The graph given to runServer belongs to the writer (the calling thread)
+   and readers never look at it: they render from the latest published
+   copy, which nobody modifies. Copies are reclaimed by epochs. A reader
+   announces the epoch it starts in, then picks up the current copy, and
+   clears its announcement once the reply is rendered. A replaced copy is
+   stamped with the epoch that follows the swap and freed once every reader
+   is idle or inside that epoch or a later one.
+   A reader never waits for the writer. It queues an update and goes on
+   serving its other connections; the writer pushes the applied update on
+   the reader's completion queue and writes a byte to its wake pipe, and
+   the reader answers it then. A connection's later requests wait in its
+   input buffer meanwhile, so replies keep request order. Sockets are
+   non-blocking: what a client does not take at once is kept on its
+   connection and sent when poll reports room.
+   Publishing is copy-on-write per perspective. A copy has its own
+   perspective shells and edges, but the KPIs of each perspective (array,
+   index, aggregates and copies of their histories) live in a ServedPart
+   that later copies share until an update touches that perspective. The
+   history table is shared page by page, a page being copied once a
+   changed perspective has an entry on it, and the name bytes are shared
+   and appended to until the writer's pool is compacted. Parts, pages and
+   names are counted by the copies using them; only the writer touches
+   the counts. */
+#define SERVER_POLL_MS      100     /* how often idle readers / the writer look for shutdown */
+#define SERVER_PUBLISH_MS   20.0    /* minimum gap between published copies */
+#define SERVER_COPY_SHARE   4.0     /* ...and at least this many times the last copy's cost */
+#define SERVER_LINE_MAX     4096
+#define SERVER_MAX_ARGS     8
+#define SERVER_READER_CONNS 64      /* connections one reader multiplexes */
+#define SERVER_OUT_HIGH     (64 * 1024) /* unsent reply bytes that pause a connection's requests */
+
+/* one perspective's KPIs as published */
+typedef struct ServedPart {
+    int refs;
+    PersNode node;                  /* KPI array, index and aggregates only */
+    HistoryChunk **chunkRefs;       /* the histories' chunk pointers, end to end */
+    HistoryChunk *chunks;
+} ServedPart;
+
+/* a page of the published history table */
+typedef struct ServedPage {
+    int refs;
+    KPIHistory entries[HISTORY_PAGE_ENTRIES];
+} ServedPage;
+
+/* published name bytes; older copies only read below their own length */
+typedef struct ServedNames {
+    int refs;
+    char *bytes;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t compactions;           /* the writer pool's, when copied */
+} ServedNames;
+
+typedef struct ServedGraph {
+    Graph graph;                    /* shells; KPIs, histories and names point into: */
+    ServedPart **parts;             /* per perspective */
+    ServedPage **pages;
+    uint32_t numPages;
+    ServedNames *names;
+    uint64_t retiredAt;             /* first epoch no reader can see it in */
+    struct ServedGraph *next;       /* retired copies */
+} ServedGraph;
+
+typedef enum UpdateOp { UPDATE_KPI, UPDATE_ACHIEVED, UPDATE_DELETE } UpdateOp;
+
+/* a KPI update handed from a reader to the writer; lives in the connection
+   that asked for it until the writer hands it back */
+typedef struct ServerUpdate {
+    UpdateOp op;
+    const char *perspective;        /* into text */
+    const char *kpi;
+    float target;
+    float achieved;
+    int32_t period;                 /* PERIOD_LATEST: current values */
+    int result;
+    int reader;                     /* whose completion queue gets it back */
+    struct ServerConn *conn;
+    struct ServerUpdate *next;
+    char text[SERVER_LINE_MAX];     /* perspective and KPI name */
+} ServerUpdate;
+
+/* one client connection of a reader. buf holds requests not answered yet
+   (a partial line, or lines behind an update still with the writer), out
+   replies the socket has not taken yet. */
+typedef struct ServerConn {
+    int fd;
+    ReportFormat format;
+    int waiting;                    /* update is with the writer */
+    int closing;                    /* close once out is sent */
+    int gone;                       /* the client hung up; free once not waiting */
+    size_t used;
+    char buf[SERVER_LINE_MAX];
+    char *out;
+    size_t outSent;
+    size_t outLen;
+    size_t outCap;
+    ServerUpdate update;
+} ServerConn;
+
+/* what the writer and one reader share, alone on its cache line: the
+   reader's announced epoch (0 = idle) and its completion queue */
+typedef struct ServerReader {
+    uint64_t epoch;                 /* atomic */
+    ServerUpdate *done;             /* atomic: applied updates, pushed by the writer */
+    int wake[2];                    /* pipe: a byte per pushed update */
+    char pad[40];
+} ServerReader;
+
+typedef struct Server {
+    Graph *graph;                   /* the writer's graph */
+    ServedGraph *current;           /* published copy (atomic) */
+    ServedGraph *retired;           /* writer only */
+    uint64_t epoch;                 /* atomic, starts at 1 */
+    ServerReader *rd;
+    int readers;
+    int listenFd;
+    char *unixPath;                 /* socket file to remove on exit, or NULL */
+    ReportFormat format;            /* default format of new connections */
+    int stop;                       /* atomic */
+    long published;                 /* atomic */
+    uint64_t publishedVersion;
+    double nextPublish;
+    unsigned char *changed;         /* writer only: per perspective, touched since the last copy */
+    int capChanged;
+    pthread_mutex_t lock;           /* guards the update queue */
+    pthread_cond_t wake;            /* updates queued, or stop */
+    ServerUpdate *head;
+    ServerUpdate *tail;
+} Server;
+
+typedef struct ReaderArg {
+    Server *srv;
+    int self;
+} ReaderArg;
+
+/* copy n elements of a table (NULL for none) */
+static void *cloneTable(const void *src, size_t n, size_t size) {
+    if (!n) return NULL;
+    void *dst = xrealloc(NULL, n * size);
+    memcpy(dst, src, n * size);
+    return dst;
+}
+
+/* the entry of handle in the copy being built, copying its page first if
+   an older copy uses it too */
+static KPIHistory *servedEntry(ServedGraph *s, uint32_t handle) {
+    uint32_t p = (handle - 1) / HISTORY_PAGE_ENTRIES;
+    ServedPage *page = s->pages[p];
+    if (page->refs > 1) {
+        page->refs--;
+        page = cloneTable(page, 1, sizeof(ServedPage));
+        page->refs = 1;
+        s->pages[p] = page;
+        s->graph.historyPages[p] = page->entries;
+    }
+    return &page->entries[(handle - 1) % HISTORY_PAGE_ENTRIES];
+}
+
+/* copy one perspective's KPIs and their histories into a new part, and
+   point the copy's history entries at them */
+static ServedPart *servePart(ServedGraph *s, const Graph *src, const PersNode *sp) {
+    ServedPart *part = xrealloc(NULL, sizeof(*part));
+    part->refs = 1;
+    memset(&part->node, 0, sizeof(part->node));
+    part->node.kpis = cloneTable(sp->kpis, (size_t)sp->kpiLen, sizeof(KPI));
+    part->node.kpiLen = part->node.kpiCap = sp->kpiLen;
+    part->node.kpiIndex = cloneTable(sp->kpiIndex, (size_t)sp->kpiIndexCap, sizeof(KPISlot));
+    part->node.kpiIndexCap = sp->kpiIndexCap;
+    part->node.kpiCount = sp->kpiCount;
+    part->node.kpiShadowed = sp->kpiShadowed;
+    part->node.perfSum = sp->perfSum;
+    part->node.perfCount = sp->perfCount;
+    part->node.perfStale = sp->perfStale;
+    part->node.perfMin = sp->perfMin;
+    part->node.perfMax = sp->perfMax;
+
+    size_t total = 0;
+    for (int j = 0; j < sp->kpiLen; ++j) {
+        const KPIHistory *h = sp->kpis[j].name ? historyOf(src, &sp->kpis[j]) : NULL;
+        if (h) total += (size_t)(h->count + HISTORY_CHUNK_OBS - 1) / HISTORY_CHUNK_OBS;
+    }
+    part->chunkRefs = total ? xrealloc(NULL, total * sizeof(HistoryChunk*)) : NULL;
+    part->chunks = total ? xrealloc(NULL, total * sizeof(HistoryChunk)) : NULL;
+    size_t at = 0;
+    for (int j = 0; j < sp->kpiLen; ++j) {
+        const KPIHistory *h = sp->kpis[j].name ? historyOf(src, &sp->kpis[j]) : NULL;
+        if (!h) continue;
+        int chunks = (h->count + HISTORY_CHUNK_OBS - 1) / HISTORY_CHUNK_OBS;
+        KPIHistory *c = servedEntry(s, sp->kpis[j].history);
+        c->chunks = part->chunkRefs + at;
+        c->count = h->count;
+        c->capChunks = chunks;
+        c->nextFree = 0;
+        for (int b = 0; b < chunks; ++b, ++at) {
+            part->chunks[at] = *h->chunks[b];
+            part->chunkRefs[at] = &part->chunks[at];
+        }
+    }
+    return part;
+}
+
+/* the copy's name bytes: the last copy's, with the names added since
+   appended, unless they no longer fit or the writer compacted its pool */
+static ServedNames *serveNames(ServedNames *last, const NamePool *pool) {
+    if (last && last->compactions == pool->compactions && pool->len >= last->len && pool->len <= last->cap) {
+        ServedNames *names = last;
+        if (pool->len > names->len) memcpy(names->bytes + names->len, pool->bytes + names->len, pool->len - names->len);
+        names->len = pool->len;
+        names->refs++;
+        return names;
+    }
+    ServedNames *names = xrealloc(NULL, sizeof(*names));
+    names->refs = 1;
+    names->cap = pool->len ? pool->len * 2 : NAME_POOL_FIRST_BYTES;
+    names->bytes = xrealloc(NULL, names->cap);
+    if (pool->len) memcpy(names->bytes, pool->bytes, pool->len);
+    names->len = pool->len;
+    names->compactions = pool->compactions;
+    return names;
+}
+
+/* build the copy of src that follows last (NULL for the first): fresh
+   shells and edges, shared or new parts, pages and names */
+static ServedGraph *serveCopy(Server *srv, ServedGraph *last) {
+    const Graph *src = srv->graph;
+    ServedGraph *s = xrealloc(NULL, sizeof(*s));
+    initGraph(&s->graph);
+    Graph *dst = &s->graph;
+    for (int i = 0; i < src->numNodes; ++i) internPerspective(dst, src->nodes[i]);
+    for (int i = 0; i < src->numNodes; ++i) {
+        const AdjList *a = &src->adj[i];
+        if (!a->count) continue;
+        dst->adj[i].to = cloneTable(a->to, (size_t)a->count, sizeof(int));
+        dst->adj[i].count = dst->adj[i].cap = a->count;
+    }
+    dst->numEdges = src->numEdges;
+
+    s->names = serveNames(last ? last->names : NULL, &src->names);
+    dst->names.bytes = s->names->bytes;
+    dst->names.len = dst->names.cap = s->names->len;
+    /* renumbered names void every part */
+    int fresh = !last || last->names->compactions != src->names.compactions;
+
+    s->numPages = (src->numHistories + HISTORY_PAGE_ENTRIES - 1) / HISTORY_PAGE_ENTRIES;
+    s->pages = xrealloc(NULL, (s->numPages ? s->numPages : 1) * sizeof(ServedPage*));
+    dst->historyPages = xrealloc(NULL, (s->numPages ? s->numPages : 1) * sizeof(KPIHistory*));
+    for (uint32_t p = 0; p < s->numPages; ++p) {
+        if (!fresh && p < last->numPages) {
+            s->pages[p] = last->pages[p];
+            s->pages[p]->refs++;
+        } else {
+            s->pages[p] = xrealloc(NULL, sizeof(ServedPage));
+            memset(s->pages[p], 0, sizeof(ServedPage));
+            s->pages[p]->refs = 1;
+        }
+        dst->historyPages[p] = s->pages[p]->entries;
+    }
+    dst->numHistories = src->numHistories;
+    dst->capHistories = s->numPages * HISTORY_PAGE_ENTRIES;
+    dst->capHistoryPages = s->numPages;
+
+    s->parts = xrealloc(NULL, ((size_t)src->numNodes + 1) * sizeof(ServedPart*));
+    for (int i = 0; i < src->numNodes; ++i) {
+        int keep = !fresh && i < last->graph.numNodes && !(i < srv->capChanged && srv->changed[i]);
+        if (keep) {
+            s->parts[i] = last->parts[i];
+            s->parts[i]->refs++;
+        } else {
+            s->parts[i] = servePart(s, src, src->pers[i]);
+        }
+        const PersNode *pn = &s->parts[i]->node;
+        PersNode *dp = dst->pers[i];
+        dp->kpis = pn->kpis;
+        dp->kpiLen = dp->kpiCap = pn->kpiLen;
+        dp->kpiIndex = pn->kpiIndex;
+        dp->kpiIndexCap = pn->kpiIndexCap;
+        dp->kpiCount = pn->kpiCount;
+        dp->kpiShadowed = pn->kpiShadowed;
+        dp->cols.dirty = 1;
+        dp->perfSum = pn->perfSum;
+        dp->perfCount = pn->perfCount;
+        dp->perfStale = pn->perfStale;
+        dp->perfMin = pn->perfMin;
+        dp->perfMax = pn->perfMax;
+    }
+    if (srv->capChanged) memset(srv->changed, 0, (size_t)srv->capChanged);
+
+    dst->format = src->format;
+    dst->duplicates = src->duplicates;
+    dst->snapshotId = src->snapshotId;
+    dst->snapshotParent = src->snapshotParent;
+    dst->version = src->version;
+    s->retiredAt = 0;
+    s->next = NULL;
+    return s;
+}
+
+/* drop a copy's hold on what it shares, then free its own shells */
+static void serveFree(ServedGraph *s) {
+    for (int i = 0; i < s->graph.numNodes; ++i) {
+        ServedPart *part = s->parts[i];
+        s->graph.pers[i]->kpis = NULL;
+        s->graph.pers[i]->kpiIndex = NULL;
+        if (--part->refs) continue;
+        free(part->node.kpis);
+        free(part->node.kpiIndex);
+        free(part->chunkRefs);
+        free(part->chunks);
+        free(part);
+    }
+    for (uint32_t p = 0; p < s->numPages; ++p)
+        if (--s->pages[p]->refs == 0) free(s->pages[p]);
+    if (--s->names->refs == 0) {
+        free(s->names->bytes);
+        free(s->names);
+    }
+    free(s->graph.historyPages);
+    s->graph.historyPages = NULL;
+    s->graph.numHistories = s->graph.capHistories = 0;
+    s->graph.names.bytes = NULL;
+    freeAll(&s->graph);
+    free(s->parts);
+    free(s->pages);
+    free(s);
+}
+
+/* the writer applied an update to perspective id */
+static void serverTouched(Server *srv, int id) {
+    if (id < 0) return;
+    if (id >= srv->capChanged) {
+        int cap = srv->capChanged ? srv->capChanged : 16;
+        while (cap <= id) cap *= 2;
+        srv->changed = xrealloc(srv->changed, (size_t)cap);
+        memset(srv->changed + srv->capChanged, 0, (size_t)(cap - srv->capChanged));
+        srv->capChanged = cap;
+    }
+    srv->changed[id] = 1;
+}
+
+/* copy what changed in the writer's graph and make it the one readers see */
+static void serverPublish(Server *srv) {
+    double t0 = nowSeconds();
+    ServedGraph *s = serveCopy(srv, srv->current);
+    ServedGraph *old = __atomic_exchange_n(&srv->current, s, __ATOMIC_SEQ_CST);
+    if (old) {
+        old->retiredAt = __atomic_add_fetch(&srv->epoch, 1, __ATOMIC_SEQ_CST);
+        old->next = srv->retired;
+        srv->retired = old;
+    }
+    srv->publishedVersion = srv->graph->version;
+    __atomic_add_fetch(&srv->published, 1, __ATOMIC_RELAXED);
+    double took = nowSeconds() - t0;
+    double gap = SERVER_COPY_SHARE * took;
+    if (gap < SERVER_PUBLISH_MS / 1000.0) gap = SERVER_PUBLISH_MS / 1000.0;
+    srv->nextPublish = nowSeconds() + gap;
+}
+
+/* free the retired copies no reader can still be using */
+static void serverReclaim(Server *srv) {
+    uint64_t oldest = UINT64_MAX;
+    for (int r = 0; r < srv->readers; ++r) {
+        uint64_t e = __atomic_load_n(&srv->rd[r].epoch, __ATOMIC_SEQ_CST);
+        if (e && e < oldest) oldest = e;
+    }
+    ServedGraph **pp = &srv->retired;
+    while (*pp) {
+        ServedGraph *s = *pp;
+        if (s->retiredAt <= oldest) {
+            *pp = s->next;
+            serveFree(s);
+        } else {
+            pp = &s->next;
+        }
+    }
+}
+
+static const Graph *readerEnter(Server *srv, int self) {
+    uint64_t e = __atomic_load_n(&srv->epoch, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&srv->rd[self].epoch, e, __ATOMIC_SEQ_CST);
+    return &__atomic_load_n(&srv->current, __ATOMIC_SEQ_CST)->graph;
+}
+
+static void readerExit(Server *srv, int self) {
+    __atomic_store_n(&srv->rd[self].epoch, 0, __ATOMIC_RELEASE);
+}
+
+static int applyUpdate(Graph *graph, const ServerUpdate *u) {
+    switch (u->op) {
+    case UPDATE_KPI:
+        if (u->period != PERIOD_LATEST)
+            return recordKPIObservation(graph, u->perspective, u->kpi, u->period, u->target, u->achieved);
+        return addKPIRecord(graph, u->perspective, u->kpi, u->target, u->achieved);
+    case UPDATE_ACHIEVED:
+        return updateKPIAchieved(graph, u->perspective, u->kpi, u->achieved);
+    case UPDATE_DELETE:
+        return deleteKPI(graph, u->perspective, u->kpi);
+    }
+    return -1;
+}
+
+/* queue an update for the writer; -1 if the server is stopping */
+static int submitUpdate(Server *srv, ServerUpdate *u) {
+    u->next = NULL;
+    u->result = -1;
+    pthread_mutex_lock(&srv->lock);
+    int stopping = srv->stop;
+    if (!stopping) {
+        if (srv->tail) srv->tail->next = u;
+        else srv->head = u;
+        srv->tail = u;
+        pthread_cond_signal(&srv->wake);
+    }
+    pthread_mutex_unlock(&srv->lock);
+    return stopping ? -1 : 0;
+}
+
+/* hand an update back to the reader that queued it. Only the writer
+   pushes and the reader takes the whole queue at once, so a plain
+   compare-and-swap push is safe. */
+static void completeUpdate(Server *srv, ServerUpdate *u) {
+    ServerReader *r = &srv->rd[u->reader];
+    u->next = __atomic_load_n(&r->done, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&r->done, &u->next, u, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {}
+    char byte = 0;
+    ssize_t n = write(r->wake[1], &byte, 1);    /* a full pipe already wakes the reader */
+    (void)n;
+}
+
+/* the writer: apply queued updates in batches, publish a new copy when
+   the graph changed and the last one is old enough, reclaim old copies.
+   Updates still queued at shutdown are answered as rejected. */
+static void serverWrite(Server *srv) {
+    Graph *graph = srv->graph;
+    pthread_mutex_lock(&srv->lock);
+    while (!srv->stop) {
+        if (!srv->head) {
+            double wait = SERVER_POLL_MS / 1000.0;
+            if (graph->version != srv->publishedVersion) wait = srv->nextPublish - nowSeconds();
+            if (wait > 0.0) {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                long long ns = (long long)ts.tv_nsec + (long long)(wait * 1e9);
+                ts.tv_sec += (time_t)(ns / 1000000000LL);
+                ts.tv_nsec = (long)(ns % 1000000000LL);
+                pthread_cond_timedwait(&srv->wake, &srv->lock, &ts);
+                if (srv->stop) break;
+            }
+        }
+        ServerUpdate *batch = srv->head;
+        srv->head = srv->tail = NULL;
+        pthread_mutex_unlock(&srv->lock);
+
+        for (ServerUpdate *u = batch; u; u = u->next) {
+            u->result = applyUpdate(graph, u) == 0 ? 0 : -1;
+            serverTouched(srv, findPerspective(graph, u->perspective));
+        }
+        if (batch && graph->wal) walCommit(graph);      /* durable before it is acknowledged */
+        for (ServerUpdate *u = batch, *next; u; u = next) {
+            next = u->next;                             /* the reader may reuse u at once */
+            completeUpdate(srv, u);
+        }
+
+        if (graph->version != srv->publishedVersion && nowSeconds() >= srv->nextPublish) serverPublish(srv);
+        serverReclaim(srv);
+        pthread_mutex_lock(&srv->lock);
+    }
+    for (ServerUpdate *u = srv->head, *next; u; u = next) {
+        next = u->next;
+        completeUpdate(srv, u);
+    }
+    srv->head = srv->tail = NULL;
+    pthread_mutex_unlock(&srv->lock);
+}
+
+static void serverStop(Server *srv) {
+    pthread_mutex_lock(&srv->lock);
+    __atomic_store_n(&srv->stop, 1, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&srv->wake);
+    pthread_mutex_unlock(&srv->lock);
+}
+
+/* send every iovec; 0, or -1 once the peer is gone */
+static int sendAll(int fd, struct iovec *iov, int n) {
+    while (n > 0) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)n;
+        ssize_t sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0) return -1;
+        while (n > 0 && (size_t)sent >= iov->iov_len) {
+            sent -= (ssize_t)iov->iov_len;
+            ++iov;
+            --n;
+        }
+        if (n > 0) {
+            iov->iov_base = (char*)iov->iov_base + sent;
+            iov->iov_len -= (size_t)sent;
+        }
+    }
+    return 0;
+}
+
+static int wouldBlock(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+/* keep bytes the socket did not take, behind those already kept */
+static void connKeep(ServerConn *c, const void *data, size_t len) {
+    if (!len) return;
+    if (c->outSent && c->outLen + len > c->outCap) {
+        c->outLen -= c->outSent;
+        memmove(c->out, c->out + c->outSent, c->outLen);
+        c->outSent = 0;
+    }
+    if (c->outLen + len > c->outCap) {
+        size_t cap = c->outCap ? c->outCap : 4096;
+        while (cap < c->outLen + len) cap *= 2;
+        c->out = xrealloc(c->out, cap);
+        c->outCap = cap;
+    }
+    memcpy(c->out + c->outLen, data, len);
+    c->outLen += len;
+}
+
+/* send kept bytes as far as the socket takes them */
+static void connFlush(ServerConn *c) {
+    while (!c->gone && c->outSent < c->outLen) {
+        ssize_t n = send(c->fd, c->out + c->outSent, c->outLen - c->outSent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (!wouldBlock()) c->gone = 1;
+            return;
+        }
+        c->outSent += (size_t)n;
+    }
+    c->outSent = c->outLen = 0;
+}
+
+/* send a reply straight away when nothing is kept before it; keep what the
+   socket does not take */
+static void connSend(ServerConn *c, struct iovec *iov, int n) {
+    if (c->gone) return;
+    if (c->outSent == c->outLen) {
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = (size_t)n;
+        ssize_t sent = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+        if (sent < 0 && !wouldBlock()) {
+            c->gone = 1;
+            return;
+        }
+        while (sent > 0 && n > 0) {
+            size_t part = (size_t)sent < iov->iov_len ? (size_t)sent : iov->iov_len;
+            iov->iov_base = (char*)iov->iov_base + part;
+            iov->iov_len -= part;
+            sent -= (ssize_t)part;
+            if (!iov->iov_len) { ++iov; --n; }
+        }
+    }
+    for (int i = 0; i < n; ++i) connKeep(c, iov[i].iov_base, iov[i].iov_len);
+}
+
+/* "OK <length>\n" + payload */
+static void sendReply(ServerConn *c, const char *data, size_t len) {
+    char head[32];
+    struct iovec iov[2];
+    iov[0].iov_base = head;
+    iov[0].iov_len = (size_t)snprintf(head, sizeof(head), "OK %lu\n", (unsigned long)len);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = len;
+    connSend(c, iov, len ? 2 : 1);
+}
+
+/* "ERR <message>\n" */
+static void sendError(ServerConn *c, const char *fmt, ...) {
+    char text[SERVER_LINE_MAX + 64];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(text + 4, sizeof(text) - 5, fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if ((size_t)n > sizeof(text) - 6) n = (int)(sizeof(text) - 6);
+    memcpy(text, "ERR ", 4);
+    text[4 + n] = '\n';
+    struct iovec iov = { text, (size_t)n + 5 };
+    connSend(c, &iov, 1);
+}
+
+/* split a request in place like the command line: whitespace-separated
+   words, "double quotes" group words; -1 on bad quoting */
+static int splitRequest(char *line, char **argv, int max) {
+    int argc = 0;
+    char *p = line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '\0') return argc;
+        if (argc == max) return -1;
+        char *out = p;
+        argv[argc++] = out;
+        while (*p && *p != ' ' && *p != '\t') {
+            if (*p == '"') {
+                ++p;
+                while (*p && *p != '"') *out++ = *p++;
+                if (*p != '"') return -1;
+                ++p;
+            } else {
+                *out++ = *p++;
+            }
+        }
+        if (*p) ++p;
+        *out = '\0';
+    }
+}
+
+static int requestNumber(const char *s, float *out) {
+    char *end;
+    *out = strtof(s, &end);
+    return end != s && *end == '\0';
+}
+
+static int requestPeriod(const char *s, int32_t *out) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || v < 0 || v >= PERIOD_LATEST) return 0;
+    *out = (int32_t)v;
+    return 1;
+}
+
+/* answer one request line; returns 0 when the connection is done. An
+   update is answered once the writer hands it back. */
+static int serveRequest(Server *srv, int self, ServerConn *c, char *line) {
+    char *argv[SERVER_MAX_ARGS];
+    int argc = splitRequest(line, argv, SERVER_MAX_ARGS);
+    if (argc <= 0) {
+        sendError(c, argc ? "unbalanced quotes or too many words" : "empty request");
+        return 1;
+    }
+    const char *cmd = argv[0];
+
+    if (strcmp(cmd, "evaluate") == 0 || strcmp(cmd, "scorecard") == 0 || strcmp(cmd, "deps") == 0) {
+        int32_t period = PERIOD_LATEST;
+        int deps = cmd[0] == 'd';
+        if (argc > (deps ? 1 : 2)) {
+            sendError(c, "usage: %s", deps ? "deps" : "evaluate|scorecard [PERIOD]");
+            return 1;
+        }
+        if (argc == 2 && !requestPeriod(argv[1], &period)) {
+            sendError(c, "invalid period '%s'", argv[1]);
+            return 1;
+        }
+        /* a private view of the shared copy, only the format differs */
+        Graph view = *readerEnter(srv, self);
+        view.format = c->format;
+        beginReportCapture();
+        if (deps) showDependencies(&view);
+        else if (cmd[0] == 'e') evaluatePerformanceForPeriod(&view, period);
+        else generateScorecardForPeriod(&view, period);
+        size_t len;
+        const char *out = endReportCapture(&len);
+        readerExit(srv, self);
+        sendReply(c, out, len);
+        return 1;
+    }
+    if (strcmp(cmd, "version") == 0) {
+        const Graph *g = readerEnter(srv, self);
+        char text[96];
+        int n = snprintf(text, sizeof(text), "version %" PRIu64 " snapshot %ld perspectives %d\n",
+                         g->version, __atomic_load_n(&srv->published, __ATOMIC_RELAXED), g->numNodes);
+        readerExit(srv, self);
+        sendReply(c, text, (size_t)n);
+        return 1;
+    }
+    if (strcmp(cmd, "format") == 0) {
+        int f = argc == 2 ? parseReportFormat(argv[1]) : -1;
+        if (f < 0) {
+            sendError(c, "usage: format color|plain|json|csv");
+            return 1;
+        }
+        c->format = (ReportFormat)f;
+        sendReply(c, "", 0);
+        return 1;
+    }
+
+    ServerUpdate *u = &c->update;
+    u->period = PERIOD_LATEST;
+    if (strcmp(cmd, "add-kpi") == 0) {
+        if (argc < 5 || argc > 6) {
+            sendError(c, "usage: add-kpi PERSPECTIVE KPI TARGET ACHIEVED [PERIOD]");
+            return 1;
+        }
+        if (!requestNumber(argv[3], &u->target) || !requestNumber(argv[4], &u->achieved)) {
+            sendError(c, "target and achieved must be numbers");
+            return 1;
+        }
+        if (argc == 6 && !requestPeriod(argv[5], &u->period)) {
+            sendError(c, "invalid period '%s'", argv[5]);
+            return 1;
+        }
+        u->op = UPDATE_KPI;
+    } else if (strcmp(cmd, "set-achieved") == 0) {
+        if (argc != 4) {
+            sendError(c, "usage: set-achieved PERSPECTIVE KPI ACHIEVED");
+            return 1;
+        }
+        if (!requestNumber(argv[3], &u->achieved)) {
+            sendError(c, "achieved must be a number");
+            return 1;
+        }
+        u->op = UPDATE_ACHIEVED;
+    } else if (strcmp(cmd, "delete-kpi") == 0) {
+        if (argc != 3) {
+            sendError(c, "usage: delete-kpi PERSPECTIVE KPI");
+            return 1;
+        }
+        u->op = UPDATE_DELETE;
+    } else if (strcmp(cmd, "quit") == 0) {
+        sendReply(c, "", 0);
+        return 0;
+    } else if (strcmp(cmd, "shutdown") == 0) {
+        serverStop(srv);
+        sendReply(c, "", 0);
+        return 0;
+    } else {
+        sendError(c, "unknown request '%s'", cmd);
+        return 1;
+    }
+    /* the words live in c->buf, which moves on before the writer is done */
+    size_t plen = strlen(argv[1]) + 1;
+    memcpy(u->text, argv[1], plen);
+    memcpy(u->text + plen, argv[2], strlen(argv[2]) + 1);
+    u->perspective = u->text;
+    u->kpi = u->text + plen;
+    u->reader = self;
+    u->conn = c;
+    if (submitUpdate(srv, u) != 0) sendError(c, "rejected");
+    else c->waiting = 1;
+    return 1;
+}
+
+/* answer the complete lines in c's buffer, in order, until one is an
+   update still with the writer or the client stops taking replies */
+static void serveLines(Server *srv, int self, ServerConn *c) {
+    size_t start = 0;
+    char *nl;
+    while (!c->waiting && !c->closing && !c->gone && c->outLen - c->outSent < SERVER_OUT_HIGH
+           && (nl = memchr(c->buf + start, '\n', c->used - start))) {
+        *nl = '\0';
+        if (nl > c->buf + start && nl[-1] == '\r') nl[-1] = '\0';
+        if (!serveRequest(srv, self, c, c->buf + start)) c->closing = 1;
+        start = (size_t)(nl + 1 - c->buf);
+    }
+    c->used -= start;
+    memmove(c->buf, c->buf + start, c->used);
+    if (c->used == sizeof(c->buf) && !c->closing && !memchr(c->buf, '\n', c->used)) {
+        sendError(c, "request too long");
+        c->closing = 1;
+    }
+}
+
+/* read what the client sent and answer what can be answered now */
+static void serveInput(Server *srv, int self, ServerConn *c) {
+    ssize_t n = recv(c->fd, c->buf + c->used, sizeof(c->buf) - c->used, 0);
+    if (n == 0 || (n < 0 && !wouldBlock())) {
+        c->gone = 1;
+        return;
+    }
+    if (n > 0) c->used += (size_t)n;
+    serveLines(srv, self, c);
+}
+
+/* answer the updates the writer handed back since the last look */
+static void serveCompleted(Server *srv, int self) {
+    char drain[64];
+    while (read(srv->rd[self].wake[0], drain, sizeof(drain)) > 0) {}
+    for (ServerUpdate *u = __atomic_exchange_n(&srv->rd[self].done, NULL, __ATOMIC_ACQUIRE), *next; u; u = next) {
+        next = u->next;
+        ServerConn *c = u->conn;
+        c->waiting = 0;
+        if (u->result != 0) sendError(c, "rejected");
+        else sendReply(c, "", 0);
+        serveLines(srv, self, c);
+    }
+}
+
+static void setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags != -1) fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void closeConn(ServerConn *c) {
+    close(c->fd);
+    free(c->out);
+    free(c);
+}
+
+/* a reader: accept connections off the shared listening socket and answer
+   requests on all of its connections as they arrive. Once the server
+   stops it waits for the updates it still has with the writer. */
+static void *serverRead(void *p) {
+    ReaderArg *arg = (ReaderArg*)p;
+    Server *srv = arg->srv;
+    int self = arg->self;
+    free(arg);
+    ServerConn *conns[SERVER_READER_CONNS];
+    struct pollfd pfd[SERVER_READER_CONNS + 2];
+    int nconns = 0, waiting = 0;
+    while (waiting || !__atomic_load_n(&srv->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < nconns; ++i) {
+            ServerConn *c = conns[i];
+            pfd[i].fd = c->gone ? -1 : c->fd;
+            pfd[i].events = (c->closing || c->used == sizeof(c->buf) ? 0 : POLLIN)
+                          | (c->outSent < c->outLen ? POLLOUT : 0);
+        }
+        int wakeAt = nconns, listenAt = nconns + 1;
+        pfd[wakeAt].fd = srv->rd[self].wake[0];
+        pfd[wakeAt].events = POLLIN;
+        pfd[listenAt].fd = nconns < SERVER_READER_CONNS ? srv->listenFd : -1;    /* full: accept no more */
+        pfd[listenAt].events = POLLIN;
+        if (poll(pfd, (nfds_t)listenAt + 1, SERVER_POLL_MS) <= 0) continue;
+
+        if (pfd[wakeAt].revents) serveCompleted(srv, self);
+        for (int i = 0; i < nconns; ++i) {
+            ServerConn *c = conns[i];
+            if (pfd[i].revents & (POLLOUT | POLLERR | POLLHUP)) {
+                connFlush(c);
+                serveLines(srv, self, c);               /* the client may take replies again */
+            }
+            if (pfd[i].revents & (POLLIN | POLLHUP)) serveInput(srv, self, c);
+        }
+        /* walk down so closing a connection (swap with the last) skips nothing */
+        waiting = 0;
+        for (int i = nconns - 1; i >= 0; --i) {
+            ServerConn *c = conns[i];
+            waiting += c->waiting;
+            if (c->waiting || !(c->gone || (c->closing && c->outSent == c->outLen))) continue;
+            closeConn(c);
+            conns[i] = conns[--nconns];
+        }
+        if (pfd[listenAt].fd < 0 || !(pfd[listenAt].revents & POLLIN)) continue;
+        int fd = accept(srv->listenFd, NULL, NULL);
+        if (fd < 0) continue;                   /* another reader took it */
+        setNonBlocking(fd);
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));    /* fails harmlessly on Unix sockets */
+        ServerConn *c = xrealloc(NULL, sizeof(*c));
+        c->fd = fd;
+        c->format = srv->format;
+        c->waiting = c->closing = c->gone = 0;
+        c->used = 0;
+        c->out = NULL;
+        c->outSent = c->outLen = c->outCap = 0;
+        conns[nconns++] = c;
+    }
+    for (int i = 0; i < nconns; ++i) {
+        connFlush(conns[i]);                    /* the "shutdown" reply, as far as it goes */
+        closeConn(conns[i]);
+    }
+    rbRelease();
+    return NULL;
+}
+
+/* "unix:PATH" or anything containing '/' is a Unix socket; "PORT" or
+   "HOST:PORT" is TCP, on 127.0.0.1 when no host is given. Returns a bound
+   and listening (listening != 0) or connected socket, or -1. */
+static int openSocket(const char *address, int listening, char **unixPath) {
+    const char *path = strncmp(address, "unix:", 5) == 0 ? address + 5 : strchr(address, '/') ? address : NULL;
+    if (path) {
+        struct sockaddr_un sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sun_family = AF_UNIX;
+        if (path[0] == '\0' || strlen(path) >= sizeof(sa.sun_path)) return -1;
+        strcpy(sa.sun_path, path);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+        struct stat st;
+        if (listening && stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);    /* left by an earlier run */
+        int rc = listening ? bind(fd, (struct sockaddr*)&sa, sizeof(sa)) : connect(fd, (struct sockaddr*)&sa, sizeof(sa));
+        if (rc != 0 || (listening && listen(fd, 64) != 0)) { close(fd); return -1; }
+        if (listening && unixPath) {
+            *unixPath = xrealloc(NULL, strlen(path) + 1);
+            strcpy(*unixPath, path);
+        }
+        return fd;
+    }
+
+    char host[256] = "127.0.0.1";
+    const char *port = strrchr(address, ':');
+    if (port) {
+        size_t n = (size_t)(port - address);
+        if (n >= sizeof(host)) return -1;
+        if (n > 0) { memcpy(host, address, n); host[n] = '\0'; }
+        ++port;
+    } else {
+        port = address;
+    }
+    struct addrinfo hints, *res, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host, port, &hints, &res) != 0) return -1;
+    int fd = -1;
+    for (ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        if (listening) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        else setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        int rc = listening ? bind(fd, ai->ai_addr, ai->ai_addrlen) : connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc != 0 || (listening && listen(fd, 64) != 0)) { close(fd); fd = -1; }
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+int runServer(Graph *graph, const char *address, int readers) {
+    if (!graph || !address) return -1;
+    if (readers < 1) readers = 1;
+    if (readers > SERVER_MAX_READERS) readers = SERVER_MAX_READERS;
+    Server srv;
+    memset(&srv, 0, sizeof(srv));
+    srv.listenFd = openSocket(address, 1, &srv.unixPath);
+    if (srv.listenFd < 0) {
+        message("Cannot listen on '%s'.\n", address);
+        return -1;
+    }
+    setNonBlocking(srv.listenFd);
+    srv.graph = graph;
+    srv.readers = readers;
+    srv.format = graph->format;
+    srv.epoch = 1;
+    srv.rd = xrealloc(NULL, (size_t)readers * sizeof(ServerReader));
+    memset(srv.rd, 0, (size_t)readers * sizeof(ServerReader));
+    for (int r = 0; r < readers; ++r) {
+        if (pipe(srv.rd[r].wake) != 0) {
+            perror("pipe");
+            exit(EXIT_FAILURE);
+        }
+        setNonBlocking(srv.rd[r].wake[0]);
+        setNonBlocking(srv.rd[r].wake[1]);
+    }
+    pthread_mutex_init(&srv.lock, NULL);
+    pthread_cond_init(&srv.wake, NULL);
+
+    double t0 = nowSeconds();
+    serverPublish(&srv);
+    message("Serving '%s' with %d reader%s (%d perspectives, copied in %.1f ms).\n",
+            address, readers, readers == 1 ? "" : "s", graph->numNodes, (nowSeconds() - t0) * 1e3);
+
+    pthread_t *tids = xrealloc(NULL, (size_t)readers * sizeof(pthread_t));
+    for (int r = 0; r < readers; ++r) {
+        ReaderArg *arg = xrealloc(NULL, sizeof(*arg));
+        arg->srv = &srv;
+        arg->self = r;
+        if (pthread_create(&tids[r], NULL, serverRead, arg) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    serverWrite(&srv);
+    for (int r = 0; r < readers; ++r) pthread_join(tids[r], NULL);
+    free(tids);
+
+    close(srv.listenFd);
+    if (srv.unixPath) unlink(srv.unixPath);
+    free(srv.unixPath);
+    ServedGraph *last = srv.current;
+    srv.current = NULL;
+    last->next = srv.retired;
+    for (ServedGraph *s = last, *next; s; s = next) {
+        next = s->next;
+        serveFree(s);
+    }
+    free(srv.changed);
+    for (int r = 0; r < readers; ++r) {
+        close(srv.rd[r].wake[0]);
+        close(srv.rd[r].wake[1]);
+    }
+    free(srv.rd);
+    pthread_mutex_destroy(&srv.lock);
+    pthread_cond_destroy(&srv.wake);
+    message("Server stopped after %ld published snapshot%s.\n", srv.published, srv.published == 1 ? "" : "s");
+    return 0;
+}
+
+int connectServer(const char *address) {
+    return address ? openSocket(address, 0, NULL) : -1;
+}
+
+long serverRequest(int fd, const char *request, char **reply, size_t *cap) {
+    if (fd < 0 || !request || !reply || !cap) return -1;
+    size_t rlen = strlen(request);
+    struct iovec iov[2] = { { (void*)request, rlen }, { "\n", 1 } };
+    if (sendAll(fd, iov, rlen && request[rlen - 1] == '\n' ? 1 : 2) != 0) return -1;
+
+    size_t used = 0, head = 0, need = 0;
+    for (;;) {
+        size_t want = head ? need + 1 : used + 4096;
+        if (want > *cap) {
+            size_t c = *cap ? *cap : 64 * 1024;
+            while (c < want) c *= 2;
+            *reply = xrealloc(*reply, c);
+            *cap = c;
+        }
+        if (head && used >= need) break;
+        ssize_t n = recv(fd, *reply + used, (head ? need : *cap - 1) - used, 0);
+        if (n <= 0) return -1;
+        used += (size_t)n;
+        if (head) continue;
+        char *nl = memchr(*reply, '\n', used);
+        if (!nl) continue;
+        head = (size_t)(nl - *reply) + 1;
+        if (strncmp(*reply, "OK ", 3) == 0) {
+            need = head + strtoul(*reply + 3, NULL, 10);
+        } else {
+            /* error text without "ERR " and the newline */
+            size_t len = head > 5 ? head - 5 : 0;
+            if (strncmp(*reply, "ERR ", 4) != 0) return -1;
+            memmove(*reply, *reply + 4, len);
+            (*reply)[len] = '\0';
+            return -2;
+        }
+    }
+    memmove(*reply, *reply + head, need - head);
+    (*reply)[need - head] = '\0';
+    return (long)(need - head);
+}
+
+#else   /* no socket server on Windows yet */
+
+int runServer(Graph *graph, const char *address, int readers) {
+    (void)graph; (void)readers;
+    message("Cannot listen on '%s': the query server needs POSIX sockets.\n", address ? address : "");
+    return -1;
+}
+
+int connectServer(const char *address) {
+    (void)address;
+    return -1;
+}
+
+long serverRequest(int fd, const char *request, char **reply, size_t *cap) {
+    (void)fd; (void)request; (void)reply; (void)cap;
+    return -1;
+}
+
+#endif
+
+/* ---------- Concurrent ingest ---------- */
+
+/* Each shard's queue is a bounded ring of sequenced slots: a producer
+   claims a position with one compare-and-swap on enqueuePos and publishes
+   the slot by advancing its seq; the shard's single consumer needs no
+   atomic read-modify-write at all. An idle consumer sleeps on its wake
+   condition variable, a producer facing a full queue on space; each side
+   only signals the other when it announced it is waiting.
+
+   A consumer applies records to its own perspectives without locking.
+   What would touch graph-wide storage is kept in the shard until the
+   batch ends: new KPI names go to a per-batch arena under staged handles,
+   log records to a buffer, band events to a queue. ingestMerge then takes
+   the shared lock once to intern the names, deliver the events and append
+   the records. History entries come from a per-shard stock refilled
+   INGEST_HISTORY_REFILL at a time, history chunks from a per-shard pool;
+   both go back to the graph at close. */
+#define INGEST_NAME_INLINE 88       /* longer KPI names are copied to the heap */
+#define INGEST_SPINS 64             /* empty polls before a consumer sleeps */
+#define INGEST_HISTORY_REFILL 64    /* history handles a shard takes per trip to the graph */
+#define NAME_SHARD_SHIFT 25         /* staged handle: NAME_STAGED | shard << 25 | arena offset */
+
+/* one queued record (128 bytes). seq == position: free for the producer
+   claiming that position; position + 1: filled, for the consumer */
+typedef struct IngestSlot {
+    uint64_t seq;
+    int32_t op;
+    int32_t perspective;
+    float target;
+    float achieved;
+    int32_t period;
+    char *longName;                 /* NULL: the name is in name[] */
+    char name[INGEST_NAME_INLINE];
+} IngestSlot;
+
+/* a name staged by the current batch and the KPI slot carrying it */
+typedef struct StagedName {
+    PersNode *pnode;
+    int slot;
+    uint32_t handle;                /* staged handle */
+    uint32_t pooled;                /* its handle in the graph's pool, once merged */
+} StagedName;
+
+typedef struct IngestShard {
+    uint64_t enqueuePos;            /* atomic: next position producers claim */
+    char pad0[56];
+    uint64_t dequeuePos;            /* consumer only */
+    IngestSlot *slots;
+    struct Ingest *owner;
+    int index;                      /* in owner->shards */
+    int sleeping;                   /* atomic: the consumer waits on wake */
+    int blocked;                    /* atomic: producers waiting on space */
+    pthread_mutex_t lock;           /* the hand-offs only */
+    pthread_cond_t wake;
+    pthread_cond_t space;
+    pthread_t tid;
+    long fullWaits;                 /* atomic */
+    long applied;                   /* consumer only, read once it stopped */
+    long rejected;
+    long batches;
+
+    /* consumer only: what the current batch staged */
+    char *names;                    /* arena: one name per record at most */
+    uint32_t namesLen;
+    StagedName *staged;
+    int numStaged;
+    BandEvent *events;
+    int numEvents;
+    int capEvents;
+    unsigned char *wal;             /* encoded log records */
+    size_t walLen;
+    size_t walCap;
+    int walRecords;
+    /* consumer only, handed to the graph at close */
+    uint32_t freeHistory;           /* stock of unused handles, linked by nextFree */
+    ObjPool chunkPool;              /* history chunks this shard took or gave back */
+    char pad1[64];
+} IngestShard;
+
+struct Ingest {
+    Graph *graph;
+    IngestShard *shards;
+    int numShards;
+    int stop;                       /* atomic: consumers exit once their queue is empty */
+    pthread_mutex_t lock;           /* the shared lock */
+    void **retired;                 /* blocks replaced by growShared, freed at close */
+    int numRetired;
+    int capRetired;
+};
+
+static void sharedLock(Graph *graph) {
+    if (graph->ingest) pthread_mutex_lock(&graph->ingest->lock);
+}
+
+static void sharedUnlock(Graph *graph) {
+    if (graph->ingest) pthread_mutex_unlock(&graph->ingest->lock);
+}
+
+/* a bigger block for a graph-wide table holding its first used bytes.
+   Without a pipeline this is realloc; with one the old block is retired
+   instead of freed (callers hold the shared lock). Publish the result with
+   an atomic store. */
+static void *growShared(Graph *graph, void *old, size_t used, size_t size) {
+    struct Ingest *in = graph->ingest;
+    if (!in) return xrealloc(old, size);
+    void *p = xrealloc(NULL, size);
+    if (used) memcpy(p, old, used);
+    if (old) {
+        if (in->numRetired == in->capRetired) {
+            in->capRetired = in->capRetired ? in->capRetired * 2 : 16;
+            in->retired = xrealloc(in->retired, (size_t)in->capRetired * sizeof(void*));
+        }
+        in->retired[in->numRetired++] = old;
+    }
+    return p;
+}
+
+static void bumpVersion(Graph *graph) {
+    if (graph->ingest) __atomic_fetch_add(&graph->version, 1, __ATOMIC_RELAXED);
+    else graph->version++;
+}
+
+/* the shard this thread consumes for, set by ingestConsumer */
+static THREAD_LOCAL IngestShard *ingestSelf;
+
+/* the shard staging graph's edits on this thread, or NULL */
+static IngestShard *stagingShard(const Graph *graph) {
+    IngestShard *sh = ingestSelf;
+    return sh && sh->owner->graph == graph ? sh : NULL;
+}
+
+static uint32_t stageName(Graph *graph, PersNode *pnode, int slot, const char *name) {
+    IngestShard *sh = stagingShard(graph);
+    if (!sh) return 0;
+    size_t len = strlen(name);
+    uint32_t handle = NAME_STAGED | (uint32_t)sh->index << NAME_SHARD_SHIFT | sh->namesLen;
+    memcpy(sh->names + sh->namesLen, name, len + 1);
+    sh->namesLen += (uint32_t)len + 1;
+    StagedName *s = &sh->staged[sh->numStaged++];
+    s->pnode = pnode;
+    s->slot = slot;
+    s->handle = handle;
+    return handle;
+}
+
+static const char *stagedName(const Graph *graph, uint32_t handle) {
+    const IngestShard *sh = &graph->ingest->shards[(handle & ~NAME_STAGED) >> NAME_SHARD_SHIFT];
+    return sh->names + (handle & ((1u << NAME_SHARD_SHIFT) - 1));
+}
+
+/* does the current batch have a staged name in pnode? */
+static int stagedIn(const Graph *graph, const PersNode *pnode) {
+    const IngestShard *sh = stagingShard(graph);
+    for (int i = 0; sh && i < sh->numStaged; ++i)
+        if (sh->staged[i].pnode == pnode) return 1;
+    return 0;
+}
+
+static uint32_t stageHistoryNew(Graph *graph) {
+    IngestShard *sh = stagingShard(graph);
+    if (!sh) return 0;
+    if (!sh->freeHistory) {
+        sharedLock(graph);
+        for (int i = 0; i < INGEST_HISTORY_REFILL; ++i) {
+            uint32_t handle = historyTake(graph);
+            KPIHistory *h = historyEntry(graph, handle);
+            h->chunks = NULL;           /* as freed entries are: stock unused at close goes back */
+            h->count = h->capChunks = 0;
+            h->nextFree = sh->freeHistory;
+            sh->freeHistory = handle;
+        }
+        sharedUnlock(graph);
+    }
+    uint32_t handle = sh->freeHistory;
+    sh->freeHistory = historyEntry(graph, handle)->nextFree;
+    return handle;
+}
+
+static int stageHistoryFree(Graph *graph, uint32_t handle) {
+    IngestShard *sh = stagingShard(graph);
+    if (!sh) return 0;
+    historyEntry(graph, handle)->nextFree = sh->freeHistory;
+    sh->freeHistory = handle;
+    return 1;
+}
+
+static ObjPool *chunkPoolOf(Graph *graph) {
+    IngestShard *sh = stagingShard(graph);
+    return sh ? &sh->chunkPool : &graph->chunkPool;
+}
+
+static int stageBandEvent(Graph *graph, const BandEvent *ev) {
+    IngestShard *sh = stagingShard(graph);
+    if (!sh) return 0;
+    if (sh->numEvents == sh->capEvents) {
+        sh->capEvents = sh->capEvents ? sh->capEvents * 2 : 64;
+        sh->events = xrealloc(sh->events, (size_t)sh->capEvents * sizeof(BandEvent));
+    }
+    sh->events[sh->numEvents++] = *ev;
+    return 1;
+}
+
+static int stageWalRecord(Graph *graph, int type, const void *a, size_t alen, const void *b, size_t blen) {
+    IngestShard *sh = stagingShard(graph);
+    if (!sh) return 0;
+    walEncode(&sh->wal, &sh->walLen, &sh->walCap, type, a, alen, b, blen);
+    sh->walRecords++;
+    return 1;
+}
+
+/* end of a batch: one trip under the shared lock interns the staged names,
+   delivers the band events (their KPI names still point into the arena)
+   and appends the log records; then the staged KPIs take their pooled
+   handles and the compactions deferred for them run */
+static void ingestMerge(IngestShard *sh) {
+    Graph *graph = sh->owner->graph;
+    if (!sh->numStaged && !sh->numEvents && !sh->walRecords) return;
+    sharedLock(graph);
+    for (int i = 0; i < sh->numStaged; ++i)
+        sh->staged[i].pooled = internName(graph, stagedName(graph, sh->staged[i].handle));
+    for (int i = 0; i < sh->numEvents; ++i) graph->bandListener(graph, &sh->events[i], graph->bandContext);
+    if (sh->walRecords) {
+        Wal *wal = graph->wal;
+        if (wal->len + sh->walLen > wal->cap) {
+            wal->cap = wal->cap * 2 + sh->walLen;
+            wal->buf = xrealloc(wal->buf, wal->cap);
+        }
+        memcpy(wal->buf + wal->len, sh->wal, sh->walLen);
+        wal->len += sh->walLen;
+        walAdded(graph, sh->walRecords);
+    }
+    sharedUnlock(graph);
+
+    for (int i = 0; i < sh->numStaged; ++i) {
+        const StagedName *s = &sh->staged[i];
+        if (s->slot < s->pnode->kpiLen && s->pnode->kpis[s->slot].name == s->handle)
+            s->pnode->kpis[s->slot].name = s->pooled;
+    }
+    for (int i = 0; i < sh->numStaged; ++i) {
+        PersNode *pnode = sh->staged[i].pnode;
+        if (pnode->kpiLen - pnode->kpiCount > pnode->kpiCount) kpiCompact(graph, pnode);
+    }
+    sh->namesLen = 0;
+    sh->numStaged = 0;
+    sh->numEvents = 0;
+    sh->walLen = 0;
+    sh->walRecords = 0;
+}
+
+/* the next filled slot, or NULL. Sequentially consistent, like the
+   producer's publishing store: see the sleep hand-off in ingestConsumer. */
+static IngestSlot *ingestHead(IngestShard *sh) {
+    IngestSlot *slot = &sh->slots[sh->dequeuePos & (INGEST_QUEUE_RECORDS - 1)];
+    return __atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) == sh->dequeuePos + 1 ? slot : NULL;
+}
+
+/* apply one record as the direct call would; 0, or -1 if it is refused */
+static int ingestApply(Graph *graph, const IngestSlot *slot) {
+    PersNode *pnode = graph->pers[slot->perspective];
+    const char *name = slot->longName ? slot->longName : slot->name;
+    KPI *k;
+    int created;
+    switch (slot->op) {
+    case INGEST_KPI:
+        if (slot->period != PERIOD_LATEST) {
+            recordObservation(graph, pnode, NULL, name, slot->period, slot->target, slot->achieved);
+            return 0;
+        }
+        return putKPI(graph, pnode, name, slot->target, slot->achieved, graph->duplicates, &created) ? 0 : -1;
+    case INGEST_ACHIEVED:
+        if (!(k = findKPI(graph, pnode, name)) || k->history) return -1;
+        setKPIValues(graph, pnode, k, k->target, slot->achieved);
+        return 0;
+    case INGEST_DELETE:
+        if (!(k = findKPI(graph, pnode, name))) return -1;
+        removeKPI(graph, pnode, k);
+        return 0;
+    }
+    return -1;
+}
+
+/* a shard's consumer: apply what is queued, up to INGEST_BATCH records at
+   a time, freeing each slot as soon as it is applied; sleep when idle */
+static void *ingestConsumer(void *p) {
+    IngestShard *sh = (IngestShard*)p;
+    struct Ingest *in = sh->owner;
+    ingestSelf = sh;
+    for (;;) {
+        int n = 0;
+        for (IngestSlot *slot; n < INGEST_BATCH && (slot = ingestHead(sh)); ++n) {
+            if (ingestApply(in->graph, slot) == 0) sh->applied++;
+            else sh->rejected++;
+            free(slot->longName);
+            /* sequentially consistent against blocked: see ingestPush */
+            __atomic_store_n(&slot->seq, sh->dequeuePos + INGEST_QUEUE_RECORDS, __ATOMIC_SEQ_CST);
+            sh->dequeuePos++;
+        }
+        if (n) {
+            sh->batches++;
+            if (__atomic_load_n(&sh->blocked, __ATOMIC_SEQ_CST)) {
+                pthread_mutex_lock(&sh->lock);
+                pthread_cond_broadcast(&sh->space);
+                pthread_mutex_unlock(&sh->lock);
+            }
+            ingestMerge(sh);
+            continue;
+        }
+        for (int spin = 0; spin < INGEST_SPINS && !ingestHead(sh); ++spin) sched_yield();
+        if (ingestHead(sh)) continue;
+        /* announce the sleep, then look again: a producer that missed the
+           announcement published its record before this second look */
+        pthread_mutex_lock(&sh->lock);
+        __atomic_store_n(&sh->sleeping, 1, __ATOMIC_SEQ_CST);
+        while (!ingestHead(sh) && !__atomic_load_n(&in->stop, __ATOMIC_ACQUIRE))
+            pthread_cond_wait(&sh->wake, &sh->lock);
+        __atomic_store_n(&sh->sleeping, 0, __ATOMIC_RELAXED);
+        int done = !ingestHead(sh);
+        pthread_mutex_unlock(&sh->lock);
+        if (done) return NULL;
+    }
+}
+
+struct Ingest *ingestOpen(Graph *graph, int shards) {
+    if (!graph || graph->ingest) return NULL;
+    if (shards > INGEST_MAX_SHARDS) shards = INGEST_MAX_SHARDS;
+    if (shards > graph->numNodes) shards = graph->numNodes;
+    if (shards < 1) shards = 1;
+    struct Ingest *in = xrealloc(NULL, sizeof(*in));
+    memset(in, 0, sizeof(*in));
+    in->graph = graph;
+    in->numShards = shards;
+    in->shards = xrealloc(NULL, (size_t)shards * sizeof(IngestShard));
+    memset(in->shards, 0, (size_t)shards * sizeof(IngestShard));
+    pthread_mutex_init(&in->lock, NULL);
+    graph->ingest = in;
+    for (int s = 0; s < shards; ++s) {
+        IngestShard *sh = &in->shards[s];
+        sh->owner = in;
+        sh->index = s;
+        sh->slots = xrealloc(NULL, INGEST_QUEUE_RECORDS * sizeof(IngestSlot));
+        for (uint64_t i = 0; i < INGEST_QUEUE_RECORDS; ++i) sh->slots[i].seq = i;
+        sh->names = xrealloc(NULL, (size_t)INGEST_BATCH * MAX_KPI_NAME_LEN);
+        sh->staged = xrealloc(NULL, INGEST_BATCH * sizeof(StagedName));
+        poolInit(&sh->chunkPool, sizeof(HistoryChunk));
+        pthread_mutex_init(&sh->lock, NULL);
+        pthread_cond_init(&sh->wake, NULL);
+        pthread_cond_init(&sh->space, NULL);
+        if (pthread_create(&sh->tid, NULL, ingestConsumer, sh) != 0) {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return in;
+}
+
+int ingestPush(struct Ingest *in, const IngestRecord *r) {
+    if (!in || !r || !r->kpi) return -1;
+    if (r->perspective < 0 || r->perspective >= in->graph->numNodes || !validKPIName(r->kpi)) return -1;
+    if (r->op == INGEST_KPI) {
+        if (!validTarget(r->target) || !validAchieved(r->achieved) || r->period < 0) return -1;
+    } else if (r->op == INGEST_ACHIEVED) {
+        if (!validAchieved(r->achieved)) return -1;
+    } else if (r->op != INGEST_DELETE) {
+        return -1;
+    }
+    IngestShard *sh = &in->shards[r->perspective % in->numShards];
+    size_t len = strlen(r->kpi);
+    char *longName = NULL;
+    if (len >= INGEST_NAME_INLINE) {
+        longName = xrealloc(NULL, len + 1);
+        memcpy(longName, r->kpi, len + 1);
+    }
+
+    IngestSlot *slot;
+    uint64_t pos = __atomic_load_n(&sh->enqueuePos, __ATOMIC_RELAXED);
+    int waited = 0;
+    for (;;) {
+        slot = &sh->slots[pos & (INGEST_QUEUE_RECORDS - 1)];
+        int64_t diff = (int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&sh->enqueuePos, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+            continue;
+        }
+        if (diff < 0) {
+            /* full: sleep until the consumer frees a batch. blocked is
+               raised before the slot is read again, and the consumer frees
+               slots before it reads blocked, so one of them sees the other */
+            if (!waited++) __atomic_fetch_add(&sh->fullWaits, 1, __ATOMIC_RELAXED);
+            pthread_mutex_lock(&sh->lock);
+            __atomic_fetch_add(&sh->blocked, 1, __ATOMIC_SEQ_CST);
+            while ((int64_t)(__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) - pos) < 0)
+                pthread_cond_wait(&sh->space, &sh->lock);
+            __atomic_fetch_sub(&sh->blocked, 1, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&sh->lock);
+        }
+        pos = __atomic_load_n(&sh->enqueuePos, __ATOMIC_RELAXED);
+    }
+    slot->op = r->op;
+    slot->perspective = r->perspective;
+    slot->target = r->target;
+    slot->achieved = r->achieved;
+    slot->period = r->op == INGEST_KPI ? r->period : PERIOD_LATEST;
+    slot->longName = longName;
+    if (!longName) memcpy(slot->name, r->kpi, len + 1);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sh->sleeping, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&sh->lock);
+        pthread_cond_signal(&sh->wake);
+        pthread_mutex_unlock(&sh->lock);
+    }
+    return 0;
+}
+
+void ingestClose(struct Ingest *in, IngestStats *stats) {
+    if (!in) return;
+    __atomic_store_n(&in->stop, 1, __ATOMIC_RELEASE);
+    IngestStats total = { 0, 0, 0, 0, 0 };
+    for (int s = 0; s < in->numShards; ++s) {
+        IngestShard *sh = &in->shards[s];
+        pthread_mutex_lock(&sh->lock);
+        pthread_cond_signal(&sh->wake);
+        pthread_mutex_unlock(&sh->lock);
+    }
+    Graph *graph = in->graph;
+    for (int s = 0; s < in->numShards; ++s) pthread_join(in->shards[s].tid, NULL);
+    for (int s = 0; s < in->numShards; ++s) {
+        IngestShard *sh = &in->shards[s];
+        total.applied += sh->applied;
+        total.rejected += sh->rejected;
+        total.batches += sh->batches;
+        total.fullWaits += sh->fullWaits;
+        /* the shard's history stock and chunks go back to the graph */
+        for (uint32_t handle = sh->freeHistory, next; handle; handle = next) {
+            KPIHistory *h = historyEntry(graph, handle);
+            next = h->nextFree;
+            h->nextFree = graph->freeHistory;
+            graph->freeHistory = handle;
+        }
+        poolAdopt(&graph->chunkPool, &sh->chunkPool);
+        pthread_mutex_destroy(&sh->lock);
+        pthread_cond_destroy(&sh->wake);
+        pthread_cond_destroy(&sh->space);
+        free(sh->slots);
+        free(sh->names);
+        free(sh->staged);
+        free(sh->events);
+        free(sh->wal);
+    }
+    total.pushed = total.applied + total.rejected;
+    if (stats) *stats = total;
+    graph->ingest = NULL;
+    for (int i = 0; i < in->numRetired; ++i) free(in->retired[i]);
+    free(in->retired);
+    pthread_mutex_destroy(&in->lock);
+    free(in->shards);
+    free(in);
+}
+
+void getAllocStats(const Graph *graph, AllocStats *out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (!graph) return;
+    const ObjPool *pools[] = { &graph->persPool, &graph->chunkPool };
+    for (size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); ++i) {
+        out->mallocCalls += pools[i]->chunkCount;
+        out->objects += pools[i]->objects;
+        out->bytes += pools[i]->bytes;
+    }
+    for (int i = 0; i < graph->numNodes; ++i) {
+        const PersNode *node = graph->pers[i];
+        out->objects += node->kpiCount;
+        out->kpiBytes += (size_t)node->kpiCap * sizeof(KPI) + (size_t)node->kpiIndexCap * sizeof(KPISlot);
+    }
+    out->kpiBytes += (size_t)graph->capHistories * sizeof(KPIHistory) +
+                     (size_t)graph->capHistoryPages * sizeof(KPIHistory*);
+    out->nameBytes = (size_t)graph->names.cap + (size_t)graph->names.indexCap * sizeof(uint32_t);
+    out->bytes += out->kpiBytes + out->nameBytes;
+}
+
+int perspectiveTreeHeight(const Graph *graph) {
+    return graph ? bst_height(graph->bstRoot) : 0;
+}
+
+/* display numbered list of perspectives using mapping order */
+void displayPerspectives(const Graph *graph)
+{
+    if (!graph) { printf("(No graph available)\n"); return; }
+    printf("\nExisting Perspectives (count = %d):\n", graph->numNodes);
+    if (graph->numNodes == 0) { printf("  (no perspectives defined)\n"); return; }
+    for (int i = 0; i < graph->numNodes; ++i) {
+        printf("  %d. %s\n", i + 1, graph->nodes[i]);
+    }
+}
+
+/* free all memory: object pools, KPI arrays and indexes, history table, name pool, columns, adjacency and mapping tables */
+void freeAll(Graph *graph) {
+    if (!graph) return;
+    int columnar = graph->columnar;
+    struct WorkPool *pool = graph->pool;
+    ReportFormat format = graph->format;
+    DuplicatePolicy duplicates = graph->duplicates;
+    BandListener bandListener = graph->bandListener;
+    void *bandContext = graph->bandContext;
+    Wal *wal = graph->wal;
+    uint64_t version = graph->version;
+    for (int i = 0; i < graph->numNodes; ++i) {
+        free(graph->pers[i]->kpis);
+        free(graph->pers[i]->kpiIndex);
+        KPIColumns *c = &graph->pers[i]->cols;
+        free(c->target);
+        free(c->achieved);
+        free(c->kpi);
+    }
+    for (uint32_t i = 0; i < graph->numHistories; ++i) free(historyEntry(graph, i + 1)->chunks);
+    for (uint32_t p = 0; p < graph->capHistories / HISTORY_PAGE_ENTRIES; ++p) free(graph->historyPages[p]);
+    free(graph->historyPages);
+    free(graph->names.bytes);
+    free(graph->names.index);
+    poolReleaseAll(&graph->persPool);
+    poolReleaseAll(&graph->chunkPool);
+    graph->bstRoot = NULL;
+    for (int i = 0; i < graph->capNodes; ++i) free(graph->adj[i].to);
+    free(graph->adj);
+    free(graph->index);
+    free(graph->pers);
+    free(graph->hashes);
+    free(graph->folded);
+    free(graph->nodes);
+    initGraph(graph);
+    graph->columnar = columnar;
+    graph->pool = pool;
+    graph->format = format;
+    graph->duplicates = duplicates;
+    graph->bandListener = bandListener;
+    graph->bandContext = bandContext;
+    graph->wal = wal;
+    graph->version = version + 1;   /* emptied counts as a change */
+}
@@ -1,77 +1,955 @@
-#ifndef BSCC_H
-#define BSCC_H
-
-#include <stdio.h>
-
-#define MAX_PERSPECTIVES 10
-#define MAX_NAME_LEN 50
-/* --- Add ANSI colour macros --- */
-#define ANSI_RESET   "\x1b[0m"
-#define ANSI_RED     "\x1b[31m"
-#define ANSI_GREEN   "\x1b[32m"
-#define ANSI_YELLOW  "\x1b[33m"   /* amber-ish */
-#define ANSI_BLUE    "\x1b[34m"
-
-
-/* KPI linked list node (stored per-perspective inside BST nodes) */
-typedef struct KPI {
-    char name[MAX_NAME_LEN];
-    float target;
-    float achieved;
-    struct KPI *next;
-} KPI;
-
-/* BST node: a perspective with its own KPI linked list and BST children */
-typedef struct PersNode {
-    char name[MAX_NAME_LEN];
-    KPI *kpiList;
-    struct PersNode *left;
-    struct PersNode *right;
-} PersNode;
-
-/* Graph adjacency mapping for dependencies
-   - nodes[] stores names in insertion order and is used for adjacency indices
-   - numNodes is the number of mapped perspective names (<= MAX_PERSPECTIVES)
-   - bstRoot points to the BST root containing PersNode nodes (same names) */
-typedef struct Graph {
-    char nodes[MAX_PERSPECTIVES][MAX_NAME_LEN];
-    int adj[MAX_PERSPECTIVES][MAX_PERSPECTIVES];
-    int numNodes;
-    PersNode *bstRoot;
-} Graph;
-
-/* Initialize graph structure and BST root */
-void initGraph(Graph *graph);
-
-/* Add perspective (case-insensitive) - ensures mapping and BST node exist */
-void addPerspectiveIfNotExists(Graph *graph, const char *name);
-
-/* Find the index in graph->nodes[] for a perspective name (case-insensitive).
-   Returns -1 if not present. */
-int findPerspective(const Graph *graph, const char *name);
-
-/* Add directed dependency edge from -> to */
-void addDependency(Graph *graph, const char *from, const char *to);
-
-/* Print adjacency list of dependencies */
-void showDependencies(const Graph *graph);
-
-/* Add Key Performance Indicator (interactive) */
-void addKPI(Graph *graph);
-
-/* Display all Key Performance Indicators by traversing the BST (inorder) */
-void displayKPIs(const Graph *graph);
-
-/* Compute and print KPI performance per KPI (simple list) */
-void generateScorecard(const Graph *graph);
-
-/* Aggregate averages per perspective, then report dependency impacts */
-void evaluatePerformanceWithDependencies(const Graph *graph);
-
-/* Print existing perspectives (numbered list) */
-void displayPerspectives(const Graph *graph);
-
-/* Free all dynamically allocated KPIs and BST nodes */
-void freeAll(Graph *graph);
-
-#endif /* BSCC_H */
+#ifndef BSCC_H
+#define BSCC_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define INITIAL_PERSPECTIVE_CAPACITY 16   /* perspective table grows by doubling */
+#define MAX_NAME_LEN 50
+/* --- Add ANSI colour macros --- */
+#define ANSI_RESET   "\x1b[0m"
+#define ANSI_RED     "\x1b[31m"
+#define ANSI_GREEN   "\x1b[32m"
+#define ANSI_YELLOW  "\x1b[33m"   /* amber-ish */
+#define ANSI_BLUE    "\x1b[34m"
+
+
+/* One dated reading of a KPI. period is any increasing integer key chosen
+   by the caller, e.g. 202541 for week 41 of 2025. */
+#define PERIOD_LATEST INT32_MAX    /* "current values" in period-targeted reports */
+
+typedef struct KPIObservation {
+    int32_t period;
+    float target;
+    float achieved;
+} KPIObservation;
+
+/* A KPI's observations in period order, stored in fixed-size chunks that are
+   addressed through a directory, so observation i is found in O(1) and an
+   append never moves existing data. Chunks come from a graph-owned pool;
+   the headers live in the graph's history table and are named by handle.
+   The table is allocated in pages, so a header never moves once issued. */
+#define HISTORY_CHUNK_OBS 32       /* power of two */
+#define HISTORY_PAGE_ENTRIES 256   /* history table page size, power of two */
+
+typedef struct HistoryChunk {
+    KPIObservation obs[HISTORY_CHUNK_OBS];
+} HistoryChunk;
+
+typedef struct KPIHistory {
+    HistoryChunk **chunks;          /* oldest first */
+    int count;                      /* observations stored */
+    int capChunks;
+    uint32_t nextFree;              /* unused entries: next unused handle, 0 = none */
+} KPIHistory;
+
+/* KPI names may be longer than perspective names; longer ones are rejected,
+   never cut. Names are interned (see NamePool), a KPI holds a handle. */
+#define MAX_KPI_NAME_LEN 1024
+
+/* One KPI: 16 bytes, kept in its perspective's kpis[] array in insertion
+   order (reports list it newest first). target / achieved are the current
+   values: the latest observation when the KPI has a history. A deleted
+   KPI leaves a slot with name 0 behind until the array is compacted. */
+typedef struct KPI {
+    uint32_t name;          /* handle into the graph's name pool (0 = deleted slot) */
+    float target;
+    float achieved;
+    uint32_t history;       /* handle into the graph's history table (0 = none yet) */
+} KPI;
+
+/* Interned KPI names: every distinct name is stored once in one growing
+   buffer, after its 32-bit hash and followed by a NUL, and named by its
+   byte offset (never 0). index is an open-addressing hash of the handles,
+   at most half full. A deleted KPI's name stays until the pool is
+   compacted: when storing a new name would grow the buffer and enough KPIs
+   were deleted since the last compaction, and at each walCheckpoint. A
+   compaction keeps only the names live KPIs use and renumbers their
+   handles; it never runs while an ingest pipeline is open. */
+typedef struct NamePool {
+    char *bytes;
+    uint32_t len;
+    uint32_t cap;
+    uint32_t *index;        /* handles, 0 = empty slot */
+    uint32_t indexCap;
+    uint32_t count;         /* distinct names */
+    uint32_t released;      /* KPIs deleted since the last compaction */
+    uint32_t compactions;   /* bumped by every compaction: earlier handles are void */
+} NamePool;
+
+/* Performance bands behind the report colours (cut-offs 20 / 80 / 100 %) */
+typedef enum PerfBand {
+    BAND_RED,       /* < 20% */
+    BAND_AMBER,     /* 20% - <80% */
+    BAND_GREEN,     /* 80% - 100% */
+    BAND_BLUE,      /* > 100% */
+    BAND_COUNT
+} PerfBand;
+
+/* Optional struct-of-arrays copy of a perspective's KPIs, in list order.
+   Built lazily when the graph is in columnar mode; dirty marks it stale. */
+typedef struct KPIColumns {
+    float *target;
+    float *achieved;
+    const KPI **kpi;        /* owning KPI records, same order */
+    int count;
+    int cap;
+    int dirty;
+} KPIColumns;
+
+/* Sum / count of KPI performance percentages plus per-band counts */
+typedef struct KPIBatchStats {
+    double sumPerf;
+    int count;
+    int bands[BAND_COUNT];
+} KPIBatchStats;
+
+/* One slot of a perspective's KPI name index: hash of the case-folded name
+   and the KPI it names, as its position in kpis[] plus one (0 = empty slot) */
+typedef struct KPISlot {
+    unsigned hash;
+    uint32_t kpi;
+} KPISlot;
+
+/* BST node: a perspective with its own KPI array and BST children.
+   The tree is an AVL tree ordered case-insensitively; height is the node's
+   subtree height (leaf = 1). id is the stable index into Graph.nodes[] / adj[].
+   kpis[0, kpiLen) holds the KPIs oldest first, kpiCount of them live; the
+   array is compacted once deleted slots outnumber them. kpiIndex is an open-addressing hash of the KPI names (at most half full);
+   kpiShadowed counts KPIs hidden from it by a newer KPI of the same name.
+   perfSum / perfCount / perfMin / perfMax are running aggregates of the KPI
+   performance percentages, kept current on every KPI mutation. Removing an
+   extreme does not rescan: min / max become bounds only and perfStale
+   counts the edits since; they are rescanned after perfCount such edits
+   (amortised O(1)) or when queried. */
+typedef struct PersNode {
+    char name[MAX_NAME_LEN];
+    int id;
+    int height;
+    KPI *kpis;
+    int kpiLen;
+    int kpiCap;
+    KPISlot *kpiIndex;
+    int kpiIndexCap;
+    int kpiCount;
+    int kpiShadowed;
+    KPIColumns cols;
+    double perfSum;
+    int perfCount;
+    int perfStale;
+    float perfMin;
+    float perfMax;
+    struct PersNode *left;
+    struct PersNode *right;
+} PersNode;
+
+/* Windowed view of a KPI's history (see kpiTrend). Performance values are
+   achieved/target*100 per observation. */
+typedef struct KPITrend {
+    int samples;            /* observations in the window */
+    int32_t firstPeriod;
+    int32_t lastPeriod;
+    float average;          /* rolling average performance over the window */
+    float slope;            /* least-squares change in performance per observation */
+    int prevSamples;        /* observations in the window just before it */
+    float prevAverage;
+    float change;           /* average - prevAverage (period-over-period) */
+} KPITrend;
+
+/* Output format of the scorecard and evaluation reports. Reports are
+   formatted into one reusable buffer and written with a single write(). */
+typedef enum ReportFormat {
+    REPORT_COLOR,   /* text with ANSI colour codes (default) */
+    REPORT_PLAIN,   /* the same text without colour codes */
+    REPORT_JSON,    /* one JSON object per report */
+    REPORT_CSV      /* header row + one row per KPI / perspective */
+} ReportFormat;
+
+/* What adding a KPI does when its perspective already has a KPI of that
+   name (names match case-insensitively) */
+typedef enum DuplicatePolicy {
+    DUPLICATE_UPDATE,   /* set the existing KPI's target and achieved (default);
+                           refused when it has a history */
+    DUPLICATE_REJECT,   /* refuse the new KPI */
+    DUPLICATE_APPEND    /* add a second KPI; lookups by name find the newest */
+} DuplicatePolicy;
+
+/* Parallel score passes split every perspective's KPIs into chunks of this
+   many entries. Partial results are merged in chunk order, so they do not
+   depend on the number of threads. */
+#define EVAL_CHUNK_KPIS 16384
+#define EVAL_MAX_THREADS 64
+
+struct WorkPool;            /* work-stealing thread pool (bsc.c) */
+struct Ingest;              /* concurrent ingest pipeline (bsc.c) */
+
+/* Fixed-size object pool: objects are carved sequentially out of large
+   chunks (which double in size up to POOL_MAX_CHUNK_OBJS objects). Single
+   objects given back go on a free list that later allocations reuse first;
+   the chunks themselves are released all at once by poolReleaseAll. */
+#define POOL_FIRST_CHUNK_OBJS 64
+#define POOL_MAX_CHUNK_OBJS   65536
+
+typedef struct PoolChunk {
+    struct PoolChunk *next;
+} PoolChunk;
+
+typedef struct ObjPool {
+    PoolChunk *chunks;
+    char *cursor;           /* next free object in the newest chunk */
+    char *limit;            /* end of the newest chunk */
+    void *freeList;         /* objects given back, linked through their first word */
+    size_t objSize;         /* rounded up for alignment */
+    int nextChunkObjs;
+    long chunkCount;        /* malloc calls made */
+    long objects;           /* objects handed out and not given back */
+    size_t bytes;           /* bytes reserved in chunks */
+} ObjPool;
+
+/* Allocation counters for a graph's KPI, perspective and history storage */
+typedef struct AllocStats {
+    long mallocCalls;       /* chunk allocations made by the pools */
+    long objects;           /* KPIs, perspective nodes and history blocks allocated */
+    size_t bytes;           /* bytes reserved in all (kpiBytes and nameBytes included) */
+    size_t kpiBytes;        /* KPI arrays, their name indexes and the history table */
+    size_t nameBytes;       /* interned KPI names and their index */
+} AllocStats;
+
+/* Write-ahead log of graph mutations (see walOpen). Records are buffered in
+   memory and made durable in groups: one write + fsync per commit, issued
+   when any of the limits below is reached or walCommit is called. */
+#define WAL_GROUP_RECORDS 4096          /* buffered records per commit */
+#define WAL_GROUP_BYTES   (1 << 20)     /* buffered bytes per commit */
+#define WAL_GROUP_MS      5.0           /* max age of the oldest buffered record */
+
+typedef struct Wal {
+    FILE *file;
+    char *path;
+    unsigned char *buf;     /* records not yet written */
+    size_t len;
+    size_t cap;
+    int pending;            /* records in buf */
+    double firstPending;    /* when the oldest record in buf was added */
+    long records;           /* records appended since open */
+    long commits;           /* write + fsync groups issued since open */
+    long replayed;          /* records applied when the log was opened */
+} Wal;
+
+/* A band change seen while a KPI was edited (see setBandListener).
+   Bands are PerfBand values, or -1 for "no data" (a perspective without
+   KPIs that count). */
+typedef enum BandEventKind {
+    BAND_EVENT_KPI,             /* a KPI's performance moved to another band */
+    BAND_EVENT_PERSPECTIVE,     /* a perspective's average moved, or gained / lost its data */
+    BAND_EVENT_IMPACT,          /* the evaluation now reports perspective -> affected */
+    BAND_EVENT_IMPACT_CLEARED   /* ...and no longer does */
+} BandEventKind;
+
+typedef struct BandEvent {
+    BandEventKind kind;
+    int perspective;        /* perspective id (impacts: the weak one) */
+    const char *kpi;        /* KPI events only, else NULL */
+    int affected;           /* impact events: dependent perspective id, else -1 */
+    int from;               /* band before, -1 = no data */
+    int to;                 /* band after, -1 = no data */
+    float before;           /* performance (KPI) or average before / after */
+    float after;
+} BandEvent;
+
+struct Graph;
+typedef void (*BandListener)(const struct Graph *graph, const BandEvent *event, void *context);
+
+/* Out-edges of one perspective: destination indices kept sorted ascending */
+typedef struct AdjList {
+    int *to;
+    int count;
+    int cap;
+} AdjList;
+
+/* Graph adjacency mapping for dependencies
+   - nodes[] stores names in insertion order and is used for adjacency indices
+   - adj[i] lists the destinations of edges i -> j (sparse, O(V+E) memory)
+   - folded[] holds the lowercased names, computed once at insert time
+   - pers[] maps an id straight to its BST node
+   - index is an open-addressing hash of folded names -> id+1 (0 = empty slot)
+   - numNodes / capNodes are the used and allocated sizes of the per-id tables
+   - bstRoot points to the BST root containing PersNode nodes (same names) */
+typedef struct Graph {
+    char (*nodes)[MAX_NAME_LEN];
+    char (*folded)[MAX_NAME_LEN];
+    unsigned *hashes;
+    PersNode **pers;
+    AdjList *adj;
+    int *index;
+    int indexCap;
+    int numNodes;
+    int capNodes;
+    int numEdges;
+    int columnar;           /* score passes use KPIColumns + SIMD kernel */
+    struct WorkPool *pool;  /* worker threads for evaluateKPIStats, or NULL */
+    ReportFormat format;    /* used by displayKPIs / scorecard / evaluation */
+    DuplicatePolicy duplicates; /* used by addKPI / addKPIRecord / loads */
+    BandListener bandListener;  /* band alerts, or NULL */
+    void *bandContext;
+    ObjPool persPool;       /* owns every PersNode */
+    ObjPool chunkPool;      /* owns every HistoryChunk */
+    NamePool names;         /* every KPI name */
+    KPIHistory **historyPages; /* history table: handle h is entry h - 1, HISTORY_PAGE_ENTRIES a page */
+    uint32_t numHistories;  /* entries in use or on the unused chain */
+    uint32_t capHistories;  /* entries in allocated pages */
+    uint32_t capHistoryPages;
+    uint32_t freeHistory;   /* first unused handle, 0 = none */
+    struct Ingest *ingest;  /* running ingest pipeline, or NULL */
+    Wal *wal;               /* attached write-ahead log, or NULL */
+    uint64_t snapshotId;    /* checksum of the snapshot the graph is based on (0 = none) */
+    uint64_t snapshotParent;/* that snapshot's own base */
+    uint64_t version;       /* bumped by every change to perspectives or KPI values */
+    PersNode *bstRoot;
+} Graph;
+
+/* Initialize graph structure and BST root */
+void initGraph(Graph *graph);
+
+/* Add perspective (case-insensitive) - ensures mapping and BST node exist */
+void addPerspectiveIfNotExists(Graph *graph, const char *name);
+
+/* Find the index in graph->nodes[] for a perspective name (case-insensitive).
+   Returns -1 if not present. */
+int findPerspective(const Graph *graph, const char *name);
+
+/* Add directed dependency edge from -> to */
+void addDependency(Graph *graph, const char *from, const char *to);
+
+/* Print adjacency list of dependencies */
+void showDependencies(const Graph *graph);
+
+/* Add Key Performance Indicator (interactive) */
+void addKPI(Graph *graph);
+
+/* Read and drop the rest of a stdin line (stops at EOF too); used after
+   scanf in the interactive prompts */
+void discardLine(void);
+
+/* Add one KPI without prompting (creates the perspective if needed).
+   Applies the addKPI validation rules and the duplicate policy; returns 0
+   on success (KPI added or updated), -1 if rejected. */
+int addKPIRecord(Graph *graph, const char *perspective, const char *name,
+                 float target, float achieved);
+
+/* Select what adding an existing KPI name does (kept across freeAll) */
+void setDuplicatePolicy(Graph *graph, DuplicatePolicy policy);
+
+/* "update", "reject" or "append" -> policy; -1 if unknown */
+int parseDuplicatePolicy(const char *name);
+
+/* KPI lookups and edits by name go through the perspective's hash index
+   and cost O(1) expected. A KPI with a history takes new values only as
+   dated observations (recordKPIObservation): its current values are its
+   latest observation, and the undated edits below refuse it rather than
+   overwrite that observation. */
+
+/* Find a KPI (the newest one if the name was appended twice); NULL if none.
+   The record moves when its perspective gains or loses KPIs. */
+const KPI *lookupKPI(const Graph *graph, const char *perspective, const char *name);
+
+/* A KPI's name, as first added (valid until the graph is next modified) */
+const char *kpiNameOf(const Graph *graph, const KPI *kpi);
+
+/* Add a KPI, or set target and achieved of the one already named so,
+   whatever the duplicate policy. Returns 1 if added, 0 if updated, -1 if
+   rejected (addKPI validation rules, or the KPI has a history). */
+int upsertKPI(Graph *graph, const char *perspective, const char *name,
+              float target, float achieved);
+
+/* Set an existing KPI's achieved value. Returns 0, or -1 if the KPI is
+   unknown, has a history or the value is invalid. */
+int updateKPIAchieved(Graph *graph, const char *perspective, const char *name, float achieved);
+
+/* Remove a KPI together with its history. Returns 0, or -1 if unknown. */
+int deleteKPI(Graph *graph, const char *perspective, const char *name);
+
+/* Record the value of a KPI for one period (creates the perspective and the
+   KPI if needed; KPI names match case-insensitively). A period already in
+   the history is overwritten, an earlier one is inserted in order. The
+   KPI's current values follow its latest observation. Returns 0 on success,
+   -1 if rejected (addKPI validation rules, period must be 0..PERIOD_LATEST-1). */
+int recordKPIObservation(Graph *graph, const char *perspective, const char *name,
+                         int32_t period, float target, float achieved);
+
+/* Rolling statistics over the last window observations of a KPI up to and
+   including period asOf (PERIOD_LATEST = newest). Costs O(log history +
+   window). Returns 0, or -1 if the KPI is unknown or has no observation
+   in range. */
+int kpiTrend(const Graph *graph, const char *perspective, const char *name,
+             int32_t asOf, int window, KPITrend *out);
+
+/* Print kpiTrend results for one KPI */
+void showKPITrend(const Graph *graph, const char *perspective, const char *name,
+                  int32_t asOf, int window);
+
+/* Display all Key Performance Indicators by traversing the BST (inorder) */
+void displayKPIs(const Graph *graph);
+
+/* Select the report format (kept across freeAll) */
+void setReportFormat(Graph *graph, ReportFormat format);
+
+/* "color", "plain", "json" or "csv" -> format; -1 if unknown */
+int parseReportFormat(const char *name);
+
+/* Compute and print KPI performance per KPI (simple list) */
+void generateScorecard(const Graph *graph);
+
+/* Scorecard as of a period: each KPI with a history shows its latest
+   observation at or before period; KPIs without a history show their
+   current values. PERIOD_LATEST gives generateScorecard's report. */
+void generateScorecardForPeriod(const Graph *graph, int32_t period);
+
+/* Aggregate averages per perspective, then report dependency impacts */
+void evaluatePerformanceWithDependencies(const Graph *graph);
+
+/* The evaluation report as of a period (same KPI selection as
+   generateScorecardForPeriod) */
+void evaluatePerformanceForPeriod(const Graph *graph, int32_t period);
+
+/* Follow dependency edges transitively: report dependency cycles and, for
+   every perspective under 80%, each downstream perspective it can reach
+   together with the shortest path length */
+void evaluateTransitiveImpact(const Graph *graph);
+
+/* Counters reported by a bulk KPI load */
+typedef struct LoadStats {
+    long rowsRead;      /* data rows seen (blank lines and header excluded) */
+    long rowsLoaded;    /* rows inserted as KPIs */
+    long rowsRejected;  /* rows failing validation */
+    double seconds;     /* wall time spent mapping + parsing + inserting */
+} LoadStats;
+
+/* Bulk-load KPIs from a perspective,kpi,target,achieved[,period] file (CSV or TSV,
+   optional header row). Rows with a period are recorded as observations
+   (recordKPIObservation); rows without one add a KPI. The file is memory-mapped and parsed in place; rows are validated
+   with the same rules as addKPI and rejected rows are reported with their line.
+   Returns 0 on success, -1 if the file could not be read. stats may be NULL. */
+int loadKPIsFromFile(Graph *graph, const char *path, LoadStats *stats);
+
+/* Switch score passes between walking KPI lists (0) and the columnar store
+   with the vectorised ratio kernel (1). Columns are built on first use. */
+void setColumnarKPIs(Graph *graph, int enabled);
+
+/* Performance sum / count / band counts for one perspective id. In columnar
+   mode this (re)builds the perspective's column cache, so the graph is not
+   const and calls on one graph must not overlap. */
+void perspectiveKPIStats(Graph *graph, int id, KPIBatchStats *out);
+
+/* Number of threads (calling thread included) used by evaluateKPIStats and
+   the period-targeted evaluation; 1 (the default) runs them serially.
+   Set it back to 1 to stop the worker threads. */
+void setEvalThreads(Graph *graph, int threads);
+
+/* Performance sum / count / band counts of every perspective as of period
+   (PERIOD_LATEST = current values); out must hold numNodes entries. The KPIs
+   are cut into EVAL_CHUNK_KPIS chunks that the worker pool shares by work
+   stealing, so a few very large perspectives still spread over all threads.
+   PERIOD_LATEST passes run the vectorised kernel over the column caches and
+   rebuild stale ones, so the graph is not const. */
+void evaluateKPIStats(Graph *graph, int32_t period, KPIBatchStats *out);
+
+/* Ratio kernel over n KPIs: achieved/target*100 per entry (KPIs with a zero
+   target are skipped). perfOut may be NULL. Dispatches to AVX2 / SSE2 / scalar. */
+void kpiPerfKernel(const float *target, const float *achieved, int n,
+                   float *perfOut, KPIBatchStats *out);
+
+/* Name of the kernel variant selected for this CPU */
+const char *kpiKernelName(void);
+
+/* Allocation counters of the graph's object pools */
+void getAllocStats(const Graph *graph, AllocStats *out);
+
+/* Height of the perspective tree (0 when empty); stays O(log n) */
+int perspectiveTreeHeight(const Graph *graph);
+
+/* Save the whole graph (perspectives, dependency edges, KPI lists and histories) as a
+   versioned, checksummed binary snapshot. The file is written to path.tmp
+   and renamed over path, so a crash never leaves a half-written snapshot.
+   Returns 0 on success, -1 on I/O error. */
+int saveSnapshot(const Graph *graph, const char *path);
+
+/* Replace the graph's contents with a snapshot. The file is memory-mapped and
+   verified (magic, version, bounds, checksum), then the graph is rebuilt by
+   copying from its sections; the mapping is released before returning.
+   Returns 0 on success, -1 if unreadable, -2 if invalid. An invalid file is
+   normally rejected before the graph is touched; if a problem only shows up
+   while rebuilding, the graph is left empty. */
+int loadSnapshot(Graph *graph, const char *path);
+
+/* Open (or create) a write-ahead log and attach it to the graph. Records
+   already in the log are replayed first; a torn or corrupt final record is
+   dropped and cut off. The log must belong to the snapshot the graph was
+   loaded from (or to no snapshot); a log already folded into that snapshot
+   by an interrupted checkpoint is discarded. From then on every new
+   perspective, dependency and KPI is appended. Returns the number of
+   records replayed, or -1 if the log cannot be used. */
+long walOpen(Graph *graph, const char *path);
+
+/* Make all buffered log records durable now. Returns 0 or -1 on I/O error. */
+int walCommit(Graph *graph);
+
+/* Save a snapshot and restart the log from it (the log is emptied). Also
+   compacts the KPI name pool when KPIs were deleted since the last time. */
+int walCheckpoint(Graph *graph, const char *snapshotPath);
+
+/* Commit, close and detach the graph's log (no-op if none). */
+void walClose(Graph *graph);
+
+/* Where status and error messages of dependency edits, loads, snapshots
+   and the write-ahead log go (NULL = stdout, the default). Reports always
+   go to stdout. */
+void setMessageStream(FILE *stream);
+
+/* ---------- Query API ----------
+   Pure queries for embedding: results go into caller-provided structs and
+   arrays and nothing is printed. They never write to the graph, so any
+   number of threads may query one graph while nobody edits it. (With worker
+   threads configured, a period query uses the parallel pass: it allocates
+   its task table per call and shares the pool one pass at a time.) Name
+   pointers in results point into the graph and stay valid until the graph
+   is next modified. Functions taking an array and a capacity return the
+   number of entries available, so a call with cap 0 gives the size. */
+
+/* One KPI's values and performance as of a period */
+typedef struct KPIResult {
+    const char *name;
+    float target;
+    float achieved;
+    float performance;      /* achieved / target * 100 */
+    PerfBand band;
+    int32_t period;         /* observation used; PERIOD_LATEST = current values */
+    int hasValue;           /* 0: no observation at or before the period */
+} KPIResult;
+
+/* A perspective's average performance */
+typedef struct PerspectiveResult {
+    const char *name;
+    int id;
+    int kpiCount;           /* KPIs counted in the average */
+    float average;          /* 0 when kpiCount is 0 */
+    PerfBand band;
+} PerspectiveResult;
+
+/* Dependency edge leaving a perspective averaging under 80% */
+typedef struct ImpactEdge {
+    int from;
+    int to;
+    float fromAverage;
+    PerfBand band;
+} ImpactEdge;
+
+/* Summary of an evaluation */
+typedef struct EvaluationResult {
+    int32_t period;
+    int numPerspectives;    /* entries written to the perspective array */
+    int numImpacts;         /* impact edges in total (written up to capacity) */
+    int withData;           /* perspectives with at least one KPI value */
+    float overall;          /* mean of the perspective averages with data */
+    int lowest;             /* id of the lowest average, -1 if no data */
+    float lowestAverage;
+} EvaluationResult;
+
+/* Reads one perspective's KPIs in list order, a batch at a time */
+typedef struct KPICursor {
+    const Graph *graph;
+    const PersNode *node;
+    int next;               /* kpis[] position after the next KPI to read */
+    int32_t period;
+} KPICursor;
+
+int perspectiveCount(const Graph *graph);
+const char *perspectiveName(const Graph *graph, int id);     /* NULL if out of range */
+
+/* Perspective ids in name order: pass -1 for the first, then the previous
+   id; returns -1 after the last. O(log perspectives) per step. */
+int nextPerspectiveByName(const Graph *graph, int prev);
+
+/* Start reading perspective id's KPIs as of period */
+void openKPICursor(const Graph *graph, int id, int32_t period, KPICursor *cur);
+
+/* Fill up to cap results; returns the number written, 0 when done */
+int readKPIs(KPICursor *cur, KPIResult *out, int cap);
+
+/* Destinations of id's dependency edges, ascending ids; writes entries
+   [first, first + cap) and returns the total count */
+int queryDependencies(const Graph *graph, int id, int first, int *to, int cap);
+
+/* Lowest and highest current KPI performance of perspective id; returns
+   the number of KPIs with a non-zero target (min / max untouched if 0).
+   O(1) unless an extreme was removed recently, then the KPIs are scanned. */
+int queryPerspectiveRange(const Graph *graph, int id, float *min, float *max);
+
+/* Averages of every perspective (id order) as of period */
+int queryPerspectives(const Graph *graph, int32_t period, PerspectiveResult *out, int cap);
+
+/* Averages, impact edges, overall score and lowest performer. persp must
+   hold perspectiveCount() entries; impacts may be NULL with impactCap 0.
+   Returns 0, or -1 on bad arguments or a too-small persp. */
+int queryEvaluation(const Graph *graph, int32_t period,
+                    PerspectiveResult *persp, int perspCap,
+                    ImpactEdge *impacts, int impactCap, EvaluationResult *out);
+
+/* ---------- Distribution analytics ----------
+   One scan over every KPI feeds all of these at once: bounded heaps for
+   the k worst / best KPIs, per-perspective band counts and a quantile
+   sketch for the percentiles. */
+
+/* A KPI's place in a ranking */
+typedef struct KPIRank {
+    const char *name;
+    int perspective;        /* perspective id */
+    float performance;
+    PerfBand band;
+} KPIRank;
+
+/* Streaming quantiles: log-linear buckets, 2^SKETCH_SUB_BITS per power of
+   two, so a quantile is within 1% of the exact value. Values below
+   2^SKETCH_MIN_EXP share bucket 0, values from 2^SKETCH_MAX_EXP share the
+   last one. Fixed size, no allocation; sketches of equal shape merge by
+   adding buckets. */
+#define SKETCH_SUB_BITS 6
+#define SKETCH_MIN_EXP  (-16)
+#define SKETCH_MAX_EXP  32
+#define SKETCH_BUCKETS  (((SKETCH_MAX_EXP - SKETCH_MIN_EXP) << SKETCH_SUB_BITS) + 2)
+
+typedef struct QuantileSketch {
+    uint64_t count;
+    float min;
+    float max;
+    uint32_t buckets[SKETCH_BUCKETS];
+} QuantileSketch;
+
+void sketchInit(QuantileSketch *s);
+void sketchAdd(QuantileSketch *s, float v);
+/* Nearest-rank quantile, q in [0, 1]; 0 for an empty sketch */
+float sketchQuantile(const QuantileSketch *s, double q);
+
+/* Organisation-wide summary of one scan */
+typedef struct KPIDistribution {
+    int32_t period;
+    long kpis;              /* KPIs with a value (and a non-zero target) */
+    double mean;
+    float min;
+    float max;
+    float p50, p90, p99;    /* from the sketch, within 1% */
+    int bands[BAND_COUNT];  /* over all perspectives */
+    int worstCount;         /* entries written to worst / best */
+    int bestCount;
+} KPIDistribution;
+
+/* Scan every KPI as of period. worst receives up to k KPIs from the
+   lowest performance up, best up to k from the highest down (either may
+   be NULL); perPerspective, when not NULL, needs perspectiveCount()
+   entries and receives each perspective's sum, count and band counts.
+   Ties rank by perspective id, then name. Returns 0, or -1 on bad
+   arguments. */
+int queryDistribution(const Graph *graph, int32_t period, int k,
+                      KPIRank *worst, KPIRank *best, KPIBatchStats *perPerspective,
+                      KPIDistribution *out);
+
+/* Print the distribution report (k worst / best, bands, percentiles) */
+void showDistribution(const Graph *graph, int32_t period, int k);
+
+/* ---------- What-if scenarios ----------
+   A scenario overrides the achieved values of some KPIs. A batch evaluates
+   any number of them against the current values without touching the
+   graph: one baseline is computed, and each scenario only adjusts the
+   aggregates of the perspectives its overrides land in, so it costs
+   O(overrides). Scenarios are shared out over the graph's worker threads. */
+
+/* Hypothetical achieved value of one KPI (names match case-insensitively) */
+typedef struct KPIOverride {
+    const char *perspective;
+    const char *kpi;
+    float achieved;
+} KPIOverride;
+
+/* A named set of overrides; a KPI named twice takes the later value */
+typedef struct Scenario {
+    const char *name;
+    const KPIOverride *overrides;
+    int count;
+} Scenario;
+
+/* Evaluation of one scenario: what evaluating the graph with the
+   overrides applied would report (up to float rounding) */
+typedef struct ScenarioResult {
+    float overall;          /* mean of the perspective averages with data */
+    int lowest;             /* id of the lowest average, -1 if no data */
+    float lowestAverage;
+    int changed;            /* perspectives whose average moved */
+    int ignored;            /* overrides naming no KPI, or with achieved < 0 */
+    int numImpacts;         /* impact edges in total */
+    int numResolved;        /* baseline impact edges the scenario removes */
+    int numNewImpacts;      /* edges the baseline lacks, stored in the batch's */
+    int firstNewImpact;     /*   impacts[] from this index on */
+} ScenarioResult;
+
+/* Evaluate n scenarios. results needs n entries. averages, if not NULL,
+   receives n rows of perspectiveCount() averages. New impact edges of all
+   scenarios go to impacts in scenario order; a scenario whose range does
+   not fit in impactCap gets none written. baseline, if not NULL, receives
+   the evaluation without overrides. Returns the total number of new impact
+   edges, or -1 on bad arguments. */
+int runScenarios(const Graph *graph, const Scenario *scenarios, int n,
+                 ScenarioResult *results, float *averages,
+                 ImpactEdge *impacts, int impactCap, EvaluationResult *baseline);
+
+/* Run a batch and print each scenario against the baseline */
+void showScenarios(const Graph *graph, const Scenario *scenarios, int n);
+
+/* ---------- Scorecard hierarchy ----------
+   Many scorecards at once, one per business unit, arranged in a tree
+   (units -> divisions -> company). rollup computes each changed unit's
+   own per-perspective sums, counts and bands in parallel, then merges
+   totals upward one depth level at a time: a parent adds its children's
+   totals and never re-reads their KPIs. A unit counts as changed when its
+   graph's version moved, so only changed units and their paths to the
+   top are recomputed. Perspectives are matched across units by name,
+   ignoring case. */
+
+typedef struct ScorecardUnit {
+    char name[MAX_NAME_LEN];
+    Graph graph;            /* the unit's own KPIs (empty for pure roll-up levels) */
+    int parent;             /* unit id, -1 at the top */
+    int depth;
+    int *children;
+    int numChildren;
+    int capChildren;
+    int *globalId;          /* graph perspective id -> hierarchy perspective id */
+    int mapped;             /* graph perspectives present in globalId */
+    KPIBatchStats *own;     /* per hierarchy perspective: this unit's KPIs */
+    KPIBatchStats *total;   /* own + every descendant */
+    uint64_t seenVersion;   /* graph version own[] was computed from */
+    int ownDirty;           /* own[] needs recomputing */
+    int stale;              /* total[] needs recomputing */
+} ScorecardUnit;
+
+typedef struct Hierarchy {
+    ScorecardUnit **units;
+    int numUnits;
+    int capUnits;
+    Graph unitNames;        /* name index only: perspective id == unit id */
+    Graph perspectives;     /* name index only: hierarchy perspective ids; its
+                               format is the report format of showRollup */
+    int capStats;           /* entries allocated in every own / total */
+    int32_t period;         /* period of the last roll-up */
+    int rolled;             /* 0 until the first roll-up */
+    int maxDepth;
+    int *order;             /* scratch: unit ids grouped by depth */
+    struct WorkPool *pool;  /* roll-up workers, or NULL */
+} Hierarchy;
+
+void initHierarchy(Hierarchy *h);
+
+/* Add a unit under parent (NULL or "" = top level). Returns its id, or -1
+   if the name is empty or taken, or the parent is unknown. */
+int addUnit(Hierarchy *h, const char *name, const char *parent);
+
+/* Unit id by name (case-insensitive), -1 if absent */
+int findUnit(const Hierarchy *h, const char *name);
+
+/* The unit's own scorecard: load into it and edit it with the usual calls */
+Graph *unitGraph(Hierarchy *h, int unit);
+
+/* Worker threads (calling thread included) for rollup */
+void setRollupThreads(Hierarchy *h, int threads);
+
+/* Bring every unit's totals up to date as of period; returns the number
+   of units whose totals were recomputed */
+int rollup(Hierarchy *h, int32_t period);
+
+/* Averages of a unit and everything below it, per hierarchy perspective
+   (as of the last roll-up); returns the perspective count */
+int queryRollup(const Hierarchy *h, int unit, PerspectiveResult *out, int cap);
+
+/* Print the roll-up tree from unit down (-1 = every top-level unit) */
+void showRollup(const Hierarchy *h, int unit);
+
+/* Release every unit, the workers and the indexes */
+void freeHierarchy(Hierarchy *h);
+
+/* ---------- Band alerts ----------
+   With a listener set, every KPI edit (add, update, observation, delete,
+   load or log replay) compares the edited KPI's band and its
+   perspective's average band before and after, straight from the running
+   aggregates. When the average crosses the 80% impact threshold (or a
+   dependency is added out of a weak perspective), one impact event per
+   dependency edge leaving that perspective follows. The cost per edit is
+   O(1) plus the perspective's out-degree, whatever the scorecard size.
+   The listener runs inside the edit and must not modify the graph. */
+
+/* Set (or clear, with NULL) the listener; kept across freeAll */
+void setBandListener(Graph *graph, BandListener listener, void *context);
+
+/* Print one event in the graph's report format: a line of text, a JSON
+   object per line, or a CSV row event,perspective,kpi,affected,from,to,before,after */
+void showBandEvent(const Graph *graph, const BandEvent *event);
+
+/* ---------- Query server ----------
+   Answers queries from other processes on a local socket. Requests are
+   single lines, words split like the command line ("double quotes" group
+   words); every reply is "OK <length>\n" followed by that many bytes, or
+   "ERR <message>\n".
+     evaluate [PERIOD] | scorecard [PERIOD] | deps   the usual reports
+     format color|plain|json|csv                      for this connection
+     version                                          version of the served copy
+     add-kpi PERSPECTIVE KPI TARGET ACHIEVED [PERIOD] | set-achieved PERSPECTIVE KPI ACHIEVED
+     delete-kpi PERSPECTIVE KPI                       updates (answered once applied)
+     quit | shutdown                                  close the connection / stop the server
+   Readers render from an immutable copy of the graph, so a read never
+   waits for a write. The calling thread is the single writer: it applies
+   updates in batches and publishes a new copy at most every 20 ms (and
+   no more often than four times the last copy's cost). A copy shares
+   every perspective no update touched with the one before, so publishing
+   costs the changed perspectives' KPIs and histories. Copies a reader
+   may still be using are freed once it has moved on (epoch-based
+   reclamation). Each reader thread multiplexes up to 64 connections and
+   never blocks on one: an update is answered when the writer hands it
+   back (the connection's later requests follow it, in order), and replies
+   a client is slow to read wait on its connection. */
+#define SERVER_MAX_READERS 64
+
+/* Serve on address ("unix:PATH" or a path for a Unix socket, "PORT" or
+   "HOST:PORT" for TCP, 127.0.0.1 by default) with readers reader threads
+   until a client sends "shutdown". The graph must not be touched by
+   anyone else meanwhile. Returns 0, or -1 if the address cannot be used. */
+int runServer(Graph *graph, const char *address, int readers);
+
+/* Connect to a server; returns a socket, or -1 */
+int connectServer(const char *address);
+
+/* Send one request and wait for its reply. The payload is stored in
+   *reply (grown as needed, *cap bytes allocated, NUL-terminated). Returns
+   its length, -2 if the server answered ERR (message in *reply), or -1 on
+   a broken connection. */
+long serverRequest(int fd, const char *request, char **reply, size_t *cap);
+
+/* ---------- Concurrent ingest ----------
+   Several producer threads feed KPI edits into one graph at once. The
+   perspectives are split into shards (perspective id modulo the shard
+   count). Each shard has a bounded queue that any producer may push to,
+   and one consumer thread that pops records in batches and applies them
+   to that shard's perspectives only. A record is applied like the
+   matching single-threaded call, and records for one perspective are
+   applied in push order.
+   A consumer keeps what touches graph-wide storage (new KPI names,
+   write-ahead log records, band events) in the shard and merges it at
+   the end of each batch under one shared lock; history entries and
+   chunks come from a per-shard stock. So shards meet once per batch, not
+   once per record. The band listener is called from the consumers, one
+   event at a time, when the batch that raised the event is merged.
+   While the pipeline is open the graph must not be used except through
+   ingestPush, and perspectives and dependencies cannot be added. */
+#define INGEST_MAX_SHARDS 64
+#define INGEST_QUEUE_RECORDS 4096   /* per shard, power of two */
+#define INGEST_BATCH 256            /* records a consumer applies per batch */
+
+typedef enum IngestOp {
+    INGEST_KPI,             /* addKPIRecord, or recordKPIObservation with a period */
+    INGEST_ACHIEVED,        /* updateKPIAchieved */
+    INGEST_DELETE           /* deleteKPI */
+} IngestOp;
+
+typedef struct IngestRecord {
+    IngestOp op;
+    int perspective;        /* perspective id (see findPerspective) */
+    const char *kpi;        /* copied by ingestPush */
+    float target;           /* INGEST_KPI only */
+    float achieved;
+    int32_t period;         /* INGEST_KPI: PERIOD_LATEST = current values */
+} IngestRecord;
+
+typedef struct IngestStats {
+    long pushed;            /* records accepted by ingestPush */
+    long applied;
+    long rejected;          /* refused when applied: unknown KPI, duplicate policy,
+                               undated edit of a KPI with a history */
+    long batches;           /* consumer batches */
+    long fullWaits;         /* pushes that found their shard's queue full */
+} IngestStats;
+
+/* Start shards consumer threads on graph (at most INGEST_MAX_SHARDS and
+   one per perspective). Returns NULL if the graph already has an open
+   pipeline. */
+struct Ingest *ingestOpen(Graph *graph, int shards);
+
+/* Queue one record; safe from any number of threads. Sleeps while the
+   shard's queue is full, until its consumer has applied a batch. Returns 0, or -1 if the record is invalid
+   (unknown perspective, bad name or value), as the direct call would. */
+int ingestPush(struct Ingest *in, const IngestRecord *r);
+
+/* Apply everything queued, stop the consumers and free the pipeline;
+   stats may be NULL. Every producer must have finished pushing. */
+void ingestClose(struct Ingest *in, IngestStats *stats);
+
+/* ---------- Instrumentation ----------
+   Built with -DBSC_STATS, the core paths count calls, time themselves and
+   record tree depth, index probes, KPIs visited and bytes allocated.
+   Without it every hook compiles to nothing and getStats returns -1.
+   Every thread counts into its own block; getStats merges them. Every
+   call is counted, but findPerspective and KPI inserts are timed on only
+   one call in 64 to keep the clock off their path. */
+
+typedef enum StatOp {
+    STAT_FIND_PERSPECTIVE,  /* findPerspective */
+    STAT_INSERT_KPI,        /* one KPI linked into its perspective */
+    STAT_SCORE_PERSPECTIVE, /* one perspective's (or chunk's) score pass */
+    STAT_QUERY_PERSPECTIVES,/* queryPerspectives, all perspectives */
+    STAT_EVALUATE,          /* queryEvaluation */
+    STAT_RENDER,            /* one rendered scorecard / evaluation report */
+    STAT_DISTRIBUTION,      /* queryDistribution */
+    STAT_OP_COUNT
+} StatOp;
+
+/* latency bucket b counts calls taking [2^(b-1), 2^b) ns; bucket 0 is < 1 ns */
+#define STAT_HIST_BUCKETS 40
+
+/* ns, maxNs and hist cover the timed calls only */
+typedef struct OpStats {
+    uint64_t calls;
+    uint64_t timed;
+    uint64_t ns;
+    uint64_t maxNs;
+    uint64_t hist[STAT_HIST_BUCKETS];
+} OpStats;
+
+typedef struct BscStats {
+    OpStats op[STAT_OP_COUNT];
+    uint64_t indexLookups;  /* perspective hash index */
+    uint64_t indexProbes;
+    uint64_t treeInserts;   /* perspective tree: depth of each new node */
+    uint64_t treeInsertDepth;
+    uint64_t treeInsertMaxDepth;
+    uint64_t treeSearches;  /* perspective tree descents (name-order iteration) */
+    uint64_t treeSearchDepth;
+    uint64_t treeSearchMaxDepth;
+    uint64_t kpisVisited;   /* KPI values read by score passes and cursors */
+    uint64_t allocCalls;    /* malloc / realloc through the core, pool chunks included */
+    uint64_t allocBytes;    /* bytes requested by those calls */
+} BscStats;
+
+/* Copy the counters; returns 0, or -1 when built without BSC_STATS */
+int getStats(BscStats *out);
+
+/* Zero every counter. Counts a thread makes while this runs may survive. */
+void resetStats(void);
+
+/* Print the counters in the graph's report format; histograms adds the
+   per-operation latency histograms */
+void showStats(const Graph *graph, int histograms);
+
+/* Print existing perspectives (numbered list) */
+void displayPerspectives(const Graph *graph);
+
+/* Free all dynamically allocated KPIs and BST nodes (a few chunk releases).
+   The columnar, thread and format settings and any attached log are kept. */
+void freeAll(Graph *graph);
+
+#endif /* BSCC_H */
@@ -1,123 +1,860 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>      /* for isdigit */
-#include "bsc.h"
-
-/* forward declare freeAll in case bsc.h doesn't (your bsc.c implements it) */
-void freeAll(Graph *graph);
-
-int main() {
-    Graph g;
-    initGraph(&g);
-    addPerspectiveIfNotExists(&g, "Financial");
-addPerspectiveIfNotExists(&g, "Customer");
-addPerspectiveIfNotExists(&g, "Internal");
-addPerspectiveIfNotExists(&g, "Learning");
-/* default dependencies so the app has some initial working data */
-
-
-
-
-    int choice;
-    while (1) {
-        printf("\n=== Balanced Scorecard System ===\n");
-        printf("1. Add Key Performance Indicator (KPI)\n");
-        printf("2. View All KPIs\n");
-        printf("3. Generate Scorecard (per-KPI performance)\n");
-        printf("4. Show Dependencies\n");
-        printf("5. Evaluate Performance (averages + dependency impact + lowest performer)\n");
-        printf("6. Add Dependency Between Perspectives\n");
-        printf("7. Exit\n");
-        printf("Enter your choice: ");
-        if (scanf("%d", &choice) != 1) {
-            printf("Invalid input.\n");
-            while (getchar() != '\n'); // clear buffer
-            continue;
-        }
-        while (getchar() != '\n'); // consume leftover newline
-
-        switch (choice) {
-            case 1:
-                /* add KPI (interactive) */
-                addKPI(&g);
-                break;
-            case 2:
-                /* display all KPIs */
-                displayKPIs(&g);
-                break;
-            case 3:
-                /* generate per-KPI scorecard */
-                generateScorecard(&g);
-                break;
-            case 4:
-                /* show graph dependencies */
-                showDependencies(&g);
-                break;
-            case 5:
-                /* evaluate performance with dependency analysis */
-                evaluatePerformanceWithDependencies(&g);
-                break;
-            case 6: {
-                /* interactive dependency input, then call addDependency(graph, from, to) */
-                char a[MAX_NAME_LEN], b[MAX_NAME_LEN];
-
-                printf("\nAdd Dependency: A dependency edge A -> B means 'if A performs poorly, it may negatively impact B'.\n");
-                printf("Example: Learning -> Internal means poor Learning may lead to weaker Internal processes.\n\n");
-                
-
-                displayPerspectives(&g);
-                if (g.numNodes == 0) {
-                    printf("No perspectives exist yet. Add a perspective by adding a KPI with a new perspective name first.\n");
-                    break;
-                }
-
-                printf("Enter source perspective (from). You can type the number shown to pick an existing one, or type a NEW name (letters and spaces only): ");
-                if (!fgets(a, sizeof(a), stdin)) break;
-                a[strcspn(a, "\r\n")] = '\0';
-                if (a[0] == '\0') { printf("Source cannot be empty.\n"); break; }
-
-                printf("Enter destination perspective (to). You can type the number shown to pick an existing one, or type a NEW name (letters and spaces only): ");
-                if (!fgets(b, sizeof(b), stdin)) break;
-                b[strcspn(b, "\r\n")] = '\0';
-                if (b[0] == '\0') { printf("Destination cannot be empty.\n"); break; }
-
-                /* Interpret numeric selection or add new name after validation */
-                if (isdigit((unsigned char)a[0])) {
-                    int idx = atoi(a);
-                    if (idx <= 0 || idx > g.numNodes) { printf("Invalid source selection number.\n"); break; }
-                    strcpy(a, g.nodes[idx - 1]);
-                } else {
-                    /* new name should not contain digits */
-                    int bad = 0;
-                    for (char *p = a; *p; ++p) if (isdigit((unsigned char)*p)) { bad = 1; break; }
-                    if (bad) { printf("Perspective names should not contain digits.\n"); break; }
-                    addPerspectiveIfNotExists(&g, a);
-                }
-
-                if (isdigit((unsigned char)b[0])) {
-                    int idx = atoi(b);
-                    if (idx <= 0 || idx > g.numNodes) { printf("Invalid destination selection number.\n"); break; }
-                    strcpy(b, g.nodes[idx - 1]);
-                } else {
-                    int bad = 0;
-                    for (char *p = b; *p; ++p) if (isdigit((unsigned char)*p)) { bad = 1; break; }
-                    if (bad) { printf("Perspective names should not contain digits.\n"); break; }
-                    addPerspectiveIfNotExists(&g, b);
-                }
-
-                /* call the core graph function that takes (graph, from, to) */
-                addDependency(&g, a, b);
-                break;
-            }
-            case 7:
-                printf("Exiting program...\n");
-                freeAll(&g);
-                exit(0);
-            default:
-                printf("Invalid choice. Please select between 1–7.\n");
-        }
-    }
-
-    return 0;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>      /* for isdigit */
+#include <limits.h>
+#include "bsc.h"
+
+/* forward declare freeAll in case bsc.h doesn't (your bsc.c implements it) */
+void freeAll(Graph *graph);
+
+/* business units rolled up by the unit / rollup commands and menu items;
+   separate from the main scorecard */
+static Hierarchy hierarchy;
+
+/* prompt and read one line (newline stripped); returns 0 on EOF or empty input */
+static int promptLine(const char *prompt, char *buf, int size) {
+    printf("%s", prompt);
+    if (!fgets(buf, size, stdin)) return 0;
+    buf[strcspn(buf, "\r\n")] = '\0';
+    return buf[0] != '\0';
+}
+
+/* prompt for a period; blank input means the latest values */
+static int promptPeriod(const char *prompt, int32_t *period) {
+    char buf[32];
+    char *end;
+    printf("%s", prompt);
+    if (!fgets(buf, sizeof(buf), stdin)) return 0;
+    buf[strcspn(buf, "\r\n")] = '\0';
+    if (buf[0] == '\0') { *period = PERIOD_LATEST; return 1; }
+    long v = strtol(buf, &end, 10);
+    if (*end != '\0' || v < 0 || v >= PERIOD_LATEST) { printf("Invalid period.\n"); return 0; }
+    *period = (int32_t)v;
+    return 1;
+}
+
+/* ---------- Headless command mode ---------- */
+
+/* exit codes of a command run (startup failures keep EXIT_FAILURE) */
+enum {
+    CMD_OK = 0,
+    CMD_USAGE = 2,          /* unknown command or wrong arguments */
+    CMD_REJECTED = 3,       /* input failed validation (incl. rejected load rows) */
+    CMD_IO = 4              /* a file could not be read or written */
+};
+
+#define CMD_MAX_ARGS 8
+
+typedef struct Command {
+    const char *name;
+    int minArgs;
+    int maxArgs;
+    int (*run)(Graph *g, int argc, char **argv);
+    const char *usage;
+} Command;
+
+static int parseNumber(const char *s, float *out) {
+    char *end;
+    *out = strtof(s, &end);
+    return end != s && *end == '\0';
+}
+
+static int parsePeriodArg(const char *s, int32_t *out) {
+    char *end;
+    long v = strtol(s, &end, 10);
+    if (end == s || *end != '\0' || v < 0 || v >= PERIOD_LATEST) return 0;
+    *out = (int32_t)v;
+    return 1;
+}
+
+/* optional period argument: absent = latest */
+static int optionalPeriod(int argc, char **argv, int at, int32_t *period) {
+    *period = PERIOD_LATEST;
+    if (argc <= at) return 1;
+    if (parsePeriodArg(argv[at], period)) return 1;
+    fprintf(stderr, "invalid period '%s'\n", argv[at]);
+    return 0;
+}
+
+static int cmdLoad(Graph *g, int argc, char **argv) {
+    (void)argc;
+    LoadStats st;
+    if (loadKPIsFromFile(g, argv[1], &st) != 0) return CMD_IO;
+    return st.rowsRejected ? CMD_REJECTED : CMD_OK;
+}
+
+static int cmdAddPerspective(Graph *g, int argc, char **argv) {
+    (void)argc;
+    for (const char *p = argv[1]; *p; ++p)
+        if (isdigit((unsigned char)*p)) { fprintf(stderr, "perspective names cannot contain digits\n"); return CMD_REJECTED; }
+    addPerspectiveIfNotExists(g, argv[1]);
+    return CMD_OK;
+}
+
+static int cmdAddKPI(Graph *g, int argc, char **argv) {
+    float target, achieved;
+    int32_t period;
+    const KPI *kpi;
+    if (!parseNumber(argv[3], &target) || !parseNumber(argv[4], &achieved)) {
+        fprintf(stderr, "target and achieved must be numbers\n");
+        return CMD_USAGE;
+    }
+    if (argc > 5) {
+        if (!parsePeriodArg(argv[5], &period)) { fprintf(stderr, "invalid period '%s'\n", argv[5]); return CMD_USAGE; }
+        if (recordKPIObservation(g, argv[1], argv[2], period, target, achieved) == 0) return CMD_OK;
+    } else if (addKPIRecord(g, argv[1], argv[2], target, achieved) == 0) {
+        return CMD_OK;
+    } else if ((kpi = lookupKPI(g, argv[1], argv[2])) && g->duplicates == DUPLICATE_REJECT) {
+        fprintf(stderr, "KPI '%s' already exists under '%s'\n", argv[2], argv[1]);
+        return CMD_REJECTED;
+    } else if (kpi && kpi->history && g->duplicates == DUPLICATE_UPDATE) {
+        fprintf(stderr, "KPI '%s' under '%s' has a history; give the values a period\n", argv[2], argv[1]);
+        return CMD_REJECTED;
+    }
+    fprintf(stderr, "KPI rejected (no digits in perspective names, target 1-100, achieved >= 0)\n");
+    return CMD_REJECTED;
+}
+
+static int cmdSetAchieved(Graph *g, int argc, char **argv) {
+    (void)argc;
+    float achieved;
+    if (!parseNumber(argv[3], &achieved)) { fprintf(stderr, "achieved must be a number\n"); return CMD_USAGE; }
+    if (updateKPIAchieved(g, argv[1], argv[2], achieved) == 0) return CMD_OK;
+    const KPI *kpi = lookupKPI(g, argv[1], argv[2]);
+    if (!kpi) fprintf(stderr, "no KPI '%s' under '%s'\n", argv[2], argv[1]);
+    else if (kpi->history) fprintf(stderr, "KPI '%s' under '%s' has a history; use add-kpi with a period\n",
+                                   argv[2], argv[1]);
+    else fprintf(stderr, "invalid achieved value\n");
+    return CMD_REJECTED;
+}
+
+static int cmdDeleteKPI(Graph *g, int argc, char **argv) {
+    (void)argc;
+    if (deleteKPI(g, argv[1], argv[2]) == 0) return CMD_OK;
+    fprintf(stderr, "no KPI '%s' under '%s'\n", argv[2], argv[1]);
+    return CMD_REJECTED;
+}
+
+static int cmdDuplicates(Graph *g, int argc, char **argv) {
+    (void)argc;
+    int p = parseDuplicatePolicy(argv[1]);
+    if (p < 0) { fprintf(stderr, "unknown duplicate policy '%s'\n", argv[1]); return CMD_USAGE; }
+    setDuplicatePolicy(g, (DuplicatePolicy)p);
+    return CMD_OK;
+}
+
+static int cmdAddDep(Graph *g, int argc, char **argv) {
+    (void)argc;
+    for (int a = 1; a <= 2; ++a)
+        for (const char *p = argv[a]; *p; ++p)
+            if (isdigit((unsigned char)*p)) { fprintf(stderr, "perspective names cannot contain digits\n"); return CMD_REJECTED; }
+    addDependency(g, argv[1], argv[2]);
+    return CMD_OK;
+}
+
+static int cmdEvaluate(Graph *g, int argc, char **argv) {
+    int32_t period;
+    if (!optionalPeriod(argc, argv, 1, &period)) return CMD_USAGE;
+    evaluatePerformanceForPeriod(g, period);
+    return CMD_OK;
+}
+
+static int cmdScorecard(Graph *g, int argc, char **argv) {
+    int32_t period;
+    if (!optionalPeriod(argc, argv, 1, &period)) return CMD_USAGE;
+    generateScorecardForPeriod(g, period);
+    return CMD_OK;
+}
+
+/* default length of the worst / best KPI lists */
+#define DISTRIBUTION_TOP 50
+
+static int cmdDistribution(Graph *g, int argc, char **argv) {
+    int k = DISTRIBUTION_TOP;
+    int32_t period;
+    if (argc > 1) {
+        char *end;
+        long v = strtol(argv[1], &end, 10);
+        if (*end != '\0' || v < 0 || v > 100000) { fprintf(stderr, "invalid count '%s'\n", argv[1]); return CMD_USAGE; }
+        k = (int)v;
+    }
+    if (!optionalPeriod(argc, argv, 2, &period)) return CMD_USAGE;
+    showDistribution(g, period, k);
+    return CMD_OK;
+}
+
+/* What-if scenarios from a scenario,perspective,kpi,achieved file (CSV or
+   TSV, optional header row). Consecutive rows with the same scenario name
+   form one scenario; all names point into text. */
+typedef struct ScenarioFile {
+    char *text;
+    Scenario *scenarios;
+    KPIOverride *overrides;
+    int numScenarios;
+} ScenarioFile;
+
+static void freeScenarioFile(ScenarioFile *sf) {
+    free(sf->text);
+    free(sf->scenarios);
+    free(sf->overrides);
+    memset(sf, 0, sizeof(*sf));
+}
+
+/* returns 0, -1 if unreadable, -2 on a malformed row (reported) */
+static int readScenarioFile(const char *path, ScenarioFile *sf) {
+    memset(sf, 0, sizeof(*sf));
+    FILE *f = fopen(path, "rb");
+    if (!f) { fprintf(stderr, "cannot read '%s'\n", path); return -1; }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    sf->text = malloc((size_t)(size > 0 ? size : 0) + 1);
+    if (!sf->text || size < 0 || fread(sf->text, 1, (size_t)size, f) != (size_t)size) {
+        fclose(f);
+        freeScenarioFile(sf);
+        fprintf(stderr, "cannot read '%s'\n", path);
+        return -1;
+    }
+    fclose(f);
+    sf->text[size] = '\0';
+
+    int lines = 1;
+    for (const char *c = sf->text; *c; ++c) lines += *c == '\n';
+    sf->scenarios = malloc((size_t)lines * sizeof(Scenario));
+    sf->overrides = malloc((size_t)lines * sizeof(KPIOverride));
+    if (!sf->scenarios || !sf->overrides) { perror("malloc"); exit(EXIT_FAILURE); }
+
+    int numOverrides = 0, lineNo = 0;
+    for (char *line = sf->text, *next; line; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        lineNo++;
+        line[strcspn(line, "\r")] = '\0';
+        if (line[0] == '\0') continue;
+        char delim = strchr(line, '\t') ? '\t' : ',';
+        char *field[4];
+        int nf = 0;                         /* 5 = too many fields */
+        for (char *p = line; p; ) {
+            if (nf == 4) { nf++; break; }
+            field[nf++] = p;
+            p = strchr(p, delim);
+            if (p) *p++ = '\0';
+        }
+        float achieved;
+        if (nf == 4 && lineNo == 1 && strcmp(field[0], "scenario") == 0 && !parseNumber(field[3], &achieved))
+            continue;                       /* header row */
+        if (nf != 4 || field[0][0] == '\0' || !parseNumber(field[3], &achieved)) {
+            fprintf(stderr, "%s:%d: expected scenario,perspective,kpi,achieved\n", path, lineNo);
+            freeScenarioFile(sf);
+            return -2;
+        }
+        if (sf->numScenarios == 0 || strcmp(sf->scenarios[sf->numScenarios - 1].name, field[0]) != 0) {
+            Scenario *sc = &sf->scenarios[sf->numScenarios++];
+            sc->name = field[0];
+            sc->overrides = &sf->overrides[numOverrides];
+            sc->count = 0;
+        }
+        KPIOverride *ov = &sf->overrides[numOverrides++];
+        ov->perspective = field[1];
+        ov->kpi = field[2];
+        ov->achieved = achieved;
+        sf->scenarios[sf->numScenarios - 1].count++;
+    }
+    return 0;
+}
+
+static int cmdWhatIf(Graph *g, int argc, char **argv) {
+    (void)argc;
+    ScenarioFile sf;
+    int rc = readScenarioFile(argv[1], &sf);
+    if (rc != 0) return rc == -1 ? CMD_IO : CMD_REJECTED;
+    showScenarios(g, sf.scenarios, sf.numScenarios);
+    freeScenarioFile(&sf);
+    return CMD_OK;
+}
+
+static int unitOrComplain(const char *name) {
+    int u = findUnit(&hierarchy, name);
+    if (u == -1) fprintf(stderr, "unknown business unit '%s'\n", name);
+    return u;
+}
+
+static int cmdUnit(Graph *g, int argc, char **argv) {
+    (void)g;
+    const char *parent = argc > 2 ? argv[2] : NULL;
+    if (parent && findUnit(&hierarchy, parent) == -1) { unitOrComplain(parent); return CMD_REJECTED; }
+    if (addUnit(&hierarchy, argv[1], parent) == -1) {
+        fprintf(stderr, "business unit '%s' already exists\n", argv[1]);
+        return CMD_REJECTED;
+    }
+    return CMD_OK;
+}
+
+static int cmdUnitLoad(Graph *g, int argc, char **argv) {
+    (void)g;
+    int u = unitOrComplain(argv[1]);
+    return u == -1 ? CMD_REJECTED : cmdLoad(unitGraph(&hierarchy, u), argc - 1, argv + 1);
+}
+
+static int cmdUnitKPI(Graph *g, int argc, char **argv) {
+    (void)g;
+    int u = unitOrComplain(argv[1]);
+    return u == -1 ? CMD_REJECTED : cmdAddKPI(unitGraph(&hierarchy, u), argc - 1, argv + 1);
+}
+
+static int cmdRollup(Graph *g, int argc, char **argv) {
+    (void)g;
+    int u = -1;
+    int32_t period;
+    if (argc > 1 && strcmp(argv[1], "*") != 0 && (u = unitOrComplain(argv[1])) == -1) return CMD_REJECTED;
+    if (!optionalPeriod(argc, argv, 2, &period)) return CMD_USAGE;
+    rollup(&hierarchy, period);
+    showRollup(&hierarchy, u);
+    return CMD_OK;
+}
+
+static int cmdDump(Graph *g, int argc, char **argv) {
+    (void)argc; (void)argv;
+    displayKPIs(g);
+    return CMD_OK;
+}
+
+static int cmdDeps(Graph *g, int argc, char **argv) {
+    (void)argc; (void)argv;
+    showDependencies(g);
+    return CMD_OK;
+}
+
+static int cmdImpact(Graph *g, int argc, char **argv) {
+    (void)argc; (void)argv;
+    evaluateTransitiveImpact(g);
+    return CMD_OK;
+}
+
+static int cmdTrend(Graph *g, int argc, char **argv) {
+    int32_t period;
+    char *end;
+    long v = strtol(argv[3], &end, 10);
+    if (end == argv[3] || *end != '\0' || v < 1 || v > INT_MAX) {
+        fprintf(stderr, "window must be a positive number\n");
+        return CMD_USAGE;
+    }
+    int window = (int)v;
+    if (!optionalPeriod(argc, argv, 4, &period)) return CMD_USAGE;
+    KPITrend t;
+    if (kpiTrend(g, argv[1], argv[2], period, window, &t) != 0) {
+        fprintf(stderr, "no history for '%s' in '%s'\n", argv[2], argv[1]);
+        return CMD_REJECTED;
+    }
+    showKPITrend(g, argv[1], argv[2], period, window);
+    return CMD_OK;
+}
+
+static int cmdFormat(Graph *g, int argc, char **argv) {
+    (void)argc;
+    int f = parseReportFormat(argv[1]);
+    if (f < 0) { fprintf(stderr, "unknown format '%s'\n", argv[1]); return CMD_USAGE; }
+    setReportFormat(g, (ReportFormat)f);
+    setReportFormat(&hierarchy.perspectives, (ReportFormat)f);
+    return CMD_OK;
+}
+
+static int cmdSave(Graph *g, int argc, char **argv) {
+    (void)argc;
+    return saveSnapshot(g, argv[1]) == 0 ? CMD_OK : CMD_IO;
+}
+
+static int cmdRestore(Graph *g, int argc, char **argv) {
+    (void)argc;
+    int rc = loadSnapshot(g, argv[1]);
+    return rc == 0 ? CMD_OK : rc == -1 ? CMD_IO : CMD_REJECTED;
+}
+
+static int cmdStats(Graph *g, int argc, char **argv) {
+    if (argc == 2 && strcmp(argv[1], "reset") == 0) { resetStats(); return CMD_OK; }
+    if (argc == 2 && strcmp(argv[1], "hist") != 0) {
+        fprintf(stderr, "usage: stats [hist|reset]\n");
+        return CMD_USAGE;
+    }
+    showStats(g, argc == 2);
+    return getStats(NULL) == 0 ? CMD_OK : CMD_REJECTED;
+}
+
+static void printBandEvent(const Graph *g, const BandEvent *ev, void *context) {
+    (void)context;
+    showBandEvent(g, ev);
+}
+
+static int cmdWatch(Graph *g, int argc, char **argv) {
+    (void)argc;
+    if (strcmp(argv[1], "on") == 0) setBandListener(g, printBandEvent, NULL);
+    else if (strcmp(argv[1], "off") == 0) setBandListener(g, NULL, NULL);
+    else { fprintf(stderr, "usage: watch on|off\n"); return CMD_USAGE; }
+    return CMD_OK;
+}
+
+/* reader threads of the query server unless given */
+#define SERVE_READERS 4
+
+static int cmdServe(Graph *g, int argc, char **argv) {
+    int readers = SERVE_READERS;
+    if (argc > 2) {
+        char *end;
+        long v = strtol(argv[2], &end, 10);
+        if (*end != '\0' || v < 1 || v > SERVER_MAX_READERS) {
+            fprintf(stderr, "readers must be 1-%d\n", SERVER_MAX_READERS);
+            return CMD_USAGE;
+        }
+        readers = (int)v;
+    }
+    fflush(stdout);
+    return runServer(g, argv[1], readers) == 0 ? CMD_OK : CMD_IO;
+}
+
+static int cmdHelp(Graph *g, int argc, char **argv);
+
+static const Command commands[] = {
+    { "load",            1, 1, cmdLoad,           "load FILE                 bulk-load a CSV/TSV file" },
+    { "add-perspective", 1, 1, cmdAddPerspective, "add-perspective NAME" },
+    { "add-kpi",         4, 5, cmdAddKPI,         "add-kpi PERSPECTIVE KPI TARGET ACHIEVED [PERIOD]" },
+    { "set-achieved",    3, 3, cmdSetAchieved,    "set-achieved PERSPECTIVE KPI ACHIEVED" },
+    { "delete-kpi",      2, 2, cmdDeleteKPI,      "delete-kpi PERSPECTIVE KPI" },
+    { "duplicates",      1, 1, cmdDuplicates,     "duplicates update|reject|append" },
+    { "add-dep",         2, 2, cmdAddDep,         "add-dep FROM TO" },
+    { "evaluate",        0, 1, cmdEvaluate,       "evaluate [PERIOD]         averages + dependency impact" },
+    { "scorecard",       0, 1, cmdScorecard,      "scorecard [PERIOD]        per-KPI performance" },
+    { "distribution",    0, 2, cmdDistribution,   "distribution [K] [PERIOD] K worst / best KPIs, bands, percentiles" },
+    { "whatif",          1, 1, cmdWhatIf,         "whatif FILE               evaluate scenario,perspective,kpi,achieved overrides" },
+    { "dump",            0, 0, cmdDump,           "dump                      all KPIs" },
+    { "deps",            0, 0, cmdDeps,           "deps                      dependency lists" },
+    { "impact",          0, 0, cmdImpact,         "impact                    transitive dependency impact" },
+    { "trend",           3, 4, cmdTrend,          "trend PERSPECTIVE KPI WINDOW [PERIOD]" },
+    { "format",          1, 1, cmdFormat,         "format color|plain|json|csv" },
+    { "save",            1, 1, cmdSave,           "save FILE                 write a snapshot" },
+    { "restore",         1, 1, cmdRestore,        "restore FILE              replace the scorecard with a snapshot" },
+    { "stats",           0, 1, cmdStats,          "stats [hist|reset]        instrumentation counters (-DBSC_STATS builds)" },
+    { "watch",           1, 1, cmdWatch,          "watch on|off              report band changes as KPIs are edited" },
+    { "serve",           1, 2, cmdServe,          "serve ADDRESS [READERS]   answer queries on a socket until a client sends shutdown" },
+    { "unit",            1, 2, cmdUnit,           "unit NAME [PARENT]        add a business unit scorecard" },
+    { "unit-load",       2, 2, cmdUnitLoad,       "unit-load UNIT FILE       bulk-load a file into a unit" },
+    { "unit-kpi",        5, 6, cmdUnitKPI,        "unit-kpi UNIT PERSPECTIVE KPI TARGET ACHIEVED [PERIOD]" },
+    { "rollup",          0, 2, cmdRollup,         "rollup [UNIT|*] [PERIOD]  roll unit scorecards up the hierarchy" },
+    { "help",            0, 0, cmdHelp,           "help" },
+};
+
+static int cmdHelp(Graph *g, int argc, char **argv) {
+    (void)g; (void)argc; (void)argv;
+    printf("Commands (one per line or --exec argument; quote names with spaces):\n");
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) printf("  %s\n", commands[i].usage);
+    return CMD_OK;
+}
+
+/* split a command line in place: whitespace-separated, "double quotes"
+   group words; returns the word count or -1 on bad quoting */
+static int splitWords(char *line, char **argv, int max) {
+    int argc = 0;
+    char *p = line;
+    for (;;) {
+        while (*p == ' ' || *p == '\t') ++p;
+        if (*p == '\0' || *p == '#') return argc;
+        if (argc == max) return -1;
+        char *out = p;
+        argv[argc++] = out;
+        while (*p && *p != ' ' && *p != '\t') {
+            if (*p == '"') {
+                ++p;
+                while (*p && *p != '"') *out++ = *p++;
+                if (*p != '"') return -1;
+                ++p;
+            } else {
+                *out++ = *p++;
+            }
+        }
+        if (*p) ++p;
+        *out = '\0';
+    }
+}
+
+/* run one command line; where names its source for error messages */
+static int runCommand(Graph *g, char *line, const char *where) {
+    char *argv[CMD_MAX_ARGS];
+    line[strcspn(line, "\r\n")] = '\0';
+    int argc = splitWords(line, argv, CMD_MAX_ARGS);
+    if (argc == 0) return CMD_OK;
+    if (argc < 0) { fprintf(stderr, "%s: unbalanced quotes or too many words\n", where); return CMD_USAGE; }
+    for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); ++i) {
+        const Command *c = &commands[i];
+        if (strcmp(argv[0], c->name) != 0) continue;
+        if (argc - 1 < c->minArgs || argc - 1 > c->maxArgs) {
+            fprintf(stderr, "%s: usage: %s\n", where, c->usage);
+            return CMD_USAGE;
+        }
+        int rc = c->run(g, argc, argv);
+        if (rc != CMD_OK) fprintf(stderr, "%s: '%s' failed (exit code %d)\n", where, argv[0], rc);
+        return rc;
+    }
+    fprintf(stderr, "%s: unknown command '%s' (try 'help')\n", where, argv[0]);
+    return CMD_USAGE;
+}
+
+/* run every line of a script file ("-" = stdin); stops at the first
+   failure unless keepGoing. Returns the first failure's exit code. */
+static int runScript(Graph *g, const char *path, int keepGoing) {
+    FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if (!f) { fprintf(stderr, "cannot read script '%s'\n", path); return CMD_IO; }
+    char line[4096], where[600];
+    int status = CMD_OK;
+    long lineNo = 0;
+    while (fgets(line, sizeof(line), f)) {
+        ++lineNo;
+        snprintf(where, sizeof(where), "%s:%ld", path, lineNo);
+        int rc;
+        if (!strchr(line, '\n') && !feof(f)) {
+            fprintf(stderr, "%s: line too long\n", where);
+            int c;
+            while ((c = fgetc(f)) != '\n' && c != EOF) {}
+            rc = CMD_USAGE;
+        } else {
+            rc = runCommand(g, line, where);
+        }
+        if (rc != CMD_OK && status == CMD_OK) status = rc;
+        if (rc != CMD_OK && !keepGoing) break;
+    }
+    if (f != stdin) fclose(f);
+    return status;
+}
+
+/* finish a session: fold the log into the startup snapshot, release everything */
+static int shutdownScorecard(Graph *g, const char *snapshotPath, int status) {
+    if (snapshotPath && walCheckpoint(g, snapshotPath) != 0 && status == CMD_OK) status = CMD_IO;
+    walClose(g);
+    setEvalThreads(g, 1);
+    freeAll(g);
+    freeHierarchy(&hierarchy);
+    fflush(stdout);
+    return status;
+}
+
+/* usage: bsc [--wal LOG] [--threads N] [--format F] [--no-color]
+              [-c COMMAND]... [--script FILE] [--keep-going] [snapshot-file]
+   With a snapshot file the scorecard is loaded from it at startup (when it
+   exists) and saved back to it on exit. With --wal every change is also
+   appended to LOG, which is replayed over the snapshot at startup and
+   emptied whenever the startup snapshot is saved. --threads sets the
+   worker threads used by period-targeted evaluation. --format selects the
+   report format (color, plain, json, csv); --no-color, or a NO_COLOR
+   environment variable, turns the colour codes off.
+   -c / --exec and --script switch to headless mode: the commands (see
+   'help') run in order without prompts, output is block-buffered, and the
+   exit code is 0, or that of the first failing command: 2 usage, 3 rejected
+   input, 4 file I/O. Status messages then go to stderr, reports to stdout. Execution stops at the first failure unless
+   --keep-going is given. */
+int main(int argc, char **argv) {
+    const char *snapshotPath = NULL;
+    const char *walPath = NULL;
+    int threads = 1;
+    int format = getenv("NO_COLOR") ? REPORT_PLAIN : REPORT_COLOR;
+    int keepGoing = 0;
+    int numSteps = 0;
+    char **steps = calloc((size_t)argc, sizeof(char *));    /* "-c" text or "@" + script path */
+    int *stepIsScript = calloc((size_t)argc, sizeof(int));
+    if (!steps || !stepIsScript) { perror("calloc"); return EXIT_FAILURE; }
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--wal") == 0 && i + 1 < argc) walPath = argv[++i];
+        else if ((strcmp(argv[i], "-c") == 0 || strcmp(argv[i], "--exec") == 0) && i + 1 < argc) steps[numSteps++] = argv[++i];
+        else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) { stepIsScript[numSteps] = 1; steps[numSteps++] = argv[++i]; }
+        else if (strcmp(argv[i], "--keep-going") == 0) keepGoing = 1;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc && parseReportFormat(argv[i + 1]) >= 0) format = parseReportFormat(argv[++i]);
+        else if (strcmp(argv[i], "--no-color") == 0) { if (format == REPORT_COLOR) format = REPORT_PLAIN; }
+        else if (argv[i][0] != '-' && !snapshotPath) snapshotPath = argv[i];
+        else {
+            printf("usage: %s [--wal LOG] [--threads N] [--format color|plain|json|csv] [--no-color]\n"
+                   "       [-c COMMAND]... [--script FILE|-] [--keep-going] [snapshot-file]\n", argv[0]);
+            return CMD_USAGE;
+        }
+    }
+    if (numSteps > 0) setMessageStream(stderr);   /* headless: stdout carries only the reports */
+    Graph g;
+    initGraph(&g);
+    setEvalThreads(&g, threads);
+    setReportFormat(&g, (ReportFormat)format);
+    initHierarchy(&hierarchy);
+    setRollupThreads(&hierarchy, threads);
+    setReportFormat(&hierarchy.perspectives, (ReportFormat)format);
+    FILE *existing = snapshotPath ? fopen(snapshotPath, "rb") : NULL;
+    if (existing) {
+        fclose(existing);
+        if (loadSnapshot(&g, snapshotPath) != 0) {
+            printf("Refusing to start with an unreadable snapshot.\n");
+            return EXIT_FAILURE;
+        }
+    } else {
+    addPerspectiveIfNotExists(&g, "Financial");
+addPerspectiveIfNotExists(&g, "Customer");
+addPerspectiveIfNotExists(&g, "Internal");
+addPerspectiveIfNotExists(&g, "Learning");
+    }
+    if (walPath && walOpen(&g, walPath) < 0) {
+        printf("Refusing to start with an unusable write-ahead log.\n");
+        freeAll(&g);
+        return EXIT_FAILURE;
+    }
+/* default dependencies so the app has some initial working data */
+
+    if (numSteps > 0) {
+        /* headless: no menu, no prompts, output flushed in large blocks */
+        static char outBuf[1 << 16];
+        setvbuf(stdout, outBuf, _IOFBF, sizeof(outBuf));
+        int status = CMD_OK;
+        for (int s = 0; s < numSteps && (status == CMD_OK || keepGoing); ++s) {
+            int rc;
+            if (stepIsScript[s]) {
+                rc = runScript(&g, steps[s], keepGoing);
+            } else {
+                char line[4096], where[32];
+                snprintf(line, sizeof(line), "%s", steps[s]);
+                snprintf(where, sizeof(where), "-c #%d", s + 1);
+                rc = runCommand(&g, line, where);
+            }
+            if (walCommit(&g) != 0 && rc == CMD_OK) rc = CMD_IO;   /* group commits cover the rest */
+            if (rc != CMD_OK && status == CMD_OK) status = rc;
+        }
+        free(steps);
+        free(stepIsScript);
+        return shutdownScorecard(&g, snapshotPath, status);
+    }
+    free(steps);
+    free(stepIsScript);
+
+    int choice;
+    while (1) {
+        walCommit(&g);  /* make the previous command's changes durable */
+        printf("\n=== Balanced Scorecard System ===\n");
+        printf("1. Add Key Performance Indicator (KPI)\n");
+        printf("2. View All KPIs\n");
+        printf("3. Generate Scorecard (per-KPI performance)\n");
+        printf("4. Show Dependencies\n");
+        printf("5. Evaluate Performance (averages + dependency impact + lowest performer)\n");
+        printf("6. Add Dependency Between Perspectives\n");
+        printf("7. Load KPIs from CSV/TSV File\n");
+        printf("8. Evaluate Transitive Dependency Impact (cycles + downstream reach)\n");
+        printf("9. Save Snapshot\n");
+        printf("10. Load Snapshot\n");
+        printf("11. Record KPI Value for a Period\n");
+        printf("12. Scorecard + Evaluation for a Period\n");
+        printf("13. KPI Trend (rolling window)\n");
+        printf("14. Core Statistics\n");
+        printf("15. KPI Distribution (worst / best KPIs, bands, percentiles)\n");
+        printf("16. Add Business Unit (scorecard from a CSV/TSV file)\n");
+        printf("17. Business Unit Roll-up\n");
+        printf("18. What-if Scenarios (overrides from a CSV/TSV file)\n");
+        printf("0. Exit\n");
+        printf("Enter your choice: ");
+        int got = scanf("%d", &choice);
+        if (got == EOF) {
+            printf("\nEnd of input, exiting...\n");
+            return shutdownScorecard(&g, snapshotPath, 0);
+        }
+        if (got != 1) {
+            printf("Invalid input.\n");
+            discardLine(); // clear buffer
+            continue;
+        }
+        discardLine(); // consume leftover newline
+
+        switch (choice) {
+            case 1:
+                /* add KPI (interactive) */
+                addKPI(&g);
+                break;
+            case 2:
+                /* display all KPIs */
+                displayKPIs(&g);
+                break;
+            case 3:
+                /* generate per-KPI scorecard */
+                generateScorecard(&g);
+                break;
+            case 4:
+                /* show graph dependencies */
+                showDependencies(&g);
+                break;
+            case 5:
+                /* evaluate performance with dependency analysis */
+                evaluatePerformanceWithDependencies(&g);
+                break;
+            case 6: {
+                /* interactive dependency input, then call addDependency(graph, from, to) */
+                char a[MAX_NAME_LEN], b[MAX_NAME_LEN];
+
+                printf("\nAdd Dependency: A dependency edge A -> B means 'if A performs poorly, it may negatively impact B'.\n");
+                printf("Example: Learning -> Internal means poor Learning may lead to weaker Internal processes.\n\n");
+                
+
+                displayPerspectives(&g);
+                if (g.numNodes == 0) {
+                    printf("No perspectives exist yet. Add a perspective by adding a KPI with a new perspective name first.\n");
+                    break;
+                }
+
+                printf("Enter source perspective (from). You can type the number shown to pick an existing one, or type a NEW name (letters and spaces only): ");
+                if (!fgets(a, sizeof(a), stdin)) break;
+                a[strcspn(a, "\r\n")] = '\0';
+                if (a[0] == '\0') { printf("Source cannot be empty.\n"); break; }
+
+                printf("Enter destination perspective (to). You can type the number shown to pick an existing one, or type a NEW name (letters and spaces only): ");
+                if (!fgets(b, sizeof(b), stdin)) break;
+                b[strcspn(b, "\r\n")] = '\0';
+                if (b[0] == '\0') { printf("Destination cannot be empty.\n"); break; }
+
+                /* Interpret numeric selection or add new name after validation */
+                if (isdigit((unsigned char)a[0])) {
+                    int idx = atoi(a);
+                    if (idx <= 0 || idx > g.numNodes) { printf("Invalid source selection number.\n"); break; }
+                    strcpy(a, g.nodes[idx - 1]);
+                } else {
+                    /* new name should not contain digits */
+                    int bad = 0;
+                    for (char *p = a; *p; ++p) if (isdigit((unsigned char)*p)) { bad = 1; break; }
+                    if (bad) { printf("Perspective names should not contain digits.\n"); break; }
+                    addPerspectiveIfNotExists(&g, a);
+                }
+
+                if (isdigit((unsigned char)b[0])) {
+                    int idx = atoi(b);
+                    if (idx <= 0 || idx > g.numNodes) { printf("Invalid destination selection number.\n"); break; }
+                    strcpy(b, g.nodes[idx - 1]);
+                } else {
+                    int bad = 0;
+                    for (char *p = b; *p; ++p) if (isdigit((unsigned char)*p)) { bad = 1; break; }
+                    if (bad) { printf("Perspective names should not contain digits.\n"); break; }
+                    addPerspectiveIfNotExists(&g, b);
+                }
+
+                /* call the core graph function that takes (graph, from, to) */
+                addDependency(&g, a, b);
+                break;
+            }
+            case 7: {
+                /* bulk load perspective,kpi,target,achieved[,period] rows from a file */
+                char path[512];
+                printf("Enter path of CSV/TSV file (perspective,kpi,target,achieved[,period]): ");
+                if (!fgets(path, sizeof(path), stdin)) break;
+                path[strcspn(path, "\r\n")] = '\0';
+                if (path[0] == '\0') { printf("Path cannot be empty.\n"); break; }
+                loadKPIsFromFile(&g, path, NULL);
+                break;
+            }
+            case 8:
+                /* follow dependencies end to end from every weak perspective */
+                evaluateTransitiveImpact(&g);
+                break;
+            case 9:
+            case 10: {
+                /* persist to / restore from a binary snapshot file */
+                char path[512];
+                printf("Enter snapshot file path%s: ", snapshotPath ? " (blank = startup file)" : "");
+                if (!fgets(path, sizeof(path), stdin)) break;
+                path[strcspn(path, "\r\n")] = '\0';
+                if (path[0] == '\0') {
+                    if (!snapshotPath) { printf("Path cannot be empty.\n"); break; }
+                    strncpy(path, snapshotPath, sizeof(path) - 1);
+                    path[sizeof(path) - 1] = '\0';
+                }
+                if (choice == 10) loadSnapshot(&g, path);
+                else if (snapshotPath && strcmp(path, snapshotPath) == 0) walCheckpoint(&g, path);
+                else saveSnapshot(&g, path);
+                break;
+            }
+            case 11: {
+                /* one dated observation; the KPI's current values follow its latest period */
+                char pers[MAX_NAME_LEN], name[MAX_KPI_NAME_LEN], line[64];
+                int32_t period;
+                float target, achieved;
+                if (!promptLine("Enter Perspective name: ", pers, sizeof(pers))) { printf("Perspective name cannot be empty.\n"); break; }
+                if (!promptLine("Enter KPI name: ", name, sizeof(name))) { printf("KPI name cannot be empty.\n"); break; }
+                if (!promptPeriod("Enter period (e.g. 202541 for 2025 week 41): ", &period)) break;
+                if (period == PERIOD_LATEST) { printf("A period is required.\n"); break; }
+                if (!promptLine("Enter Target value (1-100): ", line, sizeof(line)) || sscanf(line, "%f", &target) != 1) { printf("Invalid target.\n"); break; }
+                if (!promptLine("Enter Achieved value: ", line, sizeof(line)) || sscanf(line, "%f", &achieved) != 1) { printf("Invalid achieved value.\n"); break; }
+                if (recordKPIObservation(&g, pers, name, period, target, achieved) != 0)
+                    printf("Rejected: check the names (no digits in perspective names), target 1-100 and achieved >= 0.\n");
+                else
+                    printf("Recorded '%s' for period %d under '%s'.\n", name, (int)period, pers);
+                break;
+            }
+            case 12: {
+                int32_t period;
+                if (!promptPeriod("Enter period (blank = latest): ", &period)) break;
+                generateScorecardForPeriod(&g, period);
+                evaluatePerformanceForPeriod(&g, period);
+                break;
+            }
+            case 13: {
+                char pers[MAX_NAME_LEN], name[MAX_KPI_NAME_LEN], line[32];
+                int32_t period;
+                int window = 0;
+                if (!promptLine("Enter Perspective name: ", pers, sizeof(pers))) { printf("Perspective name cannot be empty.\n"); break; }
+                if (!promptLine("Enter KPI name: ", name, sizeof(name))) { printf("KPI name cannot be empty.\n"); break; }
+                if (!promptLine("Window size in periods (e.g. 4, 13, 52): ", line, sizeof(line)) ||
+                    sscanf(line, "%d", &window) != 1 || window < 1) { printf("Invalid window.\n"); break; }
+                if (!promptPeriod("Window ends at period (blank = latest): ", &period)) break;
+                showKPITrend(&g, pers, name, period, window);
+                break;
+            }
+            case 14: {
+                char line[8];
+                int hist = promptLine("Show latency histograms? (y/N): ", line, sizeof(line)) &&
+                           (line[0] == 'y' || line[0] == 'Y');
+                showStats(&g, hist);
+                break;
+            }
+            case 15: {
+                char line[32];
+                int k = DISTRIBUTION_TOP;
+                int32_t period;
+                if (promptLine("How many worst / best KPIs? (blank = 50): ", line, sizeof(line)) &&
+                    (sscanf(line, "%d", &k) != 1 || k < 0 || k > 100000)) { printf("Invalid count.\n"); break; }
+                if (!promptPeriod("Enter period (blank = latest): ", &period)) break;
+                showDistribution(&g, period, k);
+                break;
+            }
+            case 16: {
+                char name[MAX_NAME_LEN], parent[MAX_NAME_LEN], path[1024];
+                if (!promptLine("Business unit name: ", name, sizeof(name))) { printf("Unit name cannot be empty.\n"); break; }
+                if (!promptLine("Parent unit (blank = top level): ", parent, sizeof(parent))) parent[0] = '\0';
+                int u = addUnit(&hierarchy, name, parent);
+                if (u == -1) { printf("Unit exists already or the parent is unknown.\n"); break; }
+                if (promptLine("File to load (blank = none): ", path, sizeof(path)))
+                    loadKPIsFromFile(unitGraph(&hierarchy, u), path, NULL);
+                break;
+            }
+            case 17: {
+                int32_t period;
+                if (!promptPeriod("Enter period (blank = latest): ", &period)) break;
+                int n = rollup(&hierarchy, period);
+                showRollup(&hierarchy, -1);
+                printf("(%d unit totals recomputed)\n", n);
+                break;
+            }
+            case 18: {
+                char path[1024];
+                ScenarioFile sf;
+                if (!promptLine("Scenario file (scenario,perspective,kpi,achieved): ", path, sizeof(path))) break;
+                if (readScenarioFile(path, &sf) != 0) break;
+                showScenarios(&g, sf.scenarios, sf.numScenarios);
+                freeScenarioFile(&sf);
+                break;
+            }
+            case 0:
+                printf("Exiting program...\n");
+                exit(shutdownScorecard(&g, snapshotPath, 0));
+            default:
+                printf("Invalid choice. Please select 0 to exit or 1–18.\n");
+        }
+    }
+
+    return 0;
+}